@@ -9,13 +9,21 @@ LOCAL_SRC_FILES := \
         QCameraMem.cpp \
         ../util/QCameraQueue.cpp \
         ../util/QCameraCmdThread.cpp \
+        ../util/QCameraPlaneCopy.cpp \
+        ../util/QCameraRawFormat.cpp \
+        ../util/QCameraFrameDumper.cpp \
+        ../util/QCameraStreamStats.cpp \
         QCameraStateMachine.cpp \
         QCameraChannel.cpp \
         QCameraStream.cpp \
         QCameraPostProc.cpp \
         QCamera2HWICallbacks.cpp \
         QCameraParameters.cpp \
-        QCameraThermalAdapter.cpp
+        ../util/QCameraThermalAdapter.cpp
+
+# NEON raw kernels are picked at runtime, build them with NEON on 32 bit too
+LOCAL_SRC_FILES_arm += ../util/QCameraRawFormatNeon.cpp.neon
+LOCAL_SRC_FILES_arm64 += ../util/QCameraRawFormatNeon.cpp
 
 LOCAL_CFLAGS = -Wall -Werror -DDEFAULT_ZSL_MODE_ON -DDEFAULT_DENOISE_MODE_ON
 #Debug logs are enabled
@@ -32,6 +32,7 @@
 #include <cutils/properties.h>
 #include <hardware/camera.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <utils/Errors.h>
 #include <gralloc_priv.h>
 
@@ -46,6 +47,8 @@
 namespace qcamera {
 
 cam_capability_t *gCamCapability[MM_CAMERA_MAX_NUM_SENSORS];
+// read only parameters built from capability, shared by every open
+static CameraParameters *gCamCapParams[MM_CAMERA_MAX_NUM_SENSORS];
 static pthread_mutex_t g_camlock = PTHREAD_MUTEX_INITIALIZER;
 
 camera_device_ops_t QCamera2HardwareInterface::mCameraOps = {
@@ -933,7 +936,10 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
       m_bStartZSLSnapshotCalled(false),
       m_pPowerModule(NULL),
       mDumpFrmCnt(0),
-      mDumpSkipCnt(0)
+      mDumpSkipCnt(0),
+      m_bDumpEnabled(false),
+      m_bRawUnpack16(false),
+      m_pRaw16Converter(NULL)
 {
     mCameraDevice.common.tag = HARDWARE_DEVICE_TAG;
     mCameraDevice.common.version = HARDWARE_DEVICE_API_VERSION(1, 0);
@@ -972,6 +978,10 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
 QCamera2HardwareInterface::~QCamera2HardwareInterface()
 {
     closeCamera();
+    if (m_pRaw16Converter != NULL) {
+        delete m_pRaw16Converter;
+        m_pRaw16Converter = NULL;
+    }
     pthread_mutex_destroy(&m_lock);
     pthread_cond_destroy(&m_cond);
     pthread_mutex_destroy(&m_evtLock);
@@ -1052,7 +1062,16 @@ int QCamera2HardwareInterface::openCamera()
         gCamCapability[mCameraId]->padding_info.plane_padding = padding_info.plane_padding;
     }
 
-    mParameters.init(gCamCapability[mCameraId], mCameraHandle);
+    pthread_mutex_lock(&g_camlock);
+    if (NULL == gCamCapParams[mCameraId]) {
+        gCamCapParams[mCameraId] = new CameraParameters();
+        QCameraParameters::initCapabilityParameters(gCamCapability[mCameraId],
+                                                    *gCamCapParams[mCameraId]);
+    }
+    pthread_mutex_unlock(&g_camlock);
+
+    mParameters.init(gCamCapability[mCameraId], mCameraHandle,
+                     gCamCapParams[mCameraId]);
 
     rc = m_thermalAdapter.init(this);
     if (rc != 0) {
@@ -1089,6 +1108,9 @@ int QCamera2HardwareInterface::closeCamera()
 
     m_thermalAdapter.deinit();
 
+    // write out pending debug dumps
+    m_frameDumper.stop();
+
     // delete all channels if not already deleted
     for (i = 0; i < QCAMERA_CH_TYPE_MAX; i++) {
         if (m_channels[i] != NULL) {
@@ -1384,9 +1406,29 @@ QCameraMemory *QCamera2HardwareInterface::allocateStreamBuf(cam_stream_type_t st
             mem = grallocMemory;
         }
         break;
+    case CAM_STREAM_TYPE_RAW:
+        {
+            char value[PROPERTY_VALUE_MAX];
+            property_get("persist.camera.raw.unpack16", value, "0");
+            m_bRawUnpack16 = (atoi(value) > 0);
+            if (m_bRawUnpack16) {
+                // raw frames are unpacked in place, make room for RAW16
+                cam_dimension_t dim;
+                mParameters.getStreamDimension(stream_type, dim);
+                int raw16Size = ((dim.width + 15) & ~15) * 2 * dim.height;
+                if (size < raw16Size) {
+                    size = raw16Size;
+                }
+                if (m_pRaw16Converter == NULL) {
+                    m_pRaw16Converter = new QCameraRaw16Converter();
+                }
+            }
+            ALOGD("%s: raw unpack to RAW16 = %d", __func__, m_bRawUnpack16);
+            mem = new QCameraStreamMemory(mGetMemory, bCachedMem);
+        }
+        break;
     case CAM_STREAM_TYPE_SNAPSHOT:
     case CAM_STREAM_TYPE_NON_ZSL_SNAPSHOT:
-    case CAM_STREAM_TYPE_RAW:
     case CAM_STREAM_TYPE_METADATA:
     case CAM_STREAM_TYPE_OFFLINE_PROC:
         mem = new QCameraStreamMemory(mGetMemory, bCachedMem);
@@ -2253,10 +2295,28 @@ int QCamera2HardwareInterface::release()
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int QCamera2HardwareInterface::dump(int /*fd*/)
+int QCamera2HardwareInterface::dump(int fd)
 {
-    ALOGE("%s: not supported yet", __func__);
-    return INVALID_OPERATION;
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "Camera %d stream stats:\n", mCameraId);
+    if (write(fd, buf, len) != len) {
+        ALOGE("%s: failed to write to fd %d", __func__, fd);
+        return UNKNOWN_ERROR;
+    }
+
+    for (int i = 0; i < QCAMERA_CH_TYPE_MAX; i++) {
+        QCameraChannel *channel = m_channels[i];
+        if (channel == NULL) {
+            continue;
+        }
+        for (uint8_t j = 0; j < channel->getNumOfStreams(); j++) {
+            QCameraStream *stream = channel->getStreamByIndex(j);
+            if (stream != NULL) {
+                stream->dump(fd);
+            }
+        }
+    }
+    return NO_ERROR;
 }
 
 /*===========================================================================
@@ -3860,8 +3920,7 @@ int QCamera2HardwareInterface::updateThermalLevel(
 int QCamera2HardwareInterface::updateParameters(const char *parms, bool &needRestart)
 {
     String8 str = String8(parms);
-    QCameraParameters param(str);
-    return mParameters.updateParameters(param, needRestart);
+    return mParameters.updateParameters(str, needRestart);
 }
 
 /*===========================================================================
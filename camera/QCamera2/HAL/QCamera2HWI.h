@@ -43,6 +43,8 @@
 #include "QCameraAllocator.h"
 #include "QCameraPostProc.h"
 #include "QCameraThermalAdapter.h"
+#include "QCameraRawFormat.h"
+#include "QCameraFrameDumper.h"
 
 extern "C" {
 #include <mm_camera_interface.h>
@@ -104,6 +106,9 @@ typedef struct {
 #define QCAMERA_ION_USE_CACHE   true
 #define QCAMERA_ION_USE_NOCACHE false
 
+#define MAX_NOTIFY_QUEUE_SIZE   256
+#define MAX_PACKED_PREVIEW_BUFS 4
+
 typedef enum {
     QCAMERA_NOTIFY_CALLBACK,
     QCAMERA_DATA_CALLBACK,
@@ -135,11 +140,23 @@ public:
                           mDataCbTimestamp (NULL),
                           mCallbackCookie (NULL),
                           mParent (parent),
-                          mDataQ(releaseNotifications, this) {}
+                          mDataQ(releaseNotifications, this,
+                                 QCAMERA_QUEUE_MODE_RING,
+                                 MAX_NOTIFY_QUEUE_SIZE),
+                          mPackedBufSize(0)
+    {
+        memset(mPackedBufs, 0, sizeof(mPackedBufs));
+        memset(mPackedBufBusy, 0, sizeof(mPackedBufBusy));
+        pthread_mutex_init(&mPackedLock, NULL);
+    }
 
     virtual ~QCameraCbNotifier();
 
     virtual int32_t notifyCallback(qcamera_callback_argm_t &cbArgs);
+    int32_t notifyPackedPreviewFrame(const uint8_t *frame,
+                                     cam_format_t fmt,
+                                     const cam_dimension_t &dim,
+                                     const cam_frame_len_offset_t &offset);
     virtual void setCallbacks(camera_notify_callback notifyCb,
                               camera_data_callback dataCb,
                               camera_data_timestamp_callback dataCbTimestamp,
@@ -150,6 +167,8 @@ public:
     static void releaseNotifications(void *data, void *user_data);
     static bool matchSnapshotNotifications(void *data, void *user_data);
 private:
+    static void releasePackedBuffer(void *data, void *cookie);
+    void releasePackedBuffers();
 
     camera_notify_callback         mNotifyCb;
     camera_data_callback           mDataCb;
@@ -159,6 +178,13 @@ private:
 
     QCameraQueue     mDataQ;
     QCameraCmdThread mProcTh;
+
+    // recycled heap buffers for packed preview callbacks. Filled on the
+    // stream thread, busy until the callback thread has delivered them.
+    camera_memory_t *mPackedBufs[MAX_PACKED_PREVIEW_BUFS];
+    bool             mPackedBufBusy[MAX_PACKED_PREVIEW_BUFS];
+    int              mPackedBufSize;
+    pthread_mutex_t  mPackedLock;
 };
 class QCamera2HardwareInterface : public QCameraAllocator,
                                     public QCameraThermalCallback
@@ -280,8 +306,8 @@ private:
     bool isCACEnabled();
     bool needReprocess();
     bool needRotationReprocess();
-    void debugShowVideoFPS();
-    void debugShowPreviewFPS();
+    void debugShowVideoFPS(QCameraStream *stream);
+    void debugShowPreviewFPS(QCameraStream *stream);
     void dumpFrameToFile(const void *data, uint32_t size,
                          int index, int dump_type);
     void releaseSuperBuf(mm_camera_super_buf_t *super_buf);
@@ -429,6 +455,13 @@ private:
 
     int mDumpFrmCnt;  // frame dump count
     int mDumpSkipCnt; // frame skip count
+    QCameraFrameDumper m_frameDumper; // async frame dump writer
+    bool m_bDumpEnabled; // dump mask was on at the last dump check
+
+    // raw stream frames are unpacked to RAW16 before raw callback,
+    // set from persist.camera.raw.unpack16 when raw buffers are allocated
+    bool m_bRawUnpack16;
+    QCameraRaw16Converter *m_pRaw16Converter;
 };
 
 }; // namespace qcamera
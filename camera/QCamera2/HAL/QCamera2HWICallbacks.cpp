@@ -33,6 +33,7 @@
 #include <utils/Errors.h>
 #include <utils/Timers.h>
 #include "QCamera2HWI.h"
+#include "QCameraPlaneCopy.h"
 
 namespace qcamera {
 
@@ -277,73 +278,80 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
     }
 
     if (pme->needDebugFps()) {
-        pme->debugShowPreviewFPS();
+        pme->debugShowPreviewFPS(stream);
     }
 
     int idx = frame->buf_idx;
     pme->dumpFrameToFile(frame->buffer, frame->frame_len,
                          frame->frame_idx, QCAMERA_DUMP_FRM_PREVIEW);
 
-    // Display the buffer.
-    int dequeuedIdx = memory->displayBuffer(idx);
-    if (dequeuedIdx < 0 || dequeuedIdx >= memory->getCnt()) {
-        ALOGD("%s: Invalid dequeued buffer index %d from display",
-              __func__, dequeuedIdx);
-    } else {
-        // Return dequeued buffer back to driver
-        err = stream->bufDone(dequeuedIdx);
-        if ( err < 0) {
-            ALOGE("stream bufDone failed %d", err);
-        }
-    }
-
     // Handle preview data callback
     if (pme->mDataCb != NULL && pme->msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0) {
-        camera_memory_t *previewMem = NULL;
         camera_memory_t *data = NULL;
+        void *cbMemRef = NULL;
         int previewBufSize;
         cam_dimension_t preview_dim;
         cam_format_t previewFmt;
         stream->getFrameDimension(preview_dim);
         stream->getFormat(previewFmt);
 
-        /* The preview buffer size in the callback should be (width*height*bytes_per_pixel)
-         * As all preview formats we support, use 12 bits per pixel, buffer size = previewWidth * previewHeight * 3/2.
-         * We need to put a check if some other formats are supported in future. */
-        if ((previewFmt == CAM_FORMAT_YUV_420_NV21) ||
-            (previewFmt == CAM_FORMAT_YUV_420_NV12) ||
-            (previewFmt == CAM_FORMAT_YUV_420_YV12)) {
-            if(previewFmt == CAM_FORMAT_YUV_420_YV12) {
-                previewBufSize = ((preview_dim.width+15)/16) * 16 * preview_dim.height +
-                                 ((preview_dim.width/2+15)/16) * 16* preview_dim.height;
-                } else {
-                    previewBufSize = preview_dim.width * preview_dim.height * 3/2;
-                }
-            if(previewBufSize != memory->getSize(idx)) {
-                previewMem = pme->mGetMemory(memory->getFd(idx),
-                           previewBufSize, 1, pme->mCallbackCookie);
-                if (!previewMem || !previewMem->data) {
-                    ALOGE("%s: mGetMemory failed.\n", __func__);
-                } else {
-                    data = previewMem;
-                }
-            } else
-                data = memory->getMemory(idx, false);
+        if (pme->mParameters.isPreviewCbPacked() &&
+            ((previewFmt == CAM_FORMAT_YUV_420_NV21) ||
+             (previewFmt == CAM_FORMAT_YUV_420_NV12) ||
+             (previewFmt == CAM_FORMAT_YUV_420_YV12))) {
+            // copied out now, the buffer goes to display right after
+            cam_frame_len_offset_t offset;
+            memset(&offset, 0, sizeof(cam_frame_len_offset_t));
+            stream->getFrameOffset(offset);
+            pme->m_cbNotifier.notifyPackedPreviewFrame(
+                (const uint8_t *)frame->buffer, previewFmt, preview_dim, offset);
         } else {
-            data = memory->getMemory(idx, false);
-            ALOGE("%s: Invalid preview format, buffer size in preview callback may be wrong.", __func__);
+            /* The preview buffer size in the callback should be (width*height*bytes_per_pixel)
+             * As all preview formats we support, use 12 bits per pixel, buffer size = previewWidth * previewHeight * 3/2.
+             * We need to put a check if some other formats are supported in future. */
+            if ((previewFmt == CAM_FORMAT_YUV_420_NV21) ||
+                (previewFmt == CAM_FORMAT_YUV_420_NV12) ||
+                (previewFmt == CAM_FORMAT_YUV_420_YV12)) {
+                if(previewFmt == CAM_FORMAT_YUV_420_YV12) {
+                    previewBufSize = ((preview_dim.width+15)/16) * 16 * preview_dim.height +
+                                     ((preview_dim.width/2+15)/16) * 16* preview_dim.height;
+                    } else {
+                        previewBufSize = preview_dim.width * preview_dim.height * 3/2;
+                    }
+                if(previewBufSize != memory->getSize(idx)) {
+                    // cached per buffer by memory obj, ref dropped after callback
+                    data = memory->getCallbackMemory(idx, previewBufSize, &cbMemRef);
+                } else
+                    data = memory->getMemory(idx, false);
+            } else {
+                data = memory->getMemory(idx, false);
+                ALOGE("%s: Invalid preview format, buffer size in preview callback may be wrong.", __func__);
+            }
+            qcamera_callback_argm_t cbArg;
+            memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
+            cbArg.cb_type = QCAMERA_DATA_CALLBACK;
+            cbArg.msg_type = CAMERA_MSG_PREVIEW_FRAME;
+            cbArg.data = data;
+            cbArg.cookie = pme;
+            if (cbMemRef != NULL) {
+                cbArg.user_data = cbMemRef;
+                cbArg.release_cb = QCameraGrallocMemory::putCallbackMemory;
+            }
+            pme->m_cbNotifier.notifyCallback(cbArg);
         }
-        qcamera_callback_argm_t cbArg;
-        memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
-        cbArg.cb_type = QCAMERA_DATA_CALLBACK;
-        cbArg.msg_type = CAMERA_MSG_PREVIEW_FRAME;
-        cbArg.data = data;
-        if ( previewMem ) {
-            cbArg.user_data = previewMem;
-            cbArg.release_cb = releaseCameraMemory;
+    }
+
+    // Display the buffer.
+    int dequeuedIdx = memory->displayBuffer(idx);
+    if (dequeuedIdx < 0 || dequeuedIdx >= memory->getCnt()) {
+        ALOGD("%s: Invalid dequeued buffer index %d from display",
+              __func__, dequeuedIdx);
+    } else {
+        // Return dequeued buffer back to driver
+        err = stream->bufDone(dequeuedIdx);
+        if ( err < 0) {
+            ALOGE("stream bufDone failed %d", err);
         }
-        cbArg.cookie = pme;
-        pme->m_cbNotifier.notifyCallback(cbArg);
     }
 
     free(super_frame);
@@ -397,7 +405,7 @@ void QCamera2HardwareInterface::nodisplay_preview_stream_cb_routine(
     }
 
     if (pme->needDebugFps()) {
-        pme->debugShowPreviewFPS();
+        pme->debugShowPreviewFPS(stream);
     }
 
     QCameraMemory *previewMemObj = (QCameraMemory *)frame->mem_info;
@@ -518,7 +526,7 @@ void QCamera2HardwareInterface::postview_stream_cb_routine(mm_camera_super_buf_t
  *             (release_recording_frame) to return the frame back
  *==========================================================================*/
 void QCamera2HardwareInterface::video_stream_cb_routine(mm_camera_super_buf_t *super_frame,
-                                                        QCameraStream */*stream*/,
+                                                        QCameraStream *stream,
                                                         void *userdata)
 {
     ALOGD("[KPI Perf] %s : BEGIN", __func__);
@@ -534,7 +542,7 @@ void QCamera2HardwareInterface::video_stream_cb_routine(mm_camera_super_buf_t *s
     mm_camera_buf_def_t *frame = super_frame->bufs[0];
 
     if (pme->needDebugFps()) {
-        pme->debugShowVideoFPS();
+        pme->debugShowVideoFPS(stream);
     }
 
     ALOGE("%s: Stream(%d), Timestamp: %ld %ld",
@@ -626,7 +634,7 @@ void QCamera2HardwareInterface::snapshot_stream_cb_routine(mm_camera_super_buf_t
  *             back to kernel, and frame will be free after use.
  *==========================================================================*/
 void QCamera2HardwareInterface::raw_stream_cb_routine(mm_camera_super_buf_t * super_frame,
-                                                      QCameraStream * /*stream*/,
+                                                      QCameraStream * stream,
                                                       void * userdata)
 {
     ALOGD("[KPI Perf] %s : BEGIN", __func__);
@@ -640,6 +648,32 @@ void QCamera2HardwareInterface::raw_stream_cb_routine(mm_camera_super_buf_t * su
         return;
     }
 
+    if (pme->m_bRawUnpack16 && pme->m_pRaw16Converter != NULL &&
+        stream != NULL && super_frame->bufs[0] != NULL) {
+        // buffers were allocated with room for RAW16, unpack in place
+        cam_format_t fmt = CAM_FORMAT_MAX;
+        qcamera_raw_packing_t packing = RAW_PACKING_QCOM_10;
+        stream->getFormat(fmt);
+        if (getRawPacking(fmt, packing)) {
+            cam_dimension_t dim;
+            cam_frame_len_offset_t offset;
+            memset(&dim, 0, sizeof(dim));
+            memset(&offset, 0, sizeof(offset));
+            stream->getFrameDimension(dim);
+            stream->getFrameOffset(offset);
+            int raw16Stride = (dim.width + 15) & ~15;
+            // frame_len tells postproc how much of the buffer to dump
+            if (pme->m_pRaw16Converter->convert(super_frame->bufs[0]->buffer,
+                                                dim.width, dim.height,
+                                                offset.mp[0].stride,
+                                                raw16Stride, packing)) {
+                super_frame->bufs[0]->frame_len = raw16Stride * 2 * dim.height;
+            } else {
+                super_frame->bufs[0]->frame_len = offset.frame_len;
+            }
+        }
+    }
+
     pme->m_postprocessor.processRawData(super_frame);
     ALOGD("[KPI Perf] %s : END", __func__);
 }
@@ -792,6 +826,8 @@ void QCamera2HardwareInterface::reprocess_stream_cb_routine(mm_camera_super_buf_
  * FUNCTION   : dumpFrameToFile
  *
  * DESCRIPTION: helper function to dump frame into file for debug purpose.
+ *              Frame is queued to m_frameDumper, file I/O is not done on
+ *              the calling thread.
  *
  * PARAMETERS :
  *    @data : data ptr
@@ -808,9 +844,7 @@ void QCamera2HardwareInterface::dumpFrameToFile(const void *data,
                                                 int index,
                                                 int dump_type)
 {
-    char value[PROPERTY_VALUE_MAX];
-    property_get("persist.camera.dumpimg", value, "0");
-    int32_t enabled = atoi(value);
+    int32_t enabled = m_frameDumper.getDumpMask();
     int frm_num = 0;
     uint32_t skip_mode = 0;
 
@@ -820,6 +854,9 @@ void QCamera2HardwareInterface::dumpFrameToFile(const void *data,
     memset(&dim, 0, sizeof(dim));
 
     if(enabled & QCAMERA_DUMP_FRM_MASK_ALL) {
+        if (!__atomic_load_n(&m_bDumpEnabled, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&m_bDumpEnabled, true, __ATOMIC_RELAXED);
+        }
         if((enabled & dump_type) && data) {
             frm_num = ((enabled & 0xffff0000) >> 16);
             if(frm_num == 0) {
@@ -894,15 +931,8 @@ void QCamera2HardwareInterface::dumpFrameToFile(const void *data,
                         return;
                     }
 
-                    ALOGD("dump %s size =%d, data = %p", buf, size, data);
-                    int file_fd = open(buf, O_RDWR | O_CREAT, 0777);
-                    if (file_fd > 0) {
-                        int written_len = write(file_fd, data, size);
-                        ALOGD("%s: written number of bytes %d\n", __func__, written_len);
-                        close(file_fd);
-                    } else {
-                        ALOGE("%s: fail t open file for image dumping", __func__);
-                    }
+                    // copied here, written out by the dumper thread
+                    m_frameDumper.dump(data, size, buf);
                     mDumpFrmCnt++;
                 }
             }
@@ -910,6 +940,12 @@ void QCamera2HardwareInterface::dumpFrameToFile(const void *data,
         }
     } else {
         mDumpFrmCnt = 0;
+        // dumping just turned off, flush and end current dump session.
+        // Only the stream thread seeing the transition stops the dumper.
+        if (__atomic_load_n(&m_bDumpEnabled, __ATOMIC_RELAXED) &&
+            __atomic_exchange_n(&m_bDumpEnabled, false, __ATOMIC_ACQ_REL)) {
+            m_frameDumper.stop();
+        }
     }
 }
 
@@ -918,24 +954,16 @@ void QCamera2HardwareInterface::dumpFrameToFile(const void *data,
  *
  * DESCRIPTION: helper function to log video frame FPS for debug purpose.
  *
- * PARAMETERS : None
+ * PARAMETERS :
+ *   @stream  : video stream, its frame stats are sampled
  *
  * RETURN     : None
  *==========================================================================*/
-void QCamera2HardwareInterface::debugShowVideoFPS()
+void QCamera2HardwareInterface::debugShowVideoFPS(QCameraStream *stream)
 {
-    static int n_vFrameCount = 0;
-    static int n_vLastFrameCount = 0;
-    static nsecs_t n_vLastFpsTime = 0;
-    static float n_vFps = 0;
-    n_vFrameCount++;
-    nsecs_t now = systemTime();
-    nsecs_t diff = now - n_vLastFpsTime;
-    if (diff > ms2ns(250)) {
-        n_vFps =  ((n_vFrameCount - n_vLastFrameCount) * float(s2ns(1))) / diff;
-        ALOGE("Video Frames Per Second: %.4f", n_vFps);
-        n_vLastFpsTime = now;
-        n_vLastFrameCount = n_vFrameCount;
+    float fps = 0;
+    if (stream != NULL && stream->getStats().sampleFps(fps)) {
+        ALOGI("Video Frames Per Second: %.4f", fps);
     }
 }
 
@@ -944,24 +972,16 @@ void QCamera2HardwareInterface::debugShowVideoFPS()
  *
  * DESCRIPTION: helper function to log preview frame FPS for debug purpose.
  *
- * PARAMETERS : None
+ * PARAMETERS :
+ *   @stream  : preview stream, its frame stats are sampled
  *
  * RETURN     : None
  *==========================================================================*/
-void QCamera2HardwareInterface::debugShowPreviewFPS()
+void QCamera2HardwareInterface::debugShowPreviewFPS(QCameraStream *stream)
 {
-    static int n_pFrameCount = 0;
-    static int n_pLastFrameCount = 0;
-    static nsecs_t n_pLastFpsTime = 0;
-    static float n_pFps = 0;
-    n_pFrameCount++;
-    nsecs_t now = systemTime();
-    nsecs_t diff = now - n_pLastFpsTime;
-    if (diff > ms2ns(250)) {
-        n_pFps =  ((n_pFrameCount - n_pLastFrameCount) * float(s2ns(1))) / diff;
-        ALOGE("Preview Frames Per Second: %.4f", n_pFps);
-        n_pLastFpsTime = now;
-        n_pLastFrameCount = n_pFrameCount;
+    float fps = 0;
+    if (stream != NULL && stream->getStats().sampleFps(fps)) {
+        ALOGI("Preview Frames Per Second: %.4f", fps);
     }
 }
 
@@ -977,6 +997,8 @@ void QCamera2HardwareInterface::debugShowPreviewFPS()
 QCameraCbNotifier::~QCameraCbNotifier()
 {
     mProcTh.exit();
+    releasePackedBuffers();
+    pthread_mutex_destroy(&mPackedLock);
 }
 
 /*===========================================================================
@@ -1176,6 +1198,7 @@ void * QCameraCbNotifier::cbNotifyRoutine(void * data)
         case CAMERA_CMD_TYPE_EXIT:
             {
                 pme->mDataQ.flush();
+                pme->releasePackedBuffers();
                 running = 0;
             }
             break;
@@ -1188,6 +1211,189 @@ void * QCameraCbNotifier::cbNotifyRoutine(void * data)
     return NULL;
 }
 
+/*===========================================================================
+ * FUNCTION   : notifyPackedPreviewFrame
+ *
+ * DESCRIPTION: copy a padded YUV preview frame into a free buffer of the
+ *              packed preview ring, dropping stride and scanline padding,
+ *              and queue it as a preview data callback. Output layout is
+ *              Y plane followed by the chroma plane(s), each with row
+ *              stride equal to its width. Runs on the stream thread before
+ *              the frame buffer goes back to display or kernel; the packed
+ *              buffer stays busy until the callback releases it.
+ *
+ * PARAMETERS :
+ *   @frame   : padded frame
+ *   @fmt     : format of the padded frame
+ *   @dim     : dimension of the padded frame
+ *   @offset  : plane layout of the padded frame
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraCbNotifier::notifyPackedPreviewFrame(const uint8_t *frame,
+                                                    cam_format_t fmt,
+                                                    const cam_dimension_t &dim,
+                                                    const cam_frame_len_offset_t &offset)
+{
+    int width = dim.width;
+    int height = dim.height;
+    int num_planes;
+    int plane_w[3], plane_h[3];
+
+    plane_w[0] = width;
+    plane_h[0] = height;
+    switch (fmt) {
+    case CAM_FORMAT_YUV_420_NV12:
+    case CAM_FORMAT_YUV_420_NV21:
+        num_planes = 2;
+        plane_w[1] = width;
+        plane_h[1] = height / 2;
+        break;
+    case CAM_FORMAT_YUV_420_YV12:
+        num_planes = 3;
+        plane_w[1] = plane_w[2] = width / 2;
+        plane_h[1] = plane_h[2] = height / 2;
+        break;
+    default:
+        ALOGE("%s: format %d can't be packed", __func__, fmt);
+        return BAD_VALUE;
+    }
+    if (frame == NULL || offset.num_planes != num_planes) {
+        ALOGE("%s: invalid frame %p with %d planes", __func__,
+              frame, offset.num_planes);
+        return BAD_VALUE;
+    }
+
+    int size = 0;
+    for (int i = 0; i < num_planes; i++) {
+        size += plane_w[i] * plane_h[i];
+    }
+
+    int idx = -1;
+    camera_memory_t *mem = NULL;
+    pthread_mutex_lock(&mPackedLock);
+    if (size != mPackedBufSize) {
+        // free buffers of the old size now, busy ones when released
+        for (int i = 0; i < MAX_PACKED_PREVIEW_BUFS; i++) {
+            if (!mPackedBufBusy[i] && mPackedBufs[i] != NULL) {
+                mPackedBufs[i]->release(mPackedBufs[i]);
+                mPackedBufs[i] = NULL;
+            }
+        }
+        mPackedBufSize = size;
+    }
+    for (int i = 0; i < MAX_PACKED_PREVIEW_BUFS; i++) {
+        if (!mPackedBufBusy[i]) {
+            mPackedBufBusy[i] = true;
+            mem = mPackedBufs[i];
+            idx = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mPackedLock);
+
+    if (idx < 0) {
+        ALOGE("%s: no free packed buffer, dropping preview frame", __func__);
+        return NO_MEMORY;
+    }
+
+    if (mem == NULL) {
+        if (mParent->mGetMemory != NULL) {
+            mem = mParent->mGetMemory(-1, size, 1, mCallbackCookie);
+        }
+        if (mem == NULL || mem->data == NULL) {
+            ALOGE("%s: mGetMemory failed", __func__);
+            if (mem != NULL) {
+                mem->release(mem);
+            }
+            releasePackedBuffer((void *)(intptr_t)idx, this);
+            return NO_MEMORY;
+        }
+        // the slot is ours while busy
+        mPackedBufs[idx] = mem;
+    }
+
+    const uint8_t *src = frame;
+    uint8_t *dst = (uint8_t *)mem->data;
+    for (int i = 0; i < num_planes; i++) {
+        const cam_mp_len_offset_t &plane = offset.mp[i];
+        compactPlane(dst, plane_w[i],
+                     src + plane.offset, plane.stride,
+                     plane_w[i], plane_h[i]);
+        dst += plane_w[i] * plane_h[i];
+        src += plane.len;
+    }
+
+    qcamera_callback_argm_t cbArg;
+    memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
+    cbArg.cb_type = QCAMERA_DATA_CALLBACK;
+    cbArg.msg_type = CAMERA_MSG_PREVIEW_FRAME;
+    cbArg.data = mem;
+    cbArg.user_data = (void *)(intptr_t)idx;
+    cbArg.cookie = this;
+    cbArg.release_cb = releasePackedBuffer;
+    return notifyCallback(cbArg);
+}
+
+/*===========================================================================
+ * FUNCTION   : releasePackedBuffer
+ *
+ * DESCRIPTION: release callback of a packed preview frame, hands its buffer
+ *              back to the ring. A buffer left over from a previous frame
+ *              size is freed instead.
+ *
+ * PARAMETERS :
+ *   @data    : index of the packed buffer
+ *   @cookie  : callback notifier
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::releasePackedBuffer(void *data, void *cookie)
+{
+    QCameraCbNotifier *pme = (QCameraCbNotifier *)cookie;
+    int idx = (int)(intptr_t)data;
+
+    if (pme == NULL || idx < 0 || idx >= MAX_PACKED_PREVIEW_BUFS) {
+        ALOGE("%s: invalid packed buffer %d", __func__, idx);
+        return;
+    }
+
+    pthread_mutex_lock(&pme->mPackedLock);
+    camera_memory_t *mem = pme->mPackedBufs[idx];
+    if (mem != NULL && (int)mem->size != pme->mPackedBufSize) {
+        mem->release(mem);
+        pme->mPackedBufs[idx] = NULL;
+    }
+    pme->mPackedBufBusy[idx] = false;
+    pthread_mutex_unlock(&pme->mPackedLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : releasePackedBuffers
+ *
+ * DESCRIPTION: release the packed preview callback buffers. Only called
+ *              once the callback queue is flushed, so none is busy.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::releasePackedBuffers()
+{
+    pthread_mutex_lock(&mPackedLock);
+    for (int i = 0; i < MAX_PACKED_PREVIEW_BUFS; i++) {
+        if (mPackedBufs[i] != NULL) {
+            mPackedBufs[i]->release(mPackedBufs[i]);
+            mPackedBufs[i] = NULL;
+        }
+        mPackedBufBusy[i] = false;
+    }
+    mPackedBufSize = 0;
+    pthread_mutex_unlock(&mPackedLock);
+}
+
 /*===========================================================================
  * FUNCTION   : notifyCallback
  *
@@ -1210,10 +1416,22 @@ int32_t QCameraCbNotifier::notifyCallback(qcamera_callback_argm_t &cbArgs)
     memset(cbArg, 0, sizeof(qcamera_callback_argm_t));
     *cbArg = cbArgs;
 
-    if (mDataQ.enqueue((void *)cbArg)) {
+    // preview frames may be dropped when the app falls behind, everything
+    // else (shutter, jpeg, errors) spills past the ring and is never lost
+    bool droppable = (CAMERA_MSG_PREVIEW_FRAME == cbArg->msg_type);
+    bool rc = droppable ? mDataQ.tryEnqueue((void *)cbArg) :
+                          mDataQ.enqueue((void *)cbArg);
+    if (rc) {
         mProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else {
-        ALOGE("%s: Error adding cb data into queue", __func__);
+        if (droppable) {
+            // the queue has logged why (full ring or inactive)
+            ALOGE("%s: Dropping preview frame", __func__);
+            // caller has handed the frame over, give its buffer back
+            releaseNotifications(cbArg, this);
+        } else {
+            ALOGE("%s: Callback thread is not active", __func__);
+        }
         delete cbArg;
         return UNKNOWN_ERROR;
     }
@@ -29,6 +29,7 @@
 
 #define LOG_TAG "QCameraHWI_Mem"
 
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -921,6 +922,7 @@ QCameraGrallocMemory::QCameraGrallocMemory(camera_request_memory getMemory)
         mBufferHandle[i] = NULL;
         mLocalFlag[i] = BUFFER_NOT_OWNED;
         mPrivateHandle[i] = NULL;
+        mCallbackMemory[i] = NULL;
     }
 }
 
@@ -1009,6 +1011,104 @@ int QCameraGrallocMemory::displayBuffer(int index)
     return dequeuedIdx;
 }
 
+/*===========================================================================
+ * FUNCTION   : getCallbackMemory
+ *
+ * DESCRIPTION: get camera memory of the given size wrapping a preview buffer,
+ *              used when callback buffer size differs from gralloc buffer
+ *              size. The wrapper is created on first use and reused for
+ *              every frame of the buffer. A reference is taken for the
+ *              caller so the wrapper outlives a size change or deallocate
+ *              while its callback is still queued.
+ *
+ * PARAMETERS :
+ *   @index   : buffer index
+ *   @size    : size of the callback buffer
+ *   @ref     : [out] reference to drop with putCallbackMemory
+ *
+ * RETURN     : camera memory ptr
+ *              NULL if failed
+ *==========================================================================*/
+camera_memory_t *QCameraGrallocMemory::getCallbackMemory(int index, int size,
+                                                         void **ref)
+{
+    if (index < 0 || index >= mBufferCount || ref == NULL) {
+        ALOGE("%s: index %d out of bound", __func__, index);
+        return NULL;
+    }
+
+    cb_mem_t *cbMem = mCallbackMemory[index];
+    if (cbMem != NULL && cbMem->size != size) {
+        mCallbackMemory[index] = NULL;
+        releaseCallbackMemory(cbMem);
+        cbMem = NULL;
+    }
+
+    if (cbMem == NULL) {
+        camera_memory_t *mem = mGetMemory(mMemInfo[index].fd, size, 1, (void *)this);
+        if (mem == NULL || mem->data == NULL) {
+            ALOGE("%s: mGetMemory failed", __func__);
+            if (mem != NULL) {
+                mem->release(mem);
+            }
+            return NULL;
+        }
+        cbMem = (cb_mem_t *)malloc(sizeof(cb_mem_t));
+        if (cbMem == NULL) {
+            ALOGE("%s: no mem for callback memory", __func__);
+            mem->release(mem);
+            return NULL;
+        }
+        cbMem->mem = mem;
+        cbMem->size = size;
+        cbMem->refCount = 1;
+        mCallbackMemory[index] = cbMem;
+    }
+
+    __atomic_add_fetch(&cbMem->refCount, 1, __ATOMIC_RELAXED);
+    *ref = cbMem;
+    return cbMem->mem;
+}
+
+/*===========================================================================
+ * FUNCTION   : putCallbackMemory
+ *
+ * DESCRIPTION: drop a reference taken by getCallbackMemory. Has the release
+ *              callback signature so the callback notifier can call it
+ *              once the preview callback is delivered or dropped.
+ *
+ * PARAMETERS :
+ *   @ref     : reference returned by getCallbackMemory
+ *   @cookie  : unused
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraGrallocMemory::putCallbackMemory(void *ref, void * /*cookie*/)
+{
+    if (ref != NULL) {
+        releaseCallbackMemory((cb_mem_t *)ref);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseCallbackMemory
+ *
+ * DESCRIPTION: drop one reference of a callback memory wrapper, releasing
+ *              the wrapper with the last one
+ *
+ * PARAMETERS :
+ *   @cbMem   : callback memory wrapper
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraGrallocMemory::releaseCallbackMemory(cb_mem_t *cbMem)
+{
+    if (__atomic_sub_fetch(&cbMem->refCount, 1, __ATOMIC_ACQ_REL) == 0) {
+        cbMem->mem->release(cbMem->mem);
+        free(cbMem);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : allocate
  *
@@ -1196,6 +1296,10 @@ void QCameraGrallocMemory::deallocate()
     ALOGI("%s: E ", __FUNCTION__);
 
     for (int cnt = 0; cnt < mBufferCount; cnt++) {
+        if (mCallbackMemory[cnt] != NULL) {
+            releaseCallbackMemory(mCallbackMemory[cnt]);
+            mCallbackMemory[cnt] = NULL;
+        }
         mCameraMemory[cnt]->release(mCameraMemory[cnt]);
         struct ion_handle_data ion_handle;
         memset(&ion_handle, 0, sizeof(ion_handle));
@@ -165,6 +165,11 @@ public:
     // and dequeue one buffer from it.
     // Returns the buffer index of the dequeued buffer.
     int displayBuffer(int index);
+    // Wrapper of buffer[index] trimmed to size for preview data callback.
+    // Cached per buffer; *ref holds it alive for one queued callback and
+    // must be dropped with putCallbackMemory once the callback is done.
+    camera_memory_t *getCallbackMemory(int index, int size, void **ref);
+    static void putCallbackMemory(void *ref, void *cookie);
 
 private:
     buffer_handle_t *mBufferHandle[MM_CAMERA_MAX_NUM_FRAMES];
@@ -174,6 +179,14 @@ private:
     int mWidth, mHeight, mFormat;
     camera_request_memory mGetMemory;
     camera_memory_t *mCameraMemory[MM_CAMERA_MAX_NUM_FRAMES];
+    // one ref held by the buffer slot, one per callback still queued
+    typedef struct {
+        camera_memory_t *mem;
+        int size;
+        int refCount;
+    } cb_mem_t;
+    static void releaseCallbackMemory(cb_mem_t *cbMem);
+    cb_mem_t *mCallbackMemory[MM_CAMERA_MAX_NUM_FRAMES];
     int mMinUndequeuedBuffers;
 };
 
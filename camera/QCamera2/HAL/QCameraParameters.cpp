@@ -37,6 +37,7 @@
 #include <gralloc_priv.h>
 #include "QCamera2HWI.h"
 #include "QCameraParameters.h"
+#include "QCameraMapIndex.h"
 
 #define ASPECT_TOLERANCE 0.001
 #define FLIP_V_H (FLIP_H | FLIP_V)
@@ -103,6 +104,8 @@ const char QCameraParameters::KEY_QC_SNAPSHOT_PICTURE_FLIP[] = "snapshot-picture
 const char QCameraParameters::KEY_QC_SUPPORTED_FLIP_MODES[] = "flip-mode-values";
 const char QCameraParameters::KEY_QC_VIDEO_HDR[] = "video-hdr";
 const char QCameraParameters::KEY_QC_SUPPORTED_VIDEO_HDR_MODES[] = "video-hdr-values";
+const char QCameraParameters::KEY_QC_PREVIEW_CB_PACKED[] = "preview-cb-packed";
+const char QCameraParameters::KEY_QC_SUPPORTED_PREVIEW_CB_PACKED_MODES[] = "preview-cb-packed-values";
 
 // Values for effect settings.
 const char QCameraParameters::EFFECT_EMBOSS[] = "emboss";
@@ -521,6 +524,87 @@ const QCameraParameters::QCameraMap QCameraParameters::FLIP_MODES_MAP[] = {
     {FLIP_MODE_VH, FLIP_V_H}
 };
 
+// Setters called by updateParameters in this order, each with the user keys
+// it reads. A setter is only called if one of its keys changed, unless it is
+// marked always because it also depends on internal state (committed
+// recording hint and ZSL mode) or reads persist.* properties.
+const QCameraParameters::QCameraParamSetter QCameraParameters::PARAM_SETTERS[] = {
+    { &QCameraParameters::setPreviewSize,         { KEY_PREVIEW_SIZE, NULL }, false },
+    { &QCameraParameters::setVideoSize,           { KEY_VIDEO_SIZE, KEY_PREVIEW_SIZE,
+                                                    KEY_RECORDING_HINT, NULL }, true },
+    { &QCameraParameters::setPictureSize,         { KEY_PICTURE_SIZE, KEY_QC_ZSL,
+                                                    KEY_RECORDING_HINT, NULL }, true },
+    { &QCameraParameters::setPreviewFormat,       { KEY_PREVIEW_FORMAT, NULL }, false },
+    { &QCameraParameters::setPictureFormat,       { KEY_PICTURE_FORMAT, NULL }, false },
+    { &QCameraParameters::setJpegThumbnailSize,   { KEY_JPEG_THUMBNAIL_WIDTH,
+                                                    KEY_JPEG_THUMBNAIL_HEIGHT,
+                                                    KEY_PICTURE_SIZE, NULL }, false },
+    { &QCameraParameters::setJpegQuality,         { KEY_JPEG_QUALITY,
+                                                    KEY_JPEG_THUMBNAIL_QUALITY, NULL }, false },
+    { &QCameraParameters::setOrientation,         { KEY_QC_ORIENTATION, NULL }, false },
+    { &QCameraParameters::setRotation,            { KEY_ROTATION, NULL }, false },
+    { &QCameraParameters::setNoDisplayMode,       { KEY_QC_NO_DISPLAY_MODE, NULL }, false },
+    { &QCameraParameters::setZslMode,             { KEY_QC_ZSL, NULL }, false },
+    { &QCameraParameters::setZslAttributes,       { KEY_QC_ZSL_BURST_INTERVAL,
+                                                    KEY_QC_ZSL_BURST_LOOKBACK,
+                                                    KEY_QC_ZSL_QUEUE_DEPTH, NULL }, true },
+    { &QCameraParameters::setCameraMode,          { KEY_QC_CAMERA_MODE, NULL }, false },
+    { &QCameraParameters::setRecordingHint,       { KEY_RECORDING_HINT, NULL }, false },
+
+    { &QCameraParameters::setPreviewFpsRange,     { KEY_PREVIEW_FPS_RANGE, NULL }, false },
+    { &QCameraParameters::setPreviewFrameRate,    { KEY_PREVIEW_FRAME_RATE, NULL }, false },
+    { &QCameraParameters::setAutoExposure,        { KEY_QC_AUTO_EXPOSURE, NULL }, false },
+    { &QCameraParameters::setEffect,              { KEY_EFFECT, NULL }, false },
+    { &QCameraParameters::setBrightness,          { KEY_QC_BRIGHTNESS, NULL }, false },
+    { &QCameraParameters::setZoom,                { KEY_ZOOM, NULL }, false },
+    { &QCameraParameters::setSharpness,           { KEY_QC_SHARPNESS, NULL }, false },
+    { &QCameraParameters::setSaturation,          { KEY_QC_SATURATION, NULL }, false },
+    { &QCameraParameters::setContrast,            { KEY_QC_CONTRAST, NULL }, false },
+    { &QCameraParameters::setFocusMode,           { KEY_FOCUS_MODE, NULL }, false },
+    { &QCameraParameters::setISOValue,            { KEY_QC_ISO_MODE, NULL }, false },
+    { &QCameraParameters::setSkinToneEnhancement, { KEY_QC_SCE_FACTOR, NULL }, false },
+    { &QCameraParameters::setFlash,               { KEY_FLASH_MODE, NULL }, false },
+    { &QCameraParameters::setAecLock,             { KEY_AUTO_EXPOSURE_LOCK, NULL }, false },
+    { &QCameraParameters::setAwbLock,             { KEY_AUTO_WHITEBALANCE_LOCK, NULL }, false },
+    { &QCameraParameters::setLensShadeValue,      { KEY_QC_LENSSHADE, NULL }, false },
+    { &QCameraParameters::setMCEValue,            { KEY_QC_MEMORY_COLOR_ENHANCEMENT, NULL }, false },
+    { &QCameraParameters::setDISValue,            { KEY_QC_DIS, NULL }, false },
+    { &QCameraParameters::setHighFrameRate,       { KEY_QC_VIDEO_HIGH_FRAME_RATE, NULL }, false },
+    { &QCameraParameters::setAntibanding,         { KEY_ANTIBANDING, NULL }, false },
+    { &QCameraParameters::setExposureCompensation,{ KEY_EXPOSURE_COMPENSATION, NULL }, false },
+    { &QCameraParameters::setWhiteBalance,        { KEY_WHITE_BALANCE, NULL }, false },
+    { &QCameraParameters::setSceneMode,           { KEY_SCENE_MODE, KEY_QC_HDR_NEED_1X, NULL }, false },
+    { &QCameraParameters::setFocusAreas,          { KEY_FOCUS_AREAS, NULL }, false },
+    { &QCameraParameters::setMeteringAreas,       { KEY_METERING_AREAS, NULL }, false },
+    { &QCameraParameters::setSelectableZoneAf,    { KEY_QC_SELECTABLE_ZONE_AF, NULL }, false },
+    { &QCameraParameters::setRedeyeReduction,     { KEY_QC_REDEYE_REDUCTION, NULL }, false },
+    { &QCameraParameters::setAEBracket,           { KEY_QC_AE_BRACKET_HDR,
+                                                    KEY_QC_CAPTURE_BURST_EXPOSURE,
+                                                    KEY_SCENE_MODE, NULL }, true },
+    { &QCameraParameters::setGpsLocation,         { KEY_GPS_PROCESSING_METHOD,
+                                                    KEY_GPS_LATITUDE,
+                                                    KEY_QC_GPS_LATITUDE_REF,
+                                                    KEY_GPS_LONGITUDE,
+                                                    KEY_QC_GPS_LONGITUDE_REF,
+                                                    KEY_QC_GPS_ALTITUDE_REF,
+                                                    KEY_GPS_ALTITUDE,
+                                                    KEY_QC_GPS_STATUS,
+                                                    KEY_GPS_TIMESTAMP, NULL }, false },
+    { &QCameraParameters::setWaveletDenoise,      { KEY_QC_DENOISE, NULL }, false },
+    { &QCameraParameters::setFaceRecognition,     { KEY_QC_FACE_RECOGNITION,
+                                                    KEY_QC_MAX_NUM_REQUESTED_FACES, NULL }, false },
+    { &QCameraParameters::setFlip,                { KEY_QC_PREVIEW_FLIP, KEY_QC_VIDEO_FLIP,
+                                                    KEY_QC_SNAPSHOT_PICTURE_FLIP, NULL }, false },
+    { &QCameraParameters::setVideoHDR,            { KEY_QC_VIDEO_HDR, NULL }, false },
+    { &QCameraParameters::setPreviewCbPacked,     { KEY_QC_PREVIEW_CB_PACKED, NULL }, false },
+
+    // update live snapshot size after all other parameters are set
+    { &QCameraParameters::setLiveSnapshotSize,    { KEY_PICTURE_SIZE, KEY_PREVIEW_SIZE,
+                                                    KEY_VIDEO_SIZE,
+                                                    KEY_QC_VIDEO_HIGH_FRAME_RATE, NULL }, true },
+    { NULL,                                       { NULL }, false }
+};
+
 #define DEFAULT_CAMERA_AREA "(0, 0, 0, 0, 0)"
 #define DATA_PTR(MEM_OBJ,INDEX) MEM_OBJ->getPtr( INDEX )
 
@@ -536,6 +620,7 @@ const QCameraParameters::QCameraMap QCameraParameters::FLIP_MODES_MAP[] = {
 QCameraParameters::QCameraParameters()
     : CameraParameters(),
       m_pCapability(NULL),
+      m_pCapParams(NULL),
       m_pCamOpsTbl(NULL),
       m_pParamHeap(NULL),
       m_pParamBuf(NULL),
@@ -551,13 +636,21 @@ QCameraParameters::QCameraParameters()
       mPictureFormat(CAM_FORMAT_JPEG),
       m_bNeedRestart(false),
       m_bNoDisplayMode(false),
+      m_bPreviewCbPacked(false),
       m_bWNROn(false),
       m_bNeedLockCAF(false),
       m_bCAFLocked(false),
       m_bAFRunning(false),
-      m_tempMap()
+      m_tempMap(),
+      m_bLastParamsValid(false)
 {
     char value[PROPERTY_VALUE_MAX];
+
+    memset(m_parmBatchMask, 0, sizeof(m_parmBatchMask));
+    memset(m_parmGetMask, 0, sizeof(m_parmGetMask));
+    memset(m_parmLen, 0, sizeof(m_parmLen));
+    memset(m_pParmCommitted, 0, sizeof(m_pParmCommitted));
+    memset(m_parmCommittedLen, 0, sizeof(m_parmCommittedLen));
     // TODO: may move to parameter instead of sysprop
     property_get("persist.debug.sf.showfps", value, "0");
     m_bDebugFps = atoi(value) > 0 ? true : false;
@@ -590,6 +683,7 @@ QCameraParameters::QCameraParameters()
 QCameraParameters::QCameraParameters(const String8 &params)
     : CameraParameters(params),
     m_pCapability(NULL),
+    m_pCapParams(NULL),
     m_pCamOpsTbl(NULL),
     m_pParamHeap(NULL),
     m_pParamBuf(NULL),
@@ -605,13 +699,20 @@ QCameraParameters::QCameraParameters(const String8 &params)
     mPictureFormat(CAM_FORMAT_JPEG),
     m_bNeedRestart(false),
     m_bNoDisplayMode(false),
+    m_bPreviewCbPacked(false),
     m_bWNROn(false),
     m_bNeedLockCAF(false),
     m_bCAFLocked(false),
     m_bAFRunning(false),
-    m_tempMap()
+    m_tempMap(),
+    m_bLastParamsValid(false)
 {
     memset(&m_LiveSnapshotSize, 0, sizeof(m_LiveSnapshotSize));
+    memset(m_parmBatchMask, 0, sizeof(m_parmBatchMask));
+    memset(m_parmGetMask, 0, sizeof(m_parmGetMask));
+    memset(m_parmLen, 0, sizeof(m_parmLen));
+    memset(m_pParmCommitted, 0, sizeof(m_pParmCommitted));
+    memset(m_parmCommittedLen, 0, sizeof(m_parmCommittedLen));
 }
 
 /*===========================================================================
@@ -892,40 +993,70 @@ String8 QCameraParameters::createFpsString(const cam_fps_range_t *fps, int len)
  * PARAMETERS :
  *   @fps     : array of fps ranges
  *   @len     : size of the array
- *   @default_fps_index : reference to index of default fps range
  *
  * RETURN     : string obj
  *==========================================================================*/
 String8 QCameraParameters::createFpsRangeString(const cam_fps_range_t* fps,
-                                                int len,
-                                                int &default_fps_index)
+                                                int len)
 {
     String8 str;
     char buffer[32];
-    int max_range = 0;
-    int min_fps, max_fps;
 
-    if (len > 0) {
-        min_fps = int(fps[0].min_fps * 1000);
-        max_fps = int(fps[0].max_fps * 1000);
-        max_range = max_fps - min_fps;
-        default_fps_index = 0;
-        snprintf(buffer, sizeof(buffer), "(%d,%d)", min_fps, max_fps);
+    for (int i = 0; i < len; i++) {
+        snprintf(buffer, sizeof(buffer), (i == 0) ? "(%d,%d)" : ",(%d,%d)",
+                 int(fps[i].min_fps * 1000), int(fps[i].max_fps * 1000));
         str.append(buffer);
     }
-    for (int i = 1; i < len; i++) {
-        min_fps = int(fps[i].min_fps * 1000);
-        max_fps = int(fps[i].max_fps * 1000);
-        if (max_range < (max_fps - min_fps)) {
-            max_range = max_fps - min_fps;
+    return str;
+}
+
+/*===========================================================================
+ * FUNCTION   : getWidestFpsRangeIndex
+ *
+ * DESCRIPTION: find the fps range with the largest span, used as default.
+ *              The first one wins on ties.
+ *
+ * PARAMETERS :
+ *   @fps     : array of fps ranges
+ *   @len     : size of the array
+ *
+ * RETURN     : index of the widest range, 0 if array is empty
+ *==========================================================================*/
+int QCameraParameters::getWidestFpsRangeIndex(const cam_fps_range_t *fps,
+                                              int len)
+{
+    int default_fps_index = 0;
+    int max_range = 0;
+
+    for (int i = 0; i < len; i++) {
+        int range = int(fps[i].max_fps * 1000) - int(fps[i].min_fps * 1000);
+        if (i == 0 || max_range < range) {
+            max_range = range;
             default_fps_index = i;
         }
-        snprintf(buffer, sizeof(buffer), ",(%d,%d)", min_fps, max_fps);
-        str.append(buffer);
     }
-    return str;
+    return default_fps_index;
 }
 
+// index traits for QCameraMap lookups by name and by value
+struct QCameraParameters::MapByName {
+    typedef QCameraMap Entry;
+    typedef const char *Key;
+    static uint32_t hash(Key key) { return qcamera_map_hash_str(key); }
+    static uint32_t hashEntry(const Entry &e) { return qcamera_map_hash_str(e.desc); }
+    static bool match(const Entry &e, Key key) { return !strcmp(e.desc, key); }
+    static bool sameKey(const Entry &a, const Entry &b) { return !strcmp(a.desc, b.desc); }
+};
+
+struct QCameraParameters::MapByValue {
+    typedef QCameraMap Entry;
+    typedef int Key;
+    static uint32_t hash(Key key) { return qcamera_map_hash_int((uint32_t)key); }
+    static uint32_t hashEntry(const Entry &e) { return qcamera_map_hash_int((uint32_t)e.val); }
+    static bool match(const Entry &e, Key key) { return e.val == key; }
+    static bool sameKey(const Entry &a, const Entry &b) { return a.val == b.val; }
+};
+
 /*===========================================================================
  * FUNCTION   : lookupAttr
  *
@@ -942,10 +1073,9 @@ String8 QCameraParameters::createFpsRangeString(const cam_fps_range_t* fps,
 int QCameraParameters::lookupAttr(const QCameraMap arr[], int len, const char *name)
 {
     if (name) {
-        for (int i = 0; i < len; i++) {
-            if (!strcmp(arr[i].desc, name))
-                return arr[i].val;
-        }
+        int i = QCameraMapIndex<MapByName>::find(arr, len, name);
+        if (i >= 0)
+            return arr[i].val;
     }
     return NAME_NOT_FOUND;
 }
@@ -964,10 +1094,9 @@ int QCameraParameters::lookupAttr(const QCameraMap arr[], int len, const char *n
  *==========================================================================*/
 const char *QCameraParameters::lookupNameByValue(const QCameraMap arr[], int len, int value)
 {
-    for (int i = 0; i < len; i++) {
-        if (arr[i].val == value) {
-            return arr[i].desc;
-        }
+    int i = QCameraMapIndex<MapByValue>::find(arr, len, value);
+    if (i >= 0) {
+        return arr[i].desc;
     }
     return NULL;
 }
@@ -1820,6 +1949,31 @@ int32_t QCameraParameters::setVideoHDR(const QCameraParameters& params)
     return NO_ERROR;
 }
 
+/*===========================================================================
+ * FUNCTION   : setPreviewCbPacked
+ *
+ * DESCRIPTION: set packed preview callback mode from user setting
+ *
+ * PARAMETERS :
+ *   @params  : user setting parameters
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraParameters::setPreviewCbPacked(const QCameraParameters& params)
+{
+    const char *str = params.get(KEY_QC_PREVIEW_CB_PACKED);
+    const char *prev_str = get(KEY_QC_PREVIEW_CB_PACKED);
+    if (str != NULL) {
+        if (prev_str == NULL ||
+            strcmp(str, prev_str) != 0) {
+            return setPreviewCbPacked(str);
+        }
+    }
+    return NO_ERROR;
+}
+
 /*===========================================================================
  * FUNCTION   : setFaceRecognition
  *
@@ -2709,83 +2863,99 @@ int32_t QCameraParameters::setFlip(const QCameraParameters& params)
     return NO_ERROR;
 }
 
+/*===========================================================================
+ * FUNCTION   : isParamChanged
+ *
+ * DESCRIPTION: compare two values of a parameter key
+ *
+ * PARAMETERS :
+ *   @str      : new value, NULL if not set
+ *   @prev_str : previous value, NULL if not set
+ *
+ * RETURN     : true if the values differ
+ *==========================================================================*/
+static bool isParamChanged(const char *str, const char *prev_str)
+{
+    return (str == NULL) != (prev_str == NULL) ||
+           (str != NULL && strcmp(str, prev_str) != 0);
+}
+
 /*===========================================================================
  * FUNCTION   : updateParameters
  *
- * DESCRIPTION: update parameters from user setting
+ * DESCRIPTION: update parameters from user setting. Only the setters whose
+ *              keys differ from the last applied user setting or from the
+ *              current value (which internal calls may have changed), and
+ *              the ones marked always, are called.
  *
  * PARAMETERS :
- *   @params  : user setting parameters
+ *   @params  : user setting parameters in flattened string
  *   @needRestart : [output] if preview need restart upon setting changes
  *
  * RETURN     : int32_t type of status
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int32_t QCameraParameters::updateParameters(QCameraParameters& params,
+int32_t QCameraParameters::updateParameters(const String8 &params,
                                             bool &needRestart)
 {
     int32_t final_rc = NO_ERROR;
     int32_t rc;
+    uint64_t dirty = 0;
+    size_t num_setters = 0;
     m_bNeedRestart = false;
 
+    // compile time check that every setter has a bit in the dirty mask
+    typedef char param_setters_fit_dirty_mask[
+        (sizeof(PARAM_SETTERS) / sizeof(PARAM_SETTERS[0]) - 1 <= 64) ? 1 : -1]
+        __attribute__((unused));
+
     if(initBatchUpdate(m_pParamBuf) < 0 ) {
         ALOGE("%s:Failed to initialize group update table",__func__);
         rc = BAD_TYPE;
         goto UPDATE_PARAM_DONE;
     }
 
-    if ((rc = setPreviewSize(params)))                  final_rc = rc;
-    if ((rc = setVideoSize(params)))                    final_rc = rc;
-    if ((rc = setPictureSize(params)))                  final_rc = rc;
-    if ((rc = setPreviewFormat(params)))                final_rc = rc;
-    if ((rc = setPictureFormat(params)))                final_rc = rc;
-    if ((rc = setJpegThumbnailSize(params)))            final_rc = rc;
-    if ((rc = setJpegQuality(params)))                  final_rc = rc;
-    if ((rc = setOrientation(params)))                  final_rc = rc;
-    if ((rc = setRotation(params)))                     final_rc = rc;
-    if ((rc = setNoDisplayMode(params)))                final_rc = rc;
-    if ((rc = setZslMode(params)))                      final_rc = rc;
-    if ((rc = setZslAttributes(params)))                final_rc = rc;
-    if ((rc = setCameraMode(params)))                   final_rc = rc;
-    if ((rc = setRecordingHint(params)))                final_rc = rc;
-
-    if ((rc = setPreviewFpsRange(params)))              final_rc = rc;
-    if ((rc = setPreviewFrameRate(params)))             final_rc = rc;
-    if ((rc = setAutoExposure(params)))                 final_rc = rc;
-    if ((rc = setEffect(params)))                       final_rc = rc;
-    if ((rc = setBrightness(params)))                   final_rc = rc;
-    if ((rc = setZoom(params)))                         final_rc = rc;
-    if ((rc = setSharpness(params)))                    final_rc = rc;
-    if ((rc = setSaturation(params)))                   final_rc = rc;
-    if ((rc = setContrast(params)))                     final_rc = rc;
-    if ((rc = setFocusMode(params)))                    final_rc = rc;
-    if ((rc = setISOValue(params)))                     final_rc = rc;
-    if ((rc = setSkinToneEnhancement(params)))          final_rc = rc;
-    if ((rc = setFlash(params)))                        final_rc = rc;
-    if ((rc = setAecLock(params)))                      final_rc = rc;
-    if ((rc = setAwbLock(params)))                      final_rc = rc;
-    if ((rc = setLensShadeValue(params)))               final_rc = rc;
-    if ((rc = setMCEValue(params)))                     final_rc = rc;
-    if ((rc = setDISValue(params)))                     final_rc = rc;
-    if ((rc = setHighFrameRate(params)))                final_rc = rc;
-    if ((rc = setAntibanding(params)))                  final_rc = rc;
-    if ((rc = setExposureCompensation(params)))         final_rc = rc;
-    if ((rc = setWhiteBalance(params)))                 final_rc = rc;
-    if ((rc = setSceneMode(params)))                    final_rc = rc;
-    if ((rc = setFocusAreas(params)))                   final_rc = rc;
-    if ((rc = setMeteringAreas(params)))                final_rc = rc;
-    if ((rc = setSelectableZoneAf(params)))             final_rc = rc;
-    if ((rc = setRedeyeReduction(params)))              final_rc = rc;
-    if ((rc = setAEBracket(params)))                    final_rc = rc;
-    if ((rc = setGpsLocation(params)))                  final_rc = rc;
-    if ((rc = setWaveletDenoise(params)))               final_rc = rc;
-    if ((rc = setFaceRecognition(params)))              final_rc = rc;
-    if ((rc = setFlip(params)))                         final_rc = rc;
-    if ((rc = setVideoHDR(params)))                     final_rc = rc;
+    {
+        QCameraParameters newParams(params);
 
-    // update live snapshot size after all other parameters are set
-    if ((rc = setLiveSnapshotSize(params)))             final_rc = rc;
+        while (PARAM_SETTERS[num_setters].setter != NULL) {
+            const QCameraParamSetter *entry = &PARAM_SETTERS[num_setters];
+            if (!m_bLastParamsValid || entry->always) {
+                dirty |= 1ULL << num_setters;
+            } else {
+                for (int k = 0; entry->keys[k] != NULL; k++) {
+                    const char *str = newParams.get(entry->keys[k]);
+                    // setters ignore absent keys, so only a present one is
+                    // compared with the current value
+                    if (isParamChanged(str, m_lastParams.get(entry->keys[k])) ||
+                        (str != NULL && isParamChanged(str, get(entry->keys[k])))) {
+                        dirty |= 1ULL << num_setters;
+                        break;
+                    }
+                }
+            }
+            num_setters++;
+        }
+
+        // setters are called in table order, later ones may depend on
+        // values set by earlier ones
+        for (size_t i = 0; i < num_setters; i++) {
+            if (dirty & (1ULL << i)) {
+                if ((rc = (this->*PARAM_SETTERS[i].setter)(newParams))) {
+                    final_rc = rc;
+                }
+            }
+        }
+
+        if (final_rc == NO_ERROR) {
+            m_lastParams = newParams;
+            m_bLastParamsValid = true;
+        } else {
+            // rerun all setters next time so errors are reported again
+            m_bLastParamsValid = false;
+        }
+    }
 
 UPDATE_PARAM_DONE:
     needRestart = m_bNeedRestart;
@@ -2805,7 +2975,310 @@ UPDATE_PARAM_DONE:
  *==========================================================================*/
 int32_t QCameraParameters::commitParameters()
 {
-    return commitSetBatch();
+    int32_t rc = commitSetBatch();
+    if (rc != NO_ERROR) {
+        // local state is behind the user setting, apply all of it next time
+        m_bLastParamsValid = false;
+    }
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : initCapabilityParameters
+ *
+ * DESCRIPTION: build the read only parameters derived from camera capability,
+ *              i.e. supported values strings. They only depend on the
+ *              capability, so they are built once per camera and cloned into
+ *              the parameters at every open.
+ *
+ * PARAMETERS :
+ *   @cap     : camera capability
+ *   @params  : [output] parameters to be filled in
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::initCapabilityParameters(const cam_capability_t *cap,
+                                                 CameraParameters &params)
+{
+    // Set read only parameters from camera capability
+    params.set(KEY_SMOOTH_ZOOM_SUPPORTED,
+        cap->smooth_zoom_supported? VALUE_TRUE : VALUE_FALSE);
+    params.set(KEY_ZOOM_SUPPORTED,
+        cap->zoom_supported? VALUE_TRUE : VALUE_FALSE);
+    params.set(KEY_VIDEO_SNAPSHOT_SUPPORTED,
+        cap->video_snapshot_supported? VALUE_TRUE : VALUE_FALSE);
+    params.set(KEY_VIDEO_STABILIZATION_SUPPORTED,
+        cap->video_stablization_supported? VALUE_TRUE : VALUE_FALSE);
+    params.set(KEY_AUTO_EXPOSURE_LOCK_SUPPORTED,
+        cap->auto_exposure_lock_supported? VALUE_TRUE : VALUE_FALSE);
+    params.set(KEY_AUTO_WHITEBALANCE_LOCK_SUPPORTED,
+        cap->auto_wb_lock_supported? VALUE_TRUE : VALUE_FALSE);
+    params.set(KEY_QC_SUPPORTED_CAMERA_FEATURES,
+        cap->qcom_supported_feature_mask);
+    params.set(KEY_MAX_NUM_DETECTED_FACES_HW, cap->max_num_roi);
+    params.set(KEY_MAX_NUM_DETECTED_FACES_SW, cap->max_num_roi);
+    params.set(KEY_QC_MAX_NUM_REQUESTED_FACES, cap->max_num_roi);
+    // Set focal length, horizontal view angle, and vertical view angle
+    params.setFloat(KEY_FOCAL_LENGTH, cap->focal_length);
+    params.setFloat(KEY_HORIZONTAL_VIEW_ANGLE, cap->hor_view_angle);
+    params.setFloat(KEY_VERTICAL_VIEW_ANGLE, cap->ver_view_angle);
+
+    // Set supported preview sizes
+    if (cap->preview_sizes_tbl_cnt > 0 &&
+        cap->preview_sizes_tbl_cnt <= MAX_SIZES_CNT) {
+        String8 previewSizeValues = createSizesString(
+                cap->preview_sizes_tbl, cap->preview_sizes_tbl_cnt);
+        params.set(KEY_SUPPORTED_PREVIEW_SIZES, previewSizeValues.string());
+        ALOGD("%s: supported preview sizes: %s", __func__, previewSizeValues.string());
+    }
+
+    // Set supported video sizes
+    if (cap->video_sizes_tbl_cnt > 0 &&
+        cap->video_sizes_tbl_cnt <= MAX_SIZES_CNT) {
+        String8 videoSizeValues = createSizesString(
+                cap->video_sizes_tbl, cap->video_sizes_tbl_cnt);
+        params.set(KEY_SUPPORTED_VIDEO_SIZES, videoSizeValues.string());
+        ALOGD("%s: supported video sizes: %s", __func__, videoSizeValues.string());
+
+        //Set preferred Preview size for video
+        String8 vSize = createSizesString(&cap->video_sizes_tbl[0], 1);
+        params.set(KEY_PREFERRED_PREVIEW_SIZE_FOR_VIDEO, vSize.string());
+    }
+
+    // Set supported picture sizes
+    if (cap->picture_sizes_tbl_cnt > 0 &&
+        cap->picture_sizes_tbl_cnt <= MAX_SIZES_CNT) {
+        String8 pictureSizeValues = createSizesString(
+                cap->picture_sizes_tbl, cap->picture_sizes_tbl_cnt);
+        params.set(KEY_SUPPORTED_PICTURE_SIZES, pictureSizeValues.string());
+        ALOGD("%s: supported pic sizes: %s", __func__, pictureSizeValues.string());
+    }
+
+    // Set supported thumbnail sizes
+    String8 thumbnailSizeValues = createSizesString(
+            THUMBNAIL_SIZES_MAP,
+            sizeof(THUMBNAIL_SIZES_MAP)/sizeof(cam_dimension_t));
+    params.set(KEY_SUPPORTED_JPEG_THUMBNAIL_SIZES, thumbnailSizeValues.string());
+
+    // Set supported livesnapshot sizes
+    if (cap->livesnapshot_sizes_tbl_cnt > 0 &&
+        cap->livesnapshot_sizes_tbl_cnt <= MAX_SIZES_CNT) {
+        String8 liveSnpashotSizeValues = createSizesString(
+                cap->livesnapshot_sizes_tbl,
+                cap->livesnapshot_sizes_tbl_cnt);
+        params.set(KEY_QC_SUPPORTED_LIVESNAPSHOT_SIZES, liveSnpashotSizeValues.string());
+        ALOGI("%s: supported live snapshot sizes: %s", __func__, liveSnpashotSizeValues.string());
+    }
+
+    // Set supported preview formats
+    String8 previewFormatValues = createValuesString(
+            (int *)cap->supported_preview_fmts,
+            cap->supported_preview_fmt_cnt,
+            PREVIEW_FORMATS_MAP,
+            sizeof(PREVIEW_FORMATS_MAP)/sizeof(QCameraMap));
+    params.set(KEY_SUPPORTED_PREVIEW_FORMATS, previewFormatValues.string());
+
+    // Set supported picture formats
+    String8 pictureTypeValues(PIXEL_FORMAT_JPEG);
+    String8 str = createValuesString(
+            (int *)cap->supported_raw_fmts,
+            cap->supported_raw_fmt_cnt,
+            PICTURE_TYPES_MAP,
+            sizeof(PICTURE_TYPES_MAP)/sizeof(QCameraMap));
+    if (str.string() != NULL) {
+        pictureTypeValues.append(",");
+        pictureTypeValues.append(str);
+    }
+    params.set(KEY_SUPPORTED_PICTURE_FORMATS, pictureTypeValues.string());
+
+    // Set raw image size
+    char raw_size_str[32];
+    snprintf(raw_size_str, sizeof(raw_size_str), "%dx%d",
+             cap->raw_dim[0].width, cap->raw_dim[0].height);
+    params.set(KEY_QC_RAW_PICUTRE_SIZE, raw_size_str);
+
+    // Set FPS ranges
+    if (cap->fps_ranges_tbl_cnt > 0 &&
+        cap->fps_ranges_tbl_cnt <= MAX_SIZES_CNT) {
+        String8 fpsRangeValues = createFpsRangeString(cap->fps_ranges_tbl,
+                                                      cap->fps_ranges_tbl_cnt);
+        params.set(KEY_SUPPORTED_PREVIEW_FPS_RANGE, fpsRangeValues.string());
+
+        // Set legacy preview fps
+        String8 fpsValues = createFpsString(cap->fps_ranges_tbl,
+                                            cap->fps_ranges_tbl_cnt);
+        params.set(KEY_SUPPORTED_PREVIEW_FRAME_RATES, fpsValues.string());
+    }
+
+    // Set supported focus modes
+    if (cap->supported_focus_modes_cnt > 0) {
+        String8 focusModeValues = createValuesString(
+                (int *)cap->supported_focus_modes,
+                cap->supported_focus_modes_cnt,
+                FOCUS_MODES_MAP,
+                sizeof(FOCUS_MODES_MAP)/sizeof(QCameraMap));
+        params.set(KEY_SUPPORTED_FOCUS_MODES, focusModeValues);
+    }
+
+    // Set Saturation
+    params.set(KEY_QC_MIN_SATURATION, cap->saturation_ctrl.min_value);
+    params.set(KEY_QC_MAX_SATURATION, cap->saturation_ctrl.max_value);
+    params.set(KEY_QC_SATURATION_STEP, cap->saturation_ctrl.step);
+
+    // Set Sharpness
+    params.set(KEY_QC_MIN_SHARPNESS, cap->sharpness_ctrl.min_value);
+    params.set(KEY_QC_MAX_SHARPNESS, cap->sharpness_ctrl.max_value);
+    params.set(KEY_QC_SHARPNESS_STEP, cap->sharpness_ctrl.step);
+
+    // Set Contrast
+    params.set(KEY_QC_MIN_CONTRAST, cap->contrast_ctrl.min_value);
+    params.set(KEY_QC_MAX_CONTRAST, cap->contrast_ctrl.max_value);
+    params.set(KEY_QC_CONTRAST_STEP, cap->contrast_ctrl.step);
+
+    // Set SCE factor
+    params.set(KEY_QC_MIN_SCE_FACTOR, cap->sce_ctrl.min_value); // -100
+    params.set(KEY_QC_MAX_SCE_FACTOR, cap->sce_ctrl.max_value); // 100
+    params.set(KEY_QC_SCE_FACTOR_STEP, cap->sce_ctrl.step);     // 10
+
+    // Set Brightness
+    params.set(KEY_QC_MIN_BRIGHTNESS, cap->brightness_ctrl.min_value); // 0
+    params.set(KEY_QC_MAX_BRIGHTNESS, cap->brightness_ctrl.max_value); // 6
+    params.set(KEY_QC_BRIGHTNESS_STEP, cap->brightness_ctrl.step);     // 1
+
+    // Set Auto exposure
+    String8 autoExposureValues = createValuesString(
+            (int *)cap->supported_aec_modes,
+            cap->supported_aec_modes_cnt,
+            AUTO_EXPOSURE_MAP,
+            sizeof(AUTO_EXPOSURE_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_AUTO_EXPOSURE, autoExposureValues.string());
+
+    // Set Exposure Compensation
+    params.set(KEY_MAX_EXPOSURE_COMPENSATION, cap->exposure_compensation_max); // 12
+    params.set(KEY_MIN_EXPOSURE_COMPENSATION, cap->exposure_compensation_min); // -12
+    params.setFloat(KEY_EXPOSURE_COMPENSATION_STEP, cap->exposure_compensation_step); // 1/6
+
+    // Set Antibanding
+    String8 antibandingValues = createValuesString(
+            (int *)cap->supported_antibandings,
+            cap->supported_antibandings_cnt,
+            ANTIBANDING_MODES_MAP,
+            sizeof(ANTIBANDING_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_SUPPORTED_ANTIBANDING, antibandingValues);
+
+    // Set Effect
+    String8 effectValues = createValuesString(
+            (int *)cap->supported_effects,
+            cap->supported_effects_cnt,
+            EFFECT_MODES_MAP,
+            sizeof(EFFECT_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_SUPPORTED_EFFECTS, effectValues);
+
+    // Set WhiteBalance
+    String8 whitebalanceValues = createValuesString(
+            (int *)cap->supported_white_balances,
+            cap->supported_white_balances_cnt,
+            WHITE_BALANCE_MODES_MAP,
+            sizeof(WHITE_BALANCE_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_SUPPORTED_WHITE_BALANCE, whitebalanceValues);
+
+    // Set Flash mode
+    String8 flashValues = createValuesString(
+            (int *)cap->supported_flash_modes,
+            cap->supported_flash_modes_cnt,
+            FLASH_MODES_MAP,
+            sizeof(FLASH_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_SUPPORTED_FLASH_MODES, flashValues);
+
+    // Set Scene Mode
+    String8 sceneModeValues = createValuesString(
+            (int *)cap->supported_scene_modes,
+            cap->supported_scene_modes_cnt,
+            SCENE_MODES_MAP,
+            sizeof(SCENE_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_SUPPORTED_SCENE_MODES, sceneModeValues);
+
+    // Set ISO Mode
+    String8 isoValues = createValuesString(
+            (int *)cap->supported_iso_modes,
+            cap->supported_iso_modes_cnt,
+            ISO_MODES_MAP,
+            sizeof(ISO_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_ISO_MODES, isoValues);
+
+    // Set HFR
+    String8 hfrValues = createHfrValuesString(
+            cap->hfr_tbl,
+            cap->hfr_tbl_cnt,
+            HFR_MODES_MAP,
+            sizeof(HFR_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_VIDEO_HIGH_FRAME_RATE_MODES, hfrValues.string());
+    String8 hfrSizeValues = createHfrSizesString(
+            cap->hfr_tbl,
+            cap->hfr_tbl_cnt);
+    params.set(KEY_QC_SUPPORTED_HFR_SIZES, hfrSizeValues.string());
+
+    // Set Focus algorithms
+    String8 focusAlgoValues = createValuesString(
+            (int *)cap->supported_focus_algos,
+            cap->supported_focus_algos_cnt,
+            FOCUS_ALGO_MAP,
+            sizeof(FOCUS_ALGO_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_FOCUS_ALGOS, focusAlgoValues);
+
+    // Set Zoom Ratios
+    if (cap->zoom_supported > 0) {
+        String8 zoomRatioValues = createZoomRatioValuesString(
+                (int *)cap->zoom_ratio_tbl,
+                cap->zoom_ratio_tbl_cnt);
+        params.set(KEY_ZOOM_RATIOS, zoomRatioValues);
+        params.set(KEY_MAX_ZOOM, cap->zoom_ratio_tbl_cnt - 1);
+    }
+
+    // Set Bracketing/HDR
+    String8 bracketingValues = createValuesStringFromMap(
+            BRACKETING_MODES_MAP,
+            sizeof(BRACKETING_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_AE_BRACKET_MODES, bracketingValues);
+
+    // Set Denoise
+    String8 denoiseValues = createValuesStringFromMap(
+       DENOISE_ON_OFF_MODES_MAP, sizeof(DENOISE_ON_OFF_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_DENOISE, denoiseValues.string());
+
+    // Set feature enable/disable
+    String8 enableDisableValues = createValuesStringFromMap(
+        ENABLE_DISABLE_MODES_MAP, sizeof(ENABLE_DISABLE_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_LENSSHADE_MODES, enableDisableValues);
+    params.set(KEY_QC_SUPPORTED_MEM_COLOR_ENHANCE_MODES, enableDisableValues);
+    params.set(KEY_QC_SUPPORTED_DIS_MODES, enableDisableValues);
+    params.set(KEY_QC_SUPPORTED_HISTOGRAM_MODES, enableDisableValues);
+    params.set(KEY_QC_SUPPORTED_REDEYE_REDUCTION, enableDisableValues);
+    params.set(KEY_QC_SUPPORTED_SKIN_TONE_ENHANCEMENT_MODES, enableDisableValues);
+
+    // Set feature on/off
+    String8 onOffValues = createValuesStringFromMap(
+        ON_OFF_MODES_MAP, sizeof(ON_OFF_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_SCENE_DETECT, onOffValues);
+    params.set(KEY_QC_SUPPORTED_FACE_DETECTION, onOffValues);
+    params.set(KEY_QC_SUPPORTED_FACE_RECOGNITION, onOffValues);
+    params.set(KEY_QC_SUPPORTED_ZSL_MODES, onOffValues);
+    if ((cap->qcom_supported_feature_mask & CAM_QCOM_FEATURE_VIDEO_HDR) > 0) {
+        params.set(KEY_QC_SUPPORTED_VIDEO_HDR_MODES, onOffValues);
+    }
+    params.set(KEY_QC_SUPPORTED_PREVIEW_CB_PACKED_MODES, onOffValues);
+
+    //Set Touch AF/AEC
+    String8 touchValues = createValuesStringFromMap(
+       TOUCH_AF_AEC_MODES_MAP, sizeof(TOUCH_AF_AEC_MODES_MAP) / sizeof(QCameraMap));
+    params.set(KEY_QC_SUPPORTED_TOUCH_AF_AEC, touchValues);
+
+    //set flip mode
+    if ((cap->qcom_supported_feature_mask & CAM_QCOM_FEATURE_FLIP) > 0) {
+        String8 flipModes = createValuesStringFromMap(
+           FLIP_MODES_MAP, sizeof(FLIP_MODES_MAP) / sizeof(QCameraMap));
+        params.set(KEY_QC_SUPPORTED_FLIP_MODES, flipModes);
+    }
 }
 
 /*===========================================================================
@@ -2827,69 +3300,34 @@ int32_t QCameraParameters::initDefaultParameters()
     }
 
     /*************************Initialize Values******************************/
-    // Set read only parameters from camera capability
-    set(KEY_SMOOTH_ZOOM_SUPPORTED,
-        m_pCapability->smooth_zoom_supported? VALUE_TRUE : VALUE_FALSE);
-    set(KEY_ZOOM_SUPPORTED,
-        m_pCapability->zoom_supported? VALUE_TRUE : VALUE_FALSE);
-    set(KEY_VIDEO_SNAPSHOT_SUPPORTED,
-        m_pCapability->video_snapshot_supported? VALUE_TRUE : VALUE_FALSE);
-    set(KEY_VIDEO_STABILIZATION_SUPPORTED,
-        m_pCapability->video_stablization_supported? VALUE_TRUE : VALUE_FALSE);
-    set(KEY_AUTO_EXPOSURE_LOCK_SUPPORTED,
-        m_pCapability->auto_exposure_lock_supported? VALUE_TRUE : VALUE_FALSE);
-    set(KEY_AUTO_WHITEBALANCE_LOCK_SUPPORTED,
-        m_pCapability->auto_wb_lock_supported? VALUE_TRUE : VALUE_FALSE);
-    set(KEY_QC_SUPPORTED_CAMERA_FEATURES,
-        m_pCapability->qcom_supported_feature_mask);
-    set(KEY_MAX_NUM_DETECTED_FACES_HW, m_pCapability->max_num_roi);
-    set(KEY_MAX_NUM_DETECTED_FACES_SW, m_pCapability->max_num_roi);
-    set(KEY_QC_MAX_NUM_REQUESTED_FACES, m_pCapability->max_num_roi);
-    // Set focal length, horizontal view angle, and vertical view angle
-    setFloat(KEY_FOCAL_LENGTH, m_pCapability->focal_length);
-    setFloat(KEY_HORIZONTAL_VIEW_ANGLE, m_pCapability->hor_view_angle);
-    setFloat(KEY_VERTICAL_VIEW_ANGLE, m_pCapability->ver_view_angle);
+    // Start from the read only parameters of the camera
+    if (m_pCapParams != NULL) {
+        CameraParameters::operator=(*m_pCapParams);
+    } else {
+        initCapabilityParameters(m_pCapability, *this);
+    }
 
-    // Set supported preview sizes
+    // Set default preview size
     if (m_pCapability->preview_sizes_tbl_cnt > 0 &&
         m_pCapability->preview_sizes_tbl_cnt <= MAX_SIZES_CNT) {
-        String8 previewSizeValues = createSizesString(
-                m_pCapability->preview_sizes_tbl, m_pCapability->preview_sizes_tbl_cnt);
-        set(KEY_SUPPORTED_PREVIEW_SIZES, previewSizeValues.string());
-        ALOGD("%s: supported preview sizes: %s", __func__, previewSizeValues.string());
-        // Set default preview size
         CameraParameters::setPreviewSize(m_pCapability->preview_sizes_tbl[0].width,
                                          m_pCapability->preview_sizes_tbl[0].height);
     } else {
         ALOGE("%s: supported preview sizes cnt is 0 or exceeds max!!!", __func__);
     }
 
-    // Set supported video sizes
+    // Set default video size
     if (m_pCapability->video_sizes_tbl_cnt > 0 &&
         m_pCapability->video_sizes_tbl_cnt <= MAX_SIZES_CNT) {
-        String8 videoSizeValues = createSizesString(
-                m_pCapability->video_sizes_tbl, m_pCapability->video_sizes_tbl_cnt);
-        set(KEY_SUPPORTED_VIDEO_SIZES, videoSizeValues.string());
-        ALOGD("%s: supported video sizes: %s", __func__, videoSizeValues.string());
-        // Set default video size
         CameraParameters::setVideoSize(m_pCapability->video_sizes_tbl[0].width,
                                        m_pCapability->video_sizes_tbl[0].height);
-
-        //Set preferred Preview size for video
-        String8 vSize = createSizesString(&m_pCapability->video_sizes_tbl[0], 1);
-        set(KEY_PREFERRED_PREVIEW_SIZE_FOR_VIDEO, vSize.string());
     } else {
         ALOGE("%s: supported video sizes cnt is 0 or exceeds max!!!", __func__);
     }
 
-    // Set supported picture sizes
+    // Set default picture size to the smallest resolution
     if (m_pCapability->picture_sizes_tbl_cnt > 0 &&
         m_pCapability->picture_sizes_tbl_cnt <= MAX_SIZES_CNT) {
-        String8 pictureSizeValues = createSizesString(
-                m_pCapability->picture_sizes_tbl, m_pCapability->picture_sizes_tbl_cnt);
-        set(KEY_SUPPORTED_PICTURE_SIZES, pictureSizeValues.string());
-        ALOGD("%s: supported pic sizes: %s", __func__, pictureSizeValues.string());
-        // Set default picture size to the smallest resolution
         CameraParameters::setPictureSize(
            m_pCapability->picture_sizes_tbl[m_pCapability->picture_sizes_tbl_cnt-1].width,
            m_pCapability->picture_sizes_tbl[m_pCapability->picture_sizes_tbl_cnt-1].height);
@@ -2897,73 +3335,36 @@ int32_t QCameraParameters::initDefaultParameters()
         ALOGE("%s: supported picture sizes cnt is 0 or exceeds max!!!", __func__);
     }
 
-    // Set supported thumbnail sizes
-    String8 thumbnailSizeValues = createSizesString(
-            THUMBNAIL_SIZES_MAP,
-            sizeof(THUMBNAIL_SIZES_MAP)/sizeof(cam_dimension_t));
-    set(KEY_SUPPORTED_JPEG_THUMBNAIL_SIZES, thumbnailSizeValues.string());
     // Set default thumnail size
     set(KEY_JPEG_THUMBNAIL_WIDTH, THUMBNAIL_SIZES_MAP[0].width);
     set(KEY_JPEG_THUMBNAIL_HEIGHT, THUMBNAIL_SIZES_MAP[0].height);
 
-    // Set supported livesnapshot sizes
+    // Set default livesnapshot size
     if (m_pCapability->livesnapshot_sizes_tbl_cnt > 0 &&
         m_pCapability->livesnapshot_sizes_tbl_cnt <= MAX_SIZES_CNT) {
-        String8 liveSnpashotSizeValues = createSizesString(
-                m_pCapability->livesnapshot_sizes_tbl,
-                m_pCapability->livesnapshot_sizes_tbl_cnt);
-        set(KEY_QC_SUPPORTED_LIVESNAPSHOT_SIZES, liveSnpashotSizeValues.string());
-        ALOGI("%s: supported live snapshot sizes: %s", __func__, liveSnpashotSizeValues.string());
         m_LiveSnapshotSize =
             m_pCapability->livesnapshot_sizes_tbl[m_pCapability->livesnapshot_sizes_tbl_cnt-1];
     }
 
-    // Set supported preview formats
-    String8 previewFormatValues = createValuesString(
-            (int *)m_pCapability->supported_preview_fmts,
-            m_pCapability->supported_preview_fmt_cnt,
-            PREVIEW_FORMATS_MAP,
-            sizeof(PREVIEW_FORMATS_MAP)/sizeof(QCameraMap));
-    set(KEY_SUPPORTED_PREVIEW_FORMATS, previewFormatValues.string());
     // Set default preview format
     CameraParameters::setPreviewFormat(PIXEL_FORMAT_YUV420SP);
 
     // Set default Video Format
     set(KEY_VIDEO_FRAME_FORMAT, PIXEL_FORMAT_YUV420SP);
 
-    // Set supported picture formats
-    String8 pictureTypeValues(PIXEL_FORMAT_JPEG);
-    String8 str = createValuesString(
-            (int *)m_pCapability->supported_raw_fmts,
-            m_pCapability->supported_raw_fmt_cnt,
-            PICTURE_TYPES_MAP,
-            sizeof(PICTURE_TYPES_MAP)/sizeof(QCameraMap));
-    if (str.string() != NULL) {
-        pictureTypeValues.append(",");
-        pictureTypeValues.append(str);
-    }
-
-    set(KEY_SUPPORTED_PICTURE_FORMATS, pictureTypeValues.string());
     // Set default picture Format
     CameraParameters::setPictureFormat(PIXEL_FORMAT_JPEG);
-    // Set raw image size
-    char raw_size_str[32];
-    snprintf(raw_size_str, sizeof(raw_size_str), "%dx%d",
-             m_pCapability->raw_dim[0].width, m_pCapability->raw_dim[0].height);
-    set(KEY_QC_RAW_PICUTRE_SIZE, raw_size_str);
 
     //set default jpeg quality and thumbnail quality
     set(KEY_JPEG_QUALITY, 85);
     set(KEY_JPEG_THUMBNAIL_QUALITY, 85);
 
-    // Set FPS ranges
+    // Set default FPS range
     if (m_pCapability->fps_ranges_tbl_cnt > 0 &&
         m_pCapability->fps_ranges_tbl_cnt <= MAX_SIZES_CNT) {
-        int default_fps_index = 0;
-        String8 fpsRangeValues = createFpsRangeString(m_pCapability->fps_ranges_tbl,
-                                                      m_pCapability->fps_ranges_tbl_cnt,
-                                                      default_fps_index);
-        set(KEY_SUPPORTED_PREVIEW_FPS_RANGE, fpsRangeValues.string());
+        int default_fps_index = getWidestFpsRangeIndex(
+                m_pCapability->fps_ranges_tbl,
+                m_pCapability->fps_ranges_tbl_cnt);
 
         int min_fps =
             int(m_pCapability->fps_ranges_tbl[default_fps_index].min_fps * 1000);
@@ -2972,24 +3373,12 @@ int32_t QCameraParameters::initDefaultParameters()
         setPreviewFpsRange(min_fps, max_fps);
 
         // Set legacy preview fps
-        String8 fpsValues = createFpsString(m_pCapability->fps_ranges_tbl,
-                                            m_pCapability->fps_ranges_tbl_cnt);
-        set(KEY_SUPPORTED_PREVIEW_FRAME_RATES, fpsValues.string());
         CameraParameters::setPreviewFrameRate(int(m_pCapability->fps_ranges_tbl[default_fps_index].max_fps));
     } else {
         ALOGE("%s: supported fps ranges cnt is 0 or exceeds max!!!", __func__);
     }
-
-    // Set supported focus modes
+    // Set default focus mode and update corresponding parameter buf
     if (m_pCapability->supported_focus_modes_cnt > 0) {
-        String8 focusModeValues = createValuesString(
-                (int *)m_pCapability->supported_focus_modes,
-                m_pCapability->supported_focus_modes_cnt,
-                FOCUS_MODES_MAP,
-                sizeof(FOCUS_MODES_MAP)/sizeof(QCameraMap));
-        set(KEY_SUPPORTED_FOCUS_MODES, focusModeValues);
-
-        // Set default focus mode and update corresponding parameter buf
         const char *focusMode = lookupNameByValue(FOCUS_MODES_MAP,
                                              sizeof(FOCUS_MODES_MAP)/sizeof(QCameraMap),
                                              m_pCapability->supported_focus_modes[0]);
@@ -3020,134 +3409,23 @@ int32_t QCameraParameters::initDefaultParameters()
         setMeteringAreas(DEFAULT_CAMERA_AREA);
     }
 
-    // Set Saturation
-    set(KEY_QC_MIN_SATURATION, m_pCapability->saturation_ctrl.min_value);
-    set(KEY_QC_MAX_SATURATION, m_pCapability->saturation_ctrl.max_value);
-    set(KEY_QC_SATURATION_STEP, m_pCapability->saturation_ctrl.step);
     setSaturation(m_pCapability->saturation_ctrl.def_value);
-
-    // Set Sharpness
-    set(KEY_QC_MIN_SHARPNESS, m_pCapability->sharpness_ctrl.min_value);
-    set(KEY_QC_MAX_SHARPNESS, m_pCapability->sharpness_ctrl.max_value);
-    set(KEY_QC_SHARPNESS_STEP, m_pCapability->sharpness_ctrl.step);
     setSharpness(m_pCapability->sharpness_ctrl.def_value);
-
-    // Set Contrast
-    set(KEY_QC_MIN_CONTRAST, m_pCapability->contrast_ctrl.min_value);
-    set(KEY_QC_MAX_CONTRAST, m_pCapability->contrast_ctrl.max_value);
-    set(KEY_QC_CONTRAST_STEP, m_pCapability->contrast_ctrl.step);
     setContrast(m_pCapability->contrast_ctrl.def_value);
-
-    // Set SCE factor
-    set(KEY_QC_MIN_SCE_FACTOR, m_pCapability->sce_ctrl.min_value); // -100
-    set(KEY_QC_MAX_SCE_FACTOR, m_pCapability->sce_ctrl.max_value); // 100
-    set(KEY_QC_SCE_FACTOR_STEP, m_pCapability->sce_ctrl.step);     // 10
     setSkinToneEnhancement(m_pCapability->sce_ctrl.def_value);     // 0
-
-    // Set Brightness
-    set(KEY_QC_MIN_BRIGHTNESS, m_pCapability->brightness_ctrl.min_value); // 0
-    set(KEY_QC_MAX_BRIGHTNESS, m_pCapability->brightness_ctrl.max_value); // 6
-    set(KEY_QC_BRIGHTNESS_STEP, m_pCapability->brightness_ctrl.step);     // 1
     setBrightness(m_pCapability->brightness_ctrl.def_value);
-
-    // Set Auto exposure
-    String8 autoExposureValues = createValuesString(
-            (int *)m_pCapability->supported_aec_modes,
-            m_pCapability->supported_aec_modes_cnt,
-            AUTO_EXPOSURE_MAP,
-            sizeof(AUTO_EXPOSURE_MAP) / sizeof(QCameraMap));
-    set(KEY_QC_SUPPORTED_AUTO_EXPOSURE, autoExposureValues.string());
     setAutoExposure(AUTO_EXPOSURE_FRAME_AVG);
-
-    // Set Exposure Compensation
-    set(KEY_MAX_EXPOSURE_COMPENSATION, m_pCapability->exposure_compensation_max); // 12
-    set(KEY_MIN_EXPOSURE_COMPENSATION, m_pCapability->exposure_compensation_min); // -12
-    setFloat(KEY_EXPOSURE_COMPENSATION_STEP, m_pCapability->exposure_compensation_step); // 1/6
     setExposureCompensation(m_pCapability->exposure_compensation_default); // 0
-
-    // Set Antibanding
-    String8 antibandingValues = createValuesString(
-            (int *)m_pCapability->supported_antibandings,
-            m_pCapability->supported_antibandings_cnt,
-            ANTIBANDING_MODES_MAP,
-            sizeof(ANTIBANDING_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_SUPPORTED_ANTIBANDING, antibandingValues);
     setAntibanding(ANTIBANDING_OFF);
-
-    // Set Effect
-    String8 effectValues = createValuesString(
-            (int *)m_pCapability->supported_effects,
-            m_pCapability->supported_effects_cnt,
-            EFFECT_MODES_MAP,
-            sizeof(EFFECT_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_SUPPORTED_EFFECTS, effectValues);
     setEffect(EFFECT_NONE);
-
-    // Set WhiteBalance
-    String8 whitebalanceValues = createValuesString(
-            (int *)m_pCapability->supported_white_balances,
-            m_pCapability->supported_white_balances_cnt,
-            WHITE_BALANCE_MODES_MAP,
-            sizeof(WHITE_BALANCE_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_SUPPORTED_WHITE_BALANCE, whitebalanceValues);
     setWhiteBalance(WHITE_BALANCE_AUTO);
-
-    // Set Flash mode
-    String8 flashValues = createValuesString(
-            (int *)m_pCapability->supported_flash_modes,
-            m_pCapability->supported_flash_modes_cnt,
-            FLASH_MODES_MAP,
-            sizeof(FLASH_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_SUPPORTED_FLASH_MODES, flashValues);
     setFlash(FLASH_MODE_OFF);
-
-    // Set Scene Mode
-    String8 sceneModeValues = createValuesString(
-            (int *)m_pCapability->supported_scene_modes,
-            m_pCapability->supported_scene_modes_cnt,
-            SCENE_MODES_MAP,
-            sizeof(SCENE_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_SUPPORTED_SCENE_MODES, sceneModeValues);
     setSceneMode(SCENE_MODE_AUTO);
-
-    // Set ISO Mode
-    String8 isoValues = createValuesString(
-            (int *)m_pCapability->supported_iso_modes,
-            m_pCapability->supported_iso_modes_cnt,
-            ISO_MODES_MAP,
-            sizeof(ISO_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_QC_SUPPORTED_ISO_MODES, isoValues);
     setISOValue(ISO_AUTO);
-
-    // Set HFR
-    String8 hfrValues = createHfrValuesString(
-            m_pCapability->hfr_tbl,
-            m_pCapability->hfr_tbl_cnt,
-            HFR_MODES_MAP,
-            sizeof(HFR_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_QC_SUPPORTED_VIDEO_HIGH_FRAME_RATE_MODES, hfrValues.string());
-    String8 hfrSizeValues = createHfrSizesString(
-            m_pCapability->hfr_tbl,
-            m_pCapability->hfr_tbl_cnt);
-    set(KEY_QC_SUPPORTED_HFR_SIZES, hfrSizeValues.string());
     setHighFrameRate(VIDEO_HFR_OFF);
-
-    // Set Focus algorithms
-    String8 focusAlgoValues = createValuesString(
-            (int *)m_pCapability->supported_focus_algos,
-            m_pCapability->supported_focus_algos_cnt,
-            FOCUS_ALGO_MAP,
-            sizeof(FOCUS_ALGO_MAP) / sizeof(QCameraMap));
-    set(KEY_QC_SUPPORTED_FOCUS_ALGOS, focusAlgoValues);
     setSelectableZoneAf(FOCUS_ALGO_AUTO);
 
-    // Set Zoom Ratios
     if (m_pCapability->zoom_supported > 0) {
-        String8 zoomRatioValues = createZoomRatioValuesString(
-                m_pCapability->zoom_ratio_tbl,
-                m_pCapability->zoom_ratio_tbl_cnt);
-        set(KEY_ZOOM_RATIOS, zoomRatioValues);
-        set(KEY_MAX_ZOOM, m_pCapability->zoom_ratio_tbl_cnt - 1);
         setZoom(0);
     }
 
@@ -3158,67 +3436,25 @@ int32_t QCameraParameters::initDefaultParameters()
     if (strlen(prop) > 0) {
         set(KEY_QC_CAPTURE_BURST_EXPOSURE, prop);
     }
-    String8 bracketingValues = createValuesStringFromMap(
-            BRACKETING_MODES_MAP,
-            sizeof(BRACKETING_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_QC_SUPPORTED_AE_BRACKET_MODES, bracketingValues);
     setAEBracket(AE_BRACKET_OFF);
 
     // Set Denoise
-    String8 denoiseValues = createValuesStringFromMap(
-       DENOISE_ON_OFF_MODES_MAP, sizeof(DENOISE_ON_OFF_MODES_MAP) / sizeof(QCameraMap));
-    set(KEY_QC_SUPPORTED_DENOISE, denoiseValues.string());
 #ifdef DEFAULT_DENOISE_MODE_ON
     setWaveletDenoise(DENOISE_ON);
 #else
     setWaveletDenoise(DENOISE_OFF);
 #endif
 
-    // Set feature enable/disable
-    String8 enableDisableValues = createValuesStringFromMap(
-        ENABLE_DISABLE_MODES_MAP, sizeof(ENABLE_DISABLE_MODES_MAP) / sizeof(QCameraMap));
-
-    // Set Lens Shading
-    set(KEY_QC_SUPPORTED_LENSSHADE_MODES, enableDisableValues);
     setLensShadeValue(VALUE_ENABLE);
-
-    // Set MCE
-    set(KEY_QC_SUPPORTED_MEM_COLOR_ENHANCE_MODES, enableDisableValues);
     setMCEValue(VALUE_ENABLE);
-
-    // Set DIS
-    set(KEY_QC_SUPPORTED_DIS_MODES, enableDisableValues);
     setDISValue(VALUE_DISABLE);
-
-    // Set Histogram
-    set(KEY_QC_SUPPORTED_HISTOGRAM_MODES, enableDisableValues);
     set(KEY_QC_HISTOGRAM, VALUE_DISABLE);
-
-    //Set Red Eye Reduction
-    set(KEY_QC_SUPPORTED_REDEYE_REDUCTION, enableDisableValues);
     setRedeyeReduction(VALUE_DISABLE);
-
-    //Set SkinTone Enhancement
-    set(KEY_QC_SUPPORTED_SKIN_TONE_ENHANCEMENT_MODES, enableDisableValues);
-
-    // Set feature on/off
-    String8 onOffValues = createValuesStringFromMap(
-        ON_OFF_MODES_MAP, sizeof(ON_OFF_MODES_MAP) / sizeof(QCameraMap));
-
-    //Set Scene Detection
-    set(KEY_QC_SUPPORTED_SCENE_DETECT, onOffValues);
     setSceneDetect(VALUE_OFF);
-
-    //Set Face Detection
-    set(KEY_QC_SUPPORTED_FACE_DETECTION, onOffValues);
     set(KEY_QC_FACE_DETECTION, VALUE_OFF);
-
-    //Set Face Recognition
-    set(KEY_QC_SUPPORTED_FACE_RECOGNITION, onOffValues);
     set(KEY_QC_FACE_RECOGNITION, VALUE_OFF);
 
     //Set ZSL
-    set(KEY_QC_SUPPORTED_ZSL_MODES, onOffValues);
 #ifdef DEFAULT_ZSL_MODE_ON
     set(KEY_QC_ZSL, VALUE_ON);
     m_bZslMode = true;
@@ -3230,22 +3466,15 @@ int32_t QCameraParameters::initDefaultParameters()
 
     //Set video HDR
     if ((m_pCapability->qcom_supported_feature_mask & CAM_QCOM_FEATURE_VIDEO_HDR) > 0) {
-        set(KEY_QC_SUPPORTED_VIDEO_HDR_MODES, onOffValues);
         set(KEY_QC_VIDEO_HDR, VALUE_OFF);
     }
 
-    //Set Touch AF/AEC
-    String8 touchValues = createValuesStringFromMap(
-       TOUCH_AF_AEC_MODES_MAP, sizeof(TOUCH_AF_AEC_MODES_MAP) / sizeof(QCameraMap));
+    setPreviewCbPacked(VALUE_OFF);
 
-    set(KEY_QC_SUPPORTED_TOUCH_AF_AEC, touchValues);
     set(KEY_QC_TOUCH_AF_AEC, TOUCH_AF_AEC_OFF);
 
     //set flip mode
     if ((m_pCapability->qcom_supported_feature_mask & CAM_QCOM_FEATURE_FLIP) > 0) {
-        String8 flipModes = createValuesStringFromMap(
-           FLIP_MODES_MAP, sizeof(FLIP_MODES_MAP) / sizeof(QCameraMap));
-        set(KEY_QC_SUPPORTED_FLIP_MODES, flipModes);
         set(KEY_QC_PREVIEW_FLIP, FLIP_MODE_OFF);
         set(KEY_QC_VIDEO_FLIP, FLIP_MODE_OFF);
         set(KEY_QC_SNAPSHOT_PICTURE_FLIP, FLIP_MODE_OFF);
@@ -3278,16 +3507,21 @@ int32_t QCameraParameters::initDefaultParameters()
  * PARAMETERS :
  *   @capabilities  : ptr to camera capabilities
  *   @mmops         : ptr to memory ops table for mapping/unmapping
+ *   @capParams     : ptr to read only params built by initCapabilityParameters
+ *                    for this camera, NULL to build them here
  *
  * RETURN     : int32_t type of status
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int32_t QCameraParameters::init(cam_capability_t *capabilities, mm_camera_vtbl_t *mmOps)
+int32_t QCameraParameters::init(cam_capability_t *capabilities,
+                                mm_camera_vtbl_t *mmOps,
+                                const CameraParameters *capParams)
 {
     int32_t rc = NO_ERROR;
 
     m_pCapability = capabilities;
+    m_pCapParams = capParams;
     m_pCamOpsTbl = mmOps;
 
     //Allocate Set Param Buffer
@@ -3310,6 +3544,12 @@ int32_t QCameraParameters::init(cam_capability_t *capabilities, mm_camera_vtbl_t
         goto TRANS_INIT_ERROR2;
     }
     m_pParamBuf = (parm_buffer_t*) DATA_PTR(m_pParamHeap,0);
+    // only touched entries are cleared per batch from now on
+    memset(m_pParamBuf, 0, sizeof(parm_buffer_t));
+    m_pParamBuf->first_flagged_entry = CAM_INTF_PARM_MAX;
+    memset(m_parmBatchMask, 0, sizeof(m_parmBatchMask));
+    memset(m_parmGetMask, 0, sizeof(m_parmGetMask));
+    releaseCommittedEntries();
 
     initDefaultParameters();
 
@@ -3348,12 +3588,15 @@ void QCameraParameters::deinit()
         m_pCamOpsTbl = NULL;
     }
     m_pCapability = NULL;
+    m_pCapParams = NULL;
     if (NULL != m_pParamHeap) {
         m_pParamHeap->deallocate();
         delete m_pParamHeap;
         m_pParamHeap = NULL;
         m_pParamBuf = NULL;
     }
+    releaseCommittedEntries();
+    m_bLastParamsValid = false;
 
     m_tempMap.clear();
 }
@@ -3822,6 +4065,39 @@ int32_t QCameraParameters::setVideoHDR(const char *videoHDR)
     return BAD_VALUE;
 }
 
+/*===========================================================================
+ * FUNCTION   : setPreviewCbPacked
+ *
+ * DESCRIPTION: set packed preview callback mode. When on, YUV preview
+ *              callback frames are copied without stride/scanline padding
+ *              before the buffer is displayed. It's HAL only, nothing is
+ *              sent to the backend.
+ *
+ * PARAMETERS :
+ *   @packedStr : packed preview callback value string
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraParameters::setPreviewCbPacked(const char *packedStr)
+{
+    if (packedStr != NULL) {
+        int32_t value = lookupAttr(ON_OFF_MODES_MAP,
+                                   sizeof(ON_OFF_MODES_MAP)/sizeof(QCameraMap),
+                                   packedStr);
+        if (value != NAME_NOT_FOUND) {
+            ALOGD("%s: Setting packed preview callback %s", __func__, packedStr);
+            updateParamEntry(KEY_QC_PREVIEW_CB_PACKED, packedStr);
+            m_bPreviewCbPacked = (value != 0);
+            return NO_ERROR;
+        }
+    }
+    ALOGE("Invalid packed preview callback value: %s",
+          (packedStr == NULL) ? "NULL" : packedStr);
+    return BAD_VALUE;
+}
+
 /*===========================================================================
  * FUNCTION   : setFaceRecognition
  *
@@ -5931,7 +6207,9 @@ bool QCameraParameters::validateCameraAreas(cam_area_t *areas, int num_areas)
 /*===========================================================================
  * FUNCTION   : initBatchUpdate
  *
- * DESCRIPTION: init camera parameters buf entries
+ * DESCRIPTION: init set parameters batch. Only the entries touched by the
+ *              previous batch are cleared, the rest of the table is still
+ *              zero from init.
  *
  * PARAMETERS :
  *   @p_table : ptr to parameter buffer
@@ -5945,8 +6223,24 @@ int32_t QCameraParameters::initBatchUpdate(parm_buffer_t *p_table)
     int32_t hal_version = CAM_HAL_V1;
     m_tempMap.clear();
 
-    memset(p_table, 0, sizeof(parm_buffer_t));
+    for (int w = 0; w < PARM_BATCH_MASK_WORDS; w++) {
+        uint32_t bits = m_parmBatchMask[w];
+        while (bits) {
+            int id = w * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (m_parmGetMask[w] & (1U << (id & 31))) {
+                // server may have written the whole entry
+                memset(&p_table->entry[id], 0, sizeof(p_table->entry[id]));
+            } else {
+                memset(POINTER_OF(id, p_table), 0, m_parmLen[id]);
+                SET_NEXT_PARAM_ID(id, p_table, 0);
+            }
+        }
+        m_parmBatchMask[w] = 0;
+        m_parmGetMask[w] = 0;
+    }
     p_table->first_flagged_entry = CAM_INTF_PARM_MAX;
+
     AddSetParmEntryToBatch(p_table, CAM_INTF_PARM_HAL_VERSION,
                 sizeof(hal_version), &hal_version);
     return NO_ERROR;
@@ -5955,7 +6249,8 @@ int32_t QCameraParameters::initBatchUpdate(parm_buffer_t *p_table)
 /*===========================================================================
  * FUNCTION   : AddSetParmEntryToBatch
  *
- * DESCRIPTION: add set parameter entry into batch
+ * DESCRIPTION: add set parameter entry into batch. The entry is only marked
+ *              here, linking happens once per batch in linkBatchEntries.
  *
  * PARAMETERS :
  *   @p_table     : ptr to parameter buffer
@@ -5973,38 +6268,24 @@ int32_t QCameraParameters::AddSetParmEntryToBatch(parm_buffer_t *p_table,
                                                   void *paramValue)
 {
     int position = paramType;
-    int current, next;
-
-    /*************************************************************************
-    *                 Code to take care of linking next flags                *
-    *************************************************************************/
-    current = GET_FIRST_PARAM_ID(p_table);
-    if (position == current){
-        //DO NOTHING
-    } else if (position < current){
-        SET_NEXT_PARAM_ID(position, p_table, current);
-        SET_FIRST_PARAM_ID(p_table, position);
-    } else {
-        /* Search for the position in the linked list where we need to slot in*/
-        while (position > GET_NEXT_PARAM_ID(current, p_table))
-            current = GET_NEXT_PARAM_ID(current, p_table);
-
-        /*If node already exists no need to alter linking*/
-        if (position != GET_NEXT_PARAM_ID(current, p_table)) {
-            next = GET_NEXT_PARAM_ID(current, p_table);
-            SET_NEXT_PARAM_ID(current, p_table, position);
-            SET_NEXT_PARAM_ID(position, p_table, next);
-        }
-    }
-
-    /*************************************************************************
-    *                   Copy contents into entry                             *
-    *************************************************************************/
 
+    if (position < 0 || position >= CAM_INTF_PARM_MAX) {
+        ALOGE("%s: Invalid parameter type %d", __func__, position);
+        return BAD_VALUE;
+    }
     if (paramLength > sizeof(parm_type_t)) {
         ALOGE("%s:Size of input larger than max entry size",__func__);
         return BAD_VALUE;
     }
+
+    // a value shorter than an earlier one in this batch must not leave
+    // stale bytes behind
+    if ((m_parmBatchMask[position / 32] & (1U << (position & 31))) &&
+        m_parmLen[position] > paramLength) {
+        memset(POINTER_OF(paramType, p_table), 0, m_parmLen[position]);
+    }
+    m_parmBatchMask[position / 32] |= 1U << (position & 31);
+    m_parmLen[position] = paramLength;
     memcpy(POINTER_OF(paramType,p_table), paramValue, paramLength);
     return NO_ERROR;
 }
@@ -6026,37 +6307,130 @@ int32_t QCameraParameters::AddGetParmEntryToBatch(parm_buffer_t *p_table,
                                                   cam_intf_parm_type_t paramType)
 {
     int position = paramType;
-    int current, next;
-
-    /*************************************************************************
-    *                 Code to take care of linking next flags                *
-    *************************************************************************/
-    current = GET_FIRST_PARAM_ID(p_table);
-    if (position == current){
-        //DO NOTHING
-    } else if (position < current){
-        SET_NEXT_PARAM_ID(position, p_table, current);
-        SET_FIRST_PARAM_ID(p_table, position);
-    } else {
-        /* Search for the position in the linked list where we need to slot in*/
-        while (position > GET_NEXT_PARAM_ID(current, p_table))
-            current = GET_NEXT_PARAM_ID(current, p_table);
-
-        /*If node already exists no need to alter linking*/
-        if (position != GET_NEXT_PARAM_ID(current, p_table)) {
-            next=GET_NEXT_PARAM_ID(current, p_table);
-            SET_NEXT_PARAM_ID(current, p_table, position);
-            SET_NEXT_PARAM_ID(position, p_table, next);
-        }
+
+    if (position < 0 || position >= CAM_INTF_PARM_MAX) {
+        ALOGE("%s: Invalid parameter type %d", __func__, position);
+        return BAD_VALUE;
     }
 
+    // get entries are always sent, never compared against committed values
+    m_parmBatchMask[position / 32] |= 1U << (position & 31);
+    m_parmGetMask[position / 32] |= 1U << (position & 31);
     return NO_ERROR;
 }
 
+/*===========================================================================
+ * FUNCTION   : linkBatchEntries
+ *
+ * DESCRIPTION: link the entries of current batch into the flagged entry
+ *              list of the table in ascending order. Set entries whose
+ *              value equals the one last accepted by server are left out.
+ *
+ * PARAMETERS :
+ *   @p_table : ptr to parameter buffer
+ *
+ * RETURN     : number of entries linked
+ *==========================================================================*/
+int32_t QCameraParameters::linkBatchEntries(parm_buffer_t *p_table)
+{
+    int32_t num_linked = 0;
+    int prev = CAM_INTF_PARM_MAX;
+
+    p_table->first_flagged_entry = CAM_INTF_PARM_MAX;
+    for (int w = 0; w < PARM_BATCH_MASK_WORDS; w++) {
+        uint32_t bits = m_parmBatchMask[w];
+        while (bits) {
+            int id = w * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+
+            if (!(m_parmGetMask[w] & (1U << (id & 31))) &&
+                m_pParmCommitted[id] != NULL &&
+                m_parmCommittedLen[id] == m_parmLen[id] &&
+                memcmp(m_pParmCommitted[id], POINTER_OF(id, p_table),
+                       m_parmLen[id]) == 0) {
+                // unchanged, server already has it
+                SET_NEXT_PARAM_ID(id, p_table, 0);
+                continue;
+            }
+
+            if (prev == CAM_INTF_PARM_MAX) {
+                SET_FIRST_PARAM_ID(p_table, id);
+            } else {
+                SET_NEXT_PARAM_ID(prev, p_table, id);
+            }
+            SET_NEXT_PARAM_ID(id, p_table, CAM_INTF_PARM_MAX);
+            prev = id;
+            num_linked++;
+        }
+    }
+    return num_linked;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateCommittedEntries
+ *
+ * DESCRIPTION: record the set entries linked in the table as committed
+ *              values after server processed the batch
+ *
+ * PARAMETERS :
+ *   @p_table  : ptr to parameter buffer
+ *   @accepted : if server accepted the batch. If not, the committed values
+ *               of the linked entries are dropped so they are sent again.
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::updateCommittedEntries(parm_buffer_t *p_table,
+                                               bool accepted)
+{
+    int id = GET_FIRST_PARAM_ID(p_table);
+
+    while (id < CAM_INTF_PARM_MAX) {
+        if (!(m_parmGetMask[id / 32] & (1U << (id & 31)))) {
+            uint32_t len = m_parmLen[id];
+            if (accepted && len > 0) {
+                if (m_parmCommittedLen[id] < len) {
+                    free(m_pParmCommitted[id]);
+                    m_pParmCommitted[id] = malloc(len);
+                }
+                if (m_pParmCommitted[id] != NULL) {
+                    memcpy(m_pParmCommitted[id], POINTER_OF(id, p_table), len);
+                    m_parmCommittedLen[id] = len;
+                } else {
+                    m_parmCommittedLen[id] = 0;
+                }
+            } else {
+                free(m_pParmCommitted[id]);
+                m_pParmCommitted[id] = NULL;
+                m_parmCommittedLen[id] = 0;
+            }
+        }
+        id = GET_NEXT_PARAM_ID(id, p_table);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseCommittedEntries
+ *
+ * DESCRIPTION: forget all committed values, every entry is sent again
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::releaseCommittedEntries()
+{
+    for (int i = 0; i < CAM_INTF_PARM_MAX; i++) {
+        free(m_pParmCommitted[i]);
+        m_pParmCommitted[i] = NULL;
+        m_parmCommittedLen[i] = 0;
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : commitSetBatch
  *
- * DESCRIPTION: commit all set parameters in the batch work to backend
+ * DESCRIPTION: commit all changed set parameters in the batch work to
+ *              backend
  *
  * PARAMETERS : none
  *
@@ -6067,8 +6441,9 @@ int32_t QCameraParameters::AddGetParmEntryToBatch(parm_buffer_t *p_table,
 int32_t QCameraParameters::commitSetBatch()
 {
     int32_t rc = NO_ERROR;
-    if (m_pParamBuf->first_flagged_entry < CAM_INTF_PARM_MAX) {
+    if (linkBatchEntries(m_pParamBuf) > 0) {
         rc = m_pCamOpsTbl->ops->set_parms(m_pCamOpsTbl->camera_handle, m_pParamBuf);
+        updateCommittedEntries(m_pParamBuf, rc == NO_ERROR);
     }
     if (rc == NO_ERROR) {
         // commit change from temp storage into param map
@@ -6090,7 +6465,7 @@ int32_t QCameraParameters::commitSetBatch()
  *==========================================================================*/
 int32_t QCameraParameters::commitGetBatch()
 {
-    if (m_pParamBuf->first_flagged_entry < CAM_INTF_PARM_MAX) {
+    if (linkBatchEntries(m_pParamBuf) > 0) {
         return m_pCamOpsTbl->ops->get_parms(m_pCamOpsTbl->camera_handle, m_pParamBuf);
     } else {
         return NO_ERROR;
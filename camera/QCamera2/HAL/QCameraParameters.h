@@ -43,6 +43,7 @@ static const char ExifUndefinedPrefix[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 
 #define EXIF_ASCII_PREFIX_SIZE           8   //(sizeof(ExifAsciiPrefix))
 #define FOCAL_LENGTH_DECIMAL_PRECISION   100
+#define PARM_BATCH_MASK_WORDS            ((CAM_INTF_PARM_MAX + 31) / 32)
 
 class QCameraParameters: public CameraParameters
 {
@@ -290,6 +291,8 @@ public:
     static const char KEY_QC_HDR_NEED_1X[];
     static const char KEY_QC_VIDEO_HDR[];
     static const char KEY_QC_SUPPORTED_VIDEO_HDR_MODES[];
+    static const char KEY_QC_PREVIEW_CB_PACKED[];
+    static const char KEY_QC_SUPPORTED_PREVIEW_CB_PACKED_MODES[];
 
     // Values for SKIN TONE ENHANCEMENT
     static const char SKIN_TONE_ENHANCEMENT_ENABLE[] ;
@@ -352,11 +355,14 @@ public:
     void setTouchIndexAf(int x, int y);
     void getTouchIndexAf(int *x, int *y);
 
-    int32_t init(cam_capability_t *, mm_camera_vtbl_t *);
+    int32_t init(cam_capability_t *, mm_camera_vtbl_t *,
+                 const CameraParameters *capParams = NULL);
     void deinit();
     int32_t assign(QCameraParameters& params);
     int32_t initDefaultParameters();
-    int32_t updateParameters(QCameraParameters&, bool &needRestart);
+    static void initCapabilityParameters(const cam_capability_t *cap,
+                                         CameraParameters &params);
+    int32_t updateParameters(const String8 &params, bool &needRestart);
     int32_t commitParameters();
     int getPreviewHalPixelFormat() const;
     int32_t getStreamFormat(cam_stream_type_t streamType,
@@ -371,6 +377,7 @@ public:
     int getMaxUnmatchedFramesInQueue();
     bool isZSLMode() {return m_bZslMode;};
     bool isNoDisplayMode() {return m_bNoDisplayMode;};
+    bool isPreviewCbPacked() {return m_bPreviewCbPacked;};
     bool isWNREnabled() {return m_bWNROn;};
     uint8_t getNumOfSnapshots();
     uint8_t getNumOfExtraHDRBufsIfNeeded();
@@ -418,6 +425,13 @@ public:
     bool isAFRunning() {return m_bAFRunning;};
 
 private:
+    typedef int32_t (QCameraParameters::*setParamFunc)(const QCameraParameters&);
+    typedef struct {
+        setParamFunc setter;
+        const char *keys[10];           // keys the setter depends on, NULL terminated
+        bool always;                    // also reads internal state, call on every update
+    } QCameraParamSetter;
+
     int32_t setPreviewSize(const QCameraParameters& );
     int32_t setVideoSize(const QCameraParameters& );
     int32_t setPictureSize(const QCameraParameters& );
@@ -439,6 +453,7 @@ private:
     int32_t setSkinToneEnhancement(const QCameraParameters& );
     int32_t setSceneDetect(const QCameraParameters& );
     int32_t setVideoHDR(const QCameraParameters& );
+    int32_t setPreviewCbPacked(const QCameraParameters& );
     int32_t setZoom(const QCameraParameters& );
     int32_t setISOValue(const QCameraParameters& );
     int32_t setRotation(const QCameraParameters& );
@@ -479,6 +494,7 @@ private:
     int32_t setSkinToneEnhancement(int sceFactor);
     int32_t setSceneDetect(const char *scendDetect);
     int32_t setVideoHDR(const char *videoHDR);
+    int32_t setPreviewCbPacked(const char *packedStr);
     int32_t setZoom(int zoom_level);
     int32_t setISOValue(const char *isoValue);
     int32_t setFlash(const char *flashStr);
@@ -509,22 +525,23 @@ private:
     bool validateCameraAreas(cam_area_t *areas, int num_areas);
     int parseGPSCoordinate(const char *coord_str, rat_t *coord);
     int32_t getRational(rat_t *rat, int num, int denom);
-    String8 createSizesString(const cam_dimension_t *sizes, int len);
-    String8 createValuesString(const int *values, int len,
-                               const QCameraMap *map, int map_len);
-    String8 createValuesStringFromMap(const QCameraMap *map,
-                                      int map_len);
-    String8 createHfrValuesString(const cam_hfr_info_t *values, int len,
-                                  const QCameraMap *map, int map_len);
-    String8 createHfrSizesString(const cam_hfr_info_t *values, int len);
-    String8 createFpsRangeString(const cam_fps_range_t *fps,
-                                 int len,
-                                 int &default_fps_index);
+    static String8 createSizesString(const cam_dimension_t *sizes, int len);
+    static String8 createValuesString(const int *values, int len,
+                                      const QCameraMap *map, int map_len);
+    static String8 createValuesStringFromMap(const QCameraMap *map,
+                                             int map_len);
+    static String8 createHfrValuesString(const cam_hfr_info_t *values, int len,
+                                         const QCameraMap *map, int map_len);
+    static String8 createHfrSizesString(const cam_hfr_info_t *values, int len);
+    static String8 createFpsRangeString(const cam_fps_range_t *fps, int len);
+    static int getWidestFpsRangeIndex(const cam_fps_range_t *fps, int len);
     static int compareFPSValues(const void *p1, const void *p2);
-    String8 createFpsString(const cam_fps_range_t *fps, int len);
-    String8 createZoomRatioValuesString(int *zoomRatios, int length);
-    int lookupAttr(const QCameraMap arr[], int len, const char *name);
-    const char *lookupNameByValue(const QCameraMap arr[], int len, int value);
+    static String8 createFpsString(const cam_fps_range_t *fps, int len);
+    static String8 createZoomRatioValuesString(int *zoomRatios, int length);
+    struct MapByName;
+    struct MapByValue;
+    static int lookupAttr(const QCameraMap arr[], int len, const char *name);
+    static const char *lookupNameByValue(const QCameraMap arr[], int len, int value);
 
     // ops for batch set/get params with server
     int32_t initBatchUpdate(parm_buffer_t *p_table);
@@ -536,6 +553,9 @@ private:
     int32_t AddGetParmEntryToBatch(parm_buffer_t *p_table,
                                    cam_intf_parm_type_t paramType);
     int32_t commitGetBatch();
+    int32_t linkBatchEntries(parm_buffer_t *p_table);
+    void updateCommittedEntries(parm_buffer_t *p_table, bool accepted);
+    void releaseCommittedEntries();
 
     // ops to tempororily update parameter entries and commit
     int32_t updateParamEntry(const char *key, const char *value);
@@ -563,8 +583,10 @@ private:
     static const QCameraMap TRUE_FALSE_MODES_MAP[];
     static const QCameraMap TOUCH_AF_AEC_MODES_MAP[];
     static const QCameraMap FLIP_MODES_MAP[];
+    static const QCameraParamSetter PARAM_SETTERS[];
 
     cam_capability_t *m_pCapability;
+    const CameraParameters *m_pCapParams; // cached read only params, may be NULL
     mm_camera_vtbl_t *m_pCamOpsTbl;
     QCameraHeapMemory *m_pParamHeap;
     parm_buffer_t     *m_pParamBuf;  // ptr to param buf in m_pParamHeap
@@ -581,6 +603,7 @@ private:
     int32_t mPictureFormat;         // could be CAMERA_PICTURE_TYPE_JPEG or cam_format_t
     bool m_bNeedRestart;            // if preview needs restart after parameters updated
     bool m_bNoDisplayMode;
+    bool m_bPreviewCbPacked;        // if preview callback frames are stride compacted
     bool m_bWNROn;
     bool m_bNeedLockCAF;
     bool m_bCAFLocked;
@@ -589,6 +612,17 @@ private:
     cam_dimension_t m_LiveSnapshotSize; // live snapshot size
 
     DefaultKeyedVector<String8,String8> m_tempMap; // map for temororily store parameters to be set
+
+    // last user setting applied without error, to dispatch only changed keys
+    bool m_bLastParamsValid;
+    CameraParameters m_lastParams;
+
+    // batch bookkeeping, entries are only linked into m_pParamBuf on commit
+    uint32_t m_parmBatchMask[PARM_BATCH_MASK_WORDS]; // entries touched in current batch
+    uint32_t m_parmGetMask[PARM_BATCH_MASK_WORDS];   // entries to be read back from server
+    uint32_t m_parmLen[CAM_INTF_PARM_MAX];           // bytes written per touched entry
+    void *m_pParmCommitted[CAM_INTF_PARM_MAX];       // last value accepted by server
+    uint32_t m_parmCommittedLen[CAM_INTF_PARM_MAX];
 };
 
 }; // namespace qcamera
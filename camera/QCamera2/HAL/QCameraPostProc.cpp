@@ -1221,20 +1221,14 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
     uint8_t needNewSess = TRUE;
     QCameraPostProcessor *pme = (QCameraPostProcessor *)data;
     QCameraCmdThread *cmdThread = &pme->m_dataProcTh;
+    camera_cmd_type_t cmd;
 
     ALOGD("%s: E", __func__);
     do {
-        do {
-            ret = cam_sem_wait(&cmdThread->cmd_sem);
-            if (ret != 0 && errno != EINVAL) {
-                ALOGE("%s: cam_sem_wait error (%s)",
-                           __func__, strerror(errno));
-                return NULL;
-            }
-        } while (ret != 0);
+        if (NO_ERROR != cmdThread->waitCmd(&cmd)) {
+            return NULL;
+        }
 
-        // we got notified about new cmd avail in cmd queue
-        camera_cmd_type_t cmd = cmdThread->getCmd();
         switch (cmd) {
         case CAMERA_CMD_TYPE_START_DATA_PROC:
             ALOGD("%s: start data proc", __func__);
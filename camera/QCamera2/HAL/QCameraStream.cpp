@@ -166,6 +166,7 @@ QCameraStream::QCameraStream(QCameraAllocator &allocator,
         mStreamInfo(NULL),
         mNumBufs(0),
         mDataCB(NULL),
+        mDataQ(NULL, this, QCAMERA_QUEUE_MODE_RING, MM_CAMERA_MAX_NUM_FRAMES),
         mStreamInfoBuf(NULL),
         mStreamBufs(NULL),
         mAllocator(allocator),
@@ -300,6 +301,7 @@ done:
 int32_t QCameraStream::start()
 {
     int32_t rc = 0;
+    mStats.reset();
     rc = mProcTh.launch(dataProcRoutine, this);
     return rc;
 }
@@ -378,8 +380,15 @@ int32_t QCameraStream::processZoomDone(preview_stream_ops_t *previewWindow,
 int32_t QCameraStream::processDataNotify(mm_camera_super_buf_t *frame)
 {
     ALOGI("%s:\n", __func__);
-    mDataQ.enqueue((void *)frame);
-    return mProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    if (mDataQ.enqueue((void *)frame)) {
+        return mProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    }
+
+    ALOGD("%s: Stream thread is not active, no ops here", __func__);
+    mStats.frameDropped();
+    bufDone(frame->bufs[0]->buf_idx);
+    free(frame);
+    return NO_ERROR;
 }
 
 /*===========================================================================
@@ -411,10 +420,13 @@ void QCameraStream::dataNotifyCB(mm_camera_super_buf_t *recvd_frame,
         (mm_camera_super_buf_t *)malloc(sizeof(mm_camera_super_buf_t));
     if (frame == NULL) {
         ALOGE("%s: No mem for mm_camera_buf_def_t", __func__);
+        stream->mStats.frameDropped();
         stream->bufDone(recvd_frame->bufs[0]->buf_idx);
         return;
     }
     *frame = *recvd_frame;
+    stream->mStats.frameReceived(frame->bufs[0]->frame_idx,
+                                 frame->bufs[0]->buf_idx);
     stream->processDataNotify(frame);
     return;
 }
@@ -432,32 +444,32 @@ void QCameraStream::dataNotifyCB(mm_camera_super_buf_t *recvd_frame,
 void *QCameraStream::dataProcRoutine(void *data)
 {
     int running = 1;
-    int ret;
     QCameraStream *pme = (QCameraStream *)data;
     QCameraCmdThread *cmdThread = &pme->mProcTh;
+    camera_cmd_type_t cmd;
 
     ALOGI("%s: E", __func__);
     do {
-        do {
-            ret = cam_sem_wait(&cmdThread->cmd_sem);
-            if (ret != 0 && errno != EINVAL) {
-                ALOGE("%s: cam_sem_wait error (%s)",
-                      __func__, strerror(errno));
-                return NULL;
-            }
-        } while (ret != 0);
+        if (NO_ERROR != cmdThread->waitCmd(&cmd)) {
+            return NULL;
+        }
 
-        // we got notified about new cmd avail in cmd queue
-        camera_cmd_type_t cmd = cmdThread->getCmd();
         switch (cmd) {
         case CAMERA_CMD_TYPE_DO_NEXT_JOB:
             {
                 ALOGD("%s: Do next job", __func__);
-                mm_camera_super_buf_t *frame =
-                    (mm_camera_super_buf_t *)pme->mDataQ.dequeue();
-                if (NULL != frame) {
+                // catch up with all queued frames, the DO_NEXT_JOB cmds
+                // of the frames taken here will find the queue empty
+                void *frames[MM_CAMERA_MAX_NUM_FRAMES];
+                int numFrames = pme->mDataQ.dequeueBatch(frames,
+                                                         MM_CAMERA_MAX_NUM_FRAMES);
+                for (int i = 0; i < numFrames; i++) {
+                    mm_camera_super_buf_t *frame =
+                        (mm_camera_super_buf_t *)frames[i];
                     if (pme->mDataCB != NULL) {
+                        int64_t start = QCameraStreamStats::now();
                         pme->mDataCB(frame, pme, pme->mUserData);
+                        pme->mStats.callbackDone(start);
                     } else {
                         // no data cb routine, return buf here
                         pme->bufDone(frame->bufs[0]->buf_idx);
@@ -503,6 +515,7 @@ int32_t QCameraStream::bufDone(int index)
     if (rc < 0)
         return rc;
 
+    mStats.bufReturned(index);
     return rc;
 }
 
@@ -575,19 +588,31 @@ int32_t QCameraStream::getBufs(cam_frame_len_offset_t *offset,
         return NO_MEMORY;
     }
 
+    // map all buffers in one go, the server acks are pipelined
+    mm_camera_buf_map_t *bufMaps =
+        (mm_camera_buf_map_t *)malloc(mNumBufs * sizeof(mm_camera_buf_map_t));
+    if (!bufMaps) {
+        ALOGE("%s: Out of memory", __func__);
+        mStreamBufs->deallocate();
+        delete mStreamBufs;
+        mStreamBufs = NULL;
+        return NO_MEMORY;
+    }
     for (int i = 0; i < mNumBufs; i++) {
-        rc = ops_tbl->map_ops(i, -1, mStreamBufs->getFd(i),
-                mStreamBufs->getSize(i), ops_tbl->userdata);
-        if (rc < 0) {
-            ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
-            for (int j = 0; j < i; j++) {
-                ops_tbl->unmap_ops(j, -1, ops_tbl->userdata);
-            }
-            mStreamBufs->deallocate();
-            delete mStreamBufs;
-            mStreamBufs = NULL;
-            return INVALID_OPERATION;
-        }
+        bufMaps[i].frame_idx = i;
+        bufMaps[i].plane_idx = -1;
+        bufMaps[i].fd = mStreamBufs->getFd(i);
+        bufMaps[i].size = mStreamBufs->getSize(i);
+    }
+    rc = ops_tbl->bundled_map_ops(bufMaps, mNumBufs, ops_tbl->userdata);
+    free(bufMaps);
+    if (rc < 0) {
+        // bundled map leaves no buffer mapped on failure
+        ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
+        mStreamBufs->deallocate();
+        delete mStreamBufs;
+        mStreamBufs = NULL;
+        return INVALID_OPERATION;
     }
 
     //regFlags array is allocated by us, but consumed and freed by mm-camera-interface
@@ -657,10 +682,25 @@ int32_t QCameraStream::getBufs(cam_frame_len_offset_t *offset,
 int32_t QCameraStream::putBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl)
 {
     int rc = NO_ERROR;
-    for (int i = 0; i < mNumBufs; i++) {
-        rc = ops_tbl->unmap_ops(i, -1, ops_tbl->userdata);
+    mm_camera_buf_map_t *bufMaps =
+        (mm_camera_buf_map_t *)malloc(mNumBufs * sizeof(mm_camera_buf_map_t));
+    if (bufMaps) {
+        memset(bufMaps, 0, mNumBufs * sizeof(mm_camera_buf_map_t));
+        for (int i = 0; i < mNumBufs; i++) {
+            bufMaps[i].frame_idx = i;
+            bufMaps[i].plane_idx = -1;
+        }
+        rc = ops_tbl->bundled_unmap_ops(bufMaps, mNumBufs, ops_tbl->userdata);
+        free(bufMaps);
         if (rc < 0) {
-            ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
+            ALOGE("%s: unmap_stream_buf failed: %d", __func__, rc);
+        }
+    } else {
+        for (int i = 0; i < mNumBufs; i++) {
+            rc = ops_tbl->unmap_ops(i, -1, ops_tbl->userdata);
+            if (rc < 0) {
+                ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
+            }
         }
     }
     mBufDefs = NULL; // mBufDefs just keep a ptr to the buffer
@@ -940,4 +980,22 @@ int32_t QCameraStream::setParameter(cam_stream_parm_buffer_t &param)
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : dump
+ *
+ * DESCRIPTION: dump frame stats of the stream
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStream::dump(int fd)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "stream %d type %d", mHandle,
+             mStreamInfo != NULL ? mStreamInfo->stream_type : -1);
+    mStats.dump(fd, name);
+}
+
 }; // namespace qcamera
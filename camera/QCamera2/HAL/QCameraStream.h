@@ -34,6 +34,7 @@
 #include "QCameraCmdThread.h"
 #include "QCameraMem.h"
 #include "QCameraAllocator.h"
+#include "QCameraStreamStats.h"
 
 extern "C" {
 #include <mm_camera_interface.h>
@@ -84,6 +85,8 @@ public:
                    int32_t plane_idx, int fd, uint32_t size);
     int32_t unmapBuf(uint8_t buf_type, uint32_t buf_idx, int32_t plane_idx);
     int32_t setParameter(cam_stream_parm_buffer_t &param);
+    QCameraStreamStats &getStats() {return mStats;};
+    void dump(int fd);
 
 private:
     uint32_t mCamHandle;
@@ -107,6 +110,7 @@ private:
     cam_padding_info_t mPaddingInfo;
     cam_rect_t mCropInfo;
     pthread_mutex_t mCropLock; // lock to protect crop info
+    QCameraStreamStats mStats; // frame stats, always on
 
     static int32_t get_bufs(
                      cam_frame_len_offset_t *offset,
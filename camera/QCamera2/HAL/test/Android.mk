@@ -29,3 +29,76 @@ LOCAL_MODULE_TAGS:= tests
 LOCAL_CFLAGS += -Wall -fno-short-enums -O0
 
 include $(BUILD_EXECUTABLE)
+
+# QCameraMapIndex check and lookup benchmark, no camera needed
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= qcamera_map_index_bench.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../util
+
+LOCAL_MODULE:= qcamera_map_index_bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+# camera open time benchmark, talks to the HAL module directly
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= qcamera_open_bench.cpp
+
+LOCAL_SHARED_LIBRARIES:= \
+    libhardware \
+    libcutils
+
+LOCAL_MODULE:= qcamera_open_bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+# packed preview plane copy check and benchmark, no camera needed
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_plane_copy_test.cpp \
+    ../../util/QCameraPlaneCopy.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../util
+
+LOCAL_MODULE:= qcamera_plane_copy_test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+# make sure the NEON kernel is built and checked on 32 bit ARM too
+LOCAL_CFLAGS_arm += -mfpu=neon
+
+include $(BUILD_EXECUTABLE)
+
+# raw format unpack check and 13MP RAW16 benchmark, no camera needed
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_raw_format_test.cpp \
+    ../../util/QCameraRawFormat.cpp
+
+LOCAL_SRC_FILES_arm += ../../util/QCameraRawFormatNeon.cpp.neon
+LOCAL_SRC_FILES_arm64 += ../../util/QCameraRawFormatNeon.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+    $(LOCAL_PATH)/../../stack/common
+
+LOCAL_HEADER_LIBRARIES := generated_kernel_headers
+
+LOCAL_SHARED_LIBRARIES:= liblog
+
+LOCAL_MODULE:= qcamera_raw_format_test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,161 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Host-runnable check and benchmark for QCameraMapIndex.
+ * Looks up every key of a scene mode style table, plus a miss, by name and
+ * by value, compares each result with a linear scan and times both.
+ *   g++ -O2 -I../../util qcamera_map_index_bench.cpp -lpthread
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "QCameraMapIndex.h"
+
+using namespace qcamera;
+
+#define MAP_BENCH_ROUNDS 200000
+
+typedef struct {
+    const char *desc;
+    int val;
+} bench_map_t;
+
+// same shape as QCameraParameters::SCENE_MODES_MAP, "auto" twice to check
+// that the first entry wins like in a linear scan
+static const bench_map_t SCENE_MAP[] = {
+    { "auto",           0 },
+    { "asd",            1 },
+    { "landscape",      2 },
+    { "snow",           3 },
+    { "beach",          4 },
+    { "sunset",         5 },
+    { "night",          6 },
+    { "portrait",       7 },
+    { "backlight",      8 },
+    { "sports",         9 },
+    { "steadyphoto",    10 },
+    { "flowers",        11 },
+    { "candlelight",    12 },
+    { "fireworks",      13 },
+    { "party",          14 },
+    { "night-portrait", 15 },
+    { "theatre",        16 },
+    { "action",         17 },
+    { "AR",             18 },
+    { "hdr",            19 },
+    { "auto",           20 },
+};
+
+struct ByName {
+    typedef bench_map_t Entry;
+    typedef const char *Key;
+    static uint32_t hash(Key key) { return qcamera_map_hash_str(key); }
+    static uint32_t hashEntry(const Entry &e) { return qcamera_map_hash_str(e.desc); }
+    static bool match(const Entry &e, Key key) { return !strcmp(e.desc, key); }
+    static bool sameKey(const Entry &a, const Entry &b) { return !strcmp(a.desc, b.desc); }
+};
+
+struct ByValue {
+    typedef bench_map_t Entry;
+    typedef int Key;
+    static uint32_t hash(Key key) { return qcamera_map_hash_int((uint32_t)key); }
+    static uint32_t hashEntry(const Entry &e) { return qcamera_map_hash_int((uint32_t)e.val); }
+    static bool match(const Entry &e, Key key) { return e.val == key; }
+    static bool sameKey(const Entry &a, const Entry &b) { return a.val == b.val; }
+};
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+template <typename Traits>
+static int findLinear(const bench_map_t *arr, int len, typename Traits::Key key)
+{
+    for (int i = 0; i < len; i++) {
+        if (Traits::match(arr[i], key)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int main()
+{
+    const int len = sizeof(SCENE_MAP) / sizeof(SCENE_MAP[0]);
+    // keys copied so lookups cannot succeed by pointer equality
+    char names[len + 1][32];
+    int failed = 0;
+    volatile int sink = 0;
+
+    for (int i = 0; i < len; i++) {
+        strncpy(names[i], SCENE_MAP[i].desc, sizeof(names[i]));
+    }
+    strncpy(names[len], "no-such-mode", sizeof(names[len]));
+
+    for (int i = 0; i <= len; i++) {
+        if (QCameraMapIndex<ByName>::find(SCENE_MAP, len, names[i]) !=
+            findLinear<ByName>(SCENE_MAP, len, names[i])) {
+            printf("name lookup of %s differs from linear scan\n", names[i]);
+            failed++;
+        }
+    }
+    for (int v = -1; v <= len; v++) {
+        if (QCameraMapIndex<ByValue>::find(SCENE_MAP, len, v) !=
+            findLinear<ByValue>(SCENE_MAP, len, v)) {
+            printf("value lookup of %d differs from linear scan\n", v);
+            failed++;
+        }
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < MAP_BENCH_ROUNDS; r++) {
+        for (int i = 0; i <= len; i++) {
+            sink += findLinear<ByName>(SCENE_MAP, len, names[i]);
+        }
+    }
+    double linear_ns = (now_ns() - start) / MAP_BENCH_ROUNDS / (len + 1);
+
+    start = now_ns();
+    for (int r = 0; r < MAP_BENCH_ROUNDS; r++) {
+        for (int i = 0; i <= len; i++) {
+            sink += QCameraMapIndex<ByName>::find(SCENE_MAP, len, names[i]);
+        }
+    }
+    double index_ns = (now_ns() - start) / MAP_BENCH_ROUNDS / (len + 1);
+
+    printf("%d entry map, name lookup: linear %.1f ns  index %.1f ns\n",
+           len, linear_ns, index_ns);
+    printf("map index check %s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Camera open time benchmark.
+ * Opens and closes the HAL1 device of one camera through the camera module
+ * a number of times and reports the first open, which also builds the
+ * capability parameter template, apart from the later ones that clone it.
+ * get_parameters is timed too, it flattens the full parameter set.
+ * The camera service must not hold the camera while this runs.
+ *   qcamera_open_bench [camera id] [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+
+#define OPEN_BENCH_DEFAULT_ITER 10
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    int camera_id = (argc > 1) ? atoi(argv[1]) : 0;
+    int iter = (argc > 2) ? atoi(argv[2]) : OPEN_BENCH_DEFAULT_ITER;
+    camera_module_t *module = NULL;
+    char id[8];
+    double first_ms = 0, rest_ms = 0, rest_min_ms = 0, params_ms = 0;
+
+    if (iter < 2) {
+        iter = 2;
+    }
+    if (hw_get_module(CAMERA_HARDWARE_MODULE_ID,
+                      (const hw_module_t **)&module) != 0 || NULL == module) {
+        printf("cannot load camera module\n");
+        return 1;
+    }
+    if (camera_id < 0 || camera_id >= module->get_number_of_cameras()) {
+        printf("invalid camera id %d\n", camera_id);
+        return 1;
+    }
+    snprintf(id, sizeof(id), "%d", camera_id);
+
+    for (int i = 0; i < iter; i++) {
+        hw_device_t *hw_dev = NULL;
+        double start = now_ms();
+        if (module->common.methods->open(&module->common, id, &hw_dev) != 0 ||
+            NULL == hw_dev) {
+            printf("open of camera %d failed at iteration %d\n", camera_id, i);
+            return 1;
+        }
+        double open_ms = now_ms() - start;
+
+        camera_device_t *dev = (camera_device_t *)hw_dev;
+        start = now_ms();
+        char *params = dev->ops->get_parameters(dev);
+        params_ms += now_ms() - start;
+        if (NULL != params) {
+            if (dev->ops->put_parameters) {
+                dev->ops->put_parameters(dev, params);
+            } else {
+                free(params);
+            }
+        }
+        hw_dev->close(hw_dev);
+
+        if (0 == i) {
+            first_ms = open_ms;
+        } else {
+            rest_ms += open_ms;
+            if (1 == i || open_ms < rest_min_ms) {
+                rest_min_ms = open_ms;
+            }
+        }
+    }
+
+    printf("camera %d open: first %.2f ms, later avg %.2f ms min %.2f ms "
+           "(%d opens)\n", camera_id, first_ms, rest_ms / (iter - 1),
+           rest_min_ms, iter);
+    printf("camera %d get_parameters: avg %.3f ms\n",
+           camera_id, params_ms / iter);
+    return 0;
+}
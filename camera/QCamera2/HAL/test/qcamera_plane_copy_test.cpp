@@ -0,0 +1,181 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Host-runnable check and benchmark for the packed preview plane copy.
+ * Compacts padded planes of many widths, strides and heights with every
+ * kernel built in (scalar, NEON on ARM, and the compactPlane dispatch),
+ * compares each result byte for byte with a plain reference loop, checks
+ * that nothing past the packed plane is written, then times the kernels on
+ * a padded 1080p NV21 frame.
+ *   g++ -O2 -I../../util qcamera_plane_copy_test.cpp ../../util/QCameraPlaneCopy.cpp
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "QCameraPlaneCopy.h"
+
+using namespace qcamera;
+
+#define PLANE_GUARD      64
+#define PLANE_GUARD_BYTE 0xa5
+#define PLANE_BENCH_ROUNDS 50
+
+typedef void (*plane_copy_fn)(uint8_t *dst, int dstStride,
+                              const uint8_t *src, int srcStride,
+                              int width, int height);
+
+typedef struct {
+    const char *name;
+    plane_copy_fn fn;
+} plane_kernel_t;
+
+static const plane_kernel_t KERNELS[] = {
+    { "compactPlaneC",    compactPlaneC },
+#ifdef QCAMERA_PLANE_COPY_NEON
+    { "compactPlaneNeon", compactPlaneNeon },
+#endif
+    { "compactPlane",     compactPlane },
+};
+
+#define NUM_KERNELS ((int)(sizeof(KERNELS) / sizeof(KERNELS[0])))
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void copyReference(uint8_t *dst, int dstStride,
+                          const uint8_t *src, int srcStride,
+                          int width, int height)
+{
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            dst[y * dstStride + x] = src[y * srcStride + x];
+        }
+    }
+}
+
+// compact one width x height plane with every kernel, src misaligned by
+// srcSkew bytes so the unaligned NEON loads are covered too
+static int checkPlane(int width, int srcStride, int height, int srcSkew)
+{
+    int failed = 0;
+    size_t srcLen = (size_t)srcStride * height + srcSkew;
+    size_t dstLen = (size_t)width * height;
+    uint8_t *src = (uint8_t *)malloc(srcLen + 1);
+    uint8_t *ref = (uint8_t *)malloc(dstLen + 1);
+    uint8_t *dst = (uint8_t *)malloc(dstLen + PLANE_GUARD);
+
+    if (src == NULL || ref == NULL || dst == NULL) {
+        printf("no mem for %dx%d plane\n", width, height);
+        free(src);
+        free(ref);
+        free(dst);
+        return 1;
+    }
+    for (size_t i = 0; i < srcLen; i++) {
+        src[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    copyReference(ref, width, src + srcSkew, srcStride, width, height);
+
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        memset(dst, PLANE_GUARD_BYTE, dstLen + PLANE_GUARD);
+        KERNELS[k].fn(dst, width, src + srcSkew, srcStride, width, height);
+        if (memcmp(dst, ref, dstLen)) {
+            printf("%s: %dx%d stride %d skew %d differs from reference\n",
+                   KERNELS[k].name, width, height, srcStride, srcSkew);
+            failed++;
+        }
+        for (int g = 0; g < PLANE_GUARD; g++) {
+            if (dst[dstLen + g] != PLANE_GUARD_BYTE) {
+                printf("%s: %dx%d stride %d wrote past the plane\n",
+                       KERNELS[k].name, width, height, srcStride);
+                failed++;
+                break;
+            }
+        }
+    }
+
+    free(src);
+    free(ref);
+    free(dst);
+    return failed;
+}
+
+int main()
+{
+    static const int pads[] = { 0, 1, 15, 16, 64, 100 };
+    static const int heights[] = { 1, 2, 3, 17 };
+    int failed = 0;
+
+    for (int w = 0; w <= 272; w++) {
+        for (size_t p = 0; p < sizeof(pads) / sizeof(pads[0]); p++) {
+            for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+                failed += checkPlane(w, w + pads[p], heights[h], (int)(p & 3));
+            }
+        }
+    }
+    // real preview sizes, Y plane with 32 px stride / 32 line scanline
+    failed += checkPlane(1920, 1920, 1080, 0);
+    failed += checkPlane(1440, 1472, 1080, 0);
+    failed += checkPlane(640, 640 + 32, 480, 0);
+    failed += checkPlane(176, 192, 144, 0);
+
+    // padded 1080p NV21 frame, Y then interleaved VU plane
+    const int width = 1920, height = 1080, stride = 2048, scanline = 1088;
+    uint8_t *frame = (uint8_t *)calloc((size_t)stride * scanline * 3 / 2, 1);
+    uint8_t *packed = (uint8_t *)malloc((size_t)width * height * 3 / 2);
+    if (frame == NULL || packed == NULL) {
+        printf("no mem for benchmark frame\n");
+        free(frame);
+        free(packed);
+        return 1;
+    }
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        double start = now_ns();
+        for (int r = 0; r < PLANE_BENCH_ROUNDS; r++) {
+            KERNELS[k].fn(packed, width, frame, stride, width, height);
+            KERNELS[k].fn(packed + width * height, width,
+                          frame + stride * scanline, stride, width, height / 2);
+        }
+        double us = (now_ns() - start) / PLANE_BENCH_ROUNDS / 1000.0;
+        printf("%-17s 1080p NV21 frame: %.1f us  %.2f GB/s\n",
+               KERNELS[k].name, us, width * height * 1.5 / (us * 1000.0));
+    }
+    free(frame);
+    free(packed);
+
+    printf("plane copy check %s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,436 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Host-runnable check and benchmark for QCameraRawFormat.
+ * Unpacks random rows of every packed layout with each row unpacker the
+ * CPU can run, separately and in place, and compares them bit for bit
+ * with a reference read straight from the layout definitions. Also checks
+ * MIPI pack/unpack round trips, black level subtraction and in place frame
+ * conversion with QCameraRaw16Converter, then times 13MP frames.
+ *   g++ -O2 -I../../util -I../../stack/common qcamera_raw_format_test.cpp \
+ *       ../../util/QCameraRawFormat.cpp -lpthread
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "QCameraRawFormat.h"
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+using namespace qcamera;
+
+#define RAW_GUARD       32
+#define RAW_GUARD_BYTE  0x5a
+#define RAW_MAX_WIDTH   300
+#define RAW_BENCH_ROUNDS 5
+
+typedef struct {
+    const char *name;
+    qcamera_raw_packing_t packing;
+    raw_unpack_row_fn fn;
+    int simd;              // 0 scalar, 1 needs NEON, 2 SSE2, 3 SSSE3
+} raw_unpacker_t;
+
+static const raw_unpacker_t UNPACKERS[] = {
+    { "unpackQcom10RowC",     RAW_PACKING_QCOM_10, unpackQcom10RowC,     0 },
+    { "unpackQcom12RowC",     RAW_PACKING_QCOM_12, unpackQcom12RowC,     0 },
+    { "unpackMipi10RowC",     RAW_PACKING_MIPI_10, unpackMipi10RowC,     0 },
+    { "unpackMipi12RowC",     RAW_PACKING_MIPI_12, unpackMipi12RowC,     0 },
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+    { "unpackQcom10RowNeon",  RAW_PACKING_QCOM_10, unpackQcom10RowNeon,  1 },
+    { "unpackMipi10RowNeon",  RAW_PACKING_MIPI_10, unpackMipi10RowNeon,  1 },
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+    { "unpackQcom10RowSse2",  RAW_PACKING_QCOM_10, unpackQcom10RowSse2,  2 },
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSSE3)
+    { "unpackMipi10RowSsse3", RAW_PACKING_MIPI_10, unpackMipi10RowSsse3, 3 },
+#endif
+};
+
+#define NUM_UNPACKERS ((int)(sizeof(UNPACKERS) / sizeof(UNPACKERS[0])))
+
+static const char *PACKING_NAMES[RAW_PACKING_MAX] = {
+    "qcom10", "qcom12", "mipi10", "mipi12"
+};
+
+static uint32_t g_seed = 1;
+
+static uint32_t nextRandom()
+{
+    g_seed = g_seed * 1103515245 + 12345;
+    return g_seed >> 8;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static bool canRun(int simd)
+{
+    switch (simd) {
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+    case 1:
+#if defined(__aarch64__)
+        return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#else
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+    case 2:
+        return __builtin_cpu_supports("sse2");
+    case 3:
+        return __builtin_cpu_supports("ssse3");
+#endif
+    default:
+        return simd == 0;
+    }
+}
+
+// pixel @i of a packed row, read bit by bit from the layout definition
+static uint16_t refPixel(qcamera_raw_packing_t packing, const uint8_t *src, int i)
+{
+    int bits, bitPos[12];
+
+    switch (packing) {
+    case RAW_PACKING_QCOM_10:
+    case RAW_PACKING_QCOM_12: {
+        // little endian 64bit words, pixels from bit 0 up
+        bits = (packing == RAW_PACKING_QCOM_10) ? 10 : 12;
+        int perWord = 64 / bits;
+        int base = (i / perWord) * 64 + (i % perWord) * bits;
+        for (int b = 0; b < bits; b++) {
+            bitPos[b] = base + b;
+        }
+        break;
+    }
+    case RAW_PACKING_MIPI_10: {
+        // msb byte of each pixel, then a byte of 2 lsb per pixel
+        int g = i / 4, j = i % 4;
+        bits = 10;
+        bitPos[0] = (5 * g + 4) * 8 + 2 * j;
+        bitPos[1] = bitPos[0] + 1;
+        for (int b = 0; b < 8; b++) {
+            bitPos[2 + b] = (5 * g + j) * 8 + b;
+        }
+        break;
+    }
+    case RAW_PACKING_MIPI_12: {
+        // msb byte of each pixel, then a byte of 4 lsb per pixel
+        int g = i / 2, j = i % 2;
+        bits = 12;
+        for (int b = 0; b < 4; b++) {
+            bitPos[b] = (3 * g + 2) * 8 + 4 * j + b;
+        }
+        for (int b = 0; b < 8; b++) {
+            bitPos[4 + b] = (3 * g + j) * 8 + b;
+        }
+        break;
+    }
+    default:
+        return 0;
+    }
+
+    uint16_t v = 0;
+    for (int b = 0; b < bits; b++) {
+        v |= (uint16_t)(((src[bitPos[b] / 8] >> (bitPos[b] % 8)) & 1) << b);
+    }
+    return v;
+}
+
+// unpack one random row of @width pixels with @u, both into a separate
+// buffer and in place, and compare with the reference
+static int checkRow(const raw_unpacker_t &u, int width)
+{
+    int failed = 0;
+    int rowSize = getRawPackedRowSize(u.packing, width);
+    int bufSize = (rowSize > 2 * width) ? rowSize : 2 * width;
+    uint8_t *packed = (uint8_t *)malloc(rowSize);
+    uint8_t *dst = (uint8_t *)malloc(2 * width + RAW_GUARD);
+    uint8_t *inPlace = (uint8_t *)malloc(bufSize);
+    uint16_t ref[RAW_MAX_WIDTH];
+
+    for (int i = 0; i < rowSize; i++) {
+        packed[i] = (uint8_t)nextRandom();
+    }
+    for (int i = 0; i < width; i++) {
+        ref[i] = refPixel(u.packing, packed, i);
+    }
+
+    memset(dst, RAW_GUARD_BYTE, 2 * width + RAW_GUARD);
+    u.fn(packed, (uint16_t *)dst, width);
+    if (memcmp(dst, ref, 2 * width)) {
+        printf("%s: width %d differs from reference\n", u.name, width);
+        failed++;
+    }
+    for (int g = 0; g < RAW_GUARD; g++) {
+        if (dst[2 * width + g] != RAW_GUARD_BYTE) {
+            printf("%s: width %d wrote past the row\n", u.name, width);
+            failed++;
+            break;
+        }
+    }
+
+    memcpy(inPlace, packed, rowSize);
+    u.fn(inPlace, (uint16_t *)inPlace, width);
+    if (memcmp(inPlace, ref, 2 * width)) {
+        printf("%s: width %d in place differs from reference\n", u.name, width);
+        failed++;
+    }
+
+    free(packed);
+    free(dst);
+    free(inPlace);
+    return failed;
+}
+
+// pack random pixels to MIPI raw10/12 and unpack them again
+static int checkPackRoundTrip(qcamera_raw_packing_t packing, int width)
+{
+    int failed = 0;
+    int bits = (packing == RAW_PACKING_MIPI_10) ? 10 : 12;
+    int perGroup = (packing == RAW_PACKING_MIPI_10) ? 4 : 2;
+    int padded = (width + perGroup - 1) / perGroup * perGroup;
+    uint16_t src[RAW_MAX_WIDTH], out[RAW_MAX_WIDTH + 4];
+    uint8_t packed[RAW_MAX_WIDTH * 2];
+
+    for (int i = 0; i < width; i++) {
+        src[i] = (uint16_t)nextRandom();   // high bits must be dropped
+    }
+    if (packing == RAW_PACKING_MIPI_10) {
+        packMipi10Row(src, packed, width);
+    } else {
+        packMipi12Row(src, packed, width);
+    }
+    getRawRowUnpacker(packing)(packed, out, padded);
+    for (int i = 0; i < padded; i++) {
+        uint16_t expect = (i < width) ? (uint16_t)(src[i] & ((1 << bits) - 1)) : 0;
+        if (out[i] != expect) {
+            printf("%s pack round trip: width %d pixel %d is %u, not %u\n",
+                   PACKING_NAMES[packing], width, i, out[i], expect);
+            failed++;
+            break;
+        }
+    }
+    return failed;
+}
+
+// subtract random black levels with every variant the CPU can run
+static int checkBlackLevel(int width)
+{
+    int failed = 0;
+    uint16_t row[RAW_MAX_WIDTH], ref[RAW_MAX_WIDTH], out[RAW_MAX_WIDTH];
+    uint16_t black0 = (uint16_t)(nextRandom() & 0x3FF);
+    uint16_t black1 = (uint16_t)(nextRandom() & 0x3FF);
+
+    for (int x = 0; x < width; x++) {
+        row[x] = (uint16_t)(nextRandom() & 0xFFF);
+        int b = (x & 1) ? black1 : black0;
+        ref[x] = (uint16_t)((row[x] > b) ? row[x] - b : 0);
+    }
+
+    struct {
+        const char *name;
+        raw_black_level_row_fn fn;
+        int simd;
+    } variants[] = {
+        { "subtractBlackLevelRow",     subtractBlackLevelRow,     0 },
+        { "subtractBlackLevelRowC",    subtractBlackLevelRowC,    0 },
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+        { "subtractBlackLevelRowNeon", subtractBlackLevelRowNeon, 1 },
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+        { "subtractBlackLevelRowSse2", subtractBlackLevelRowSse2, 2 },
+#endif
+    };
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        if (!canRun(variants[v].simd)) {
+            continue;
+        }
+        memcpy(out, row, sizeof(uint16_t) * width);
+        variants[v].fn(out, width, black0, black1);
+        if (memcmp(out, ref, sizeof(uint16_t) * width)) {
+            printf("%s: width %d differs from reference\n", variants[v].name, width);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+// fill a frame with random packed rows, stride padding included
+static void fillFrame(uint8_t *buf, int height, int srcStride)
+{
+    for (int i = 0; i < height * srcStride; i++) {
+        buf[i] = (uint8_t)nextRandom();
+    }
+}
+
+// convert a random frame in place and compare every row with the reference
+static int checkFrame(QCameraRaw16Converter &conv, qcamera_raw_packing_t packing,
+                      int width, int height, int srcPad, int raw16Pad)
+{
+    int failed = 0;
+    int srcStride = getRawPackedRowSize(packing, width) + srcPad;
+    int raw16Stride = width + raw16Pad;
+    uint8_t *packed = (uint8_t *)malloc((size_t)height * srcStride);
+    uint8_t *buf = (uint8_t *)malloc((size_t)height * raw16Stride * 2);
+
+    fillFrame(packed, height, srcStride);
+    memcpy(buf, packed, (size_t)height * srcStride);
+    if (!conv.convert(buf, width, height, srcStride, raw16Stride, packing)) {
+        printf("%s %dx%d frame: not converted\n", PACKING_NAMES[packing],
+               width, height);
+        failed++;
+    }
+    for (int y = 0; y < height && !failed; y++) {
+        const uint16_t *row = (const uint16_t *)buf + (size_t)y * raw16Stride;
+        for (int x = 0; x < width; x++) {
+            if (row[x] != refPixel(packing, packed + (size_t)y * srcStride, x)) {
+                printf("%s %dx%d frame: row %d col %d differs from reference\n",
+                       PACKING_NAMES[packing], width, height, y, x);
+                failed++;
+                break;
+            }
+        }
+    }
+
+    free(packed);
+    free(buf);
+    return failed;
+}
+
+// time a 13MP in place conversion row by row with @unpackRow, or with the
+// converter thread pool if @unpackRow is NULL
+static double benchFrame(QCameraRaw16Converter &conv, qcamera_raw_packing_t packing,
+                         raw_unpack_row_fn unpackRow,
+                         const uint8_t *packed, uint8_t *buf)
+{
+    const int width = 4208, height = 3120;
+    int srcStride = getRawPackedRowSize(packing, width);
+    double total = 0;
+
+    for (int r = 0; r < RAW_BENCH_ROUNDS; r++) {
+        memcpy(buf, packed, (size_t)height * srcStride);
+        double start = now_ns();
+        if (unpackRow == NULL) {
+            conv.convert(buf, width, height, srcStride, width, packing);
+        } else {
+            // bottom up, each row only overwrites rows already converted
+            for (int y = height - 1; y >= 0; y--) {
+                unpackRow(buf + (size_t)y * srcStride,
+                          (uint16_t *)buf + (size_t)y * width, width);
+            }
+        }
+        total += now_ns() - start;
+    }
+    return total / RAW_BENCH_ROUNDS / 1e6;
+}
+
+int main()
+{
+    static const int frames[][4] = {
+        // width, height, packed row pad, RAW16 row pad
+        { 4208, 96, 0, 0 },
+        { 640, 480, 16, 0 },
+        { 638, 121, 3, 10 },
+        { 10, 500, 0, 0 },
+        { 1, 70, 0, 3 },
+    };
+    QCameraRaw16Converter conv;
+    int failed = 0;
+
+    for (int k = 0; k < NUM_UNPACKERS; k++) {
+        if (!canRun(UNPACKERS[k].simd)) {
+            printf("%s not supported by this CPU, skipped\n", UNPACKERS[k].name);
+            continue;
+        }
+        for (int w = 1; w <= RAW_MAX_WIDTH; w++) {
+            failed += checkRow(UNPACKERS[k], w);
+        }
+    }
+    for (int p = 0; p < RAW_PACKING_MAX; p++) {
+        raw_unpacker_t best = { "getRawRowUnpacker", (qcamera_raw_packing_t)p,
+                                getRawRowUnpacker((qcamera_raw_packing_t)p), 0 };
+        for (int w = 1; w <= RAW_MAX_WIDTH; w++) {
+            failed += checkRow(best, w);
+        }
+        for (size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++) {
+            failed += checkFrame(conv, (qcamera_raw_packing_t)p, frames[f][0],
+                                 frames[f][1], frames[f][2], frames[f][3]);
+        }
+    }
+    for (int w = 1; w <= RAW_MAX_WIDTH - 4; w++) {
+        failed += checkPackRoundTrip(RAW_PACKING_MIPI_10, w);
+        failed += checkPackRoundTrip(RAW_PACKING_MIPI_12, w);
+    }
+    for (int w = 0; w <= RAW_MAX_WIDTH; w++) {
+        failed += checkBlackLevel(w);
+    }
+
+    // 13MP frames, scalar rows vs best rows vs converter thread pool
+    size_t size = (size_t)4208 * 3120 * 2;
+    uint8_t *packed = (uint8_t *)malloc(size);
+    uint8_t *buf = (uint8_t *)malloc(size);
+    if (packed == NULL || buf == NULL) {
+        printf("no mem for benchmark frame\n");
+        free(packed);
+        free(buf);
+        return 1;
+    }
+    fillFrame(packed, 3120, getRawPackedRowSize(RAW_PACKING_QCOM_12, 4208));
+    for (int p = 0; p < RAW_PACKING_MAX; p++) {
+        qcamera_raw_packing_t packing = (qcamera_raw_packing_t)p;
+        raw_unpack_row_fn scalar = NULL;
+        for (int k = 0; k < NUM_UNPACKERS; k++) {
+            if (UNPACKERS[k].packing == packing && UNPACKERS[k].simd == 0) {
+                scalar = UNPACKERS[k].fn;
+            }
+        }
+        double scalarMs = benchFrame(conv, packing, scalar, packed, buf);
+        double bestMs = benchFrame(conv, packing, getRawRowUnpacker(packing),
+                                   packed, buf);
+        double convMs = benchFrame(conv, packing, NULL, packed, buf);
+        printf("%s 13MP to RAW16: scalar %.1f ms  best row %.1f ms  converter %.1f ms\n",
+               PACKING_NAMES[p], scalarMs, bestMs, convMs);
+    }
+    free(packed);
+    free(buf);
+
+    printf("raw format check %s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
@@ -13,7 +13,16 @@ LOCAL_SRC_FILES := \
         QCamera3VendorTags.cpp \
         ../util/QCameraCmdThread.cpp \
         ../util/QCameraFlash.cpp \
-        ../util/QCameraQueue.cpp
+        ../util/QCameraQueue.cpp \
+        ../util/QCameraRawFormat.cpp \
+        ../util/QCameraStreamStats.cpp \
+        ../util/QCameraLatencyHistogram.cpp \
+        ../util/QCameraMetadataPool.cpp \
+        ../util/QCameraThermalAdapter.cpp
+
+# NEON raw kernels are picked at runtime, build them with NEON on 32 bit too
+LOCAL_SRC_FILES_arm += ../util/QCameraRawFormatNeon.cpp.neon
+LOCAL_SRC_FILES_arm64 += ../util/QCameraRawFormatNeon.cpp
 
 LOCAL_CFLAGS := -Wall -Werror
 LOCAL_CFLAGS += -DHAS_MULTIMEDIA_HINTS
@@ -864,15 +864,20 @@ QCamera3RawChannel::QCamera3RawChannel(uint32_t cam_handle,
                         QCamera3RegularChannel(cam_handle, cam_ops,
                                 cb_routine, paddingInfo, userData, stream,
                                 CAM_STREAM_TYPE_RAW),
-                        mIsRaw16(raw_16)
+                        mIsRaw16(raw_16),
+                        mRaw16Converter(NULL)
 {
     char prop[PROPERTY_VALUE_MAX];
     property_get("persist.camera.raw.dump", prop, "0");
     mRawDump = atoi(prop);
+    if (mIsRaw16) {
+        mRaw16Converter = new QCameraRaw16Converter();
+    }
 }
 
 QCamera3RawChannel::~QCamera3RawChannel()
 {
+    delete mRaw16Converter;
 }
 
 void QCamera3RawChannel::streamCbRoutine(
@@ -921,11 +926,12 @@ void QCamera3RawChannel::dumpRawSnapshot(mm_camera_buf_def_t *frame)
 
 void QCamera3RawChannel::convertToRaw16(mm_camera_buf_def_t *frame)
 {
-    // Convert image buffer from Opaque raw format to RAW16 format
+    // Convert image buffer from packed raw format to RAW16 format.
     // 10bit Opaque raw is stored in the format of:
     // 0000 - p5 - p4 - p3 - p2 - p1 - p0
     // where p0 to p5 are 6 pixels (each is 10bit)_and most significant
-    // 4 bits are 0s. Each 64bit word contains 6 pixels.
+    // 4 bits are 0s. Each 64bit word contains 6 pixels. MIPI packed
+    // stream formats are handled as well, see QCameraRawFormat.
 
     QCamera3Stream *stream = getStreamByIndex(0);
     cam_dimension_t dim;
@@ -936,23 +942,26 @@ void QCamera3RawChannel::convertToRaw16(mm_camera_buf_def_t *frame)
     memset(&offset, 0, sizeof(cam_frame_len_offset_t));
     stream->getFrameOffset(offset);
 
+    cam_format_t fmt = CAM_FORMAT_BAYER_QCOM_RAW_10BPP_GBRG;
+    stream->getFormat(fmt);
+    qcamera_raw_packing_t packing = RAW_PACKING_QCOM_10;
+    if (!getRawPacking(fmt, packing)) {
+        ALOGE("%s: unsupported raw format %d", __func__, fmt);
+        return;
+    }
+
     uint32_t raw16_stride = (dim.width + 15) & ~15;
-    uint16_t* raw16_buffer = (uint16_t *)frame->buffer;
 
     // In-place format conversion.
-    // Raw16 format always occupy more memory than opaque raw10.
-    // Convert to Raw16 by iterating through all pixels from bottom-right
-    // to top-left of the image.
+    // Raw16 format always occupy more memory than packed raw.
+    // Rows are converted from bottom to top, pixel groups from right to
+    // left, see QCameraRaw16Converter.
     // One special notes:
     // 1. Cross-platform raw16's stride is 16 pixels.
     // 2. Opaque raw10's stride is 6 pixels, and aligned to 16 bytes.
-    for (int y = dim.height-1; y >= 0; y--) {
-        uint64_t* row_start = (uint64_t *)frame->buffer +
-            y * offset.mp[0].stride / 8;
-        for (int x = dim.width-1;  x >= 0; x--) {
-            uint16_t raw16_pixel = 0x3FF & (row_start[x/6] >> (10*(x%6)));
-            raw16_buffer[y*raw16_stride+x] = raw16_pixel;
-        }
+    if (mRaw16Converter != NULL) {
+        mRaw16Converter->convert(frame->buffer, dim.width, dim.height,
+                                 offset.mp[0].stride, raw16_stride, packing);
     }
 }
 
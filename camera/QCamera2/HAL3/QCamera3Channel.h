@@ -36,6 +36,7 @@
 #include "QCamera3Mem.h"
 #include "QCamera3PostProc.h"
 #include "QCamera3HALHeader.h"
+#include "QCameraRawFormat.h"
 #include "utils/Vector.h"
 
 extern "C" {
@@ -236,6 +237,7 @@ public:
 private:
     bool mRawDump;
     bool mIsRaw16;
+    QCameraRaw16Converter *mRaw16Converter;
 
     void dumpRawSnapshot(mm_camera_buf_def_t *frame);
     void convertToRaw16(mm_camera_buf_def_t *frame);
@@ -34,14 +34,17 @@
 #include <cutils/properties.h>
 #include <hardware/camera3.h>
 #include <camera/CameraMetadata.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <stdint.h>
 #include <utils/Log.h>
 #include <utils/Errors.h>
 #include <sync/sync.h>
 #include <gralloc_priv.h>
 #include "../util/QCameraFlash.h"
+#include "../util/QCameraMapIndex.h"
 #include "QCamera3HWI.h"
 #include "QCamera3Mem.h"
 #include "QCamera3Channel.h"
@@ -210,7 +213,16 @@ camera3_device_ops_t QCamera3HardwareInterface::mCameraOps = {
     .reserved =                           {0},
 };
 
-int QCamera3HardwareInterface::kMaxInFlight = 5;
+int QCamera3HardwareInterface::kDefaultInFlight = 5;
+int QCamera3HardwareInterface::kMinInFlight = 3;
+
+/* max pending requests/buffers listed by dump */
+#define MAX_DUMP_ENTRIES 32
+/* metadata results between in-flight depth adjustments */
+#define INFLIGHT_EVAL_INTERVAL 16
+/* dump waits at most DUMP_LOCK_RETRIES * DUMP_LOCK_WAIT_US for mMutex */
+#define DUMP_LOCK_RETRIES 10
+#define DUMP_LOCK_WAIT_US 50000
 
 /*===========================================================================
  * FUNCTION   : QCamera3HardwareInterface
@@ -239,9 +251,11 @@ QCamera3HardwareInterface::QCamera3HardwareInterface(int cameraId,
       mParamHeap(NULL),
       mParameters(NULL),
       mPrevParameters(NULL),
+      m_thermalAdapter(QCameraThermalAdapter::getInstance()),
       mLoopBackResult(NULL),
       mAfState(0),
       mFlush(false),
+      mFlushGen(0),
       mMinProcessedFrameDuration(0),
       mMinJpegFrameDuration(0),
       mMinRawFrameDuration(0),
@@ -262,6 +276,21 @@ QCamera3HardwareInterface::QCamera3HardwareInterface(int cameraId,
 
     pthread_cond_init(&mRequestCond, NULL);
     mPendingRequest = 0;
+    resetPendingFrames();
+    cam_ring_init(&mSubmitQ, mSubmitQSlots, MAX_PENDING_FRAMES);
+    cam_ring_init(&mSubmitFreeQ, mSubmitFreeQSlots, MAX_PENDING_FRAMES);
+    for (int i = 0; i < MAX_PENDING_FRAMES; i++) {
+        mSubmitJobs[i].request.settings = NULL;
+        cam_ring_enq(&mSubmitFreeQ, &mSubmitJobs[i]);
+    }
+    mSubmitSpare = NULL;
+    mCachedSettings = NULL;
+    mSettingsRecording = false;
+    resetSettingsCache();
+    mSettingsCacheHits = 0;
+    mSettingsCacheMisses = 0;
+    mThermalLevel = QCAMERA_THERMAL_NO_ADJUSTMENT;
+    initInFlightDepth();
     mCurrentRequestId = -1;
     pthread_mutex_init(&mMutex, NULL);
 
@@ -287,6 +316,10 @@ QCamera3HardwareInterface::QCamera3HardwareInterface(int cameraId,
 QCamera3HardwareInterface::~QCamera3HardwareInterface()
 {
     ALOGV("%s: E", __func__);
+    // Issue what is still queued while the channels exist
+    drainSubmitQueue();
+    mSubmitTh.exit();
+
     /* We need to stop all streams before deleting any stream */
 
     // NOTE: 'camera3_stream_t *' objects are already freed at
@@ -328,8 +361,8 @@ QCamera3HardwareInterface::~QCamera3HardwareInterface()
     if (mCameraOpened)
         closeCamera();
 
-    mPendingBuffersMap.mPendingBufferList.clear();
-    mPendingRequestsList.clear();
+    resetPendingFrames();
+    resetSettingsCache();
 
     for (size_t i = 0; i < CAMERA3_TEMPLATE_COUNT; i++)
         if (mDefaultMetadata[i])
@@ -421,6 +454,11 @@ int QCamera3HardwareInterface::openCamera()
         return UNKNOWN_ERROR;
     }
 
+    rc = m_thermalAdapter.init(this);
+    if (rc != 0) {
+        ALOGE("Init thermal adapter failed");
+    }
+
     mCameraOpened = true;
 
     return NO_ERROR;
@@ -441,6 +479,8 @@ int QCamera3HardwareInterface::closeCamera()
 {
     int rc = NO_ERROR;
 
+    m_thermalAdapter.deinit();
+
     rc = mCameraHandle->ops->close_camera(mCameraHandle->camera_handle);
     mCameraHandle = NULL;
     mCameraOpened = false;
@@ -494,6 +534,7 @@ int QCamera3HardwareInterface::initialize(
        goto err1;
     }
     mCallbackOps = callback_ops;
+    mSubmitTh.launch(submitRoutine, this);
 
     pthread_mutex_unlock(&mMutex);
     mCameraInitialized = true;
@@ -647,6 +688,9 @@ int QCamera3HardwareInterface::configureStreams(
         return rc;
     }
 
+    // Requests of the old configuration must reach the channels first
+    drainSubmitQueue();
+
     /* first invalidate all the steams in the mStreamList
      * if they appear again, they will be validated */
     for (List<stream_info_t*>::iterator it = mStreamInfo.begin();
@@ -942,12 +986,15 @@ int QCamera3HardwareInterface::configureStreams(
 
     mCameraHandle->ops->set_parms(mCameraHandle->camera_handle, mParameters);
 
-    /* Initialize mPendingRequestInfo and mPendnigBuffersMap */
-    mPendingRequestsList.clear();
+    /* Initialize pending frames */
+    resetPendingFrames();
     mPendingFrameDropList.clear();
-    // Initialize/Reset the pending buffers list
-    mPendingBuffersMap.num_buffers = 0;
-    mPendingBuffersMap.mPendingBufferList.clear();
+    initInFlightDepth();
+
+    mShutterLatency.reset();
+    mMetaLatency.reset();
+    mBufferLatency.reset();
+    mResultPool.clear();
 
     mFirstRequest = true;
 
@@ -999,6 +1046,11 @@ int QCamera3HardwareInterface::validateCaptureRequest(
                 __FUNCTION__, frameNumber);
         return BAD_VALUE;
     }
+    if (request->num_output_buffers > MAX_NUM_STREAMS) {
+        ALOGE("%s: Request %d: Too many output buffers %d!",
+                __FUNCTION__, frameNumber, request->num_output_buffers);
+        return BAD_VALUE;
+    }
     if (request->input_buffer != NULL) {
         b = request->input_buffer;
         QCamera3Channel *channel =
@@ -1204,8 +1256,11 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
 
         //Recieved an urgent Frame Number, handle it
         //using partial results
-        for (List<PendingRequestInfo>::iterator i =
-            mPendingRequestsList.begin(); i != mPendingRequestsList.end(); i++) {
+        for (uint32_t f = mPendingFirstFrame; f != mPendingEndFrame; f++) {
+            PendingRequestInfo *i = getPendingFrame(f);
+            if (i == NULL || !i->request_pending) {
+                continue;
+            }
             camera3_notify_msg_t notify_msg;
             ALOGV("%s: Iterator Frame = %d urgent frame = %d",
                 __func__, i->frame_number, urgent_frame_number);
@@ -1217,6 +1272,8 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
                 notify_msg.message.shutter.timestamp = capture_time -
                     (urgent_frame_number - i->frame_number) * NSEC_PER_33MSEC;
                 mCallbackOps->notify(mCallbackOps, &notify_msg);
+                i->shutter_time = QCameraLatencyHistogram::now();
+                mShutterLatency.add(i->shutter_time - i->request_time);
                 i->timestamp = notify_msg.message.shutter.timestamp;
                 i->bNotified = 1;
                 ALOGV("%s: Support notification !!!! notify frame_number = %d, capture_time = %lld",
@@ -1233,6 +1290,8 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
                 notify_msg.message.shutter.frame_number = i->frame_number;
                 notify_msg.message.shutter.timestamp = capture_time;
                 mCallbackOps->notify(mCallbackOps, &notify_msg);
+                i->shutter_time = QCameraLatencyHistogram::now();
+                mShutterLatency.add(i->shutter_time - i->request_time);
 
                 i->timestamp = capture_time;
                 i->bNotified = 1;
@@ -1249,7 +1308,7 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
                 mCallbackOps->process_capture_result(mCallbackOps, &result);
                 ALOGV("%s: urgent frame_number = %d, capture_time = %lld",
                      __func__, result.frame_number, capture_time);
-                free_camera_metadata((camera_metadata_t *)result.result);
+                mResultPool.put((camera_metadata_t *)result.result);
                 break;
             }
         }
@@ -1265,8 +1324,12 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
             frame_number, capture_time);
 
     // Go through the pending requests info and send shutter/results to frameworks
-    for (List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
-        i != mPendingRequestsList.end() && i->frame_number <= frame_number;) {
+    for (uint32_t f = mPendingFirstFrame;
+        f != mPendingEndFrame && f <= frame_number; f++) {
+        PendingRequestInfo *i = getPendingFrame(f);
+        if (i == NULL || !i->request_pending) {
+            continue;
+        }
         camera3_capture_result_t result;
         memset(&result, 0, sizeof(camera3_capture_result_t));
         ALOGV("%s: frame_number in the list is %d", __func__, i->frame_number);
@@ -1282,8 +1345,8 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
         // buffer with CAMERA3_BUFFER_STATUS_ERROR
         if (cam_frame_drop.frame_dropped) {
             camera3_notify_msg_t notify_msg;
-            for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
-                    j != i->buffers.end(); j++) {
+            for (uint32_t n = 0; n < i->num_buffers; n++) {
+                RequestedBufferInfo *j = &i->buffers[n];
                 QCamera3Channel *channel = (QCamera3Channel *)j->stream->priv;
                 uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
                 for (uint32_t k=0; k<cam_frame_drop.cam_stream_ID.num_streams; k++) {
@@ -1373,74 +1436,59 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
         result.frame_number = i->frame_number;
         result.num_output_buffers = 0;
         result.output_buffers = NULL;
-        for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
-                    j != i->buffers.end(); j++) {
-            if (j->buffer) {
-                result.num_output_buffers++;
-            }
+        nsecs_t metaTime = QCameraLatencyHistogram::now();
+        mMetaLatency.add(metaTime - i->request_time);
+        if (i->frame_number == frame_number && i->bNotified) {
+            nsecs_t procLatency = metaTime - i->shutter_time;
+            mProcLatencyAvg = (mProcLatencyAvg == 0) ? procLatency :
+                    mProcLatencyAvg + (procLatency - mProcLatencyAvg) / 8;
         }
 
-        if (result.num_output_buffers > 0) {
-            camera3_stream_buffer_t *result_buffers =
-                new camera3_stream_buffer_t[result.num_output_buffers];
-            if (!result_buffers) {
-                ALOGE("%s: Fatal error: out of memory", __func__);
+        camera3_stream_buffer_t result_buffers[MAX_NUM_STREAMS];
+        for (uint32_t n = 0; n < i->num_buffers; n++) {
+            RequestedBufferInfo *j = &i->buffers[n];
+            if (!j->cached) {
+                continue;
             }
-            size_t result_buffers_idx = 0;
-            for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
-                    j != i->buffers.end(); j++) {
-                if (j->buffer) {
-                    for (List<PendingFrameDropInfo>::iterator m = mPendingFrameDropList.begin();
-                            m != mPendingFrameDropList.end(); m++) {
-                        QCamera3Channel *channel = (QCamera3Channel *)j->buffer->stream->priv;
-                        uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
-                        if((m->stream_ID==streamID) && (m->frame_number==frame_number)) {
-                            j->buffer->status=CAMERA3_BUFFER_STATUS_ERROR;
-                            ALOGV("%s: Stream STATUS_ERROR frame_number=%d, streamID=%d",
-                                  __func__, frame_number, streamID);
-                            m = mPendingFrameDropList.erase(m);
-                            break;
-                        }
-                    }
-
-                    for (List<PendingBufferInfo>::iterator k =
-                      mPendingBuffersMap.mPendingBufferList.begin();
-                      k != mPendingBuffersMap.mPendingBufferList.end(); k++) {
-                      if (k->buffer == j->buffer->buffer) {
-                        ALOGV("%s: Found buffer %p in pending buffer List "
-                              "for frame %d, Take it out!!", __func__,
-                               k->buffer, k->frame_number);
-                        mPendingBuffersMap.num_buffers--;
-                        k = mPendingBuffersMap.mPendingBufferList.erase(k);
-                        break;
-                      }
-                    }
-
-                    result_buffers[result_buffers_idx++] = *(j->buffer);
-                    free(j->buffer);
-                    j->buffer = NULL;
+            for (List<PendingFrameDropInfo>::iterator m = mPendingFrameDropList.begin();
+                    m != mPendingFrameDropList.end(); m++) {
+                QCamera3Channel *channel = (QCamera3Channel *)j->buffer.stream->priv;
+                uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
+                if((m->stream_ID==streamID) && (m->frame_number==frame_number)) {
+                    j->buffer.status=CAMERA3_BUFFER_STATUS_ERROR;
+                    ALOGV("%s: Stream STATUS_ERROR frame_number=%d, streamID=%d",
+                          __func__, frame_number, streamID);
+                    m = mPendingFrameDropList.erase(m);
+                    break;
                 }
             }
+            ALOGV("%s: Return cached buffer %p for frame %d",
+                  __func__, j->handle, i->frame_number);
+            result_buffers[result.num_output_buffers++] = j->buffer;
+            j->cached = 0;
+            returnPendingBuffer(i, j);
+        }
+        if (result.num_output_buffers > 0) {
             result.output_buffers = result_buffers;
-            mCallbackOps->process_capture_result(mCallbackOps, &result);
-            ALOGV("%s: meta frame_number = %d, capture_time = %lld",
-                    __func__, result.frame_number, i->timestamp);
-            free_camera_metadata((camera_metadata_t *)result.result);
-            delete[] result_buffers;
-        } else {
-            mCallbackOps->process_capture_result(mCallbackOps, &result);
-            ALOGV("%s: meta frame_number = %d, capture_time = %lld",
-                        __func__, result.frame_number, i->timestamp);
-            free_camera_metadata((camera_metadata_t *)result.result);
         }
-        // erase the element from the list
-        i = mPendingRequestsList.erase(i);
+        mCallbackOps->process_capture_result(mCallbackOps, &result);
+        ALOGV("%s: meta frame_number = %d, capture_time = %lld",
+                __func__, result.frame_number, i->timestamp);
+        mResultPool.put((camera_metadata_t *)result.result);
+
+        // result sent, the slot stays until the remaining buffers return
+        i->request_pending = 0;
+        releasePendingFrameIfDone(i);
     }
 
+    updateInFlightDepth(frame_number, capture_time);
+
 done_metadata:
-    for (List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
-        i != mPendingRequestsList.end() ;i++) {
-        i->pipeline_depth++;
+    for (uint32_t f = mPendingFirstFrame; f != mPendingEndFrame; f++) {
+        PendingRequestInfo *i = getPendingFrame(f);
+        if (i != NULL && i->request_pending) {
+            i->pipeline_depth++;
+        }
     }
     if (!pending_requests)
         unblockRequestIfNecessary();
@@ -1461,21 +1509,14 @@ done_metadata:
 void QCamera3HardwareInterface::handleBufferWithLock(
     camera3_stream_buffer_t *buffer, uint32_t frame_number)
 {
-    // If the frame number doesn't exist in the pending request list,
-    // directly send the buffer to the frameworks, and update pending buffers map
+    // If the request of the frame number is no longer pending, directly
+    // send the buffer to the frameworks, and update pending buffers
     // Otherwise, book-keep the buffer.
-    List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
-    while (i != mPendingRequestsList.end() && i->frame_number != frame_number){
-        i++;
-    }
-    if (i == mPendingRequestsList.end()) {
-        // Verify all pending requests frame_numbers are greater
-        for (List<PendingRequestInfo>::iterator j = mPendingRequestsList.begin();
-                j != mPendingRequestsList.end(); j++) {
-            if (j->frame_number < frame_number) {
-                ALOGE("%s: Error: pending frame number %d is smaller than %d",
-                        __func__, j->frame_number, frame_number);
-            }
+    PendingRequestInfo *i = getPendingFrame(frame_number);
+    if (i == NULL || !i->request_pending) {
+        if (i == NULL) {
+            ALOGE("%s: Error: buffer %p for frame %d is not pending",
+                    __func__, buffer->buffer, frame_number);
         }
         camera3_capture_result_t result;
         memset(&result, 0, sizeof(camera3_capture_result_t));
@@ -1499,22 +1540,23 @@ void QCamera3HardwareInterface::handleBufferWithLock(
         ALOGV("%s: result frame_number = %d, buffer = %p",
                 __func__, frame_number, buffer->buffer);
 
-        for (List<PendingBufferInfo>::iterator k =
-                mPendingBuffersMap.mPendingBufferList.begin();
-                k != mPendingBuffersMap.mPendingBufferList.end(); k++ ) {
-            if (k->buffer == buffer->buffer) {
-                ALOGV("%s: Found Frame buffer, take it out from list",
-                        __func__);
-
-                mPendingBuffersMap.num_buffers--;
-                k = mPendingBuffersMap.mPendingBufferList.erase(k);
-                break;
+        if (i != NULL) {
+            for (uint32_t n = 0; n < i->num_buffers; n++) {
+                if (i->buffers[n].pending &&
+                        i->buffers[n].handle == buffer->buffer) {
+                    ALOGV("%s: Found Frame buffer, take it out from list",
+                            __func__);
+                    returnPendingBuffer(i, &i->buffers[n]);
+                    break;
+                }
             }
         }
-        ALOGV("%s: mPendingBuffersMap.num_buffers = %d",
-            __func__, mPendingBuffersMap.num_buffers);
+        ALOGV("%s: mPendingBufferCnt = %d", __func__, mPendingBufferCnt);
 
         mCallbackOps->process_capture_result(mCallbackOps, &result);
+        if (i != NULL) {
+            releasePendingFrameIfDone(i);
+        }
     } else {
         if (i->input_buffer_present) {
             camera3_capture_result result;
@@ -1524,19 +1566,26 @@ void QCamera3HardwareInterface::handleBufferWithLock(
             result.num_output_buffers = 1;
             result.output_buffers = buffer;
             result.partial_result = 0;
+            for (uint32_t n = 0; n < i->num_buffers; n++) {
+                if (i->buffers[n].pending &&
+                        i->buffers[n].stream == buffer->stream) {
+                    returnPendingBuffer(i, &i->buffers[n]);
+                    break;
+                }
+            }
             mCallbackOps->process_capture_result(mCallbackOps, &result);
-            i = mPendingRequestsList.erase(i);
+            i->request_pending = 0;
+            releasePendingFrameIfDone(i);
             mPendingRequest--;
         } else {
-            for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
-                j != i->buffers.end(); j++) {
+            for (uint32_t n = 0; n < i->num_buffers; n++) {
+                RequestedBufferInfo *j = &i->buffers[n];
                 if (j->stream == buffer->stream) {
-                    if (j->buffer != NULL) {
+                    if (j->cached) {
                         ALOGE("%s: Error: buffer is already set", __func__);
                     } else {
-                        j->buffer = (camera3_stream_buffer_t *)malloc(
-                            sizeof(camera3_stream_buffer_t));
-                        *(j->buffer) = *buffer;
+                        j->buffer = *buffer;
+                        j->cached = 1;
                         ALOGV("%s: cache buffer %p at result frame_number %d",
                             __func__, buffer, frame_number);
                     }
@@ -1546,6 +1595,146 @@ void QCamera3HardwareInterface::handleBufferWithLock(
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : getPendingFrame
+ *
+ * DESCRIPTION: look up the pending frame slot of a frame number. Note that
+ *              mMutex is held when this function is called.
+ *
+ * PARAMETERS :
+ *   @frameNumber : frame number to look up
+ *
+ * RETURN     : pending frame, NULL if the frame is not pending
+ *==========================================================================*/
+QCamera3HardwareInterface::PendingRequestInfo *
+QCamera3HardwareInterface::getPendingFrame(uint32_t frameNumber)
+{
+    PendingRequestInfo *frame =
+            &mPendingFrames[frameNumber & (MAX_PENDING_FRAMES - 1)];
+    if (!frame->in_use || frame->frame_number != frameNumber) {
+        return NULL;
+    }
+    return frame;
+}
+
+/*===========================================================================
+ * FUNCTION   : waitPendingFrameSlot
+ *
+ * DESCRIPTION: wait until the ring slot of a new frame number is free. The
+ *              slot is only busy if a frame MAX_PENDING_FRAMES back still
+ *              holds buffers. Note that mMutex is held when this function
+ *              is called.
+ *
+ * PARAMETERS :
+ *   @frameNumber : frame number of the new request
+ *
+ * RETURN     : NO_ERROR on success
+ *              -EINVAL if the frame number does not increase
+ *              -ENODEV if the slot did not free up in time
+ *==========================================================================*/
+int QCamera3HardwareInterface::waitPendingFrameSlot(uint32_t frameNumber)
+{
+    struct timespec ts;
+
+    if (mPendingFirstFrame != mPendingEndFrame &&
+            (int32_t)(frameNumber - mPendingEndFrame) < 0) {
+        ALOGE("%s: frame number %d is not after pending frame %d",
+                __func__, frameNumber, mPendingEndFrame - 1);
+        return -EINVAL;
+    }
+    if (mPendingFirstFrame == mPendingEndFrame ||
+            frameNumber - mPendingFirstFrame < MAX_PENDING_FRAMES) {
+        return NO_ERROR;
+    }
+
+    ALOGE("%s: frame %d still has %d buffers pending, waiting",
+            __func__, mPendingFirstFrame,
+            getPendingFrame(mPendingFirstFrame)->num_pending_buffers);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += 5;
+    while (mPendingFirstFrame != mPendingEndFrame &&
+            frameNumber - mPendingFirstFrame >= MAX_PENDING_FRAMES) {
+        if (pthread_cond_timedwait(&mRequestCond, &mMutex, &ts) == ETIMEDOUT) {
+            ALOGE("%s: Unblocked on timeout!!!!", __func__);
+            return -ENODEV;
+        }
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : returnPendingBuffer
+ *
+ * DESCRIPTION: mark a buffer of a pending frame as returned to the
+ *              framework. Note that mMutex is held when this function is
+ *              called.
+ *
+ * PARAMETERS :
+ *   @frame   : pending frame of the buffer
+ *   @buf     : buffer being returned
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::returnPendingBuffer(PendingRequestInfo *frame,
+        RequestedBufferInfo *buf)
+{
+    mBufferLatency.add(QCameraLatencyHistogram::now() - frame->request_time);
+    buf->pending = 0;
+    frame->num_pending_buffers--;
+    mPendingBufferCnt--;
+}
+
+/*===========================================================================
+ * FUNCTION   : releasePendingFrameIfDone
+ *
+ * DESCRIPTION: free the ring slot of a frame once its result is sent and
+ *              all its buffers are returned. Note that mMutex is held when
+ *              this function is called.
+ *
+ * PARAMETERS :
+ *   @frame   : pending frame
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::releasePendingFrameIfDone(
+        PendingRequestInfo *frame)
+{
+    if (frame->request_pending || frame->num_pending_buffers > 0) {
+        return;
+    }
+    frame->in_use = 0;
+    frame->jpegMetadata.clear();
+
+    if (frame->frame_number == mPendingFirstFrame) {
+        while (mPendingFirstFrame != mPendingEndFrame &&
+                getPendingFrame(mPendingFirstFrame) == NULL) {
+            mPendingFirstFrame++;
+        }
+        // a request may wait for the slot to free up
+        pthread_cond_signal(&mRequestCond);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : resetPendingFrames
+ *
+ * DESCRIPTION: drop all pending frames
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::resetPendingFrames()
+{
+    for (uint32_t i = 0; i < MAX_PENDING_FRAMES; i++) {
+        mPendingFrames[i].in_use = 0;
+        mPendingFrames[i].jpegMetadata.clear();
+    }
+    mPendingFirstFrame = 0;
+    mPendingEndFrame = 0;
+    mPendingBufferCnt = 0;
+}
+
 /*===========================================================================
  * FUNCTION   : unblockRequestIfNecessary
  *
@@ -1563,6 +1752,166 @@ void QCamera3HardwareInterface::unblockRequestIfNecessary()
    pthread_cond_signal(&mRequestCond);
 }
 
+/*===========================================================================
+ * FUNCTION   : initInFlightDepth
+ *
+ * DESCRIPTION: set up the in-flight depth of a new session. The depth is
+ *              capped by the smallest buffer count of the output streams,
+ *              since every request holds a buffer of each stream it
+ *              targets. BLOB streams are left out as few requests carry
+ *              them. persist.camera.hal3.inflight fixes the depth, by
+ *              default it adapts starting from kDefaultInFlight.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::initInFlightDepth()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    int cap = QCamera3RegularChannel::kMaxBuffers;
+    int depth;
+
+    for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
+            it != mStreamInfo.end(); it++) {
+        camera3_stream_t *stream = (*it)->stream;
+        if (stream->stream_type == CAMERA3_STREAM_INPUT ||
+                stream->format == HAL_PIXEL_FORMAT_BLOB ||
+                stream->max_buffers == 0) {
+            continue;
+        }
+        if ((int)stream->max_buffers < cap) {
+            cap = stream->max_buffers;
+        }
+    }
+    if (cap < kMinInFlight) {
+        cap = kMinInFlight;
+    }
+
+    memset(prop, 0, sizeof(prop));
+    property_get("persist.camera.hal3.inflight", prop, "0");
+    depth = atoi(prop);
+    mInFlightAdaptive = (depth <= 0);
+    if (mInFlightAdaptive) {
+        depth = kDefaultInFlight;
+    }
+    if (depth < kMinInFlight) {
+        depth = kMinInFlight;
+    } else if (depth > cap) {
+        depth = cap;
+    }
+
+    mInFlightCap = cap;
+    mMaxInFlight = depth;
+    mInFlightEvalCnt = 0;
+    mProcLatencyAvg = 0;
+    mFrameIntervalAvg = 0;
+    mLastMetaFrame = 0;
+    mLastCaptureTime = 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateInFlightDepth
+ *
+ * DESCRIPTION: track the sensor frame interval and, every
+ *              INFLIGHT_EVAL_INTERVAL results, move the in-flight depth one
+ *              step towards the depth that covers the shutter to metadata
+ *              latency. Note that mMutex is held when this function is
+ *              called.
+ *
+ * PARAMETERS :
+ *   @frameNumber : frame number of the metadata
+ *   @captureTime : sensor timestamp of the metadata
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::updateInFlightDepth(uint32_t frameNumber,
+        nsecs_t captureTime)
+{
+    if (mLastCaptureTime != 0 && frameNumber > mLastMetaFrame &&
+            captureTime > mLastCaptureTime) {
+        nsecs_t interval = (captureTime - mLastCaptureTime) /
+                (frameNumber - mLastMetaFrame);
+        mFrameIntervalAvg = (mFrameIntervalAvg == 0) ? interval :
+                mFrameIntervalAvg + (interval - mFrameIntervalAvg) / 8;
+    }
+    mLastMetaFrame = frameNumber;
+    mLastCaptureTime = captureTime;
+
+    if (!mInFlightAdaptive || ++mInFlightEvalCnt < INFLIGHT_EVAL_INTERVAL ||
+            mFrameIntervalAvg == 0 || mProcLatencyAvg == 0) {
+        return;
+    }
+    mInFlightEvalCnt = 0;
+
+    // Requests queued ahead of the sensor, the frame being exposed and the
+    // frames still in processing after their shutter. This gives
+    // kDefaultInFlight for 30fps with 1-2 frames of processing.
+    int target = EMPTY_PIPELINE_DELAY + 1 + (int)((mProcLatencyAvg +
+            mFrameIntervalAvg - 1) / mFrameIntervalAvg);
+    if (target > mMaxInFlight && mMaxInFlight < mInFlightCap) {
+        mMaxInFlight++;
+        ALOGI("%s: in-flight depth raised to %d", __func__, mMaxInFlight);
+        pthread_cond_signal(&mRequestCond);
+    } else if (target < mMaxInFlight - 1 && mMaxInFlight > kMinInFlight) {
+        mMaxInFlight--;
+        ALOGI("%s: in-flight depth lowered to %d", __func__, mMaxInFlight);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getInFlightLimit
+ *
+ * DESCRIPTION: in-flight depth after thermal mitigation
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : max number of requests in flight
+ *==========================================================================*/
+int QCamera3HardwareInterface::getInFlightLimit()
+{
+    int limit = mMaxInFlight;
+
+    switch (__atomic_load_n(&mThermalLevel, __ATOMIC_RELAXED)) {
+    case QCAMERA_THERMAL_NO_ADJUSTMENT:
+        break;
+    case QCAMERA_THERMAL_SLIGHT_ADJUSTMENT:
+        if (limit > kDefaultInFlight) {
+            limit = kDefaultInFlight;
+        }
+        break;
+    default:
+        limit = kMinInFlight;
+        break;
+    }
+    return limit;
+}
+
+/*===========================================================================
+ * FUNCTION   : thermalEvtHandle
+ *
+ * DESCRIPTION: routine to handle thermal event notification
+ *
+ * PARAMETERS :
+ *   @level      : thermal level
+ *   @userdata   : userdata passed in during registration
+ *   @data       : opaque data from thermal client
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int QCamera3HardwareInterface::thermalEvtHandle(
+        qcamera_thermal_level_enum_t level, void *userdata, void *data)
+{
+    // Make sure thermal events are logged
+    ALOGI("%s: level = %d, userdata = %p, data = %p",
+        __func__, level, userdata, data);
+    // Picked up by the next capture request, no need to take mMutex
+    __atomic_store_n(&mThermalLevel, (int32_t)level, __ATOMIC_RELAXED);
+    return NO_ERROR;
+}
+
 /*===========================================================================
  * FUNCTION   : registerStreamBuffers
  *
@@ -1597,7 +1946,7 @@ int QCamera3HardwareInterface::processCaptureRequest(
 {
     int rc = NO_ERROR;
     int32_t request_id;
-    CameraMetadata meta;
+    camera_metadata_ro_entry_t entry;
 
     pthread_mutex_lock(&mMutex);
 
@@ -1608,98 +1957,20 @@ int QCamera3HardwareInterface::processCaptureRequest(
         return -EINVAL;
     }
 
-    meta = request->settings;
-
-    // For first capture request, send capture intent, and
-    // stream on all streams
-    if (mFirstRequest) {
-
-        for (size_t i = 0; i < request->num_output_buffers; i++) {
-            const camera3_stream_buffer_t& output = request->output_buffers[i];
-            QCamera3Channel *channel = (QCamera3Channel *)output.stream->priv;
-            rc = channel->registerBuffer(output.buffer);
-            if (rc < 0) {
-                ALOGE("%s: registerBuffer failed",
-                        __func__);
-                pthread_mutex_unlock(&mMutex);
-                return -ENODEV;
-            }
-        }
-
-        if (meta.exists(ANDROID_CONTROL_CAPTURE_INTENT)) {
-            int32_t hal_version = CAM_HAL_V3;
-            uint8_t captureIntent =
-                meta.find(ANDROID_CONTROL_CAPTURE_INTENT).data.u8[0];
-
-            memset(mParameters, 0, sizeof(metadata_buffer_t));
-            mParameters->first_flagged_entry = CAM_INTF_PARM_MAX;
-            AddSetMetaEntryToBatch(mParameters, CAM_INTF_PARM_HAL_VERSION,
-                sizeof(hal_version), &hal_version);
-            AddSetMetaEntryToBatch(mParameters, CAM_INTF_META_CAPTURE_INTENT,
-                sizeof(captureIntent), &captureIntent);
-            mCameraHandle->ops->set_parms(mCameraHandle->camera_handle,
-                mParameters);
-        }
-
-        //First initialize all streams
-        for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
-            it != mStreamInfo.end(); it++) {
-            QCamera3Channel *channel = (QCamera3Channel *)(*it)->stream->priv;
-            rc = channel->initialize();
-            if (NO_ERROR != rc) {
-                ALOGE("%s : Channel initialization failed %d", __func__, rc);
-                pthread_mutex_unlock(&mMutex);
-                return -ENODEV;
-            }
-        }
-        if (mSupportChannel) {
-            rc = mSupportChannel->initialize();
-            if (rc < 0) {
-                ALOGE("%s: Support channel initialization failed", __func__);
-                pthread_mutex_unlock(&mMutex);
-                return -ENODEV;
-            }
-        }
-
-        //Then start them.
-        ALOGD("%s: Start META Channel", __func__);
-        rc = mMetadataChannel->start();
-        if (rc < 0) {
-            ALOGE("%s: Metadata channel start failed", __func__);
-            pthread_mutex_unlock(&mMutex);
-            return -ENODEV;
-        }
-
-        if (mSupportChannel) {
-            rc = mSupportChannel->start();
-            if (rc < 0) {
-                ALOGE("%s: Support channel start failed", __func__);
-                mMetadataChannel->stop();
-                pthread_mutex_unlock(&mMutex);
-                return -ENODEV;
-            }
-        }
-        for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
-            it != mStreamInfo.end(); it++) {
-            QCamera3Channel *channel = (QCamera3Channel *)(*it)->stream->priv;
-            ALOGD("%s: Start Regular Channel mask=%d", __func__, channel->getStreamTypeMask());
-            rc = channel->start();
-            if (rc < 0) {
-                ALOGE("%s: Start Regular Channel failed mask=%d", __func__, channel->getStreamTypeMask());
-                if (mSupportChannel)
-                    mSupportChannel->stop();
-                mMetadataChannel->stop();
-                pthread_mutex_unlock(&mMutex);
-                return -ENODEV;
-            }
-        }
+    rc = waitPendingFrameSlot(request->frame_number);
+    if (rc != NO_ERROR) {
+        pthread_mutex_unlock(&mMutex);
+        return rc;
     }
 
     uint32_t frameNumber = request->frame_number;
-    cam_stream_ID_t streamID;
 
-    if (meta.exists(ANDROID_REQUEST_ID)) {
-        request_id = meta.find(ANDROID_REQUEST_ID).data.i32[0];
+    // Only look up the request id here, the settings are translated on
+    // the submission thread
+    if (request->settings != NULL &&
+            find_camera_metadata_ro_entry(request->settings,
+                    ANDROID_REQUEST_ID, &entry) == OK) {
+        request_id = entry.data.i32[0];
         mCurrentRequestId = request_id;
         ALOGV("%s: Received request with id: %d",__func__, request_id);
     } else if (mFirstRequest || mCurrentRequestId == -1){
@@ -1717,25 +1988,279 @@ int QCamera3HardwareInterface::processCaptureRequest(
                                     request->num_output_buffers,
                                     request->input_buffer,
                                     frameNumber);
+    int blob_request = 0;
+    for (size_t i = 0; i < request->num_output_buffers; i++) {
+        if (request->output_buffers[i].stream->format == HAL_PIXEL_FORMAT_BLOB) {
+            //Call function to store local copy of jpeg data for encode params.
+            blob_request = 1;
+        }
+    }
+
+    SubmitJob *job = getSubmitJob(request);
+    if (job == NULL) {
+        pthread_mutex_unlock(&mMutex);
+        return -ENODEV;
+    }
+    job->first_request = mFirstRequest;
+    job->flush_gen = mFlushGen;
+
+    /* Update pending frames */
+    PendingRequestInfo *pendingRequest =
+            &mPendingFrames[frameNumber & (MAX_PENDING_FRAMES - 1)];
+    pendingRequest->frame_number = frameNumber;
+    pendingRequest->in_use = 1;
+    pendingRequest->request_pending = 1;
+    pendingRequest->num_buffers = request->num_output_buffers;
+    pendingRequest->num_pending_buffers = request->num_output_buffers;
+    pendingRequest->request_id = request_id;
+    pendingRequest->blob_request = blob_request;
+    pendingRequest->timestamp = 0;
+    pendingRequest->bNotified = 0;
+    pendingRequest->input_buffer_present = (request->input_buffer != NULL)? 1 : 0;
+    pendingRequest->pipeline_depth = 0;
+    pendingRequest->partial_result_cnt = 0;
+    pendingRequest->request_time = QCameraLatencyHistogram::now();
+    pendingRequest->shutter_time = 0;
+    extractJpegMetadata(pendingRequest->jpegMetadata, request);
+
+    for (size_t i = 0; i < request->num_output_buffers; i++) {
+        RequestedBufferInfo *requestedBuf = &pendingRequest->buffers[i];
+        requestedBuf->stream = request->output_buffers[i].stream;
+        requestedBuf->handle = request->output_buffers[i].buffer;
+        requestedBuf->cached = 0;
+        requestedBuf->pending = 1;
+        mPendingBufferCnt++;
+        ALOGV("%s: frame = %d, buffer = %p, stream = %p, stream format = %d",
+          __func__, frameNumber, requestedBuf->handle, requestedBuf->stream,
+          requestedBuf->stream->format);
+    }
+    ALOGV("%s: mPendingBufferCnt = %d", __func__, mPendingBufferCnt);
+
+    if (mPendingFirstFrame == mPendingEndFrame) {
+        mPendingFirstFrame = frameNumber;
+    }
+    mPendingEndFrame = frameNumber + 1;
+
+    // Hand the request over, the submission thread waits for the acquire
+    // fences, translates the settings and issues it to the channels. There
+    // are only MAX_PENDING_FRAMES jobs, so mSubmitQ always has room.
+    mSubmitSpare = NULL;
+    cam_ring_enq(&mSubmitQ, job);
+    mSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+
+    if (mFlush) {
+        pthread_mutex_unlock(&mMutex);
+        return NO_ERROR;
+    }
+
+    mFirstRequest = false;
+    // Added a timed condition wait
+    struct timespec ts;
+    uint8_t isValidTimeout = 1;
+    rc = clock_gettime(CLOCK_REALTIME, &ts);
+    if (rc < 0) {
+        isValidTimeout = 0;
+        ALOGE("%s: Error reading the real time clock!!", __func__);
+    }
+    else {
+        // Make timeout as 5 sec for request to be honored
+        ts.tv_sec += 5;
+    }
+    //Block on conditional variable
+
+    mPendingRequest++;
+    while (mPendingRequest >= getInFlightLimit()) {
+        if (!isValidTimeout) {
+            ALOGV("%s: Blocking on conditional wait", __func__);
+            pthread_cond_wait(&mRequestCond, &mMutex);
+        }
+        else {
+            ALOGV("%s: Blocking on timed conditional wait", __func__);
+            rc = pthread_cond_timedwait(&mRequestCond, &mMutex, &ts);
+            if (rc == ETIMEDOUT) {
+                rc = -ENODEV;
+                ALOGE("%s: Unblocked on timeout!!!!", __func__);
+                break;
+            }
+        }
+        ALOGV("%s: Unblocked", __func__);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : getSubmitJob
+ *
+ * DESCRIPTION: fill a free submission job with a copy of the request. The
+ *              job is only handed to the submission thread once it is
+ *              queued into mSubmitQ; until then it is kept as the spare
+ *              job, so a failed request doesn't lose it. Note that mMutex
+ *              is held when this function is called.
+ *
+ * PARAMETERS :
+ *   @request : request from framework
+ *
+ * RETURN     : job on success
+ *              NULL if no job is free or the settings can't be copied
+ *==========================================================================*/
+QCamera3HardwareInterface::SubmitJob *QCamera3HardwareInterface::getSubmitJob(
+        const camera3_capture_request_t *request)
+{
+    if (mSubmitSpare == NULL) {
+        void *free_job = NULL;
+        if (cam_ring_deq(&mSubmitFreeQ, &free_job) != 0) {
+            ALOGE("%s: submission queue full, %d requests queued",
+                    __func__, cam_ring_count(&mSubmitQ));
+            return NULL;
+        }
+        mSubmitSpare = (SubmitJob *)free_job;
+    }
+
+    SubmitJob *job = mSubmitSpare;
+    job->request = *request;
+    job->request.settings = NULL;
+    if (request->settings != NULL) {
+        job->request.settings = clone_camera_metadata(request->settings);
+        if (job->request.settings == NULL) {
+            ALOGE("%s: failed to copy settings of frame %d",
+                    __func__, request->frame_number);
+            return NULL;
+        }
+    }
+    if (request->input_buffer != NULL) {
+        job->input_buffer = *request->input_buffer;
+        job->request.input_buffer = &job->input_buffer;
+    }
+    for (size_t i = 0; i < request->num_output_buffers; i++) {
+        job->output_buffers[i] = request->output_buffers[i];
+    }
+    job->request.output_buffers = job->output_buffers;
+    job->first_request = false;
+    job->fences_done = 0;
+    job->buffers_issued = 0;
+    job->error_code = CAMERA3_MSG_ERROR_REQUEST;
+    return job;
+}
+
+/*===========================================================================
+ * FUNCTION   : submitRoutine
+ *
+ * DESCRIPTION: submission thread, issues queued capture requests to the
+ *              backend
+ *
+ * PARAMETERS :
+ *   @data    : user data ptr (QCamera3HardwareInterface)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCamera3HardwareInterface::submitRoutine(void *data)
+{
+    int running = 1;
+    QCamera3HardwareInterface *hw = (QCamera3HardwareInterface *)data;
+    QCameraCmdThread *cmdThread = &hw->mSubmitTh;
+    camera_cmd_type_t cmd;
+    cmdThread->setName("cam_submit");
+
+    do {
+        if (NO_ERROR != cmdThread->waitCmd(&cmd)) {
+            return NULL;
+        }
+
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            // one pass takes every request queued so far, the commands of
+            // the remaining ones find the ring empty
+            hw->submitJobs();
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            hw->submitJobs();
+            // signal cmd is completed
+            cam_sem_post(&cmdThread->sync_sem);
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : submitJobs
+ *
+ * DESCRIPTION: issue all requests in the submission queue. Runs on the
+ *              submission thread without mMutex held.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::submitJobs()
+{
+    void *queued = NULL;
+
+    while (cam_ring_deq(&mSubmitQ, &queued) == 0) {
+        SubmitJob *job = (SubmitJob *)queued;
+        if (submitRequest(job) != NO_ERROR) {
+            failSubmittedRequest(job);
+        }
+        if (job->request.settings != NULL) {
+            free_camera_metadata((camera_metadata_t *)job->request.settings);
+            job->request.settings = NULL;
+        }
+        cam_ring_enq(&mSubmitFreeQ, job);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : submitRequest
+ *
+ * DESCRIPTION: stream on if needed, wait for the acquire fences, translate
+ *              the settings and issue the request to the channels. Runs on
+ *              the submission thread without mMutex held.
+ *
+ * PARAMETERS :
+ *   @job     : queued request
+ *
+ * RETURN     : NO_ERROR on success
+ *              none-zero failure code, job->fences_done and
+ *              job->buffers_issued tell how far the request got
+ *==========================================================================*/
+int QCamera3HardwareInterface::submitRequest(SubmitJob *job)
+{
+    int rc = NO_ERROR;
+    camera3_capture_request_t *request = &job->request;
+    uint32_t frameNumber = request->frame_number;
+    cam_stream_ID_t streamID;
+
+    // For first capture request, send capture intent, and
+    // stream on all streams
+    if (job->first_request && !isSubmitFlushed(job)) {
+        rc = startChannels(request);
+        if (rc != NO_ERROR) {
+            job->error_code = CAMERA3_MSG_ERROR_DEVICE;
+            return rc;
+        }
+    }
+
     // Acquire all request buffers first
     streamID.num_streams = 0;
-    int blob_request = 0;
     for (size_t i = 0; i < request->num_output_buffers; i++) {
         const camera3_stream_buffer_t& output = request->output_buffers[i];
         QCamera3Channel *channel = (QCamera3Channel *)output.stream->priv;
 
-        if (output.stream->format == HAL_PIXEL_FORMAT_BLOB) {
-            //Call function to store local copy of jpeg data for encode params.
-            blob_request = 1;
-        }
         if (output.acquire_fence != -1) {
             rc = sync_wait(output.acquire_fence, TIMEOUT_NEVER);
             close(output.acquire_fence);
-            if (rc != OK) {
-               ALOGE("%s: sync wait failed %d", __func__, rc);
-               pthread_mutex_unlock(&mMutex);
-               return rc;
-            }
+        }
+        job->fences_done = i + 1;
+        if (rc != OK) {
+           ALOGE("%s: sync wait failed %d", __func__, rc);
+           return rc;
         }
 
         streamID.streamID[streamID.num_streams] =
@@ -1747,47 +2272,12 @@ int QCamera3HardwareInterface::processCaptureRequest(
        rc = setFrameParameters(request, streamID);
         if (rc < 0) {
             ALOGE("%s: fail to set frame parameters", __func__);
-            pthread_mutex_unlock(&mMutex);
             return rc;
         }
     }
 
-    /* Update pending request list and pending buffers map */
-    PendingRequestInfo pendingRequest;
-    pendingRequest.frame_number = frameNumber;
-    pendingRequest.num_buffers = request->num_output_buffers;
-    pendingRequest.request_id = request_id;
-    pendingRequest.blob_request = blob_request;
-    pendingRequest.bNotified = 0;
-    pendingRequest.input_buffer_present = (request->input_buffer != NULL)? 1 : 0;
-    pendingRequest.pipeline_depth = 0;
-    pendingRequest.partial_result_cnt = 0;
-    extractJpegMetadata(pendingRequest.jpegMetadata, request);
-
-    for (size_t i = 0; i < request->num_output_buffers; i++) {
-        RequestedBufferInfo requestedBuf;
-        requestedBuf.stream = request->output_buffers[i].stream;
-        requestedBuf.buffer = NULL;
-        pendingRequest.buffers.push_back(requestedBuf);
-
-        // Add to buffer handle the pending buffers list
-        PendingBufferInfo bufferInfo;
-        bufferInfo.frame_number = frameNumber;
-        bufferInfo.buffer = request->output_buffers[i].buffer;
-        bufferInfo.stream = request->output_buffers[i].stream;
-        mPendingBuffersMap.mPendingBufferList.push_back(bufferInfo);
-        mPendingBuffersMap.num_buffers++;
-        ALOGV("%s: frame = %d, buffer = %p, stream = %p, stream format = %d",
-          __func__, frameNumber, bufferInfo.buffer, bufferInfo.stream,
-          bufferInfo.stream->format);
-    }
-    ALOGV("%s: mPendingBuffersMap.num_buffers = %d",
-          __func__, mPendingBuffersMap.num_buffers);
-
-    mPendingRequestsList.push_back(pendingRequest);
-
-    if (mFlush) {
-        pthread_mutex_unlock(&mMutex);
+    // flush returns the buffers of requests that are not issued yet
+    if (isSubmitFlushed(job)) {
         return NO_ERROR;
     }
 
@@ -1828,14 +2318,13 @@ int QCamera3HardwareInterface::processCaptureRequest(
                             pInputBuffer, mParameters);
                 if (rc < 0) {
                     ALOGE("%s: Fail to request on picture channel", __func__);
-                    pthread_mutex_unlock(&mMutex);
                     return rc;
                 }
+                job->buffers_issued = i + 1;
 
                 rc = setReprocParameters(request);
                 if (rc < 0) {
                     ALOGE("%s: fail to set reproc parameters", __func__);
-                    pthread_mutex_unlock(&mMutex);
                     return rc;
                 }
             } else{
@@ -1856,70 +2345,410 @@ int QCamera3HardwareInterface::processCaptureRequest(
         }
         if (rc < 0) {
             ALOGE("%s: Fail to issue channel request", __func__);
-            pthread_mutex_unlock(&mMutex);
             return -ENODEV;
         }
+        job->buffers_issued = i + 1;
+    }
+
+    /*set the parameters to backend*/
+    mCameraHandle->ops->set_parms(mCameraHandle->camera_handle, mParameters);
+
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : isSubmitFlushed
+ *
+ * DESCRIPTION: check if a queued request was flushed, either by the flush
+ *              in progress or by one that completed after it was queued.
+ *              Its buffers are returned by flush then and it must not be
+ *              issued. Runs on the submission thread without mMutex held.
+ *
+ * PARAMETERS :
+ *   @job     : queued request
+ *
+ * RETURN     : true if the request must not be issued
+ *==========================================================================*/
+bool QCamera3HardwareInterface::isSubmitFlushed(const SubmitJob *job)
+{
+    // flush bumps mFlushGen before it clears mFlush
+    if (__atomic_load_n(&mFlush, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+    return job->flush_gen != __atomic_load_n(&mFlushGen, __ATOMIC_ACQUIRE);
+}
+
+/*===========================================================================
+ * FUNCTION   : startChannels
+ *
+ * DESCRIPTION: register the first buffers, send the capture intent and
+ *              stream on all channels for the first request after stream
+ *              configuration or flush
+ *
+ * PARAMETERS :
+ *   @request : first request
+ *
+ * RETURN     : NO_ERROR on success
+ *              -ENODEV on failure
+ *==========================================================================*/
+int QCamera3HardwareInterface::startChannels(
+        const camera3_capture_request_t *request)
+{
+    int rc = NO_ERROR;
+    camera_metadata_ro_entry_t entry;
+
+    for (size_t i = 0; i < request->num_output_buffers; i++) {
+        const camera3_stream_buffer_t& output = request->output_buffers[i];
+        QCamera3Channel *channel = (QCamera3Channel *)output.stream->priv;
+        rc = channel->registerBuffer(output.buffer);
+        if (rc < 0) {
+            ALOGE("%s: registerBuffer failed",
+                    __func__);
+            return -ENODEV;
+        }
+    }
+
+    if (request->settings != NULL &&
+            find_camera_metadata_ro_entry(request->settings,
+                    ANDROID_CONTROL_CAPTURE_INTENT, &entry) == OK) {
+        int32_t hal_version = CAM_HAL_V3;
+        uint8_t captureIntent = entry.data.u8[0];
+
+        memset(mParameters, 0, sizeof(metadata_buffer_t));
+        mParameters->first_flagged_entry = CAM_INTF_PARM_MAX;
+        AddSetMetaEntryToBatch(mParameters, CAM_INTF_PARM_HAL_VERSION,
+            sizeof(hal_version), &hal_version);
+        AddSetMetaEntryToBatch(mParameters, CAM_INTF_META_CAPTURE_INTENT,
+            sizeof(captureIntent), &captureIntent);
+        mCameraHandle->ops->set_parms(mCameraHandle->camera_handle,
+            mParameters);
+    }
+
+    //First initialize all streams
+    for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
+        it != mStreamInfo.end(); it++) {
+        QCamera3Channel *channel = (QCamera3Channel *)(*it)->stream->priv;
+        rc = channel->initialize();
+        if (NO_ERROR != rc) {
+            ALOGE("%s : Channel initialization failed %d", __func__, rc);
+            return -ENODEV;
+        }
+    }
+    if (mSupportChannel) {
+        rc = mSupportChannel->initialize();
+        if (rc < 0) {
+            ALOGE("%s: Support channel initialization failed", __func__);
+            return -ENODEV;
+        }
+    }
+
+    //Then start them.
+    ALOGD("%s: Start META Channel", __func__);
+    rc = mMetadataChannel->start();
+    if (rc < 0) {
+        ALOGE("%s: Metadata channel start failed", __func__);
+        return -ENODEV;
+    }
+
+    if (mSupportChannel) {
+        rc = mSupportChannel->start();
+        if (rc < 0) {
+            ALOGE("%s: Support channel start failed", __func__);
+            mMetadataChannel->stop();
+            return -ENODEV;
+        }
+    }
+    for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
+        it != mStreamInfo.end(); it++) {
+        QCamera3Channel *channel = (QCamera3Channel *)(*it)->stream->priv;
+        ALOGD("%s: Start Regular Channel mask=%d", __func__, channel->getStreamTypeMask());
+        rc = channel->start();
+        if (rc < 0) {
+            ALOGE("%s: Start Regular Channel failed mask=%d", __func__, channel->getStreamTypeMask());
+            if (mSupportChannel)
+                mSupportChannel->stop();
+            mMetadataChannel->stop();
+            return -ENODEV;
+        }
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : failSubmittedRequest
+ *
+ * DESCRIPTION: report a request the submission thread could not issue and
+ *              return the buffers no channel took. Buffers already issued
+ *              come back through the channel callbacks.
+ *
+ * PARAMETERS :
+ *   @job     : failed request
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::failSubmittedRequest(SubmitJob *job)
+{
+    camera3_notify_msg_t notify_msg;
+    camera3_capture_result_t result;
+    camera3_stream_buffer_t pStream_Buf[MAX_NUM_STREAMS];
+    const camera3_capture_request_t *request = &job->request;
+    size_t numBufs = 0;
+
+    pthread_mutex_lock(&mMutex);
+
+    PendingRequestInfo *frame = getPendingFrame(request->frame_number);
+    if (frame == NULL || !frame->request_pending) {
+        // flushed meanwhile, the buffers are back already
+        pthread_mutex_unlock(&mMutex);
+        return;
+    }
+
+    ALOGE("%s: failed to submit frame %d, error %d", __func__,
+            request->frame_number, job->error_code);
+    notify_msg.type = CAMERA3_MSG_ERROR;
+    notify_msg.message.error.error_code = job->error_code;
+    notify_msg.message.error.error_stream = NULL;
+    notify_msg.message.error.frame_number = request->frame_number;
+    mCallbackOps->notify(mCallbackOps, &notify_msg);
+
+    for (uint32_t i = job->buffers_issued; i < request->num_output_buffers; i++) {
+        RequestedBufferInfo *buf = &frame->buffers[i];
+        if (!buf->pending) {
+            continue;
+        }
+        pStream_Buf[numBufs] = request->output_buffers[i];
+        // a fence we did not wait for goes back to the framework
+        pStream_Buf[numBufs].release_fence =
+                (i < job->fences_done) ? -1 : request->output_buffers[i].acquire_fence;
+        pStream_Buf[numBufs].acquire_fence = -1;
+        pStream_Buf[numBufs].status = CAMERA3_BUFFER_STATUS_ERROR;
+        numBufs++;
+        returnPendingBuffer(frame, buf);
+    }
+    if (numBufs > 0) {
+        memset(&result, 0, sizeof(camera3_capture_result_t));
+        result.frame_number = request->frame_number;
+        result.num_output_buffers = numBufs;
+        result.output_buffers = pStream_Buf;
+        mCallbackOps->process_capture_result(mCallbackOps, &result);
     }
 
-    /*set the parameters to backend*/
-    mCameraHandle->ops->set_parms(mCameraHandle->camera_handle, mParameters);
+    frame->request_pending = 0;
+    if (mPendingRequest > 0) {
+        mPendingRequest--;
+    }
+    releasePendingFrameIfDone(frame);
+    unblockRequestIfNecessary();
+    pthread_mutex_unlock(&mMutex);
+}
 
-    mFirstRequest = false;
-    // Added a timed condition wait
-    struct timespec ts;
-    uint8_t isValidTimeout = 1;
-    rc = clock_gettime(CLOCK_REALTIME, &ts);
-    if (rc < 0) {
-        isValidTimeout = 0;
-        ALOGE("%s: Error reading the real time clock!!", __func__);
+/*===========================================================================
+ * FUNCTION   : drainSubmitQueue
+ *
+ * DESCRIPTION: wait until the submission thread has handled every queued
+ *              request. Must be called without mMutex held.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::drainSubmitQueue()
+{
+    if (mSubmitTh.cmd_pid == 0) {
+        return;
     }
-    else {
-        // Make timeout as 5 sec for request to be honored
-        ts.tv_sec += 5;
+    mSubmitTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, FALSE);
+}
+
+/*===========================================================================
+ * FUNCTION   : dumpPrintf
+ *
+ * DESCRIPTION: formatted write to a dump fd
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *   @fmt     : printf style format
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void dumpPrintf(int fd, const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len > (int)sizeof(buf) - 1) {
+        len = sizeof(buf) - 1;
     }
-    //Block on conditional variable
+    if (len > 0 && write(fd, buf, len) != len) {
+        ALOGE("%s: failed to write to fd %d", __func__, fd);
+    }
+}
 
-    mPendingRequest++;
-    while (mPendingRequest >= kMaxInFlight) {
-        if (!isValidTimeout) {
-            ALOGV("%s: Blocking on conditional wait", __func__);
-            pthread_cond_wait(&mRequestCond, &mMutex);
+/*===========================================================================
+ * FUNCTION   : dumpPipelineLocked
+ *
+ * DESCRIPTION: dump pending requests, pending buffers and per stream
+ *              occupancy. Called with mMutex held.
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *   @now     : time the dump was requested
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::dumpPipelineLocked(int fd, nsecs_t now)
+{
+    int n = 0;
+    int pendingRequests = 0;
+    for (uint32_t f = mPendingFirstFrame; f != mPendingEndFrame; f++) {
+        PendingRequestInfo *i = getPendingFrame(f);
+        if (i != NULL && i->request_pending) {
+            pendingRequests++;
         }
-        else {
-            ALOGV("%s: Blocking on timed conditional wait", __func__);
-            rc = pthread_cond_timedwait(&mRequestCond, &mMutex, &ts);
-            if (rc == ETIMEDOUT) {
-                rc = -ENODEV;
-                ALOGE("%s: Unblocked on timeout!!!!", __func__);
+    }
+    dumpPrintf(fd, " In flight requests: %d of max %d, %d pending results\n",
+               mPendingRequest, getInFlightLimit(), pendingRequests);
+    dumpPrintf(fd, " Submission queue: %u requests\n",
+               cam_ring_count(&mSubmitQ));
+    dumpPrintf(fd, " Settings translation cache: %u hits, %u misses\n",
+               __atomic_load_n(&mSettingsCacheHits, __ATOMIC_RELAXED),
+               __atomic_load_n(&mSettingsCacheMisses, __ATOMIC_RELAXED));
+    dumpPrintf(fd, " Result metadata pool: %u reused, %u allocated\n",
+               mResultPool.getReuseCnt(), mResultPool.getAllocCnt());
+    dumpPrintf(fd, " In flight depth %d (%s, cap %d, thermal level %d), "
+               "shutter to metadata %.1f ms, frame interval %.1f ms\n",
+               mMaxInFlight, mInFlightAdaptive ? "adaptive" : "fixed",
+               mInFlightCap, __atomic_load_n(&mThermalLevel, __ATOMIC_RELAXED),
+               mProcLatencyAvg / 1000000.0, mFrameIntervalAvg / 1000000.0);
+    for (uint32_t f = mPendingFirstFrame; f != mPendingEndFrame; f++) {
+        PendingRequestInfo *i = getPendingFrame(f);
+        if (i == NULL || !i->request_pending) {
+            continue;
+        }
+        if (n++ == MAX_DUMP_ENTRIES) {
+            dumpPrintf(fd, "  ...\n");
+            break;
+        }
+        uint32_t cached = 0;
+        for (uint32_t j = 0; j < i->num_buffers; j++) {
+            if (i->buffers[j].cached) {
+                cached++;
+            }
+        }
+        dumpPrintf(fd, "  frame %u request %d: age %.1f ms, shutter %s, "
+                   "partial %u, depth %u, buffers %u/%u held%s\n",
+                   i->frame_number, i->request_id,
+                   (now - i->request_time) / 1000000.0,
+                   i->bNotified ? "sent" : "pending",
+                   i->partial_result_cnt, i->pipeline_depth,
+                   cached, i->num_buffers,
+                   i->input_buffer_present ? ", reprocess" : "");
+    }
+
+    n = 0;
+    dumpPrintf(fd, " Pending buffers: %u\n", mPendingBufferCnt);
+    for (uint32_t f = mPendingFirstFrame;
+            f != mPendingEndFrame && n <= MAX_DUMP_ENTRIES; f++) {
+        PendingRequestInfo *i = getPendingFrame(f);
+        if (i == NULL) {
+            continue;
+        }
+        for (uint32_t j = 0; j < i->num_buffers; j++) {
+            if (!i->buffers[j].pending) {
+                continue;
+            }
+            if (n++ == MAX_DUMP_ENTRIES) {
+                dumpPrintf(fd, "  ...\n");
                 break;
             }
+            dumpPrintf(fd, "  frame %u: stream %p, buffer %p, age %.1f ms\n",
+                       i->frame_number, i->buffers[j].stream,
+                       i->buffers[j].handle,
+                       (now - i->request_time) / 1000000.0);
         }
-        ALOGV("%s: Unblocked", __func__);
     }
-    pthread_mutex_unlock(&mMutex);
 
-    return rc;
+    dumpPrintf(fd, " Streams:\n");
+    for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
+            it != mStreamInfo.end(); it++) {
+        camera3_stream_t *stream = (*it)->stream;
+        uint32_t inFlight = 0;
+        for (uint32_t f = mPendingFirstFrame; f != mPendingEndFrame; f++) {
+            PendingRequestInfo *i = getPendingFrame(f);
+            for (uint32_t j = 0; i != NULL && j < i->num_buffers; j++) {
+                if (i->buffers[j].pending && i->buffers[j].stream == stream) {
+                    inFlight++;
+                }
+            }
+        }
+        dumpPrintf(fd, "  %p: %ux%u format 0x%x type %d, "
+                   "%u of %u buffers in flight\n",
+                   stream, stream->width, stream->height, stream->format,
+                   stream->stream_type, inFlight, stream->max_buffers);
+
+        QCamera3Channel *channel = (*it)->channel;
+        if (channel != NULL) {
+            for (uint8_t j = 0; j < channel->getNumOfStreams(); j++) {
+                QCamera3Stream *chStream = channel->getStreamByIndex(j);
+                if (chStream != NULL) {
+                    chStream->dump(fd);
+                }
+            }
+        }
+    }
+    QCamera3Channel *internal[] = {mMetadataChannel, mSupportChannel};
+    for (size_t i = 0; i < sizeof(internal) / sizeof(internal[0]); i++) {
+        if (internal[i] == NULL) {
+            continue;
+        }
+        for (uint8_t j = 0; j < internal[i]->getNumOfStreams(); j++) {
+            QCamera3Stream *chStream = internal[i]->getStreamByIndex(j);
+            if (chStream != NULL) {
+                chStream->dump(fd);
+            }
+        }
+    }
 }
 
 /*===========================================================================
  * FUNCTION   : dump
  *
- * DESCRIPTION:
+ * DESCRIPTION: dump pipeline state and request to result latency
+ *              histograms, for dumpsys media.camera
  *
  * PARAMETERS :
+ *   @fd      : fd to write to
  *
- *
- * RETURN     :
+ * RETURN     : none
  *==========================================================================*/
-void QCamera3HardwareInterface::dump(int /*fd*/)
+void QCamera3HardwareInterface::dump(int fd)
 {
-    /*Enable lock when we implement this function*/
-    /*
-    pthread_mutex_lock(&mMutex);
+    nsecs_t now = QCameraLatencyHistogram::now();
+    bool locked = false;
 
-    pthread_mutex_unlock(&mMutex);
-    */
-    return;
+    dumpPrintf(fd, "Camera %d HAL3 state:\n", mCameraId);
+
+    // a stalled HAL may sit on mMutex, wait a bit but never block dumpsys
+    for (int i = 0; i < DUMP_LOCK_RETRIES; i++) {
+        if (pthread_mutex_trylock(&mMutex) == 0) {
+            locked = true;
+            break;
+        }
+        usleep(DUMP_LOCK_WAIT_US);
+    }
+    if (locked) {
+        dumpPipelineLocked(fd, now);
+        pthread_mutex_unlock(&mMutex);
+    } else {
+        dumpPrintf(fd, " mMutex busy, pipeline state skipped\n");
+    }
+
+    dumpPrintf(fd, " Request to result latency:\n");
+    mShutterLatency.dump(fd, "shutter");
+    mMetaLatency.dump(fd, "metadata");
+    mBufferLatency.dump(fd, "buffer");
 }
 
 /*===========================================================================
@@ -1934,18 +2763,19 @@ void QCamera3HardwareInterface::dump(int /*fd*/)
  *==========================================================================*/
 int QCamera3HardwareInterface::flush()
 {
-    unsigned int frameNum = 0;
     camera3_notify_msg_t notify_msg;
     camera3_capture_result_t result;
-    camera3_stream_buffer_t *pStream_Buf = NULL;
-    FlushMap flushMap;
+    camera3_stream_buffer_t pStream_Buf[MAX_NUM_STREAMS];
 
     ALOGV("%s: Unblocking Process Capture Request", __func__);
 
     pthread_mutex_lock(&mMutex);
-    mFlush = true;
+    __atomic_store_n(&mFlush, true, __ATOMIC_RELEASE);
     pthread_mutex_unlock(&mMutex);
 
+    // Queued requests are no longer issued, wait for the one in progress
+    drainSubmitQueue();
+
     memset(&result, 0, sizeof(camera3_capture_result_t));
 
     // Stop the Streams/Channels
@@ -1971,147 +2801,71 @@ int QCamera3HardwareInterface::flush()
     mPendingRequest = 0;
     pthread_cond_signal(&mRequestCond);
 
-    List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
-    frameNum = i->frame_number;
-    ALOGV("%s: Oldest frame num on  mPendingRequestsList = %d",
-      __func__, frameNum);
-
-    // Go through the pending buffers and group them depending
-    // on frame number
-    for (List<PendingBufferInfo>::iterator k =
-            mPendingBuffersMap.mPendingBufferList.begin();
-            k != mPendingBuffersMap.mPendingBufferList.end();) {
-
-        if (k->frame_number < frameNum) {
-            ssize_t idx = flushMap.indexOfKey(k->frame_number);
-            if (idx == NAME_NOT_FOUND) {
-                Vector<PendingBufferInfo> pending;
-                pending.add(*k);
-                flushMap.add(k->frame_number, pending);
-            } else {
-                Vector<PendingBufferInfo> &pending =
-                        flushMap.editValueFor(k->frame_number);
-                pending.add(*k);
-            }
-
-            mPendingBuffersMap.num_buffers--;
-            k = mPendingBuffersMap.mPendingBufferList.erase(k);
-        } else {
-            k++;
-        }
-    }
-
-    for (size_t i = 0; i < flushMap.size(); i++) {
-        uint32_t frame_number = flushMap.keyAt(i);
-        const Vector<PendingBufferInfo> &pending = flushMap.valueAt(i);
-
-        // Send Error notify to frameworks for each buffer for which
-        // metadata buffer is already sent
-        ALOGV("%s: Sending ERROR BUFFER for frame %d number of buffer %d",
-          __func__, frame_number, pending.size());
-
-        pStream_Buf = new camera3_stream_buffer_t[pending.size()];
-        if (NULL == pStream_Buf) {
-            ALOGE("%s: No memory for pending buffers array", __func__);
-            pthread_mutex_unlock(&mMutex);
-            return NO_MEMORY;
+    // Go through the pending frames in frame number order. Buffers of
+    // frames whose metadata is already sent are returned with ERROR_BUFFER,
+    // frames with the request still pending get ERROR_REQUEST.
+    for (uint32_t f = mPendingFirstFrame; f != mPendingEndFrame; f++) {
+        PendingRequestInfo *i = getPendingFrame(f);
+        if (i == NULL || i->num_pending_buffers == 0) {
+            continue;
         }
 
-        for (size_t j = 0; j < pending.size(); j++) {
-            const PendingBufferInfo &info = pending.itemAt(j);
+        if (i->request_pending) {
+            ALOGV("%s:Sending ERROR REQUEST for frame %d",
+                  __func__, i->frame_number);
             notify_msg.type = CAMERA3_MSG_ERROR;
-            notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_BUFFER;
-            notify_msg.message.error.error_stream = info.stream;
-            notify_msg.message.error.frame_number = frame_number;
-            pStream_Buf[j].acquire_fence = -1;
-            pStream_Buf[j].release_fence = -1;
-            pStream_Buf[j].buffer = info.buffer;
-            pStream_Buf[j].status = CAMERA3_BUFFER_STATUS_ERROR;
-            pStream_Buf[j].stream = info.stream;
+            notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_REQUEST;
+            notify_msg.message.error.error_stream = NULL;
+            notify_msg.message.error.frame_number = i->frame_number;
             mCallbackOps->notify(mCallbackOps, &notify_msg);
-            ALOGV("%s: notify frame_number = %d stream %p", __func__,
-                    frame_number, info.stream);
-        }
-
-        result.result = NULL;
-        result.frame_number = frame_number;
-        result.num_output_buffers = pending.size();
-        result.output_buffers = pStream_Buf;
-        mCallbackOps->process_capture_result(mCallbackOps, &result);
-
-        delete [] pStream_Buf;
-    }
-
-    ALOGV("%s:Sending ERROR REQUEST for all pending requests", __func__);
-
-    flushMap.clear();
-    for (List<PendingBufferInfo>::iterator k =
-            mPendingBuffersMap.mPendingBufferList.begin();
-            k != mPendingBuffersMap.mPendingBufferList.end();) {
-        ssize_t idx = flushMap.indexOfKey(k->frame_number);
-        if (idx == NAME_NOT_FOUND) {
-            Vector<PendingBufferInfo> pending;
-            pending.add(*k);
-            flushMap.add(k->frame_number, pending);
         } else {
-            Vector<PendingBufferInfo> &pending =
-                    flushMap.editValueFor(k->frame_number);
-            pending.add(*k);
-        }
-
-        mPendingBuffersMap.num_buffers--;
-        k = mPendingBuffersMap.mPendingBufferList.erase(k);
-    }
-
-    // Go through the pending requests info and send error request to framework
-    for (size_t i = 0; i < flushMap.size(); i++) {
-        uint32_t frame_number = flushMap.keyAt(i);
-        const Vector<PendingBufferInfo> &pending = flushMap.valueAt(i);
-        ALOGV("%s:Sending ERROR REQUEST for frame %d",
-              __func__, frame_number);
-
-        // Send shutter notify to frameworks
-        notify_msg.type = CAMERA3_MSG_ERROR;
-        notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_REQUEST;
-        notify_msg.message.error.error_stream = NULL;
-        notify_msg.message.error.frame_number = frame_number;
-        mCallbackOps->notify(mCallbackOps, &notify_msg);
-
-        pStream_Buf = new camera3_stream_buffer_t[pending.size()];
-        if (NULL == pStream_Buf) {
-            ALOGE("%s: No memory for pending buffers array", __func__);
-            pthread_mutex_unlock(&mMutex);
-            return NO_MEMORY;
+            ALOGV("%s: Sending ERROR BUFFER for frame %d number of buffer %d",
+                  __func__, i->frame_number, i->num_pending_buffers);
         }
 
-        for (size_t j = 0; j < pending.size(); j++) {
-            const PendingBufferInfo &info = pending.itemAt(j);
-            pStream_Buf[j].acquire_fence = -1;
-            pStream_Buf[j].release_fence = -1;
-            pStream_Buf[j].buffer = info.buffer;
-            pStream_Buf[j].status = CAMERA3_BUFFER_STATUS_ERROR;
-            pStream_Buf[j].stream = info.stream;
+        size_t numBufs = 0;
+        for (uint32_t j = 0; j < i->num_buffers; j++) {
+            const RequestedBufferInfo &info = i->buffers[j];
+            if (!info.pending) {
+                continue;
+            }
+            if (!i->request_pending) {
+                // Send Error notify to frameworks for each buffer for which
+                // metadata buffer is already sent
+                notify_msg.type = CAMERA3_MSG_ERROR;
+                notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_BUFFER;
+                notify_msg.message.error.error_stream = info.stream;
+                notify_msg.message.error.frame_number = i->frame_number;
+                mCallbackOps->notify(mCallbackOps, &notify_msg);
+                ALOGV("%s: notify frame_number = %d stream %p", __func__,
+                        i->frame_number, info.stream);
+            }
+            pStream_Buf[numBufs].acquire_fence = -1;
+            pStream_Buf[numBufs].release_fence = -1;
+            pStream_Buf[numBufs].buffer = info.handle;
+            pStream_Buf[numBufs].status = CAMERA3_BUFFER_STATUS_ERROR;
+            pStream_Buf[numBufs].stream = info.stream;
+            numBufs++;
         }
 
-        result.num_output_buffers = pending.size();
-        result.output_buffers = pStream_Buf;
         result.result = NULL;
-        result.frame_number = frame_number;
+        result.frame_number = i->frame_number;
+        result.num_output_buffers = numBufs;
+        result.output_buffers = pStream_Buf;
         mCallbackOps->process_capture_result(mCallbackOps, &result);
-        delete [] pStream_Buf;
     }
 
-    /* Reset pending buffer list and requests list */
-    mPendingRequestsList.clear();
+    /* Reset pending frames */
+    resetPendingFrames();
     /* Reset pending frame Drop list and requests list */
     mPendingFrameDropList.clear();
-
-    flushMap.clear();
-    mPendingBuffersMap.num_buffers = 0;
-    mPendingBuffersMap.mPendingBufferList.clear();
     ALOGV("%s: Cleared all the pending buffers ", __func__);
 
-    mFlush = false;
+    // Requests queued while flushing got their buffers back above. They
+    // may still be picked up by the submission thread after mFlush is
+    // cleared, the new generation makes sure they are not issued.
+    __atomic_store_n(&mFlushGen, mFlushGen + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&mFlush, false, __ATOMIC_RELEASE);
 
     mFirstRequest = true;
 
@@ -2199,6 +2953,12 @@ QCamera3HardwareInterface::translateFromHalMetadata(
     CameraMetadata camMetadata;
     camera_metadata_t* resultMetadata;
 
+    // start from a pooled buffer big enough for a whole result
+    camera_metadata_t *pooled = mResultPool.get();
+    if (pooled != NULL) {
+        camMetadata.acquire(pooled);
+    }
+
     if (jpegMetadata.entryCount())
         camMetadata.append(jpegMetadata);
 
@@ -2775,6 +3535,12 @@ QCamera3HardwareInterface::translateCbUrgentMetadataToResultMetadata
     int32_t *flashMode = NULL;
     int32_t *redeye = NULL;
 
+    // partial results share the pool of the full results
+    camera_metadata_t *pooled = mResultPool.get();
+    if (pooled != NULL) {
+        camMetadata.acquire(pooled);
+    }
+
     uint8_t curr_entry = GET_FIRST_PARAM_ID(metadata);
     uint8_t next_entry;
     while (curr_entry != CAM_INTF_PARM_MAX) {
@@ -3939,7 +4705,8 @@ int QCamera3HardwareInterface::initStaticMetadata(int cameraId)
                       avail_testpattern_modes,
                       size);
 
-    uint8_t max_pipeline_depth = kMaxInFlight + EMPTY_PIPELINE_DELAY;
+    uint8_t max_pipeline_depth =
+        QCamera3RegularChannel::kMaxBuffers + EMPTY_PIPELINE_DELAY;
     staticInfo.update(ANDROID_REQUEST_PIPELINE_MAX_DEPTH,
                       &max_pipeline_depth,
                       1);
@@ -4541,9 +5308,31 @@ int32_t QCamera3HardwareInterface::AddSetMetaEntryToBatch(metadata_buffer_t *p_t
     }
     memcpy(POINTER_OF(paramType,p_table), paramValue, paramLength);
     SET_PARM_VALID_BIT(paramType,p_table,1);
+    if (mSettingsRecording) {
+        recordCachedEntry(paramType, paramLength, paramValue);
+    }
     return NO_ERROR;
 }
 
+// index traits for QCameraMap lookups in either direction
+struct QCamera3HardwareInterface::MapByHalName {
+    typedef QCameraMap Entry;
+    typedef int Key;
+    static uint32_t hash(Key key) { return qcamera_map_hash_int((uint32_t)key); }
+    static uint32_t hashEntry(const Entry &e) { return qcamera_map_hash_int(e.hal_name); }
+    static bool match(const Entry &e, Key key) { return e.hal_name == key; }
+    static bool sameKey(const Entry &a, const Entry &b) { return a.hal_name == b.hal_name; }
+};
+
+struct QCamera3HardwareInterface::MapByFwkName {
+    typedef QCameraMap Entry;
+    typedef unsigned int Key;
+    static uint32_t hash(Key key) { return qcamera_map_hash_int(key); }
+    static uint32_t hashEntry(const Entry &e) { return qcamera_map_hash_int(e.fwk_name); }
+    static bool match(const Entry &e, Key key) { return e.fwk_name == key; }
+    static bool sameKey(const Entry &a, const Entry &b) { return a.fwk_name == b.fwk_name; }
+};
+
 /*===========================================================================
  * FUNCTION   : lookupFwkName
  *
@@ -4562,11 +5351,9 @@ int32_t QCamera3HardwareInterface::AddSetMetaEntryToBatch(metadata_buffer_t *p_t
 int32_t QCamera3HardwareInterface::lookupFwkName(const QCameraMap arr[],
                                              int len, int hal_name)
 {
-
-    for (int i = 0; i < len; i++) {
-        if (arr[i].hal_name == hal_name)
-            return arr[i].fwk_name;
-    }
+    int i = QCameraMapIndex<MapByHalName>::find(arr, len, hal_name);
+    if (i >= 0)
+        return arr[i].fwk_name;
 
     /* Not able to find matching framework type is not necessarily
      * an error case. This happens when mm-camera supports more attributes
@@ -4593,10 +5380,9 @@ int32_t QCamera3HardwareInterface::lookupFwkName(const QCameraMap arr[],
 int8_t QCamera3HardwareInterface::lookupHalName(const QCameraMap arr[],
                                              int len, unsigned int fwk_name)
 {
-    for (int i = 0; i < len; i++) {
-       if (arr[i].fwk_name == fwk_name)
-           return arr[i].hal_name;
-    }
+    int i = QCameraMapIndex<MapByFwkName>::find(arr, len, fwk_name);
+    if (i >= 0)
+        return arr[i].hal_name;
     ALOGE("%s: Cannot find matching hal type", __func__);
     return NAME_NOT_FOUND;
 }
@@ -5020,7 +5806,7 @@ int QCamera3HardwareInterface::setFrameParameters(
 
     if(request->settings != NULL){
         mRepeatingRequest = false;
-        rc = translateToHalMetadata(request, mParameters);
+        rc = translateFrameSettings(request, mParameters);
     } else {
        mRepeatingRequest = true;
     }
@@ -5028,6 +5814,192 @@ int QCamera3HardwareInterface::setFrameParameters(
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : isSameSettings
+ *
+ * DESCRIPTION: compare two settings buffers entry by entry
+ *
+ * PARAMETERS :
+ *   @a       : settings buffer
+ *   @b       : settings buffer
+ *
+ * RETURN     : true if both hold the same entries in the same order
+ *==========================================================================*/
+static bool isSameSettings(const camera_metadata_t *a,
+        const camera_metadata_t *b)
+{
+    size_t cnt = get_camera_metadata_entry_count(a);
+    if (cnt != get_camera_metadata_entry_count(b) ||
+            get_camera_metadata_data_count(a) !=
+            get_camera_metadata_data_count(b)) {
+        return false;
+    }
+    for (size_t i = 0; i < cnt; i++) {
+        camera_metadata_ro_entry_t ea, eb;
+        if (get_camera_metadata_ro_entry(a, i, &ea) != OK ||
+                get_camera_metadata_ro_entry(b, i, &eb) != OK) {
+            return false;
+        }
+        if (ea.tag != eb.tag || ea.type != eb.type || ea.count != eb.count ||
+                memcmp(ea.data.u8, eb.data.u8,
+                    ea.count * camera_metadata_type_size[ea.type]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : translateFrameSettings
+ *
+ * DESCRIPTION: translate request settings, reusing the translation of the
+ *              previous settings if they are identical
+ *
+ * PARAMETERS :
+ *   @request      : request sent from framework, settings not NULL
+ *   @hal_metadata : parameter buffer to add the entries to
+ *
+ * RETURN     : success: NO_ERROR
+ *              failure: return code of translateToHalMetadata
+ *==========================================================================*/
+int QCamera3HardwareInterface::translateFrameSettings(
+        const camera3_capture_request_t *request,
+        metadata_buffer_t *hal_metadata)
+{
+    int rc;
+
+    if (mCachedSettings != NULL &&
+            isSameSettings(mCachedSettings, request->settings)) {
+        mSettingsCacheHits++;
+        return replayCachedSettings(hal_metadata);
+    }
+    mSettingsCacheMisses++;
+
+    resetSettingsCache();
+    mSettingsRecording = true;
+    rc = translateToHalMetadata(request, hal_metadata);
+    mSettingsRecording = false;
+    if (rc != NO_ERROR || mSettingsCacheFull) {
+        resetSettingsCache();
+        return rc;
+    }
+
+    // the params to link on replay, sorted like the parameter list
+    mCachedParamCnt = 0;
+    for (uint32_t i = 0; i < mCachedEntryCnt; i++) {
+        uint8_t param = mCachedEntries[i].param;
+        uint32_t j = mCachedParamCnt;
+        while (j > 0 && mCachedParams[j - 1] > param) {
+            j--;
+        }
+        if (j > 0 && mCachedParams[j - 1] == param) {
+            continue;
+        }
+        memmove(&mCachedParams[j + 1], &mCachedParams[j],
+                mCachedParamCnt - j);
+        mCachedParams[j] = param;
+        mCachedParamCnt++;
+    }
+    mCachedSettings = clone_camera_metadata(request->settings);
+    mCachedSettingsRc = rc;
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : replayCachedSettings
+ *
+ * DESCRIPTION: add the entries recorded by the last translation. The new
+ *              params are linked in one pass over the parameter list, then
+ *              the values are copied in the order they were written.
+ *
+ * PARAMETERS :
+ *   @hal_metadata : parameter buffer to add the entries to
+ *
+ * RETURN     : return code of the recorded translation
+ *==========================================================================*/
+int QCamera3HardwareInterface::replayCachedSettings(
+        metadata_buffer_t *hal_metadata)
+{
+    uint8_t prev = CAM_INTF_PARM_MAX;
+    uint8_t current = GET_FIRST_PARAM_ID(hal_metadata);
+
+    for (uint32_t i = 0; i < mCachedParamCnt; i++) {
+        uint8_t param = mCachedParams[i];
+        while (current < param) {
+            prev = current;
+            current = GET_NEXT_PARAM_ID(current, hal_metadata);
+        }
+        if (current == param) {
+            continue;
+        }
+        SET_NEXT_PARAM_ID(param, hal_metadata, current);
+        if (prev == CAM_INTF_PARM_MAX) {
+            SET_FIRST_PARAM_ID(hal_metadata, param);
+        } else {
+            SET_NEXT_PARAM_ID(prev, hal_metadata, param);
+        }
+        prev = param;
+    }
+
+    for (uint32_t i = 0; i < mCachedEntryCnt; i++) {
+        const CachedMetaEntry *entry = &mCachedEntries[i];
+        memcpy(POINTER_OF(entry->param, hal_metadata),
+                &mCachedData[entry->offset], entry->length);
+        SET_PARM_VALID_BIT(entry->param, hal_metadata, 1);
+    }
+    return mCachedSettingsRc;
+}
+
+/*===========================================================================
+ * FUNCTION   : recordCachedEntry
+ *
+ * DESCRIPTION: remember an entry written while translating settings
+ *
+ * PARAMETERS :
+ *   @paramType   : parameter type
+ *   @paramLength : length of parameter value
+ *   @paramValue  : ptr to parameter value
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::recordCachedEntry(unsigned int paramType,
+        uint32_t paramLength, const void *paramValue)
+{
+    if (mCachedEntryCnt == MAX_CACHED_META_ENTRIES ||
+            paramLength > SETTINGS_CACHE_DATA_SIZE - mCachedDataLen) {
+        mSettingsCacheFull = true;
+        return;
+    }
+    CachedMetaEntry *entry = &mCachedEntries[mCachedEntryCnt++];
+    entry->param = (uint8_t)paramType;
+    entry->length = paramLength;
+    entry->offset = mCachedDataLen;
+    memcpy(&mCachedData[mCachedDataLen], paramValue, paramLength);
+    mCachedDataLen += paramLength;
+}
+
+/*===========================================================================
+ * FUNCTION   : resetSettingsCache
+ *
+ * DESCRIPTION: drop the cached settings translation
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::resetSettingsCache()
+{
+    if (mCachedSettings != NULL) {
+        free_camera_metadata(mCachedSettings);
+        mCachedSettings = NULL;
+    }
+    mCachedSettingsRc = NO_ERROR;
+    mSettingsCacheFull = false;
+    mCachedEntryCnt = 0;
+    mCachedParamCnt = 0;
+    mCachedDataLen = 0;
+}
+
 /*===========================================================================
  * FUNCTION   : setReprocParameters
  *
@@ -32,17 +32,21 @@
 
 #include <pthread.h>
 #include <utils/List.h>
-#include <utils/KeyedVector.h>
 #include <hardware/camera3.h>
 #include <camera/CameraMetadata.h>
 #include "QCamera3HALHeader.h"
 #include "QCamera3Channel.h"
+#include "QCameraCmdThread.h"
+#include "QCameraLatencyHistogram.h"
+#include "QCameraMetadataPool.h"
+#include "QCameraThermalAdapter.h"
 
 #include <hardware/power.h>
 
 extern "C" {
 #include <mm_camera_interface.h>
 #include <mm_jpeg_interface.h>
+#include <cam_ring.h>
 }
 
 #ifdef CDBG
@@ -72,6 +76,14 @@ typedef int64_t nsecs_t;
 #define NSEC_PER_SEC 1000000000LL
 #define NSEC_PER_USEC 1000
 #define NSEC_PER_33MSEC 33000000LL
+/* Pending frame ring size, must be a power of two. A frame is held until
+ * its metadata and all its buffers are returned, so this has to cover the
+ * in-flight depth plus the buffers a stream may still hold */
+#define MAX_PENDING_FRAMES 64
+/* Capacity of the translated settings cache, settings needing more are
+ * translated on every request */
+#define MAX_CACHED_META_ENTRIES 96
+#define SETTINGS_CACHE_DATA_SIZE (8 * 1024)
 
 class QCamera3MetadataChannel;
 class QCamera3PicChannel;
@@ -84,7 +96,7 @@ typedef struct {
     QCamera3Channel *channel;
 } stream_info_t;
 
-class QCamera3HardwareInterface {
+class QCamera3HardwareInterface : public QCameraThermalCallback {
 public:
     /* static variable and functions accessed by camera service */
     static camera3_device_ops_t mCameraOps;
@@ -142,12 +154,20 @@ public:
     int processCaptureRequest(camera3_capture_request_t *request);
     void dump(int fd);
     int flush();
+    int thermalEvtHandle(qcamera_thermal_level_enum_t level,
+            void *userdata, void *data);
 
     int setFrameParameters(camera3_capture_request_t *request,
             cam_stream_ID_t streamID);
     int setReprocParameters(camera3_capture_request_t *request);
     int translateToHalMetadata(const camera3_capture_request_t *request,
             metadata_buffer_t *parm);
+    int translateFrameSettings(const camera3_capture_request_t *request,
+            metadata_buffer_t *parm);
+    int replayCachedSettings(metadata_buffer_t *parm);
+    void recordCachedEntry(unsigned int paramType, uint32_t paramLength,
+            const void *paramValue);
+    void resetSettingsCache();
     camera_metadata_t* translateCbUrgentMetadataToResultMetadata (
                              metadata_buffer_t *metadata);
 
@@ -179,6 +199,8 @@ private:
                                unsigned int paramType,
                                uint32_t paramLength,
                                void *paramValue);
+    struct MapByHalName;
+    struct MapByFwkName;
     static int8_t lookupHalName(const QCameraMap arr[],
                       int len, unsigned int fwk_name);
     static int32_t lookupFwkName(const QCameraMap arr[],
@@ -193,6 +215,9 @@ private:
     void handleBufferWithLock(camera3_stream_buffer_t *buffer,
         uint32_t frame_number);
     void unblockRequestIfNecessary();
+    void initInFlightDepth();
+    void updateInFlightDepth(uint32_t frameNumber, nsecs_t captureTime);
+    int getInFlightLimit();
     void dumpMetadataToFile(tuning_params_t &meta,
                             uint32_t &dumpFrameCount,
                             int32_t enabled,
@@ -200,6 +225,7 @@ private:
                             uint32_t frameNumber);
 
     void cleanAndSortStreamInfo();
+    void dumpPipelineLocked(int fd, nsecs_t now);
     void extractJpegMetadata(CameraMetadata& jpegMetadata,
             const camera3_capture_request_t *request);
 public:
@@ -212,7 +238,8 @@ public:
             bool& hasFlash,
             char (&flashNode)[QCAMERA_MAX_FILEPATH_LENGTH]);
 public:
-    static int kMaxInFlight;
+    static int kDefaultInFlight;
+    static int kMinInFlight;
 private:
     camera3_device_t   mCameraDevice;
     uint8_t            mCameraId;
@@ -238,16 +265,49 @@ private:
     metadata_buffer_t* mPrevParameters;
     bool m_bWNROn;
 
+    /* Settings of the last translated request and the entries the
+     * translation wrote, in order. A request carrying identical settings
+     * replays them instead of translating again */
+    typedef struct {
+        uint8_t param;
+        uint32_t length;
+        uint32_t offset;
+    } CachedMetaEntry;
+    camera_metadata_t *mCachedSettings;
+    int mCachedSettingsRc;
+    bool mSettingsRecording;
+    bool mSettingsCacheFull;
+    CachedMetaEntry mCachedEntries[MAX_CACHED_META_ENTRIES];
+    uint32_t mCachedEntryCnt;
+    uint8_t mCachedParams[MAX_CACHED_META_ENTRIES]; // sorted, no duplicates
+    uint32_t mCachedParamCnt;
+    uint8_t mCachedData[SETTINGS_CACHE_DATA_SIZE];
+    uint32_t mCachedDataLen;
+    uint32_t mSettingsCacheHits;
+    uint32_t mSettingsCacheMisses;
+
     /* Data structure to store pending request */
     typedef struct {
         camera3_stream_t *stream;
-        camera3_stream_buffer_t *buffer;
+        // Buffer handle from the request
+        buffer_handle_t *handle;
+        // Result buffer held until the frame's metadata is sent
+        camera3_stream_buffer_t buffer;
+        uint8_t cached;
+        // Handle not yet returned to the framework
+        uint8_t pending;
     } RequestedBufferInfo;
     typedef struct {
         uint32_t frame_number;
+        // Slot holds a frame with a pending result or pending buffers
+        uint8_t in_use;
+        // Result metadata not yet sent
+        uint8_t request_pending;
         uint32_t num_buffers;
+        // Number of buffers still pending
+        uint32_t num_pending_buffers;
         int32_t request_id;
-        List<RequestedBufferInfo> buffers;
+        RequestedBufferInfo buffers[MAX_NUM_STREAMS];
         int blob_request;
         nsecs_t timestamp;
         uint8_t bNotified;
@@ -255,40 +315,88 @@ private:
         CameraMetadata jpegMetadata;
         uint8_t pipeline_depth;
         uint32_t partial_result_cnt;
+        nsecs_t request_time; // when request was accepted, for latency stats
+        nsecs_t shutter_time; // when shutter was notified
     } PendingRequestInfo;
     typedef struct {
         uint32_t frame_number;
         uint32_t stream_ID;
     } PendingFrameDropInfo;
 
-    // Store the Pending buffers for Flushing
-    typedef struct {
-        // Frame number pertaining to the buffer
-        uint32_t frame_number;
-        camera3_stream_t *stream;
-        // Buffer handle
-        buffer_handle_t *buffer;
-    } PendingBufferInfo;
+    PendingRequestInfo *getPendingFrame(uint32_t frameNumber);
+    int waitPendingFrameSlot(uint32_t frameNumber);
+    void returnPendingBuffer(PendingRequestInfo *frame,
+            RequestedBufferInfo *buf);
+    void releasePendingFrameIfDone(PendingRequestInfo *frame);
+    void resetPendingFrames();
 
+    /* Capture request handed to the submission thread. request points
+     * at the buffer copies below and owns a clone of the settings */
     typedef struct {
-        // Total number of buffer requests pending
-        uint32_t num_buffers;
-        // List of pending buffers
-        List<PendingBufferInfo> mPendingBufferList;
-    } PendingBuffersMap;
-
-    typedef KeyedVector<uint32_t, Vector<PendingBufferInfo> > FlushMap;
-
-    List<PendingRequestInfo> mPendingRequestsList;
+        camera3_capture_request_t request;
+        camera3_stream_buffer_t input_buffer;
+        camera3_stream_buffer_t output_buffers[MAX_NUM_STREAMS];
+        bool first_request;      // stream on before submitting
+        uint32_t flush_gen;      // mFlushGen when the request was queued
+        uint32_t fences_done;    // acquire fences waited for and closed
+        uint32_t buffers_issued; // buffers handed to channels
+        int error_code;          // CAMERA3_MSG_ERROR_* if submission fails
+    } SubmitJob;
+
+    static void *submitRoutine(void *data);
+    SubmitJob *getSubmitJob(const camera3_capture_request_t *request);
+    void submitJobs();
+    int submitRequest(SubmitJob *job);
+    int startChannels(const camera3_capture_request_t *request);
+    void failSubmittedRequest(SubmitJob *job);
+    bool isSubmitFlushed(const SubmitJob *job);
+    void drainSubmitQueue();
+
+    // Requests are handed to mSubmitTh without mMutex. mSubmitQ carries
+    // filled jobs from processCaptureRequest to the submission thread,
+    // mSubmitFreeQ carries them back once issued. Each ring has a single
+    // producer and a single consumer.
+    QCameraCmdThread mSubmitTh;
+    SubmitJob mSubmitJobs[MAX_PENDING_FRAMES];
+    SubmitJob *mSubmitSpare; // taken from mSubmitFreeQ but not queued
+    cam_ring_t mSubmitQ;
+    cam_ring_t mSubmitFreeQ;
+    void *mSubmitQSlots[MAX_PENDING_FRAMES];
+    void *mSubmitFreeQSlots[MAX_PENDING_FRAMES];
+
+    // Pending frames indexed by frame_number % MAX_PENDING_FRAMES. Frame
+    // numbers increase, so live frames always lie in
+    // [mPendingFirstFrame, mPendingEndFrame).
+    PendingRequestInfo mPendingFrames[MAX_PENDING_FRAMES];
+    uint32_t mPendingFirstFrame;
+    uint32_t mPendingEndFrame;
+    // Total number of buffer requests pending
+    uint32_t mPendingBufferCnt;
     List<PendingFrameDropInfo> mPendingFrameDropList;
-    PendingBuffersMap mPendingBuffersMap;
     pthread_cond_t mRequestCond;
     int mPendingRequest;
+    // In-flight depth of the session, mPendingRequest is kept below it
+    int mMaxInFlight;
+    // Upper bound of the depth from the stream buffer counts
+    int mInFlightCap;
+    bool mInFlightAdaptive;
+    uint32_t mInFlightEvalCnt;
+    // Averages driving the depth, shutter to metadata latency and
+    // sensor frame interval
+    nsecs_t mProcLatencyAvg;
+    nsecs_t mFrameIntervalAvg;
+    uint32_t mLastMetaFrame;
+    nsecs_t mLastCaptureTime;
+    // Last thermal level, written from the thermal client thread
+    int32_t mThermalLevel;
+    QCameraThermalAdapter &m_thermalAdapter;
     int32_t mCurrentRequestId;
     camera3_capture_result_t *mLoopBackResult;
     nsecs_t mLoopBackTimestamp;
     uint8_t mAfState;
     bool mFlush;
+    // Bumped by every flush, requests queued before are not issued
+    uint32_t mFlushGen;
 
     //mutex for serialized access to camera3_device_ops_t functions
     pthread_mutex_t mMutex;
@@ -307,6 +415,13 @@ private:
     uint32_t mMetaFrameCount;
     const camera_module_callbacks_t *mCallbacks;
 
+    // request to result latencies, reset on configure_streams
+    QCameraLatencyHistogram mShutterLatency;
+    QCameraLatencyHistogram mMetaLatency;
+    QCameraLatencyHistogram mBufferLatency;
+    // result metadata buffers, reused once process_capture_result returns
+    QCameraMetadataPool mResultPool;
+
     static const QCameraMap EFFECT_MODES_MAP[];
     static const QCameraMap WHITE_BALANCE_MODES_MAP[];
     static const QCameraMap SCENE_MODES_MAP[];
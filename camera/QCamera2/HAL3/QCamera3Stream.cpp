@@ -173,7 +173,8 @@ QCamera3Stream::QCamera3Stream(uint32_t camHandle,
         mNumBufs(0),
         mDataCB(NULL),
         mUserData(NULL),
-        mDataQ(releaseFrameData, this),
+        mDataQ(releaseFrameData, this, QCAMERA_QUEUE_MODE_RING,
+               MM_CAMERA_MAX_NUM_FRAMES),
         mStreamInfoBuf(NULL),
         mStreamBufs(NULL),
         mBufDefs(NULL),
@@ -342,6 +343,7 @@ int32_t QCamera3Stream::start()
     int32_t rc = 0;
 
     mDataQ.init();
+    mStats.reset();
     rc = mProcTh.launch(dataProcRoutine, this);
     return rc;
 }
@@ -384,6 +386,7 @@ int32_t QCamera3Stream::processDataNotify(mm_camera_super_buf_t *frame)
         rc = mProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else {
         ALOGD("%s: Stream thread is not active, no ops here", __func__);
+        mStats.frameDropped();
         bufDone(frame->bufs[0]->buf_idx);
         free(frame);
         rc = NO_ERROR;
@@ -421,10 +424,13 @@ void QCamera3Stream::dataNotifyCB(mm_camera_super_buf_t *recvd_frame,
         (mm_camera_super_buf_t *)malloc(sizeof(mm_camera_super_buf_t));
     if (frame == NULL) {
         ALOGE("%s: No mem for mm_camera_buf_def_t", __func__);
+        stream->mStats.frameDropped();
         stream->bufDone(recvd_frame->bufs[0]->buf_idx);
         return;
     }
     *frame = *recvd_frame;
+    stream->mStats.frameReceived(frame->bufs[0]->frame_idx,
+                                 frame->bufs[0]->buf_idx);
     stream->processDataNotify(frame);
     return;
 }
@@ -442,33 +448,33 @@ void QCamera3Stream::dataNotifyCB(mm_camera_super_buf_t *recvd_frame,
 void *QCamera3Stream::dataProcRoutine(void *data)
 {
     int running = 1;
-    int ret;
     QCamera3Stream *pme = (QCamera3Stream *)data;
     QCameraCmdThread *cmdThread = &pme->mProcTh;
+    camera_cmd_type_t cmd;
     cmdThread->setName("cam_stream_proc");
 
     ALOGV("%s: E", __func__);
     do {
-        do {
-            ret = cam_sem_wait(&cmdThread->cmd_sem);
-            if (ret != 0 && errno != EINVAL) {
-                ALOGE("%s: cam_sem_wait error (%s)",
-                      __func__, strerror(errno));
-                return NULL;
-            }
-        } while (ret != 0);
+        if (NO_ERROR != cmdThread->waitCmd(&cmd)) {
+            return NULL;
+        }
 
-        // we got notified about new cmd avail in cmd queue
-        camera_cmd_type_t cmd = cmdThread->getCmd();
         switch (cmd) {
         case CAMERA_CMD_TYPE_DO_NEXT_JOB:
             {
                 ALOGV("%s: Do next job", __func__);
-                mm_camera_super_buf_t *frame =
-                    (mm_camera_super_buf_t *)pme->mDataQ.dequeue();
-                if (NULL != frame) {
+                // catch up with all queued frames, the DO_NEXT_JOB cmds
+                // of the frames taken here will find the queue empty
+                void *frames[MM_CAMERA_MAX_NUM_FRAMES];
+                int numFrames = pme->mDataQ.dequeueBatch(frames,
+                                                         MM_CAMERA_MAX_NUM_FRAMES);
+                for (int i = 0; i < numFrames; i++) {
+                    mm_camera_super_buf_t *frame =
+                        (mm_camera_super_buf_t *)frames[i];
                     if (pme->mDataCB != NULL) {
+                        int64_t start = QCameraStreamStats::now();
                         pme->mDataCB(frame, pme, pme->mUserData);
+                        pme->mStats.callbackDone(start);
                     } else {
                         // no data cb routine, return buf here
                         pme->bufDone(frame->bufs[0]->buf_idx);
@@ -564,6 +570,7 @@ int32_t QCamera3Stream::bufDone(int index)
     if (rc < 0)
         return FAILED_TRANSACTION;
 
+    mStats.bufReturned(index);
     return rc;
 }
 
@@ -608,14 +615,26 @@ int32_t QCamera3Stream::getBufs(cam_frame_len_offset_t *offset,
     }
 
     int registeredBuffers = mStreamBufs->getCnt();
-    for (int i = 0; i < registeredBuffers; i++) {
-        rc = ops_tbl->map_ops(i, -1, mStreamBufs->getFd(i),
-                mStreamBufs->getSize(i), ops_tbl->userdata);
+    if (registeredBuffers > 0) {
+        // map all buffers in one go, the server acks are pipelined
+        mm_camera_buf_map_t *bufMaps = (mm_camera_buf_map_t *)malloc(
+                registeredBuffers * sizeof(mm_camera_buf_map_t));
+        if (!bufMaps) {
+            ALOGE("%s: Out of memory", __func__);
+            return NO_MEMORY;
+        }
+        for (int i = 0; i < registeredBuffers; i++) {
+            bufMaps[i].frame_idx = i;
+            bufMaps[i].plane_idx = -1;
+            bufMaps[i].fd = mStreamBufs->getFd(i);
+            bufMaps[i].size = mStreamBufs->getSize(i);
+        }
+        rc = ops_tbl->bundled_map_ops(bufMaps, registeredBuffers,
+                ops_tbl->userdata);
+        free(bufMaps);
         if (rc < 0) {
+            // bundled map leaves no buffer mapped on failure
             ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
-            for (int j = 0; j < i; j++) {
-                ops_tbl->unmap_ops(j, -1, ops_tbl->userdata);
-            }
             return INVALID_OPERATION;
         }
     }
@@ -680,11 +699,31 @@ int32_t QCamera3Stream::getBufs(cam_frame_len_offset_t *offset,
 int32_t QCamera3Stream::putBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl)
 {
     int rc = NO_ERROR;
-    for (int i = 0; i < mNumBufs; i++) {
-        if (NULL != mBufDefs[i].mem_info) {
-            rc = ops_tbl->unmap_ops(i, -1, ops_tbl->userdata);
-            if (rc < 0) {
-                ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
+    int numMapped = 0;
+    mm_camera_buf_map_t *bufMaps =
+        (mm_camera_buf_map_t *)malloc(mNumBufs * sizeof(mm_camera_buf_map_t));
+    if (bufMaps) {
+        // only buffers registered so far are mapped
+        memset(bufMaps, 0, mNumBufs * sizeof(mm_camera_buf_map_t));
+        for (int i = 0; i < mNumBufs; i++) {
+            if (NULL != mBufDefs[i].mem_info) {
+                bufMaps[numMapped].frame_idx = i;
+                bufMaps[numMapped].plane_idx = -1;
+                numMapped++;
+            }
+        }
+        rc = ops_tbl->bundled_unmap_ops(bufMaps, numMapped, ops_tbl->userdata);
+        free(bufMaps);
+        if (rc < 0) {
+            ALOGE("%s: unmap_stream_buf failed: %d", __func__, rc);
+        }
+    } else {
+        for (int i = 0; i < mNumBufs; i++) {
+            if (NULL != mBufDefs[i].mem_info) {
+                rc = ops_tbl->unmap_ops(i, -1, ops_tbl->userdata);
+                if (rc < 0) {
+                    ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
+                }
             }
         }
     }
@@ -921,4 +960,22 @@ void QCamera3Stream::releaseFrameData(void *data, void *user_data)
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : dump
+ *
+ * DESCRIPTION: dump frame stats of the stream
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3Stream::dump(int fd)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "stream %d type %d", mHandle,
+             mStreamInfo != NULL ? mStreamInfo->stream_type : -1);
+    mStats.dump(fd, name);
+}
+
 }; // namespace qcamera
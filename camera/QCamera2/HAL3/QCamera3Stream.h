@@ -33,6 +33,7 @@
 #include <hardware/camera3.h>
 #include "QCameraCmdThread.h"
 #include "QCamera3Mem.h"
+#include "QCameraStreamStats.h"
 
 extern "C" {
 #include <mm_camera_interface.h>
@@ -83,6 +84,8 @@ public:
                    int32_t plane_idx, int fd, uint32_t size);
     int32_t unmapBuf(uint8_t buf_type, uint32_t buf_idx, int32_t plane_idx);
     int32_t setParameter(cam_stream_parm_buffer_t &param);
+    QCameraStreamStats &getStats() {return mStats;};
+    void dump(int fd);
 
     static void releaseFrameData(void *data, void *user_data);
 
@@ -107,6 +110,7 @@ private:
     cam_frame_len_offset_t mFrameLenOffset;
     cam_padding_info_t mPaddingInfo;
     QCamera3Channel *mChannel;
+    QCameraStreamStats mStats; // frame stats, always on
 
     static int32_t get_bufs(
                      cam_frame_len_offset_t *offset,
@@ -0,0 +1,148 @@
+/* Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __CAM_POOL_H__
+#define __CAM_POOL_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Fixed size element pool backed by one preallocated slab.
+ * Free elements are chained through their first word. When the slab is
+ * exhausted allocation falls back to the heap, and such elements are
+ * handed back to the heap on free, so a pool never fails harder than
+ * malloc would. hits/misses tell how often the slab was enough.
+ */
+
+typedef struct {
+    uint8_t *slab;         /* preallocated elements */
+    void *free_list;       /* chain of free elements in slab */
+    uint32_t elem_size;
+    uint32_t count;        /* num of elements in slab */
+    uint32_t hits;         /* allocs served from slab */
+    uint32_t misses;       /* allocs that fell back to heap */
+    pthread_mutex_t lock;
+} cam_pool_t;
+
+static inline int32_t cam_pool_init(cam_pool_t *pool,
+                                    uint32_t elem_size,
+                                    uint32_t count)
+{
+    uint32_t i;
+
+    memset(pool, 0, sizeof(cam_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+
+    /* keep every element aligned for the free list link */
+    if (elem_size < sizeof(void *)) {
+        elem_size = sizeof(void *);
+    }
+    elem_size = (elem_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    pool->elem_size = elem_size;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    pool->slab = (uint8_t *)malloc((size_t)elem_size * count);
+    if (NULL == pool->slab) {
+        /* every alloc will be a miss, still functional */
+        return -1;
+    }
+    pool->count = count;
+    for (i = 0; i < count; i++) {
+        void **elem = (void **)(pool->slab + (size_t)i * elem_size);
+        *elem = pool->free_list;
+        pool->free_list = elem;
+    }
+    return 0;
+}
+
+/* returns a zeroed element */
+static inline void *cam_pool_alloc(cam_pool_t *pool)
+{
+    void *elem = NULL;
+
+    if (pool->elem_size == 0) {
+        /* pool not initialized */
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (NULL != pool->free_list) {
+        elem = pool->free_list;
+        pool->free_list = *(void **)elem;
+        pool->hits++;
+    } else {
+        pool->misses++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (NULL == elem) {
+        return calloc(1, pool->elem_size);
+    }
+    memset(elem, 0, pool->elem_size);
+    return elem;
+}
+
+static inline void cam_pool_free(cam_pool_t *pool, void *elem)
+{
+    uint8_t *p = (uint8_t *)elem;
+
+    if (NULL == elem) {
+        return;
+    }
+
+    if (NULL == pool->slab ||
+        p < pool->slab ||
+        p >= pool->slab + (size_t)pool->elem_size * pool->count) {
+        /* heap fallback element */
+        free(elem);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    *(void **)elem = pool->free_list;
+    pool->free_list = elem;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* all slab elements must have been returned before deinit */
+static inline void cam_pool_deinit(cam_pool_t *pool)
+{
+    if (NULL != pool->slab) {
+        free(pool->slab);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    memset(pool, 0, sizeof(cam_pool_t));
+}
+
+#endif /* __CAM_POOL_H__ */
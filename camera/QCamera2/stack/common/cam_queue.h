@@ -28,6 +28,7 @@
  */
 
 #include "cam_list.h"
+#include "cam_pool.h"
 
 #include <stdlib.h>
 
@@ -40,6 +41,7 @@ typedef struct {
     cam_node_t head; /* dummy head */
     uint32_t size;
     pthread_mutex_t lock;
+    cam_pool_t node_pool; /* preallocated cam_node_t */
 } cam_queue_t;
 
 static inline int32_t cam_queue_init(cam_queue_t *queue)
@@ -47,18 +49,30 @@ static inline int32_t cam_queue_init(cam_queue_t *queue)
     pthread_mutex_init(&queue->lock, NULL);
     cam_list_init(&queue->head.list);
     queue->size = 0;
+    cam_pool_init(&queue->node_pool, sizeof(cam_node_t), 0);
+    return 0;
+}
+
+/* same as cam_queue_init, with num_nodes nodes preallocated so that
+ * enq/deq do not hit the heap as long as no more are pending */
+static inline int32_t cam_queue_init_with_pool(cam_queue_t *queue,
+                                               uint32_t num_nodes)
+{
+    pthread_mutex_init(&queue->lock, NULL);
+    cam_list_init(&queue->head.list);
+    queue->size = 0;
+    cam_pool_init(&queue->node_pool, sizeof(cam_node_t), num_nodes);
     return 0;
 }
 
 static inline int32_t cam_queue_enq(cam_queue_t *queue, void *data)
 {
     cam_node_t *node =
-        (cam_node_t *)malloc(sizeof(cam_node_t));
+        (cam_node_t *)cam_pool_alloc(&queue->node_pool);
     if (NULL == node) {
         return -1;
     }
 
-    memset(node, 0, sizeof(cam_node_t));
     node->data = data;
 
     pthread_mutex_lock(&queue->lock);
@@ -88,7 +102,7 @@ static inline void *cam_queue_deq(cam_queue_t *queue)
 
     if (NULL != node) {
         data = node->data;
-        free(node);
+        cam_pool_free(&queue->node_pool, node);
     }
 
     return data;
@@ -116,7 +130,7 @@ static inline int32_t cam_queue_flush(cam_queue_t *queue)
         if (NULL != node->data) {
             free(node->data);
         }
-        free(node);
+        cam_pool_free(&queue->node_pool, node);
 
     }
     queue->size = 0;
@@ -127,6 +141,7 @@ static inline int32_t cam_queue_flush(cam_queue_t *queue)
 static inline int32_t cam_queue_deinit(cam_queue_t *queue)
 {
     cam_queue_flush(queue);
+    cam_pool_deinit(&queue->node_pool);
     pthread_mutex_destroy(&queue->lock);
     return 0;
 }
@@ -0,0 +1,164 @@
+/* Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __CAM_RING_H__
+#define __CAM_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bounded single-producer/single-consumer ring of pointers.
+ * Exactly one thread may enqueue and exactly one thread may dequeue at a
+ * time; no lock is taken on either side. head is only written by the
+ * consumer and tail only by the producer, and each side keeps its own
+ * cached copy of the other index so that it only touches the peer's
+ * cache line when the ring looks full (or empty). Indices run freely and
+ * are masked on access, so capacity must be a power of 2 and all of it is
+ * usable. Slot storage is owned by the caller.
+ */
+
+#define CAM_RING_CACHE_LINE 64
+
+typedef struct {
+    /* consumer side */
+    uint32_t head __attribute__((aligned(CAM_RING_CACHE_LINE)));
+    uint32_t tail_cache;
+    /* producer side */
+    uint32_t tail __attribute__((aligned(CAM_RING_CACHE_LINE)));
+    uint32_t head_cache;
+    /* read only after init */
+    void **slots __attribute__((aligned(CAM_RING_CACHE_LINE)));
+    uint32_t mask;
+} cam_ring_t;
+
+/* capacity must be a power of 2, slots must hold capacity entries */
+static inline int32_t cam_ring_init(cam_ring_t *ring,
+                                    void **slots,
+                                    uint32_t capacity)
+{
+    if (NULL == slots || capacity == 0 || (capacity & (capacity - 1))) {
+        return -1;
+    }
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->tail = 0;
+    ring->head_cache = 0;
+    ring->slots = slots;
+    ring->mask = capacity - 1;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return 0;
+}
+
+/* drops all entries, neither side may be active */
+static inline void cam_ring_reset(cam_ring_t *ring)
+{
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->tail = 0;
+    ring->head_cache = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* producer only, returns -1 if the ring is full */
+static inline int32_t cam_ring_enq(cam_ring_t *ring, void *data)
+{
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    if (tail - ring->head_cache > ring->mask) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - ring->head_cache > ring->mask) {
+            return -1;
+        }
+    }
+    ring->slots[tail & ring->mask] = data;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* consumer only, returns -1 if the ring is empty */
+static inline int32_t cam_ring_deq(cam_ring_t *ring, void **data)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    if (head == ring->tail_cache) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head == ring->tail_cache) {
+            return -1;
+        }
+    }
+    *data = ring->slots[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* consumer only, dequeues up to max entries at once and returns the
+ * number taken; a single release store hands all slots back */
+static inline uint32_t cam_ring_deq_batch(cam_ring_t *ring,
+                                          void **data,
+                                          uint32_t max)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t avail;
+    uint32_t i;
+
+    ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    avail = ring->tail_cache - head;
+    if (avail > max) {
+        avail = max;
+    }
+    for (i = 0; i < avail; i++) {
+        data[i] = ring->slots[(head + i) & ring->mask];
+    }
+    if (avail > 0) {
+        __atomic_store_n(&ring->head, head + avail, __ATOMIC_RELEASE);
+    }
+    return avail;
+}
+
+/* snapshot, exact only when called from one of the two sides while the
+ * other is idle */
+static inline uint32_t cam_ring_count(cam_ring_t *ring)
+{
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    return tail - head;
+}
+
+#define cam_ring_empty(ring) (cam_ring_count(ring) == 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAM_RING_H__ */
@@ -30,52 +30,137 @@
 #ifndef __QCAMERA_SEMAPHORE_H__
 #define __QCAMERA_SEMAPHORE_H__
 
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Implement semaphore with mutex and conditional variable.
- * Reason being, POSIX semaphore on Android are not used or
- * well tested.
+/* Counting semaphore built directly on a futex.
+ * val is the count, waiters the number of threads sleeping in the kernel.
+ * post only enters the kernel if somebody is asleep, and wait only enters
+ * it if the count is zero, so the uncontended paths are a single atomic op.
+ * POSIX semaphores on Android are not used for the same reason as before:
+ * they are not well tested there.
  */
 
 typedef struct {
     int val;
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
+    int waiters;
 } cam_semaphore_t;
 
+static inline int cam_futex(int *uaddr, int op, int val,
+                            const struct timespec *timeout)
+{
+    return (int)syscall(__NR_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
 static inline void cam_sem_init(cam_semaphore_t *s, int n)
 {
-    pthread_mutex_init(&(s->mutex), NULL);
-    pthread_cond_init(&(s->cond), NULL);
-    s->val = n;
+    __atomic_store_n(&s->waiters, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->val, n, __ATOMIC_RELEASE);
+}
+
+/* post n counts at once, waking up to n waiters with a single syscall */
+static inline void cam_sem_post_n(cam_semaphore_t *s, int n)
+{
+    if (n <= 0) {
+        return;
+    }
+    __atomic_fetch_add(&s->val, n, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST) > 0) {
+        cam_futex(&s->val, FUTEX_WAKE_PRIVATE, n, NULL);
+    }
 }
 
 static inline void cam_sem_post(cam_semaphore_t *s)
 {
-    pthread_mutex_lock(&(s->mutex));
-    s->val++;
-    pthread_cond_signal(&(s->cond));
-    pthread_mutex_unlock(&(s->mutex));
+    cam_sem_post_n(s, 1);
+}
+
+/* take one count without blocking, return 0 on success */
+static inline int cam_sem_trywait(cam_semaphore_t *s)
+{
+    int v = __atomic_load_n(&s->val, __ATOMIC_RELAXED);
+    while (v > 0) {
+        if (__atomic_compare_exchange_n(&s->val, &v, v - 1, 1,
+                                        __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            return 0;
+        }
+    }
+    return EAGAIN;
+}
+
+static inline int cam_sem_timespec_remaining(const struct timespec *deadline,
+                                             struct timespec *remaining)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    remaining->tv_sec = deadline->tv_sec - now.tv_sec;
+    remaining->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (remaining->tv_nsec < 0) {
+        remaining->tv_sec--;
+        remaining->tv_nsec += 1000000000L;
+    }
+    return remaining->tv_sec >= 0;
+}
+
+/* wait for one count. rel_timeout is an interval, NULL waits forever.
+ * return 0 on success, ETIMEDOUT if the interval elapsed first */
+static inline int cam_sem_timedwait(cam_semaphore_t *s,
+                                    const struct timespec *rel_timeout)
+{
+    struct timespec deadline, remaining;
+
+    if (0 == cam_sem_trywait(s)) {
+        return 0;
+    }
+
+    if (NULL != rel_timeout) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += rel_timeout->tv_sec;
+        deadline.tv_nsec += rel_timeout->tv_nsec;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    for (;;) {
+        if (NULL != rel_timeout &&
+            !cam_sem_timespec_remaining(&deadline, &remaining)) {
+            return ETIMEDOUT;
+        }
+
+        __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+        /* sleeps only if val is still 0, so a post racing with us is
+         * either seen here or wakes us up */
+        if (__atomic_load_n(&s->val, __ATOMIC_SEQ_CST) <= 0) {
+            cam_futex(&s->val, FUTEX_WAIT_PRIVATE, 0,
+                      (NULL != rel_timeout) ? &remaining : NULL);
+        }
+        __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_SEQ_CST);
+
+        if (0 == cam_sem_trywait(s)) {
+            return 0;
+        }
+    }
 }
 
 static inline int cam_sem_wait(cam_semaphore_t *s)
 {
-    int rc = 0;
-    pthread_mutex_lock(&(s->mutex));
-    while (s->val == 0)
-        rc = pthread_cond_wait(&(s->cond), &(s->mutex));
-    s->val--;
-    pthread_mutex_unlock(&(s->mutex));
-    return rc;
+    return cam_sem_timedwait(s, NULL);
 }
 
 static inline void cam_sem_destroy(cam_semaphore_t *s)
 {
-    pthread_mutex_destroy(&(s->mutex));
-    pthread_cond_destroy(&(s->cond));
-    s->val = 0;
+    __atomic_store_n(&s->val, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->waiters, 0, __ATOMIC_RELAXED);
 }
 
 #ifdef __cplusplus
@@ -151,17 +151,61 @@ typedef int32_t (*unmap_stream_buf_op_t) (uint32_t frame_idx,
                                           int32_t plane_idx,
                                           void *userdata);
 
+/** mm_camera_buf_map_t: info of one stream buffer in a bundled
+*                        map/unmap request
+*    @frame_idx : buffer index within stream buffers
+*    @plane_idx : plane index. If all planes share the same
+*                 fd, plane_idx = -1; otherwise, plean_idx is
+*                 the index to plane (0..num_of_planes)
+*    @fd : file descriptor of the stream buffer, ignored for unmapping
+*    @size: size of the stream buffer, ignored for unmapping
+**/
+typedef struct {
+    uint32_t frame_idx;
+    int32_t plane_idx;
+    int fd;
+    uint32_t size;
+} mm_camera_buf_map_t;
+
+/** bundled_map_stream_buf_op_t: function definition for operation
+*                                of mapping a set of stream buffers
+*                                via domain socket in one go. On
+*                                failure none of the buffers is left
+*                                mapped.
+*    @bufs : array of buffers to be mapped
+*    @num_bufs : number of entries in bufs
+*    @userdata : user data pointer
+**/
+typedef int32_t (*bundled_map_stream_buf_op_t) (const mm_camera_buf_map_t *bufs,
+                                                uint32_t num_bufs,
+                                                void *userdata);
+
+/** bundled_unmap_stream_buf_op_t: function definition for operation
+*                                  of unmapping a set of stream
+*                                  buffers via domain socket in one go
+*    @bufs : array of buffers to be unmapped
+*    @num_bufs : number of entries in bufs
+*    @userdata : user data pointer
+**/
+typedef int32_t (*bundled_unmap_stream_buf_op_t) (const mm_camera_buf_map_t *bufs,
+                                                  uint32_t num_bufs,
+                                                  void *userdata);
+
 /** mm_camera_map_unmap_ops_tbl_t: virtual table
 *                      for mapping/unmapping stream buffers via
 *                      domain socket
 *    @map_ops : operation for mapping
 *    @unmap_ops : operation for unmapping
 *    @userdata: user data pointer
+*    @bundled_map_ops : operation for mapping a set of buffers
+*    @bundled_unmap_ops : operation for unmapping a set of buffers
 **/
 typedef struct {
     map_stream_buf_op_t map_ops;
     unmap_stream_buf_op_t unmap_ops;
     void *userdata;
+    bundled_map_stream_buf_op_t bundled_map_ops;
+    bundled_unmap_stream_buf_op_t bundled_unmap_ops;
 } mm_camera_map_unmap_ops_tbl_t;
 
 /** mm_camera_stream_mem_vtbl_t: virtual table for stream
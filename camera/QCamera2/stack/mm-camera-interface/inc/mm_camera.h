@@ -44,6 +44,14 @@
 /* num of data poll threads allowed in a channel obj */
 #define MM_CAMERA_CHANNEL_POLL_THREAD_MAX 1
 
+/* num of preallocated cmd nodes for the evt cmd thread */
+#define MM_CAMERA_EVT_CMD_POOL_SIZE 8
+
+/* max num of map/unmap msgs in flight on domain socket before waiting for
+ * acks. Acks come back as v4l2 events, so keep it well below the depth of
+ * the kernel event queue to not lose any of them */
+#define MM_CAMERA_MAP_PIPELINE_DEPTH 4
+
 #define MM_CAMERA_DEV_NAME_LEN 32
 #define MM_CAMERA_DEV_OPEN_TRIES 20
 #define MM_CAMERA_DEV_OPEN_RETRY_SLEEP 20
@@ -102,6 +110,7 @@ typedef struct {
     cam_semaphore_t cmd_sem;     /* semaphore for cmd thread */
     mm_camera_cmd_cb_t cb;       /* cb for cmd */
     void* user_data;             /* user_data for cb */
+    cam_pool_t cmd_pool;         /* preallocated mm_camera_cmdcb_t */
 } mm_camera_cmd_thread_t;
 
 typedef enum {
@@ -127,13 +136,17 @@ typedef struct {
      * for MM_CAMERA_POLL_TYPE_EVT, only index 0 is valid;
      * for MM_CAMERA_POLL_TYPE_DATA, depends on valid stream fd */
     mm_camera_poll_entry_t poll_entries[MAX_STREAM_NUM_IN_BUNDLE];
-    int32_t pfds[2];
+    /* fd of each entry as currently registered in the epoll set,
+     * -1 if the entry is not registered */
+    int32_t epoll_reg_fds[MAX_STREAM_NUM_IN_BUNDLE];
+    int32_t epoll_fd;            /* epoll instance watching entry fds + evt_fd */
+    int32_t evt_fd;              /* eventfd to wake up poll thread for cmds */
     pthread_t pid;
     int32_t state;
     int timeoutms;
-    uint32_t cmd;
-    struct pollfd poll_fds[MAX_STREAM_NUM_IN_BUNDLE + 1];
-    uint8_t num_fds;
+    uint32_t pending_cmds;       /* bitmask of pending cmds, protected by mutex */
+    uint32_t cmd_seq;            /* seq of last cmd sent, protected by mutex */
+    uint32_t done_seq;           /* seq of last cmd handled, protected by mutex */
     pthread_mutex_t mutex;
     pthread_cond_t cond_v;
     int32_t status;
@@ -296,16 +309,26 @@ typedef struct {
     mm_camera_buf_info_t super_buf[MAX_STREAM_NUM_IN_BUNDLE];
     uint8_t matched;
     uint32_t frame_idx;
+    uint32_t arrived_mask;   /* bit i set once super_buf[i] is filled */
+    struct cam_list list;    /* link in unmatched list while not matched */
 } mm_channel_queue_node_t;
 
 typedef struct {
-    cam_queue_t que;
+    cam_queue_t que;         /* matched superbufs, in frame order */
     uint8_t num_streams;
     /* container for bundled stream handlers */
     uint32_t bundled_streams[MAX_STREAM_NUM_IN_BUNDLE];
     mm_camera_channel_attr_t attr;
     uint32_t expected_frame_id;
     uint32_t match_cnt;
+    cam_pool_t superbuf_pool; /* preallocated mm_channel_queue_node_t */
+    /* unmatched superbufs, all newer than any matched one. Kept both in
+     * a list ordered by frame_idx and in slots indexed by
+     * frame_idx & unmatched_mask for O(1) lookup */
+    struct cam_list unmatched_list;
+    mm_channel_queue_node_t **unmatched_slots;
+    uint32_t unmatched_mask;
+    uint32_t unmatched_cnt;
 } mm_channel_queue_t;
 
 typedef struct {
@@ -382,6 +405,8 @@ typedef struct mm_camera_obj {
     pthread_mutex_t evt_lock;
     pthread_cond_t evt_cond;
     mm_camera_event_t evt_rcvd;
+    uint32_t map_acks;        /* map/unmap done acks recvd, under evt_lock */
+    int32_t map_status;       /* first failure status among acks, under evt_lock */
 
     pthread_mutex_t msg_lock; /* lock for sending msg through socket */
 } mm_camera_obj_t;
@@ -416,6 +441,12 @@ extern int32_t mm_camera_util_sendmsg(mm_camera_obj_t *my_obj,
                                       void *msg,
                                       uint32_t buf_size,
                                       int sendfd);
+/* send a set of msgs throught domain socket for fd mapping, pipelined */
+extern int32_t mm_camera_util_bundled_sendmsg(mm_camera_obj_t *my_obj,
+                                              void *msgs,
+                                              uint32_t buf_size,
+                                              uint32_t num_msgs,
+                                              int *sendfds);
 /* Check if hardware target is A family */
 uint8_t mm_camera_util_chip_is_a_family(void);
 
@@ -574,7 +605,10 @@ extern int32_t mm_camera_poll_thread_commit_updates(
 extern int32_t mm_camera_cmd_thread_launch(
                                 mm_camera_cmd_thread_t * cmd_thread,
                                 mm_camera_cmd_cb_t cb,
-                                void* user_data);
+                                void* user_data,
+                                uint32_t pool_size);
+extern mm_camera_cmdcb_t *mm_camera_cmd_thread_alloc_cmd(
+                                mm_camera_cmd_thread_t * cmd_thread);
 extern int32_t mm_camera_cmd_thread_name(const char* name);
 extern int32_t mm_camera_cmd_thread_release(mm_camera_cmd_thread_t * cmd_thread);
 
@@ -161,9 +161,12 @@ static void mm_camera_event_notify(void* user_data)
             msm_evt = (struct msm_v4l2_event_data *)ev.u.data;
             switch (msm_evt->command) {
             case CAM_EVENT_TYPE_MAP_UNMAP_DONE:
+                /* acks come back in the order the msgs were sent */
                 pthread_mutex_lock(&my_obj->evt_lock);
-                my_obj->evt_rcvd.server_event_type = msm_evt->command;
-                my_obj->evt_rcvd.status = msm_evt->status;
+                my_obj->map_acks++;
+                if (MSM_CAMERA_STATUS_SUCCESS == my_obj->map_status) {
+                    my_obj->map_status = msm_evt->status;
+                }
                 pthread_cond_signal(&my_obj->evt_cond);
                 pthread_mutex_unlock(&my_obj->evt_lock);
                 break;
@@ -200,9 +203,8 @@ int32_t mm_camera_enqueue_evt(mm_camera_obj_t *my_obj,
     int32_t rc = 0;
     mm_camera_cmdcb_t *node = NULL;
 
-    node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+    node = mm_camera_cmd_thread_alloc_cmd(&my_obj->evt_thread);
     if (NULL != node) {
-        memset(node, 0, sizeof(mm_camera_cmdcb_t));
         node->cmd_type = MM_CAMERA_CMD_TYPE_EVT_CB;
         node->u.evt = *event;
 
@@ -296,7 +298,8 @@ int32_t mm_camera_open(mm_camera_obj_t *my_obj)
     CDBG("%s : Launch evt Thread in Cam Open",__func__);
     mm_camera_cmd_thread_launch(&my_obj->evt_thread,
                                 mm_camera_dispatch_app_event,
-                                (void *)my_obj);
+                                (void *)my_obj,
+                                MM_CAMERA_EVT_CMD_POOL_SIZE);
 
     /* launch event poll thread
      * we will add evt fd into event poll thread upon user first register for evt */
@@ -1497,18 +1500,92 @@ int32_t mm_camera_util_sendmsg(mm_camera_obj_t *my_obj,
                                uint32_t buf_size,
                                int sendfd)
 {
-    int32_t rc = -1;
-    int32_t status;
+    return mm_camera_util_bundled_sendmsg(my_obj, msg, buf_size, 1, &sendfd);
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_camera_util_wait_for_map_acks
+ *
+ * DESCRIPTION: utility function to wait until at least acks map/unmap done
+ *              events are received. Must be called with evt_lock held.
+ *
+ * PARAMETERS :
+ *   @my_obj       : camera object
+ *   @acks         : num of acks to wait for
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_camera_util_wait_for_map_acks(mm_camera_obj_t *my_obj,
+                                             uint32_t acks)
+{
+    while (my_obj->map_acks < acks) {
+        pthread_cond_wait(&my_obj->evt_cond, &my_obj->evt_lock);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_camera_util_bundled_sendmsg
+ *
+ * DESCRIPTION: utility function to send a set of msgs via domain socket.
+ *              Msgs are pipelined: up to MM_CAMERA_MAP_PIPELINE_DEPTH of
+ *              them are in flight before waiting for map/unmap done acks,
+ *              and the call returns once all sent msgs are acked.
+ *
+ * PARAMETERS :
+ *   @my_obj       : camera object
+ *   @msgs         : array of messages to be sent
+ *   @buf_size     : size of each message
+ *   @num_msgs     : num of messages in msgs
+ *   @sendfds      : array of fds to be passed with each message,
+ *                   >0 if any file descriptor need to be passed across process
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure, including any of the msgs acked with failure
+ *==========================================================================*/
+int32_t mm_camera_util_bundled_sendmsg(mm_camera_obj_t *my_obj,
+                                       void *msgs,
+                                       uint32_t buf_size,
+                                       uint32_t num_msgs,
+                                       int *sendfds)
+{
+    int32_t rc = 0;
+    uint32_t sent = 0;
+    uint8_t *msg = (uint8_t *)msgs;
 
     /* need to lock msg_lock, since sendmsg until reposonse back is deemed as one operation*/
     pthread_mutex_lock(&my_obj->msg_lock);
-    if(mm_camera_socket_sendmsg(my_obj->ds_fd, msg, buf_size, sendfd) > 0) {
-        /* wait for event that mapping/unmapping is done */
-        mm_camera_util_wait_for_event(my_obj, CAM_EVENT_TYPE_MAP_UNMAP_DONE, &status);
-        if (MSM_CAMERA_STATUS_SUCCESS == status) {
-            rc = 0;
+
+    pthread_mutex_lock(&my_obj->evt_lock);
+    my_obj->map_acks = 0;
+    my_obj->map_status = MSM_CAMERA_STATUS_SUCCESS;
+    pthread_mutex_unlock(&my_obj->evt_lock);
+
+    for (sent = 0; sent < num_msgs; sent++) {
+        if (sent >= MM_CAMERA_MAP_PIPELINE_DEPTH) {
+            /* keep the window of unacked msgs bounded */
+            pthread_mutex_lock(&my_obj->evt_lock);
+            mm_camera_util_wait_for_map_acks(my_obj,
+                sent - MM_CAMERA_MAP_PIPELINE_DEPTH + 1);
+            pthread_mutex_unlock(&my_obj->evt_lock);
         }
+        if (mm_camera_socket_sendmsg(my_obj->ds_fd, msg + sent * buf_size,
+                                     buf_size, sendfds[sent]) <= 0) {
+            CDBG_ERROR("%s: sendmsg failed for msg %d of %d",
+                       __func__, sent, num_msgs);
+            rc = -1;
+            break;
+        }
+    }
+
+    /* wait for event that mapping/unmapping is done for all sent msgs */
+    pthread_mutex_lock(&my_obj->evt_lock);
+    mm_camera_util_wait_for_map_acks(my_obj, sent);
+    if (MSM_CAMERA_STATUS_SUCCESS != my_obj->map_status) {
+        rc = -1;
     }
+    pthread_mutex_unlock(&my_obj->evt_lock);
+
     pthread_mutex_unlock(&my_obj->msg_lock);
     return rc;
 }
@@ -100,12 +100,15 @@ int32_t mm_channel_fsm_fn_paused(mm_channel_t *my_obj,
                           void * out_val);
 
 /* channel super queue functions */
-int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue);
+int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue,
+                                       uint32_t pool_size);
 int32_t mm_channel_superbuf_queue_deinit(mm_channel_queue_t * queue);
 int32_t mm_channel_superbuf_comp_and_enqueue(mm_channel_t *ch_obj,
                                              mm_channel_queue_t * queue,
                                              mm_camera_buf_info_t *buf);
 mm_channel_queue_node_t* mm_channel_superbuf_dequeue(mm_channel_queue_t * queue);
+mm_channel_queue_node_t* mm_channel_superbuf_dequeue_internal(mm_channel_queue_t * queue,
+                                                              uint8_t matched_only);
 int32_t mm_channel_superbuf_bufdone_overflow(mm_channel_t *my_obj,
                                              mm_channel_queue_t *queue);
 int32_t mm_channel_superbuf_skip(mm_channel_t *my_obj,
@@ -242,9 +245,8 @@ static void mm_channel_process_stream_buf(mm_camera_cmdcb_t * cmd_cb,
                      __func__, ch_obj->pending_cnt);
 
                 /* send cam_sem_post to wake up cb thread to dispatch super buffer */
-                cb_node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+                cb_node = mm_camera_cmd_thread_alloc_cmd(&ch_obj->cb_thread);
                 if (NULL != cb_node) {
-                    memset(cb_node, 0, sizeof(mm_camera_cmdcb_t));
                     cb_node->cmd_type = MM_CAMERA_CMD_TYPE_SUPER_BUF_DATA_CB;
                     cb_node->u.superbuf.num_bufs = node->num_of_bufs;
                     for (i=0; i<node->num_of_bufs; i++) {
@@ -272,7 +274,7 @@ static void mm_channel_process_stream_buf(mm_camera_cmdcb_t * cmd_cb,
                     mm_channel_qbuf(ch_obj, node->super_buf[i].buf);
                 }
             }
-            free(node);
+            cam_pool_free(&ch_obj->bundle.superbuf_queue.superbuf_pool, node);
         } else {
             /* no superbuf avail, break the loop */
             break;
@@ -869,6 +871,7 @@ int32_t mm_channel_start(mm_channel_t *my_obj)
     uint8_t num_streams_to_start = 0;
     mm_stream_t *s_obj = NULL;
     int meta_stream_idx = 0;
+    uint32_t pool_size = 0;
 
     for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
         if (my_obj->streams[i].my_hdl > 0) {
@@ -892,9 +895,25 @@ int32_t mm_channel_start(mm_channel_t *my_obj)
     }
 
     if (NULL != my_obj->bundle.super_buf_notify_cb) {
+        /* size node pools by the bufs of all bundled streams, fall back to
+         * max num of frames if stream has not told its buf count yet */
+        for (i = 0; i < num_streams_to_start; i++) {
+            if (NULL != s_objs[i]->stream_info &&
+                s_objs[i]->stream_info->num_bufs > 0) {
+                pool_size += s_objs[i]->stream_info->num_bufs;
+            } else {
+                pool_size += MM_CAMERA_MAX_NUM_FRAMES;
+            }
+        }
+
         /* need to send up cb, therefore launch thread */
         /* init superbuf queue */
-        mm_channel_superbuf_queue_init(&my_obj->bundle.superbuf_queue);
+        rc = mm_channel_superbuf_queue_init(&my_obj->bundle.superbuf_queue,
+                                            pool_size);
+        if (rc < 0) {
+            CDBG_ERROR("%s: init superbuf queue failed", __func__);
+            return rc;
+        }
         my_obj->bundle.superbuf_queue.num_streams = num_streams_to_start;
         my_obj->bundle.superbuf_queue.expected_frame_id = 0;
 
@@ -908,12 +927,14 @@ int32_t mm_channel_start(mm_channel_t *my_obj)
         /* launch cb thread for dispatching super buf through cb */
         mm_camera_cmd_thread_launch(&my_obj->cb_thread,
                                     mm_channel_dispatch_super_buf,
-                                    (void*)my_obj);
+                                    (void*)my_obj,
+                                    pool_size);
 
         /* launch cmd thread for super buf dataCB */
         mm_camera_cmd_thread_launch(&my_obj->cmd_thread,
                                     mm_channel_process_stream_buf,
-                                    (void*)my_obj);
+                                    (void*)my_obj,
+                                    pool_size);
 
         /* set flag to TRUE */
         my_obj->bundle.is_active = TRUE;
@@ -1088,9 +1109,8 @@ int32_t mm_channel_request_super_buf(mm_channel_t *my_obj, uint32_t num_buf_requ
     /* set pending_cnt
      * will trigger dispatching super frames if pending_cnt > 0 */
     /* send cam_sem_post to wake up cmd thread to dispatch super buffer */
-    node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+    node = mm_camera_cmd_thread_alloc_cmd(&my_obj->cmd_thread);
     if (NULL != node) {
-        memset(node, 0, sizeof(mm_camera_cmdcb_t));
         node->cmd_type = MM_CAMERA_CMD_TYPE_REQ_DATA_CB;
         node->u.req_buf.num_buf_requested = num_buf_requested;
 
@@ -1146,9 +1166,8 @@ int32_t mm_channel_flush_super_buf_queue(mm_channel_t *my_obj, uint32_t frame_id
     int32_t rc = 0;
     mm_camera_cmdcb_t* node = NULL;
 
-    node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+    node = mm_camera_cmd_thread_alloc_cmd(&my_obj->cmd_thread);
     if (NULL != node) {
-        memset(node, 0, sizeof(mm_camera_cmdcb_t));
         node->cmd_type = MM_CAMERA_CMD_TYPE_FLUSH_QUEUE;
         node->u.frame_idx = frame_idx;
 
@@ -1184,9 +1203,8 @@ int32_t mm_channel_config_notify_mode(mm_channel_t *my_obj,
     int32_t rc = 0;
     mm_camera_cmdcb_t* node = NULL;
 
-    node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+    node = mm_camera_cmd_thread_alloc_cmd(&my_obj->cmd_thread);
     if (NULL != node) {
-        memset(node, 0, sizeof(mm_camera_cmdcb_t));
         node->u.notify_mode = notify_mode;
         node->cmd_type = MM_CAMERA_CMD_TYPE_CONFIG_NOTIFY;
 
@@ -1399,14 +1417,39 @@ int32_t mm_channel_unmap_stream_buf(mm_channel_t *my_obj,
  *
  * PARAMETERS :
  *   @queue   : ptr to superbuf queue to be initialized
+ *   @pool_size : num of superbufs to be preallocated. Should cover all
+ *                buffers of bundled streams, as each pending superbuf
+ *                holds at least one of them.
  *
  * RETURN     : int32_t type of status
  *              0  -- success
  *              -1 -- failure
  *==========================================================================*/
-int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue)
+int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue,
+                                       uint32_t pool_size)
 {
-    return cam_queue_init(&queue->que);
+    uint32_t window = 4;
+
+    /* slots must cover the unmatched frames plus the incoming one with
+     * room for gaps in frame_idx; keep it a power of 2 for masking */
+    while (window < 2 * ((uint32_t)queue->attr.max_unmatched_frames + 1)) {
+        window <<= 1;
+    }
+    queue->unmatched_slots =
+        (mm_channel_queue_node_t **)malloc(window * sizeof(mm_channel_queue_node_t *));
+    if (NULL == queue->unmatched_slots) {
+        CDBG_ERROR("%s: No memory for %d unmatched slots", __func__, window);
+        return -1;
+    }
+    memset(queue->unmatched_slots, 0, window * sizeof(mm_channel_queue_node_t *));
+    queue->unmatched_mask = window - 1;
+    queue->unmatched_cnt = 0;
+    cam_list_init(&queue->unmatched_list);
+
+    cam_pool_init(&queue->superbuf_pool,
+                  sizeof(mm_channel_queue_node_t),
+                  pool_size);
+    return cam_queue_init_with_pool(&queue->que, pool_size);
 }
 
 /*===========================================================================
@@ -1423,7 +1466,28 @@ int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue)
  *==========================================================================*/
 int32_t mm_channel_superbuf_queue_deinit(mm_channel_queue_t * queue)
 {
-    return cam_queue_deinit(&queue->que);
+    int32_t rc = 0;
+    mm_channel_queue_node_t* super_buf = NULL;
+
+    /* superbufs belong to the pool, cannot be freed by cam_queue_flush */
+    pthread_mutex_lock(&queue->que.lock);
+    super_buf = mm_channel_superbuf_dequeue_internal(queue, FALSE);
+    while (super_buf != NULL) {
+        cam_pool_free(&queue->superbuf_pool, super_buf);
+        super_buf = mm_channel_superbuf_dequeue_internal(queue, FALSE);
+    }
+    pthread_mutex_unlock(&queue->que.lock);
+
+    CDBG_HIGH("%s: superbuf pool hits %d misses %d, node pool hits %d misses %d",
+              __func__,
+              queue->superbuf_pool.hits, queue->superbuf_pool.misses,
+              queue->que.node_pool.hits, queue->que.node_pool.misses);
+
+    rc = cam_queue_deinit(&queue->que);
+    cam_pool_deinit(&queue->superbuf_pool);
+    free(queue->unmatched_slots);
+    queue->unmatched_slots = NULL;
+    return rc;
 }
 
 /*===========================================================================
@@ -1534,6 +1598,108 @@ end:
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_unmatched_del
+ *
+ * DESCRIPTION: remove a superbuf from unmatched list and slots. Must be
+ *              called with queue lock held.
+ *
+ * PARAMETERS :
+ *   @queue     : superbuf queue
+ *   @super_buf : unmatched superbuf to be removed
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_unmatched_del(mm_channel_queue_t *queue,
+                                              mm_channel_queue_node_t *super_buf)
+{
+    uint32_t slot = super_buf->frame_idx & queue->unmatched_mask;
+
+    if (queue->unmatched_slots[slot] == super_buf) {
+        queue->unmatched_slots[slot] = NULL;
+    }
+    cam_list_del_node(&super_buf->list);
+    queue->unmatched_cnt--;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_unmatched_release
+ *
+ * DESCRIPTION: remove an unmatched superbuf from queue and return its
+ *              arrived bufs to kernel. Must be called with queue lock held.
+ *
+ * PARAMETERS :
+ *   @ch_obj    : channel object
+ *   @queue     : superbuf queue
+ *   @super_buf : unmatched superbuf to be released
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_unmatched_release(mm_channel_t *ch_obj,
+                                                  mm_channel_queue_t *queue,
+                                                  mm_channel_queue_node_t *super_buf)
+{
+    uint8_t i;
+
+    mm_channel_superbuf_unmatched_del(queue, super_buf);
+    for (i = 0; i < super_buf->num_of_bufs; i++) {
+        if (super_buf->arrived_mask & (1U << i)) {
+            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
+        }
+    }
+    cam_pool_free(&queue->superbuf_pool, super_buf);
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_matched_enq
+ *
+ * DESCRIPTION: append a matched superbuf to the matched queue. Must be
+ *              called with queue lock held.
+ *
+ * PARAMETERS :
+ *   @ch_obj    : channel object
+ *   @queue     : superbuf queue
+ *   @super_buf : matched superbuf
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_matched_enq(mm_channel_t *ch_obj,
+                                            mm_channel_queue_t *queue,
+                                            mm_channel_queue_node_t *super_buf)
+{
+    uint8_t i;
+    cam_node_t *node = NULL;
+    struct cam_list *head = &queue->que.head.list;
+    struct cam_list *pos = head->prev;
+
+    node = (cam_node_t *)cam_pool_alloc(&queue->que.node_pool);
+    if (NULL == node) {
+        /* No memory, qbuf the superbuf since we cannot enqueue */
+        for (i = 0; i < super_buf->num_of_bufs; i++) {
+            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
+        }
+        cam_pool_free(&queue->superbuf_pool, super_buf);
+        return;
+    }
+    node->data = (void *)super_buf;
+
+    /* normally newest, only step back if expected frame id was rewound */
+    while (pos != head) {
+        mm_channel_queue_node_t *tail =
+            (mm_channel_queue_node_t *)member_of(pos, cam_node_t, list)->data;
+        if (tail->frame_idx <= super_buf->frame_idx) {
+            break;
+        }
+        pos = pos->prev;
+    }
+    cam_list_insert_before_node(&node->list, pos->next);
+    queue->que.size++;
+
+    super_buf->matched = 1;
+    queue->expected_frame_id = super_buf->frame_idx + queue->attr.post_frame_skip;
+    queue->match_cnt++;
+}
+
 /*===========================================================================
  * FUNCTION   : mm_channel_superbuf_comp_and_enqueue
  *
@@ -1553,12 +1719,11 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                         mm_channel_queue_t *queue,
                         mm_camera_buf_info_t *buf_info)
 {
-    cam_node_t* node = NULL;
-    struct cam_list *head = NULL;
-    struct cam_list *pos = NULL;
     mm_channel_queue_node_t* super_buf = NULL;
-    uint8_t buf_s_idx, i, found_super_buf, unmatched_bundles;
-    struct cam_list *last_buf, *insert_before_buf;
+    mm_channel_queue_node_t* oldest = NULL;
+    uint8_t buf_s_idx;
+    uint32_t all_mask;
+    uint32_t slot;
 
     CDBG("%s: E", __func__);
     for (buf_s_idx = 0; buf_s_idx < queue->num_streams; buf_s_idx++) {
@@ -1588,148 +1753,96 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
          * if frame not to be queued, we need to qbuf it back */
     }
 
+    all_mask = (1U << queue->num_streams) - 1;
+    slot = buf_info->frame_idx & queue->unmatched_mask;
+
     /* comp */
     pthread_mutex_lock(&queue->que.lock);
-    head = &queue->que.head.list;
-    /* get the last one in the queue which is possibly having no matching */
-    pos = head->next;
+    super_buf = queue->unmatched_slots[slot];
 
-    found_super_buf = 0;
-    unmatched_bundles = 0;
-    last_buf = NULL;
-    insert_before_buf = NULL;
-    while (pos != head) {
-        node = member_of(pos, cam_node_t, list);
-        super_buf = (mm_channel_queue_node_t*)node->data;
-        if (NULL != super_buf) {
-            if (super_buf->matched) {
-                /* find a matched super buf, move to next one */
-                pos = pos->next;
-                continue;
-            } else if ( buf_info->frame_idx == super_buf->frame_idx ) {
-                /* have an unmatched super buf that matches our frame idx,
-                 *  break the loop */
-                found_super_buf = 1;
-                break;
-            } else {
-                unmatched_bundles++;
-                if ( NULL == last_buf ) {
-                    if ( super_buf->frame_idx < buf_info->frame_idx ) {
-                        last_buf = pos;
-                    }
-                }
-                if ( NULL == insert_before_buf ) {
-                    if ( super_buf->frame_idx > buf_info->frame_idx ) {
-                        insert_before_buf = pos;
-                    }
-                }
-                pos = pos->next;
-            }
+    if ((NULL != super_buf) && (super_buf->frame_idx == buf_info->frame_idx)) {
+        /* have an unmatched super buf that matches our frame idx */
+        if (super_buf->arrived_mask & (1U << buf_s_idx)) {
+            /* same stream delivered this frame idx twice, keep the new one */
+            mm_channel_qbuf(ch_obj, super_buf->super_buf[buf_s_idx].buf);
         }
-    }
+        super_buf->super_buf[buf_s_idx] = *buf_info;
+        super_buf->arrived_mask |= (1U << buf_s_idx);
 
-    if ( found_super_buf ) {
-            super_buf->super_buf[buf_s_idx] = *buf_info;
+        if (super_buf->arrived_mask == all_mask) {
+            mm_channel_superbuf_unmatched_del(queue, super_buf);
 
-            /* check if superbuf is all matched */
-            super_buf->matched = 1;
-            for (i=0; i < super_buf->num_of_bufs; i++) {
-                if (super_buf->super_buf[i].frame_idx == 0) {
-                    super_buf->matched = 0;
+            /* Any older unmatched buffer need to be released */
+            while (queue->unmatched_list.next != &queue->unmatched_list) {
+                oldest = member_of(queue->unmatched_list.next,
+                                   mm_channel_queue_node_t, list);
+                if (oldest->frame_idx >= buf_info->frame_idx) {
                     break;
                 }
+                mm_channel_superbuf_unmatched_release(ch_obj, queue, oldest);
             }
 
-            if (super_buf->matched) {
-                queue->expected_frame_id = buf_info->frame_idx + queue->attr.post_frame_skip;
-                queue->match_cnt++;
-                /* Any older unmatched buffer need to be released */
-                if ( last_buf ) {
-                    while ( last_buf != pos ) {
-                        node = member_of(last_buf, cam_node_t, list);
-                        super_buf = (mm_channel_queue_node_t*)node->data;
-                        if (NULL != super_buf) {
-                            for (i=0; i<super_buf->num_of_bufs; i++) {
-                                if (super_buf->super_buf[i].frame_idx != 0) {
-                                        mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                                }
-                            }
-                            queue->que.size--;
-                            last_buf = last_buf->next;
-                            cam_list_del_node(&node->list);
-                            free(node);
-                            free(super_buf);
-                        } else {
-                            CDBG_ERROR(" %s : Invalid superbuf in queue!", __func__);
-                            break;
-                        }
-                    }
-                }
-            }
-    } else {
-        if (  ( queue->attr.max_unmatched_frames < unmatched_bundles ) &&
-              ( NULL == last_buf ) ) {
-            /* incoming frame is older than the last bundled one */
-            mm_channel_qbuf(ch_obj, buf_info->buf);
+            mm_channel_superbuf_matched_enq(ch_obj, queue, super_buf);
+        }
+        goto done;
+    }
+
+    if (NULL != super_buf) {
+        /* slot taken by a frame at least a window apart */
+        if (super_buf->frame_idx < buf_info->frame_idx) {
+            /* too old to still get matched, drop it */
+            mm_channel_superbuf_unmatched_release(ch_obj, queue, super_buf);
         } else {
-            if ( queue->attr.max_unmatched_frames < unmatched_bundles ) {
-                /* release the oldest bundled superbuf */
-                node = member_of(last_buf, cam_node_t, list);
-                super_buf = (mm_channel_queue_node_t*)node->data;
-                for (i=0; i<super_buf->num_of_bufs; i++) {
-                    if (super_buf->super_buf[i].frame_idx != 0) {
-                            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                    }
-                }
-                queue->que.size--;
-                node = member_of(last_buf, cam_node_t, list);
-                cam_list_del_node(&node->list);
-                free(node);
-                free(super_buf);
-            }
-            /* insert the new frame at the appropriate position. */
-
-            mm_channel_queue_node_t *new_buf = NULL;
-            cam_node_t* new_node = NULL;
-
-            new_buf = (mm_channel_queue_node_t*)malloc(sizeof(mm_channel_queue_node_t));
-            new_node = (cam_node_t*)malloc(sizeof(cam_node_t));
-            if (NULL != new_buf && NULL != new_node) {
-                memset(new_buf, 0, sizeof(mm_channel_queue_node_t));
-                memset(new_node, 0, sizeof(cam_node_t));
-                new_node->data = (void *)new_buf;
-                new_buf->num_of_bufs = queue->num_streams;
-                new_buf->super_buf[buf_s_idx] = *buf_info;
-                new_buf->frame_idx = buf_info->frame_idx;
-
-                /* enqueue */
-                if ( insert_before_buf ) {
-                    cam_list_insert_before_node(&new_node->list, insert_before_buf);
-                } else {
-                    cam_list_add_tail_node(&new_node->list, &queue->que.head.list);
-                }
-                queue->que.size++;
+            /* incoming frame is far older than a pending one */
+            mm_channel_qbuf(ch_obj, buf_info->buf);
+            goto done;
+        }
+    }
 
-                if(queue->num_streams == 1) {
-                    new_buf->matched = 1;
+    if (queue->attr.max_unmatched_frames < queue->unmatched_cnt) {
+        oldest = member_of(queue->unmatched_list.next,
+                           mm_channel_queue_node_t, list);
+        if (oldest->frame_idx > buf_info->frame_idx) {
+            /* incoming frame is older than the last bundled one */
+            mm_channel_qbuf(ch_obj, buf_info->buf);
+            goto done;
+        }
+        /* release the oldest bundled superbuf */
+        mm_channel_superbuf_unmatched_release(ch_obj, queue, oldest);
+    }
 
-                    queue->expected_frame_id = buf_info->frame_idx + queue->attr.post_frame_skip;
-                    queue->match_cnt++;
-                }
-            } else {
-                /* No memory */
-                if (NULL != new_buf) {
-                    free(new_buf);
-                }
-                if (NULL != new_node) {
-                    free(new_node);
-                }
-                /* qbuf the new buf since we cannot enqueue */
-                mm_channel_qbuf(ch_obj, buf_info->buf);
+    /* insert the new frame at the appropriate position. */
+    super_buf = (mm_channel_queue_node_t*)cam_pool_alloc(&queue->superbuf_pool);
+    if (NULL == super_buf) {
+        /* No memory, qbuf the new buf since we cannot enqueue */
+        mm_channel_qbuf(ch_obj, buf_info->buf);
+        goto done;
+    }
+    super_buf->num_of_bufs = queue->num_streams;
+    super_buf->super_buf[buf_s_idx] = *buf_info;
+    super_buf->frame_idx = buf_info->frame_idx;
+    super_buf->arrived_mask = (1U << buf_s_idx);
+
+    if (super_buf->arrived_mask == all_mask) {
+        /* single stream bundle, matched right away */
+        cam_list_init(&super_buf->list);
+        mm_channel_superbuf_matched_enq(ch_obj, queue, super_buf);
+    } else {
+        /* frames mostly come in order, so search from the newest */
+        struct cam_list *pos = queue->unmatched_list.prev;
+        while (pos != &queue->unmatched_list) {
+            if (member_of(pos, mm_channel_queue_node_t, list)->frame_idx <
+                    buf_info->frame_idx) {
+                break;
             }
+            pos = pos->prev;
         }
+        cam_list_insert_before_node(&super_buf->list, pos->next);
+        queue->unmatched_slots[slot] = super_buf;
+        queue->unmatched_cnt++;
     }
 
+done:
     pthread_mutex_unlock(&queue->que.lock);
 
     CDBG("%s: X", __func__);
@@ -1758,25 +1871,19 @@ mm_channel_queue_node_t* mm_channel_superbuf_dequeue_internal(mm_channel_queue_t
     head = &queue->que.head.list;
     pos = head->next;
     if (pos != head) {
-        /* get the first node */
+        /* get the first node, matched ones are older than unmatched ones */
         node = member_of(pos, cam_node_t, list);
         super_buf = (mm_channel_queue_node_t*)node->data;
-        if ( (NULL != super_buf) &&
-             (matched_only == TRUE) &&
-             (super_buf->matched == FALSE) ) {
-            /* require to dequeue matched frame only, but this superbuf is not matched,
-               simply set return ptr to NULL */
-            super_buf = NULL;
-        }
-        if (NULL != super_buf) {
-            /* remove from the queue */
-            cam_list_del_node(&node->list);
-            queue->que.size--;
-            if (super_buf->matched == TRUE) {
-                queue->match_cnt--;
-            }
-            free(node);
-        }
+        /* remove from the queue */
+        cam_list_del_node(&node->list);
+        queue->que.size--;
+        queue->match_cnt--;
+        cam_pool_free(&queue->que.node_pool, node);
+    } else if ((matched_only == FALSE) &&
+               (queue->unmatched_list.next != &queue->unmatched_list)) {
+        super_buf = member_of(queue->unmatched_list.next,
+                              mm_channel_queue_node_t, list);
+        mm_channel_superbuf_unmatched_del(queue, super_buf);
     }
 
     return super_buf;
@@ -1839,7 +1946,7 @@ int32_t mm_channel_superbuf_bufdone_overflow(mm_channel_t* my_obj,
                     mm_channel_qbuf(my_obj, super_buf->super_buf[i].buf);
                 }
             }
-            free(super_buf);
+            cam_pool_free(&queue->superbuf_pool, super_buf);
         }
     }
     pthread_mutex_unlock(&queue->que.lock);
@@ -1883,7 +1990,7 @@ int32_t mm_channel_superbuf_skip(mm_channel_t* my_obj,
                     mm_channel_qbuf(my_obj, super_buf->super_buf[i].buf);
                 }
             }
-            free(super_buf);
+            cam_pool_free(&queue->superbuf_pool, super_buf);
         }
     }
     pthread_mutex_unlock(&queue->que.lock);
@@ -1919,7 +2026,7 @@ int32_t mm_channel_superbuf_flush(mm_channel_t* my_obj,
                 mm_channel_qbuf(my_obj, super_buf->super_buf[i].buf);
             }
         }
-        free(super_buf);
+        cam_pool_free(&queue->superbuf_pool, super_buf);
         super_buf = mm_channel_superbuf_dequeue_internal(queue, FALSE);
     }
     pthread_mutex_unlock(&queue->que.lock);
@@ -124,9 +124,8 @@ void mm_stream_handle_rcvd_buf(mm_stream_t *my_obj,
         mm_camera_cmdcb_t* node = NULL;
 
         /* send cam_sem_post to wake up channel cmd thread to enqueue to super buffer */
-        node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+        node = mm_camera_cmd_thread_alloc_cmd(&my_obj->ch_obj->cmd_thread);
         if (NULL != node) {
-            memset(node, 0, sizeof(mm_camera_cmdcb_t));
             node->cmd_type = MM_CAMERA_CMD_TYPE_DATA_CB;
             node->u.buf = *buf_info;
 
@@ -144,9 +143,8 @@ void mm_stream_handle_rcvd_buf(mm_stream_t *my_obj,
         mm_camera_cmdcb_t* node = NULL;
 
         /* send cam_sem_post to wake up cmd thread to dispatch dataCB */
-        node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+        node = mm_camera_cmd_thread_alloc_cmd(&my_obj->cmd_thread);
         if (NULL != node) {
-            memset(node, 0, sizeof(mm_camera_cmdcb_t));
             node->cmd_type = MM_CAMERA_CMD_TYPE_DATA_CB;
             node->u.buf = *buf_info;
 
@@ -661,7 +659,8 @@ int32_t mm_stream_fsm_reg(mm_stream_t * my_obj,
             if (has_cb) {
                 mm_camera_cmd_thread_launch(&my_obj->cmd_thread,
                                             mm_stream_dispatch_app_data,
-                                            (void *)my_obj);
+                                            (void *)my_obj,
+                                            my_obj->buf_num);
             }
 
             my_obj->state = MM_STREAM_STATE_ACTIVE;
@@ -1375,6 +1374,141 @@ static int32_t mm_stream_unmap_buf_ops(uint32_t frame_idx,
                                plane_idx);
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_stream_bundled_unmap_buf_ops
+ *
+ * DESCRIPTION: ops for unmapping a set of stream buffers via domain socket to
+ *              server in one go. Unmap msgs are pipelined instead of waiting
+ *              for the server ack of each buffer in turn.
+ *
+ * PARAMETERS :
+ *   @bufs         : array of buffers to be unmapped
+ *   @num_bufs     : num of entries in bufs
+ *   @userdata     : user data ptr (stream object)
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_stream_bundled_unmap_buf_ops(const mm_camera_buf_map_t *bufs,
+                                               uint32_t num_bufs,
+                                               void *userdata)
+{
+    int32_t rc = 0;
+    uint32_t i;
+    cam_sock_packet_t *packets = NULL;
+    int *sendfds = NULL;
+    mm_stream_t *my_obj = (mm_stream_t *)userdata;
+
+    if (NULL == my_obj || NULL == my_obj->ch_obj || NULL == my_obj->ch_obj->cam_obj) {
+        CDBG_ERROR("%s: NULL obj of stream/channel/camera", __func__);
+        return -1;
+    }
+    if (0 == num_bufs) {
+        return 0;
+    }
+
+    packets = (cam_sock_packet_t *)malloc(sizeof(cam_sock_packet_t) * num_bufs);
+    sendfds = (int *)malloc(sizeof(int) * num_bufs);
+    if (NULL == packets || NULL == sendfds) {
+        CDBG_ERROR("%s: No memory for %d unmap msgs", __func__, num_bufs);
+        free(packets);
+        free(sendfds);
+        return -1;
+    }
+
+    memset(packets, 0, sizeof(cam_sock_packet_t) * num_bufs);
+    for (i = 0; i < num_bufs; i++) {
+        packets[i].msg_type = CAM_MAPPING_TYPE_FD_UNMAPPING;
+        packets[i].payload.buf_unmap.type = CAM_MAPPING_BUF_TYPE_STREAM_BUF;
+        packets[i].payload.buf_unmap.stream_id = my_obj->server_stream_id;
+        packets[i].payload.buf_unmap.frame_idx = bufs[i].frame_idx;
+        packets[i].payload.buf_unmap.plane_idx = bufs[i].plane_idx;
+        sendfds[i] = 0;
+    }
+
+    rc = mm_camera_util_bundled_sendmsg(my_obj->ch_obj->cam_obj,
+                                        packets,
+                                        sizeof(cam_sock_packet_t),
+                                        num_bufs,
+                                        sendfds);
+    free(packets);
+    free(sendfds);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_stream_bundled_map_buf_ops
+ *
+ * DESCRIPTION: ops for mapping a set of stream buffers via domain socket to
+ *              server in one go. Map msgs are pipelined instead of waiting
+ *              for the server ack of each buffer in turn. If any buffer fails
+ *              to map, the whole set is unmapped again.
+ *
+ * PARAMETERS :
+ *   @bufs         : array of buffers to be mapped
+ *   @num_bufs     : num of entries in bufs
+ *   @userdata     : user data ptr (stream object)
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_stream_bundled_map_buf_ops(const mm_camera_buf_map_t *bufs,
+                                             uint32_t num_bufs,
+                                             void *userdata)
+{
+    int32_t rc = 0;
+    uint32_t i;
+    cam_sock_packet_t *packets = NULL;
+    int *sendfds = NULL;
+    mm_stream_t *my_obj = (mm_stream_t *)userdata;
+
+    if (NULL == my_obj || NULL == my_obj->ch_obj || NULL == my_obj->ch_obj->cam_obj) {
+        CDBG_ERROR("%s: NULL obj of stream/channel/camera", __func__);
+        return -1;
+    }
+    if (0 == num_bufs) {
+        return 0;
+    }
+
+    packets = (cam_sock_packet_t *)malloc(sizeof(cam_sock_packet_t) * num_bufs);
+    sendfds = (int *)malloc(sizeof(int) * num_bufs);
+    if (NULL == packets || NULL == sendfds) {
+        CDBG_ERROR("%s: No memory for %d map msgs", __func__, num_bufs);
+        free(packets);
+        free(sendfds);
+        return -1;
+    }
+
+    memset(packets, 0, sizeof(cam_sock_packet_t) * num_bufs);
+    for (i = 0; i < num_bufs; i++) {
+        packets[i].msg_type = CAM_MAPPING_TYPE_FD_MAPPING;
+        packets[i].payload.buf_map.type = CAM_MAPPING_BUF_TYPE_STREAM_BUF;
+        packets[i].payload.buf_map.fd = bufs[i].fd;
+        packets[i].payload.buf_map.size = bufs[i].size;
+        packets[i].payload.buf_map.stream_id = my_obj->server_stream_id;
+        packets[i].payload.buf_map.frame_idx = bufs[i].frame_idx;
+        packets[i].payload.buf_map.plane_idx = bufs[i].plane_idx;
+        sendfds[i] = bufs[i].fd;
+    }
+
+    rc = mm_camera_util_bundled_sendmsg(my_obj->ch_obj->cam_obj,
+                                        packets,
+                                        sizeof(cam_sock_packet_t),
+                                        num_bufs,
+                                        sendfds);
+    free(packets);
+    free(sendfds);
+
+    if (0 != rc) {
+        /* acks do not tell which buffers made it, so drop all of them */
+        CDBG_ERROR("%s: failed to map %d bufs, unmapping", __func__, num_bufs);
+        mm_stream_bundled_unmap_buf_ops(bufs, num_bufs, userdata);
+    }
+    return rc;
+}
+
 /*===========================================================================
  * FUNCTION   : mm_stream_init_bufs
  *
@@ -1404,6 +1538,8 @@ int32_t mm_stream_init_bufs(mm_stream_t * my_obj)
     my_obj->map_ops.map_ops = mm_stream_map_buf_ops;
     my_obj->map_ops.unmap_ops = mm_stream_unmap_buf_ops;
     my_obj->map_ops.userdata = my_obj;
+    my_obj->map_ops.bundled_map_ops = mm_stream_bundled_map_buf_ops;
+    my_obj->map_ops.bundled_unmap_ops = mm_stream_bundled_unmap_buf_ops;
 
     rc = my_obj->mem_vtbl.get_bufs(&my_obj->frame_offset,
                                    &my_obj->buf_num,
@@ -34,7 +34,8 @@
 #include <sys/stat.h>
 #include <sys/prctl.h>
 #include <fcntl.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <cam_semaphore.h>
 
 #include "mm_camera_dbg.h"
@@ -60,16 +61,44 @@ typedef enum {
     MM_CAMERA_POLL_TASK_STATE_MAX
 } mm_camera_poll_task_state_type_t;
 
-typedef struct {
-    uint8_t cmd;
-    mm_camera_event_t event;
-} mm_camera_sig_evt_t;
+/* max events handled per epoll_wait: all stream fds plus the evt_fd */
+#define MM_CAMERA_POLL_MAX_EVENTS (MAX_STREAM_NUM_IN_BUNDLE + 1)
 
+/*===========================================================================
+ * FUNCTION   : mm_camera_poll_post_cmd
+ *
+ * DESCRIPTION: mark a command pending and wake up the polling thread through
+ *              eventfd. Must be called with poll_cb->mutex held.
+ *
+ * PARAMETERS :
+ *   @poll_cb      : ptr to poll thread object
+ *   @cmd          : command to be sent
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_camera_poll_post_cmd(mm_camera_poll_thread_t *poll_cb,
+                                       uint32_t cmd)
+{
+    uint64_t val = 1;
+    ssize_t len;
+
+    poll_cb->pending_cmds |= (1U << cmd);
+    poll_cb->cmd_seq++;
+
+    len = write(poll_cb->evt_fd, &val, sizeof(val));
+    if (len != sizeof(val)) {
+        CDBG_ERROR("%s: len = %d, errno = %d", __func__, (int)len, errno);
+        return -1;
+    }
+    return 0;
+}
 
 /*===========================================================================
  * FUNCTION   : mm_camera_poll_sig_async
  *
- * DESCRIPTION: Asynchoronous call to send a command through pipe.
+ * DESCRIPTION: Asynchoronous call to send a command to poll thread.
  *
  * PARAMETERS :
  *   @poll_cb      : ptr to poll thread object
@@ -82,39 +111,19 @@ typedef struct {
 static int32_t mm_camera_poll_sig_async(mm_camera_poll_thread_t *poll_cb,
                                   uint32_t cmd)
 {
-    /* send through pipe */
-    /* get the mutex */
-    mm_camera_sig_evt_t cmd_evt;
-    int len;
-
     CDBG("%s: E cmd = %d", __func__,cmd);
-    memset(&cmd_evt, 0, sizeof(cmd_evt));
-    cmd_evt.cmd = cmd;
     pthread_mutex_lock(&poll_cb->mutex);
-    /* reset the statue to false */
-    poll_cb->status = FALSE;
-    /* send cmd to worker */
-
-    len = write(poll_cb->pfds[1], &cmd_evt, sizeof(cmd_evt));
-    if(len < 1) {
-        CDBG_ERROR("%s: len = %d, errno = %d", __func__, len, errno);
-        /* Avoid waiting for the signal */
-        pthread_mutex_unlock(&poll_cb->mutex);
-        return 0;
-    }
-    CDBG("%s: begin IN mutex write done, len = %d", __func__, len);
+    mm_camera_poll_post_cmd(poll_cb, cmd);
     pthread_mutex_unlock(&poll_cb->mutex);
     CDBG("%s: X", __func__);
     return 0;
 }
 
-
-
-
 /*===========================================================================
  * FUNCTION   : mm_camera_poll_sig
  *
- * DESCRIPTION: synchorinzed call to send a command through pipe.
+ * DESCRIPTION: synchorinzed call to send a command to poll thread. Returns
+ *              once poll thread has handled this and all earlier commands.
  *
  * PARAMETERS :
  *   @poll_cb      : ptr to poll thread object
@@ -127,29 +136,18 @@ static int32_t mm_camera_poll_sig_async(mm_camera_poll_thread_t *poll_cb,
 static int32_t mm_camera_poll_sig(mm_camera_poll_thread_t *poll_cb,
                                   uint32_t cmd)
 {
-    /* send through pipe */
-    /* get the mutex */
-    mm_camera_sig_evt_t cmd_evt;
-    int len;
+    uint32_t seq;
 
     CDBG("%s: E cmd = %d", __func__,cmd);
-    memset(&cmd_evt, 0, sizeof(cmd_evt));
-    cmd_evt.cmd = cmd;
     pthread_mutex_lock(&poll_cb->mutex);
-    /* reset the statue to false */
-    poll_cb->status = FALSE;
-    /* send cmd to worker */
-
-    len = write(poll_cb->pfds[1], &cmd_evt, sizeof(cmd_evt));
-    if(len < 1) {
-        CDBG_ERROR("%s: len = %d, errno = %d", __func__, len, errno);
+    if (0 != mm_camera_poll_post_cmd(poll_cb, cmd)) {
         /* Avoid waiting for the signal */
         pthread_mutex_unlock(&poll_cb->mutex);
         return 0;
     }
-    CDBG("%s: begin IN mutex write done, len = %d", __func__, len);
-    /* wait till worker task gives positive signal */
-    if (FALSE == poll_cb->status) {
+    seq = poll_cb->cmd_seq;
+    /* wait till worker task handled our cmd */
+    while ((int32_t)(poll_cb->done_seq - seq) < 0) {
         CDBG("%s: wait", __func__);
         pthread_cond_wait(&poll_cb->cond_v, &poll_cb->mutex);
     }
@@ -160,20 +158,23 @@ static int32_t mm_camera_poll_sig(mm_camera_poll_thread_t *poll_cb,
 }
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_sig
+ * FUNCTION   : mm_camera_poll_sig_done
  *
  * DESCRIPTION: signal the status of done
  *
  * PARAMETERS :
  *   @poll_cb : ptr to poll thread object
+ *   @seq     : seq of the last cmd handled
  *
  * RETURN     : none
  *==========================================================================*/
-static void mm_camera_poll_sig_done(mm_camera_poll_thread_t *poll_cb)
+static void mm_camera_poll_sig_done(mm_camera_poll_thread_t *poll_cb,
+                                    uint32_t seq)
 {
     pthread_mutex_lock(&poll_cb->mutex);
     poll_cb->status = TRUE;
-    pthread_cond_signal(&poll_cb->cond_v);
+    poll_cb->done_seq = seq;
+    pthread_cond_broadcast(&poll_cb->cond_v);
     CDBG("%s: done, in mutex", __func__);
     pthread_mutex_unlock(&poll_cb->mutex);
 }
@@ -196,75 +197,97 @@ static void mm_camera_poll_set_state(mm_camera_poll_thread_t *poll_cb,
 }
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_proc_pipe
+ * FUNCTION   : mm_camera_poll_update_entries
  *
- * DESCRIPTION: polling thread routine to process pipe
+ * DESCRIPTION: sync the epoll set with poll entries. Only entries whose fd
+ *              changed since last update are touched.
  *
  * PARAMETERS :
  *   @poll_cb : ptr to poll thread object
  *
  * RETURN     : none
  *==========================================================================*/
-static void mm_camera_poll_proc_pipe(mm_camera_poll_thread_t *poll_cb)
+static void mm_camera_poll_update_entries(mm_camera_poll_thread_t *poll_cb)
 {
-    ssize_t read_len;
     int i;
-    mm_camera_sig_evt_t cmd_evt;
-    read_len = read(poll_cb->pfds[0], &cmd_evt, sizeof(cmd_evt));
-    CDBG("%s: read_fd = %d, read_len = %d, expect_len = %d cmd = %d",
-         __func__, poll_cb->pfds[0], (int)read_len, (int)sizeof(cmd_evt), cmd_evt.cmd);
-    // read_len is unused if not debugging.
-    (void)read_len;
-    switch (cmd_evt.cmd) {
-    case MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED:
-    case MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC:
-        /* we always have index 0 for pipe read */
-        poll_cb->num_fds = 0;
-        poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->pfds[0];
-        poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-        poll_cb->num_fds++;
-
-        if (MM_CAMERA_POLL_TYPE_EVT == poll_cb->poll_type) {
-            if (poll_cb->poll_entries[0].fd > 0) {
-                /* fd is valid, we update poll_fds */
-                poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->poll_entries[0].fd;
-                poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-                poll_cb->num_fds++;
-            }
-        } else if (MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) {
-            for(i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
-                if(poll_cb->poll_entries[i].fd > 0) {
-                    /* fd is valid, we update poll_fds to this fd */
-                    poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->poll_entries[i].fd;
-                    poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-                    poll_cb->num_fds++;
-                } else {
-                    /* fd is invalid, we set the entry to -1 to prevent polling.
-                     * According to spec, polling will not poll on entry with fd=-1.
-                     * If this is not the case, we need to skip these invalid fds
-                     * when updating this array.
-                     * We still keep fd=-1 in this array because this makes easier to
-                     * map cb associated with this fd once incoming data avail by directly
-                     * using the index-1(0 is reserved for pipe read, so need to reduce index by 1) */
-                    poll_cb->poll_fds[poll_cb->num_fds].fd = -1;
-                    poll_cb->poll_fds[poll_cb->num_fds].events = 0;
-                    poll_cb->num_fds++;
-                }
+    int num_entries = MAX_STREAM_NUM_IN_BUNDLE;
+    struct epoll_event ev;
+
+    if (MM_CAMERA_POLL_TYPE_EVT == poll_cb->poll_type) {
+        /* for EVT type, only idx=0 is valid */
+        num_entries = 1;
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        int32_t fd = poll_cb->poll_entries[i].fd;
+        int32_t reg_fd = poll_cb->epoll_reg_fds[i];
+
+        if (reg_fd >= 0 && reg_fd != fd) {
+            /* fd may have been closed already, which drops it from
+             * the epoll set, so failure here is not an error */
+            epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_DEL, reg_fd, NULL);
+            poll_cb->epoll_reg_fds[i] = -1;
+        }
+
+        if (fd > 0) {
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN | EPOLLRDNORM | EPOLLPRI;
+            ev.data.ptr = &poll_cb->poll_entries[i];
+            /* the same fd number may have been closed and reopened between
+             * two updates, so (re)add it whenever it is still listed */
+            if (epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 &&
+                (errno != EEXIST ||
+                 epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0)) {
+                CDBG_ERROR("%s: failed to add fd %d to epoll set, errno = %d",
+                           __func__, fd, errno);
+                continue;
             }
+            poll_cb->epoll_reg_fds[i] = fd;
         }
-        if (cmd_evt.cmd != MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC)
-            mm_camera_poll_sig_done(poll_cb);
-        break;
-
-    case MM_CAMERA_PIPE_CMD_COMMIT:
-        mm_camera_poll_sig_done(poll_cb);
-        break;
-    case MM_CAMERA_PIPE_CMD_EXIT:
-    default:
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_camera_poll_proc_cmds
+ *
+ * DESCRIPTION: polling thread routine to process pending cmds
+ *
+ * PARAMETERS :
+ *   @poll_cb : ptr to poll thread object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_camera_poll_proc_cmds(mm_camera_poll_thread_t *poll_cb)
+{
+    ssize_t read_len;
+    uint64_t val = 0;
+    uint32_t cmds;
+    uint32_t seq;
+
+    /* reset eventfd counter, several cmds may be folded in one wake up */
+    read_len = read(poll_cb->evt_fd, &val, sizeof(val));
+    CDBG("%s: evt_fd = %d, read_len = %d, count = %llu",
+         __func__, poll_cb->evt_fd, (int)read_len, (unsigned long long)val);
+    // read_len is unused if not debugging.
+    (void)read_len;
+
+    pthread_mutex_lock(&poll_cb->mutex);
+    cmds = poll_cb->pending_cmds;
+    seq = poll_cb->cmd_seq;
+    poll_cb->pending_cmds = 0;
+    pthread_mutex_unlock(&poll_cb->mutex);
+
+    if (cmds & ((1U << MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED) |
+                (1U << MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC))) {
+        mm_camera_poll_update_entries(poll_cb);
+    }
+
+    if (cmds & (1U << MM_CAMERA_PIPE_CMD_EXIT)) {
         mm_camera_poll_set_state(poll_cb, MM_CAMERA_POLL_TASK_STATE_STOPPED);
-        mm_camera_poll_sig_done(poll_cb);
-        break;
     }
+
+    /* all cmds up to seq are handled now, release the sync callers */
+    mm_camera_poll_sig_done(poll_cb, seq);
 }
 
 /*===========================================================================
@@ -280,47 +303,60 @@ static void mm_camera_poll_proc_pipe(mm_camera_poll_thread_t *poll_cb)
 static void *mm_camera_poll_fn(mm_camera_poll_thread_t *poll_cb)
 {
     int rc = 0, i;
+    struct epoll_event events[MM_CAMERA_POLL_MAX_EVENTS];
 
-    CDBG("%s: poll type = %d, num_fd = %d poll_cb = %p\n",
-         __func__, poll_cb->poll_type, poll_cb->num_fds,poll_cb);
+    CDBG("%s: poll type = %d, poll_cb = %p\n",
+         __func__, poll_cb->poll_type, poll_cb);
     do {
-         for(i = 0; i < poll_cb->num_fds; i++) {
-            poll_cb->poll_fds[i].events = POLLIN|POLLRDNORM|POLLPRI;
-         }
-
-         rc = poll(poll_cb->poll_fds, poll_cb->num_fds, poll_cb->timeoutms);
-         if(rc > 0) {
-            if ((poll_cb->poll_fds[0].revents & POLLIN) &&
-                (poll_cb->poll_fds[0].revents & POLLRDNORM)) {
-                /* if we have data on pipe, we only process pipe in this iteration */
-                CDBG("%s: cmd received on pipe\n", __func__);
-                mm_camera_poll_proc_pipe(poll_cb);
-            } else {
-                for(i=1; i<poll_cb->num_fds; i++) {
-                    /* Checking for ctrl events */
-                    if ((poll_cb->poll_type == MM_CAMERA_POLL_TYPE_EVT) &&
-                        (poll_cb->poll_fds[i].revents & POLLPRI)) {
-                        CDBG("%s: mm_camera_evt_notify\n", __func__);
-                        if (NULL != poll_cb->poll_entries[i-1].notify_cb) {
-                            poll_cb->poll_entries[i-1].notify_cb(poll_cb->poll_entries[i-1].user_data);
-                        }
-                    }
-
-                    if ((MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) &&
-                        (poll_cb->poll_fds[i].revents & POLLIN) &&
-                        (poll_cb->poll_fds[i].revents & POLLRDNORM)) {
-                        CDBG("%s: mm_stream_data_notify\n", __func__);
-                        if (NULL != poll_cb->poll_entries[i-1].notify_cb) {
-                            poll_cb->poll_entries[i-1].notify_cb(poll_cb->poll_entries[i-1].user_data);
-                        }
-                    }
-                }
+        rc = epoll_wait(poll_cb->epoll_fd, events,
+                        MM_CAMERA_POLL_MAX_EVENTS, poll_cb->timeoutms);
+        if (rc < 0) {
+            if (errno != EINTR) {
+                /* instead of spinning, block on evt_fd until next cmd so
+                 * that updates and exit are still served */
+                CDBG_ERROR("%s: epoll_wait failed, errno = %d",
+                           __func__, errno);
+                mm_camera_poll_proc_cmds(poll_cb);
             }
-        } else {
-            /* in error case sleep 10 us and then continue. hard coded here */
-            usleep(10);
             continue;
         }
+
+        /* if we have a cmd pending, we only process cmds in this iteration
+         * since entries may have changed; epoll is level triggered so
+         * data events will be reported again */
+        for (i = 0; i < rc; i++) {
+            if (NULL == events[i].data.ptr) {
+                break;
+            }
+        }
+        if (i < rc) {
+            CDBG("%s: cmd received\n", __func__);
+            mm_camera_poll_proc_cmds(poll_cb);
+            continue;
+        }
+
+        for (i = 0; i < rc; i++) {
+            mm_camera_poll_entry_t *entry =
+                (mm_camera_poll_entry_t *)events[i].data.ptr;
+            uint32_t revents = events[i].events;
+
+            /* Checking for ctrl events */
+            if ((MM_CAMERA_POLL_TYPE_EVT == poll_cb->poll_type) &&
+                (revents & EPOLLPRI)) {
+                CDBG("%s: mm_camera_evt_notify\n", __func__);
+                if (NULL != entry->notify_cb) {
+                    entry->notify_cb(entry->user_data);
+                }
+            }
+
+            if ((MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) &&
+                (revents & EPOLLIN) && (revents & EPOLLRDNORM)) {
+                CDBG("%s: mm_stream_data_notify\n", __func__);
+                if (NULL != entry->notify_cb) {
+                    entry->notify_cb(entry->user_data);
+                }
+            }
+        }
     } while (poll_cb->state == MM_CAMERA_POLL_TASK_STATE_POLL);
     return NULL;
 }
@@ -340,11 +376,8 @@ static void *mm_camera_poll_thread(void *data)
     prctl(PR_SET_NAME, (unsigned long)"mm_cam_poll_th", 0, 0, 0);
     mm_camera_poll_thread_t *poll_cb = (mm_camera_poll_thread_t *)data;
 
-    /* add pipe read fd into poll first */
-    poll_cb->poll_fds[poll_cb->num_fds++].fd = poll_cb->pfds[0];
-
-    mm_camera_poll_sig_done(poll_cb);
     mm_camera_poll_set_state(poll_cb, MM_CAMERA_POLL_TASK_STATE_POLL);
+    mm_camera_poll_sig_done(poll_cb, 0);
     return mm_camera_poll_fn(poll_cb);
 }
 
@@ -491,25 +524,58 @@ int32_t mm_camera_poll_thread_launch(mm_camera_poll_thread_t * poll_cb,
                                      mm_camera_poll_thread_type_t poll_type)
 {
     int32_t rc = 0;
+    int i;
+    struct epoll_event ev;
 
     pthread_mutex_lock(&constr_destr_lock);
 
     poll_cb->poll_type = poll_type;
 
-    poll_cb->pfds[0] = -1;
-    poll_cb->pfds[1] = -1;
-    rc = pipe(poll_cb->pfds);
-    if(rc < 0) {
-        CDBG_ERROR("%s: pipe open rc=%d\n", __func__, rc);
+    poll_cb->evt_fd = -1;
+    poll_cb->epoll_fd = -1;
+    poll_cb->pending_cmds = 0;
+    poll_cb->cmd_seq = 0;
+    poll_cb->done_seq = 0;
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        poll_cb->epoll_reg_fds[i] = -1;
+    }
+
+    poll_cb->evt_fd = eventfd(0, EFD_CLOEXEC);
+    if (poll_cb->evt_fd < 0) {
+        CDBG_ERROR("%s: eventfd open errno=%d\n", __func__, errno);
+        pthread_mutex_unlock(&constr_destr_lock);
+        return -1;
+    }
+
+    poll_cb->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (poll_cb->epoll_fd < 0) {
+        CDBG_ERROR("%s: epoll open errno=%d\n", __func__, errno);
+        close(poll_cb->evt_fd);
+        poll_cb->evt_fd = -1;
+        pthread_mutex_unlock(&constr_destr_lock);
+        return -1;
+    }
+
+    /* evt_fd is the only fd registered with NULL user data */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    rc = epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_ADD, poll_cb->evt_fd, &ev);
+    if (rc < 0) {
+        CDBG_ERROR("%s: epoll add evt_fd errno=%d\n", __func__, errno);
+        close(poll_cb->epoll_fd);
+        close(poll_cb->evt_fd);
+        poll_cb->epoll_fd = -1;
+        poll_cb->evt_fd = -1;
         pthread_mutex_unlock(&constr_destr_lock);
         return -1;
     }
 
     poll_cb->timeoutms = -1;  /* Infinite seconds */
 
-    CDBG("%s: poll_type = %d, read fd = %d, write fd = %d timeout = %d",
+    CDBG("%s: poll_type = %d, evt fd = %d, epoll fd = %d timeout = %d",
         __func__, poll_cb->poll_type,
-        poll_cb->pfds[0], poll_cb->pfds[1],poll_cb->timeoutms);
+        poll_cb->evt_fd, poll_cb->epoll_fd, poll_cb->timeoutms);
 
     pthread_mutex_init(&poll_cb->mutex, NULL);
     pthread_cond_init(&poll_cb->cond_v, NULL);
@@ -545,12 +611,12 @@ int32_t mm_camera_poll_thread_release(mm_camera_poll_thread_t *poll_cb)
         CDBG_ERROR("%s: pthread dead already\n", __func__);
     }
 
-    /* close pipe */
-    if(poll_cb->pfds[0] >= 0) {
-        close(poll_cb->pfds[0]);
+    /* close eventfd and epoll instance */
+    if(poll_cb->epoll_fd >= 0) {
+        close(poll_cb->epoll_fd);
     }
-    if(poll_cb->pfds[1] >= 0) {
-        close(poll_cb->pfds[1]);
+    if(poll_cb->evt_fd >= 0) {
+        close(poll_cb->evt_fd);
     }
 
     pthread_mutex_destroy(&poll_cb->mutex);
@@ -558,8 +624,8 @@ int32_t mm_camera_poll_thread_release(mm_camera_poll_thread_t *poll_cb)
     memset(poll_cb, 0, sizeof(mm_camera_poll_thread_t));
 done:
     pthread_mutex_unlock(&constr_destr_lock);
-    poll_cb->pfds[0] = -1;
-    poll_cb->pfds[1] = -1;
+    poll_cb->evt_fd = -1;
+    poll_cb->epoll_fd = -1;
     return rc;
 }
 
@@ -600,7 +666,7 @@ static void *mm_camera_cmd_thread(void *data)
                 running = 0;
                 break;
             }
-            free(node);
+            cam_pool_free(&cmd_thread->cmd_pool, node);
             node = (mm_camera_cmdcb_t*)cam_queue_deq(&cmd_thread->cmd_queue);
         } /* (node != NULL) */
     } while (running);
@@ -609,12 +675,16 @@ static void *mm_camera_cmd_thread(void *data)
 
 int32_t mm_camera_cmd_thread_launch(mm_camera_cmd_thread_t * cmd_thread,
                                     mm_camera_cmd_cb_t cb,
-                                    void* user_data)
+                                    void* user_data,
+                                    uint32_t pool_size)
 {
     int32_t rc = 0;
 
     cam_sem_init(&cmd_thread->cmd_sem, 0);
-    cam_queue_init(&cmd_thread->cmd_queue);
+    /* preallocate cmds and queue nodes so that steady state
+     * traffic of up to pool_size pending cmds stays off the heap */
+    cam_queue_init_with_pool(&cmd_thread->cmd_queue, pool_size);
+    cam_pool_init(&cmd_thread->cmd_pool, sizeof(mm_camera_cmdcb_t), pool_size);
     cmd_thread->cb = cb;
     cmd_thread->user_data = user_data;
 
@@ -626,6 +696,13 @@ int32_t mm_camera_cmd_thread_launch(mm_camera_cmd_thread_t * cmd_thread,
     return rc;
 }
 
+mm_camera_cmdcb_t *mm_camera_cmd_thread_alloc_cmd(
+                                    mm_camera_cmd_thread_t * cmd_thread)
+{
+    /* node is zeroed, and is freed back to the pool by the cmd thread */
+    return (mm_camera_cmdcb_t *)cam_pool_alloc(&cmd_thread->cmd_pool);
+}
+
 int32_t mm_camera_cmd_thread_name(const char* name)
 {
     int32_t rc = 0;
@@ -638,13 +715,12 @@ int32_t mm_camera_cmd_thread_name(const char* name)
 int32_t mm_camera_cmd_thread_stop(mm_camera_cmd_thread_t * cmd_thread)
 {
     int32_t rc = 0;
-    mm_camera_cmdcb_t* node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+    mm_camera_cmdcb_t* node = mm_camera_cmd_thread_alloc_cmd(cmd_thread);
     if (NULL == node) {
         CDBG_ERROR("%s: No memory for mm_camera_cmdcb_t", __func__);
         return -1;
     }
 
-    memset(node, 0, sizeof(mm_camera_cmdcb_t));
     node->cmd_type = MM_CAMERA_CMD_TYPE_EXIT;
 
     cam_queue_enq(&cmd_thread->cmd_queue, node);
@@ -660,6 +736,20 @@ int32_t mm_camera_cmd_thread_stop(mm_camera_cmd_thread_t * cmd_thread)
 int32_t mm_camera_cmd_thread_destroy(mm_camera_cmd_thread_t * cmd_thread)
 {
     int32_t rc = 0;
+    mm_camera_cmdcb_t* node = NULL;
+
+    /* cmds left behind by exit need to go back to the pool */
+    node = (mm_camera_cmdcb_t*)cam_queue_deq(&cmd_thread->cmd_queue);
+    while (node != NULL) {
+        cam_pool_free(&cmd_thread->cmd_pool, node);
+        node = (mm_camera_cmdcb_t*)cam_queue_deq(&cmd_thread->cmd_queue);
+    }
+    CDBG_HIGH("%s: cmd pool hits %d misses %d, node pool hits %d misses %d",
+              __func__,
+              cmd_thread->cmd_pool.hits, cmd_thread->cmd_pool.misses,
+              cmd_thread->cmd_queue.node_pool.hits,
+              cmd_thread->cmd_queue.node_pool.misses);
+    cam_pool_deinit(&cmd_thread->cmd_pool);
     cam_queue_deinit(&cmd_thread->cmd_queue);
     cam_sem_destroy(&cmd_thread->cmd_sem);
     memset(cmd_thread, 0, sizeof(mm_camera_cmd_thread_t));
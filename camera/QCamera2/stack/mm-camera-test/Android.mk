@@ -76,4 +76,20 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_EXECUTABLE)
 
+# cam_semaphore_t microbenchmark, also builds and runs on the host:
+#   gcc -O2 -I../common src/mm_qcamera_sem_bench.c -lpthread
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= src/mm_qcamera_sem_bench.c
+
+LOCAL_C_INCLUDES:= $(LOCAL_PATH)/../common
+
+LOCAL_CFLAGS += -Wall -Werror
+
+LOCAL_MODULE:= mm-qcamera-sem-bench
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
 LOCAL_PATH := $(OLD_LOCAL_PATH)
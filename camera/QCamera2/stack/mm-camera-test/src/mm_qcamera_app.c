@@ -33,50 +33,30 @@
 #include <linux/msm_ion.h>
 #include <sys/mman.h>
 
+#include "cam_semaphore.h"
 #include "mm_qcamera_dbg.h"
 #include "mm_qcamera_app.h"
 
-static pthread_mutex_t app_mutex;
-static int thread_status = 0;
-static pthread_cond_t app_cond_v;
-
-#define MM_QCAMERA_APP_NANOSEC_SCALE 1000000000
+/* posted by mm_camera_app_done, so a done that comes before the wait is
+ * not lost */
+static cam_semaphore_t app_done_sem = { 0, 0 };
 
 int mm_camera_app_timedwait(uint8_t seconds)
 {
-    int rc = 0;
-    pthread_mutex_lock(&app_mutex);
-    if(FALSE == thread_status) {
-        struct timespec tw;
-        memset(&tw, 0, sizeof tw);
-        tw.tv_sec = 0;
-        tw.tv_nsec = time(0) + seconds * MM_QCAMERA_APP_NANOSEC_SCALE;
-
-        rc = pthread_cond_timedwait(&app_cond_v, &app_mutex,&tw);
-        thread_status = FALSE;
-    }
-    pthread_mutex_unlock(&app_mutex);
-    return rc;
+    struct timespec tw;
+    memset(&tw, 0, sizeof tw);
+    tw.tv_sec = seconds;
+    return cam_sem_timedwait(&app_done_sem, &tw);
 }
 
 int mm_camera_app_wait()
 {
-    int rc = 0;
-    pthread_mutex_lock(&app_mutex);
-    if(FALSE == thread_status){
-        pthread_cond_wait(&app_cond_v, &app_mutex);
-        thread_status = FALSE;
-    }
-    pthread_mutex_unlock(&app_mutex);
-    return rc;
+    return cam_sem_wait(&app_done_sem);
 }
 
 void mm_camera_app_done()
 {
-  pthread_mutex_lock(&app_mutex);
-  thread_status = TRUE;
-  pthread_cond_signal(&app_cond_v);
-  pthread_mutex_unlock(&app_mutex);
+    cam_sem_post(&app_done_sem);
 }
 
 int mm_app_load_hal(mm_camera_app_t *my_cam_app)
@@ -0,0 +1,279 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Host-runnable microbenchmark for cam_semaphore_t.
+ * Measures post->wake latency with two threads ping-ponging, the
+ * uncontended post/wait cost, waking a batch of waiters with
+ * cam_sem_post_n versus n single posts, and how late cam_sem_timedwait
+ * returns after its timeout. The mutex + condvar semaphore cam_semaphore_t
+ * used to be is kept below as the reference.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cam_semaphore.h"
+
+#define SEM_BENCH_PINGPONG_ITER  200000
+#define SEM_BENCH_UNCONTENDED    2000000
+#define SEM_BENCH_BATCH_ITER     20000
+#define SEM_BENCH_BATCH_WAITERS  4
+#define SEM_BENCH_TIMEOUT_ITER   20
+#define SEM_BENCH_TIMEOUT_US     2000
+
+typedef struct {
+    int val;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} cond_sem_t;
+
+static void cond_sem_init(cond_sem_t *s, int n)
+{
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->val = n;
+}
+
+static void cond_sem_post(cond_sem_t *s)
+{
+    pthread_mutex_lock(&s->mutex);
+    s->val++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void cond_sem_wait(cond_sem_t *s)
+{
+    pthread_mutex_lock(&s->mutex);
+    while (s->val == 0)
+        pthread_cond_wait(&s->cond, &s->mutex);
+    s->val--;
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void cond_sem_destroy(cond_sem_t *s)
+{
+    pthread_mutex_destroy(&s->mutex);
+    pthread_cond_destroy(&s->cond);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* ping-pong: main posts ping, peer waits on it and posts pong back */
+typedef struct {
+    cam_semaphore_t ping, pong;
+    cond_sem_t cping, cpong;
+    int use_cond;
+    int iter;
+} pingpong_t;
+
+static void *pingpong_peer(void *arg)
+{
+    pingpong_t *pp = (pingpong_t *)arg;
+    int i;
+    for (i = 0; i < pp->iter; i++) {
+        if (pp->use_cond) {
+            cond_sem_wait(&pp->cping);
+            cond_sem_post(&pp->cpong);
+        } else {
+            cam_sem_wait(&pp->ping);
+            cam_sem_post(&pp->pong);
+        }
+    }
+    return NULL;
+}
+
+static double bench_pingpong(int use_cond)
+{
+    pingpong_t pp;
+    pthread_t tid;
+    double start, end;
+    int i;
+
+    memset(&pp, 0, sizeof(pp));
+    cam_sem_init(&pp.ping, 0);
+    cam_sem_init(&pp.pong, 0);
+    cond_sem_init(&pp.cping, 0);
+    cond_sem_init(&pp.cpong, 0);
+    pp.use_cond = use_cond;
+    pp.iter = SEM_BENCH_PINGPONG_ITER;
+    pthread_create(&tid, NULL, pingpong_peer, &pp);
+
+    start = now_ns();
+    for (i = 0; i < pp.iter; i++) {
+        if (use_cond) {
+            cond_sem_post(&pp.cping);
+            cond_sem_wait(&pp.cpong);
+        } else {
+            cam_sem_post(&pp.ping);
+            cam_sem_wait(&pp.pong);
+        }
+    }
+    end = now_ns();
+    pthread_join(tid, NULL);
+
+    cam_sem_destroy(&pp.ping);
+    cam_sem_destroy(&pp.pong);
+    cond_sem_destroy(&pp.cping);
+    cond_sem_destroy(&pp.cpong);
+    /* one round trip is two post->wake hops */
+    return (end - start) / pp.iter / 2;
+}
+
+static double bench_uncontended(int use_cond)
+{
+    cam_semaphore_t s;
+    cond_sem_t cs;
+    double start, end;
+    int i;
+
+    cam_sem_init(&s, 0);
+    cond_sem_init(&cs, 0);
+    start = now_ns();
+    for (i = 0; i < SEM_BENCH_UNCONTENDED; i++) {
+        if (use_cond) {
+            cond_sem_post(&cs);
+            cond_sem_wait(&cs);
+        } else {
+            cam_sem_post(&s);
+            cam_sem_wait(&s);
+        }
+    }
+    end = now_ns();
+    cam_sem_destroy(&s);
+    cond_sem_destroy(&cs);
+    return (end - start) / SEM_BENCH_UNCONTENDED;
+}
+
+/* batch: n waiters each take one count per round, then report back */
+typedef struct {
+    cam_semaphore_t go;
+    cam_semaphore_t done;
+    int iter;
+} batch_t;
+
+static void *batch_waiter(void *arg)
+{
+    batch_t *b = (batch_t *)arg;
+    int i;
+    for (i = 0; i < b->iter; i++) {
+        cam_sem_wait(&b->go);
+        cam_sem_post(&b->done);
+    }
+    return NULL;
+}
+
+static double bench_batch(int use_post_n)
+{
+    batch_t b;
+    pthread_t tid[SEM_BENCH_BATCH_WAITERS];
+    double start, end;
+    int i, j;
+
+    cam_sem_init(&b.go, 0);
+    cam_sem_init(&b.done, 0);
+    b.iter = SEM_BENCH_BATCH_ITER;
+    for (j = 0; j < SEM_BENCH_BATCH_WAITERS; j++) {
+        pthread_create(&tid[j], NULL, batch_waiter, &b);
+    }
+
+    start = now_ns();
+    for (i = 0; i < b.iter; i++) {
+        if (use_post_n) {
+            cam_sem_post_n(&b.go, SEM_BENCH_BATCH_WAITERS);
+        } else {
+            for (j = 0; j < SEM_BENCH_BATCH_WAITERS; j++) {
+                cam_sem_post(&b.go);
+            }
+        }
+        for (j = 0; j < SEM_BENCH_BATCH_WAITERS; j++) {
+            cam_sem_wait(&b.done);
+        }
+    }
+    end = now_ns();
+
+    for (j = 0; j < SEM_BENCH_BATCH_WAITERS; j++) {
+        pthread_join(tid[j], NULL);
+    }
+    cam_sem_destroy(&b.go);
+    cam_sem_destroy(&b.done);
+    return (end - start) / b.iter;
+}
+
+static int bench_timeout(double *late_us)
+{
+    cam_semaphore_t s;
+    struct timespec tw;
+    double start, total = 0;
+    int i;
+
+    cam_sem_init(&s, 0);
+    tw.tv_sec = 0;
+    tw.tv_nsec = SEM_BENCH_TIMEOUT_US * 1000L;
+    for (i = 0; i < SEM_BENCH_TIMEOUT_ITER; i++) {
+        start = now_ns();
+        if (ETIMEDOUT != cam_sem_timedwait(&s, &tw) ||
+            (now_ns() - start) / 1000 < SEM_BENCH_TIMEOUT_US) {
+            cam_sem_destroy(&s);
+            return -1;
+        }
+        total += (now_ns() - start) / 1000 - SEM_BENCH_TIMEOUT_US;
+    }
+    cam_sem_destroy(&s);
+    *late_us = total / SEM_BENCH_TIMEOUT_ITER;
+    return 0;
+}
+
+int main(void)
+{
+    double late_us = 0;
+
+    printf("post->wake latency     futex %8.1f ns  condvar %8.1f ns\n",
+           bench_pingpong(0), bench_pingpong(1));
+    printf("uncontended post+wait  futex %8.1f ns  condvar %8.1f ns\n",
+           bench_uncontended(0), bench_uncontended(1));
+    printf("wake %d waiters         post_n %6.1f ns  %d posts %6.1f ns\n",
+           SEM_BENCH_BATCH_WAITERS, bench_batch(1),
+           SEM_BENCH_BATCH_WAITERS, bench_batch(0));
+    if (bench_timeout(&late_us) < 0) {
+        printf("timedwait returned early or without timing out\n");
+        return 1;
+    }
+    printf("timedwait %d us        returns %.1f us late on average\n",
+           SEM_BENCH_TIMEOUT_US, late_us);
+    return 0;
+}
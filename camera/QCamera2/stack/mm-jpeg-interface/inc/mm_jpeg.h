@@ -40,7 +40,6 @@
 #include "QOMX_JpegExtensions.h"
 
 #define MM_JPEG_MAX_THREADS 30
-#define MM_JPEG_CIRQ_SIZE 30
 #define MM_JPEG_MAX_SESSION 10
 #define MAX_EXIF_TABLE_ENTRIES 50
 #define ASPECT_TOLERANCE 0.001
@@ -62,17 +61,6 @@ typedef enum {
   MM_JPEG_CMD_TYPE_MAX
 } mm_jpeg_cmd_type_t;
 
-typedef struct {
-  union {
-    int i_data[MM_JPEG_CIRQ_SIZE];
-    void *p_data[MM_JPEG_CIRQ_SIZE];
-  };
-  int front;
-  int rear;
-  int count;
-  pthread_mutex_t lock;
-} mm_jpeg_cirq_t;
-
 typedef struct {
   uint32_t client_hdl;           /* client handler */
   uint32_t jobId;                /* job ID */
@@ -108,7 +96,6 @@ typedef struct {
   QEXIF_INFO_DATA exif_info_local[MAX_EXIF_TABLE_ENTRIES];  //all exif tags for JPEG encoder
   int exif_count_local;
 
-  mm_jpeg_cirq_t cb_q;
   int32_t ebd_count;
   int32_t fbd_count;
 
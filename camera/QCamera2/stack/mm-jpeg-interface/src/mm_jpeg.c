@@ -136,108 +136,6 @@ OMX_ERRORTYPE mm_jpeg_event_handler(OMX_HANDLETYPE hComponent,
     OMX_U32 nData2,
     OMX_PTR pEventData);
 
-/** cirq_reset:
- *
- *  Arguments:
- *    @q: circular queue
- *
- *  Return:
- *       none
- *
- *  Description:
- *       Resets the circular queue
- *
- **/
-static inline void cirq_reset(mm_jpeg_cirq_t *q)
-{
-  q->front = 0;
-  q->rear = 0;
-  q->count = 0;
-  pthread_mutex_init(&q->lock, NULL);
-}
-
-/** cirq_empty:
- *
- *  Arguments:
- *    @q: circular queue
- *
- *  Return:
- *       none
- *
- *  Description:
- *       check if the curcular queue is empty
- *
- **/
-#define cirq_empty(q) (q->count == 0)
-
-/** cirq_full:
- *
- *  Arguments:
- *    @q: circular queue
- *
- *  Return:
- *       none
- *
- *  Description:
- *       check if the curcular queue is full
- *
- **/
-#define cirq_full(q) (q->count == MM_JPEG_CIRQ_SIZE)
-
-/** cirq_enqueue:
- *
- *  Arguments:
- *    @q: circular queue
- *    @data: data to be inserted
- *
- *  Return:
- *       true/false
- *
- *  Description:
- *       enqueue an element into circular queue
- *
- **/
-#define cirq_enqueue(q, type, data) ({ \
-  int rc = 0; \
-  pthread_mutex_lock(&q->lock); \
-  if (cirq_full(q)) { \
-    rc = -1; \
-  } else { \
-    q->type[q->rear] = data; \
-    q->rear = (q->rear + 1) % MM_JPEG_CIRQ_SIZE; \
-    q->count++; \
-  } \
-  pthread_mutex_unlock(&q->lock); \
-  rc; \
-})
-
-/** cirq_dequeue:
- *
- *  Arguments:
- *    @q: circular queue
- *    @data: data to be popped
- *
- *  Return:
- *       true/false
- *
- *  Description:
- *       dequeue an element from the circular queue
- *
- **/
-#define cirq_dequeue(q, type, data) ({ \
-  int rc = 0; \
-  pthread_mutex_lock(&q->lock); \
-  if (cirq_empty(q)) { \
-    pthread_mutex_unlock(&q->lock); \
-    rc = -1; \
-  } else { \
-    data = q->type[q->front]; \
-    q->count--; \
-  } \
-  pthread_mutex_unlock(&q->lock); \
-  rc; \
-})
-
 /**
  *
  * special queue functions for job queue
@@ -461,11 +359,9 @@ OMX_ERRORTYPE mm_jpeg_session_change_state(mm_jpeg_job_session_t* p_session,
 OMX_ERRORTYPE mm_jpeg_session_create(mm_jpeg_job_session_t* p_session)
 {
   OMX_ERRORTYPE rc = OMX_ErrorNone;
-  mm_jpeg_cirq_t *p_cirq = NULL;
 
   pthread_mutex_init(&p_session->lock, NULL);
   pthread_cond_init(&p_session->cond, NULL);
-  cirq_reset(&p_session->cb_q);
   p_session->state_change_pending = OMX_FALSE;
   p_session->abort_flag = OMX_FALSE;
   p_session->error_flag = OMX_ErrorNone;
@@ -1608,17 +1504,16 @@ int32_t mm_jpeg_process_encoding_job(mm_jpeg_obj *my_obj, mm_jpeg_job_q_node_t*
   if (NULL == p_session) {
     CDBG_ERROR("%s:%d] invalid job id %x", __func__, __LINE__,
       job_node->enc_info.job_id);
+    node = mm_jpeg_queue_remove_job_by_job_id(&my_obj->ongoing_job_q,
+      job_node->enc_info.job_id);
+    if (node) {
+      free(node);
+    }
     return -1;
   }
 
-  /* sent encode cmd to OMX, queue job into ongoing queue */
-  rc = mm_jpeg_queue_enq(&my_obj->ongoing_job_q, job_node);
-  if (rc) {
-    CDBG_ERROR("%s:%d] jpeg enqueue failed %d",
-      __func__, __LINE__, ret);
-    goto error;
-  }
-
+  /* job is already queued into ongoing queue by the worker,
+   * sent encode cmd to OMX */
   p_session->encode_job = job_node->enc_info.encode_job;
   p_session->jobId = job_node->enc_info.job_id;
   ret = mm_jpeg_session_encode(p_session);
@@ -1651,6 +1546,103 @@ error:
   return rc;
 }
 
+/** mm_jpeg_queue_has_session:
+ *
+ *  Arguments:
+ *    @queue: job queue
+ *    @session_id: session id
+ *
+ *  Return:
+ *       true if a job of the session is in the queue
+ *
+ *  Description:
+ *       Check if the session has a job in the queue. Must be called
+ *       with queue lock held.
+ *
+ **/
+static int mm_jpeg_queue_has_session(mm_jpeg_queue_t *queue,
+  uint32_t session_id)
+{
+  struct cam_list *head = &queue->head.list;
+  struct cam_list *pos = head->next;
+
+  while (pos != head) {
+    mm_jpeg_q_node_t *node = member_of(pos, mm_jpeg_q_node_t, list);
+    mm_jpeg_job_q_node_t *data = (mm_jpeg_job_q_node_t *)node->data;
+    if (data && (data->enc_info.encode_job.session_id == session_id)) {
+      return 1;
+    }
+    pos = pos->next;
+  }
+  return 0;
+}
+
+/** mm_jpeg_jobmgr_pick_job:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *
+ *  Return:
+ *       job node to be processed, NULL if no job can run now
+ *
+ *  Description:
+ *       Take the first job from todo queue that can run now, i.e.
+ *       there is a free encode slot and its session has no other job
+ *       ongoing, and move it into ongoing queue. Exit cmds can always
+ *       be taken. Must be called with job_lock held.
+ *
+ **/
+static mm_jpeg_job_q_node_t *mm_jpeg_jobmgr_pick_job(mm_jpeg_obj *my_obj)
+{
+  mm_jpeg_queue_t *todo_q = &my_obj->job_mgr.job_queue;
+  mm_jpeg_queue_t *ongoing_q = &my_obj->ongoing_job_q;
+  mm_jpeg_job_q_node_t *job_node = NULL;
+  struct cam_list *head = NULL;
+  struct cam_list *pos = NULL;
+  int slot_free;
+
+  pthread_mutex_lock(&todo_q->lock);
+  pthread_mutex_lock(&ongoing_q->lock);
+  slot_free = (ongoing_q->size < NUM_MAX_JPEG_CNCURRENT_JOBS);
+
+  head = &todo_q->head.list;
+  pos = head->next;
+  while (pos != head) {
+    mm_jpeg_q_node_t *node = member_of(pos, mm_jpeg_q_node_t, list);
+    mm_jpeg_job_q_node_t *data = (mm_jpeg_job_q_node_t *)node->data;
+    pos = pos->next;
+
+    if (NULL == data) {
+      continue;
+    }
+    if ((MM_JPEG_CMD_TYPE_JOB == data->type) &&
+      (!slot_free || mm_jpeg_queue_has_session(ongoing_q,
+        data->enc_info.encode_job.session_id))) {
+      /* keep per session order, later jobs of it stay queued too */
+      continue;
+    }
+
+    cam_list_del_node(&node->list);
+    todo_q->size--;
+    free(node);
+    job_node = data;
+    break;
+  }
+  pthread_mutex_unlock(&ongoing_q->lock);
+  pthread_mutex_unlock(&todo_q->lock);
+
+  if ((NULL != job_node) && (MM_JPEG_CMD_TYPE_JOB == job_node->type)) {
+    /* queue job into ongoing queue, it counts against the encode slots
+     * from now on */
+    if (0 != mm_jpeg_queue_enq(ongoing_q, job_node)) {
+      CDBG_ERROR("%s:%d] jpeg enqueue failed", __func__, __LINE__);
+      free(job_node);
+      return NULL;
+    }
+  }
+  return job_node;
+}
+
 /** mm_jpeg_jobmgr_thread:
  *
  *  Arguments:
@@ -1660,14 +1652,16 @@ error:
  *       0 for success else failure
  *
  *  Description:
- *       job manager thread main function
+ *       job manager thread main function. Every wake up (new job, job
+ *       done, session destroyed) drains all jobs that can run now;
+ *       jobs that cannot run yet are picked up once an ongoing job
+ *       completes and posts the semaphore again.
  *
  **/
 static void *mm_jpeg_jobmgr_thread(void *data)
 {
   int rc = 0;
   int running = 1;
-  uint32_t num_ongoing_jobs = 0;
   mm_jpeg_obj *my_obj = (mm_jpeg_obj*)data;
   mm_jpeg_job_cmd_thread_t *cmd_thread = &my_obj->job_mgr;
   mm_jpeg_job_q_node_t* node = NULL;
@@ -1683,30 +1677,17 @@ static void *mm_jpeg_jobmgr_thread(void *data)
       }
     } while (rc != 0);
 
-    /* check ongoing q size */
-    num_ongoing_jobs = mm_jpeg_queue_get_size(&my_obj->ongoing_job_q);
-    if (num_ongoing_jobs >= NUM_MAX_JPEG_CNCURRENT_JOBS) {
-      CDBG("%s:%d] ongoing job already reach max %d", __func__,
-        __LINE__, num_ongoing_jobs);
-      continue;
-    }
-
     pthread_mutex_lock(&my_obj->job_lock);
     /* can go ahead with new work */
-    node = (mm_jpeg_job_q_node_t*)mm_jpeg_queue_deq(&cmd_thread->job_queue);
-    if (node != NULL) {
-      switch (node->type) {
-      case MM_JPEG_CMD_TYPE_JOB:
-        rc = mm_jpeg_process_encoding_job(my_obj, node);
-        break;
-      case MM_JPEG_CMD_TYPE_EXIT:
-      default:
+    while (NULL != (node = mm_jpeg_jobmgr_pick_job(my_obj))) {
+      if (MM_JPEG_CMD_TYPE_JOB != node->type) {
         /* free node */
         free(node);
         /* set running flag to false */
         running = 0;
         break;
       }
+      rc = mm_jpeg_process_encoding_job(my_obj, node);
     }
     pthread_mutex_unlock(&my_obj->job_lock);
 
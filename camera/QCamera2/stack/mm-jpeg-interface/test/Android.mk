@@ -35,4 +35,23 @@ LOCAL_SHARED_LIBRARIES := liblog libcutils libdl libmmjpeg_interface
 
 include $(BUILD_EXECUTABLE)
 
+# cam_ring_t unit test and throughput benchmark, need no camera or OMX
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Werror -Wno-unused-parameter
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)/../../common
+LOCAL_SRC_FILES := mm_jpeg_ring_test.c
+LOCAL_MODULE := mm-jpeg-ring-test
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Werror -Wno-unused-parameter
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)/../../common
+LOCAL_SRC_FILES := mm_jpeg_ring_bench.c
+LOCAL_MODULE := mm-jpeg-ring-bench
+include $(BUILD_EXECUTABLE)
+
 LOCAL_PATH := $(OLD_LOCAL_PATH)
@@ -0,0 +1,170 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Throughput benchmark for cam_ring_t against the mutex guarded cam_list
+ * queue mm_jpeg_queue_t is built on. One producer and one consumer move
+ * MM_RING_BENCH_XFER pointers, the consumer dequeues in batches from the
+ * ring and one node at a time from the list. Runs on the host as well:
+ *   gcc -O2 -I../../common mm_jpeg_ring_bench.c -lpthread
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "cam_list.h"
+#include "cam_ring.h"
+
+#define MM_RING_BENCH_XFER  2000000
+#define MM_RING_BENCH_SLOTS 64
+#define MM_RING_BENCH_BATCH 16
+
+typedef struct {
+  struct cam_list list;
+  void *data;
+} bench_node_t;
+
+typedef struct {
+  cam_ring_t ring;
+  void *slots[MM_RING_BENCH_SLOTS];
+  bench_node_t head;
+  pthread_mutex_t lock;
+} bench_q_t;
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void *ring_producer(void *arg)
+{
+  bench_q_t *q = (bench_q_t *)arg;
+  uintptr_t i;
+
+  for (i = 1; i <= MM_RING_BENCH_XFER; i++) {
+    while (0 != cam_ring_enq(&q->ring, (void *)i)) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void *list_producer(void *arg)
+{
+  bench_q_t *q = (bench_q_t *)arg;
+  uintptr_t i;
+
+  for (i = 1; i <= MM_RING_BENCH_XFER; i++) {
+    bench_node_t *node = (bench_node_t *)malloc(sizeof(bench_node_t));
+    if (NULL == node) {
+      abort();
+    }
+    node->data = (void *)i;
+    pthread_mutex_lock(&q->lock);
+    cam_list_add_tail_node(&node->list, &q->head.list);
+    pthread_mutex_unlock(&q->lock);
+  }
+  return NULL;
+}
+
+static double bench_ring(void)
+{
+  bench_q_t q;
+  pthread_t tid;
+  void *out[MM_RING_BENCH_BATCH];
+  uintptr_t expect = 1;
+  uint32_t cnt, i;
+  double start;
+
+  cam_ring_init(&q.ring, q.slots, MM_RING_BENCH_SLOTS);
+  start = now_ns();
+  pthread_create(&tid, NULL, ring_producer, &q);
+  while (expect <= MM_RING_BENCH_XFER) {
+    cnt = cam_ring_deq_batch(&q.ring, out, MM_RING_BENCH_BATCH);
+    if (0 == cnt) {
+      sched_yield();
+    }
+    for (i = 0; i < cnt; i++) {
+      if ((void *)expect++ != out[i]) {
+        printf("%s: out of order entry\n", __func__);
+        exit(1);
+      }
+    }
+  }
+  pthread_join(tid, NULL);
+  return (now_ns() - start) / MM_RING_BENCH_XFER;
+}
+
+static double bench_list(void)
+{
+  bench_q_t q;
+  pthread_t tid;
+  uintptr_t expect = 1;
+  double start;
+
+  cam_list_init(&q.head.list);
+  pthread_mutex_init(&q.lock, NULL);
+  start = now_ns();
+  pthread_create(&tid, NULL, list_producer, &q);
+  while (expect <= MM_RING_BENCH_XFER) {
+    bench_node_t *node = NULL;
+    pthread_mutex_lock(&q.lock);
+    if (q.head.list.next != &q.head.list) {
+      node = member_of(q.head.list.next, bench_node_t, list);
+      cam_list_del_node(&node->list);
+    }
+    pthread_mutex_unlock(&q.lock);
+    if (NULL == node) {
+      sched_yield();
+      continue;
+    }
+    if ((void *)expect++ != node->data) {
+      printf("%s: out of order entry\n", __func__);
+      exit(1);
+    }
+    free(node);
+  }
+  pthread_join(tid, NULL);
+  pthread_mutex_destroy(&q.lock);
+  return (now_ns() - start) / MM_RING_BENCH_XFER;
+}
+
+int main(void)
+{
+  double ring_ns = bench_ring();
+  double list_ns = bench_list();
+
+  printf("%d transfers  cam_ring %.1f ns/entry  locked list %.1f ns/entry\n",
+    MM_RING_BENCH_XFER, ring_ns, list_ns);
+  return 0;
+}
@@ -0,0 +1,180 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Unit test for cam_ring_t, the SPSC ring in stack/common.
+ * Runs on the host as well:
+ *   gcc -O2 -I../../common mm_jpeg_ring_test.c -lpthread
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "cam_ring.h"
+
+#define RING_TEST_SIZE 8
+#define RING_TEST_XFER 1000000
+
+static int g_failed;
+
+#define RING_CHECK(cond) ({ \
+  if (!(cond)) { \
+    printf("%s:%d] check failed: %s\n", __func__, __LINE__, #cond); \
+    g_failed++; \
+  } \
+})
+
+static void test_init(void)
+{
+  cam_ring_t ring;
+  void *slots[RING_TEST_SIZE];
+
+  RING_CHECK(0 != cam_ring_init(&ring, NULL, RING_TEST_SIZE));
+  RING_CHECK(0 != cam_ring_init(&ring, slots, 0));
+  RING_CHECK(0 != cam_ring_init(&ring, slots, 6));
+  RING_CHECK(0 == cam_ring_init(&ring, slots, RING_TEST_SIZE));
+  RING_CHECK(cam_ring_empty(&ring));
+}
+
+/* fill to capacity, check full, drain in order, check empty, and do it
+ * enough times for the free running indices to wrap the slot array */
+static void test_fifo(void)
+{
+  cam_ring_t ring;
+  void *slots[RING_TEST_SIZE];
+  void *data = NULL;
+  uintptr_t next_in = 1, next_out = 1;
+  int lap, i;
+
+  cam_ring_init(&ring, slots, RING_TEST_SIZE);
+  for (lap = 0; lap < 5; lap++) {
+    for (i = 0; i < RING_TEST_SIZE; i++) {
+      RING_CHECK(0 == cam_ring_enq(&ring, (void *)next_in++));
+    }
+    RING_CHECK(RING_TEST_SIZE == cam_ring_count(&ring));
+    RING_CHECK(0 != cam_ring_enq(&ring, (void *)next_in));
+    for (i = 0; i < RING_TEST_SIZE; i++) {
+      RING_CHECK(0 == cam_ring_deq(&ring, &data));
+      RING_CHECK((void *)next_out++ == data);
+    }
+    RING_CHECK(0 != cam_ring_deq(&ring, &data));
+    RING_CHECK(cam_ring_empty(&ring));
+
+    /* leave the ring half full so the next lap starts mid array */
+    for (i = 0; i < RING_TEST_SIZE / 2 + lap % 2; i++) {
+      cam_ring_enq(&ring, (void *)next_in++);
+    }
+    while (0 == cam_ring_deq(&ring, &data)) {
+      RING_CHECK((void *)next_out++ == data);
+    }
+  }
+}
+
+static void test_batch(void)
+{
+  cam_ring_t ring;
+  void *slots[RING_TEST_SIZE];
+  void *out[RING_TEST_SIZE];
+  uint32_t cnt;
+  int i;
+
+  cam_ring_init(&ring, slots, RING_TEST_SIZE);
+  RING_CHECK(0 == cam_ring_deq_batch(&ring, out, RING_TEST_SIZE));
+  for (i = 0; i < 5; i++) {
+    cam_ring_enq(&ring, (void *)(uintptr_t)(i + 1));
+  }
+  cnt = cam_ring_deq_batch(&ring, out, 3);
+  RING_CHECK(3 == cnt);
+  RING_CHECK((void *)1 == out[0] && (void *)3 == out[2]);
+  cnt = cam_ring_deq_batch(&ring, out, RING_TEST_SIZE);
+  RING_CHECK(2 == cnt);
+  RING_CHECK((void *)4 == out[0] && (void *)5 == out[1]);
+  RING_CHECK(cam_ring_empty(&ring));
+
+  cam_ring_enq(&ring, (void *)1);
+  cam_ring_reset(&ring);
+  RING_CHECK(cam_ring_empty(&ring));
+}
+
+typedef struct {
+  cam_ring_t ring;
+  void *slots[RING_TEST_SIZE];
+} ring_xfer_t;
+
+static void *test_producer(void *arg)
+{
+  ring_xfer_t *x = (ring_xfer_t *)arg;
+  uintptr_t i;
+
+  for (i = 1; i <= RING_TEST_XFER; i++) {
+    while (0 != cam_ring_enq(&x->ring, (void *)i)) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+/* small ring, so both full and empty paths are hit across threads */
+static void test_threads(void)
+{
+  ring_xfer_t x;
+  pthread_t tid;
+  void *out[RING_TEST_SIZE];
+  uintptr_t expect = 1;
+  uint32_t cnt, i;
+
+  cam_ring_init(&x.ring, x.slots, RING_TEST_SIZE);
+  pthread_create(&tid, NULL, test_producer, &x);
+  while (expect <= RING_TEST_XFER) {
+    cnt = cam_ring_deq_batch(&x.ring, out, RING_TEST_SIZE);
+    if (0 == cnt) {
+      sched_yield();
+    }
+    for (i = 0; i < cnt; i++) {
+      if ((void *)expect != out[i]) {
+        RING_CHECK((void *)expect == out[i]);
+        expect = RING_TEST_XFER + 1;
+        break;
+      }
+      expect++;
+    }
+  }
+  pthread_join(tid, NULL);
+  RING_CHECK(cam_ring_empty(&x.ring));
+}
+
+int main(void)
+{
+  test_init();
+  test_fifo();
+  test_batch();
+  test_threads();
+  printf("cam_ring test %s\n", g_failed ? "FAILED" : "passed");
+  return g_failed ? 1 : 0;
+}
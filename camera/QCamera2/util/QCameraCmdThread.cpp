@@ -30,6 +30,8 @@
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <malloc.h>
+#include <errno.h>
+#include <string.h>
 #include <sys/prctl.h>
 #include "QCameraCmdThread.h"
 
@@ -50,6 +52,8 @@ QCameraCmdThread::QCameraCmdThread() :
     cmd_queue()
 {
     cmd_pid = 0;
+    m_numCmds = 0;
+    m_cmdIdx = 0;
     cam_sem_init(&sync_sem, 0);
     cam_sem_init(&cmd_sem, 0);
 }
@@ -85,6 +89,10 @@ QCameraCmdThread::~QCameraCmdThread()
 int32_t QCameraCmdThread::launch(void *(*start_routine)(void *),
                                  void* user_data)
 {
+    /* cmds left over from a previous run are not for the new thread */
+    m_numCmds = 0;
+    m_cmdIdx = 0;
+
     /* launch the thread */
     pthread_create(&cmd_pid,
                    NULL,
@@ -175,6 +183,83 @@ camera_cmd_type_t QCameraCmdThread::getCmd()
     return cmd;
 }
 
+/*===========================================================================
+ * FUNCTION   : waitCmd
+ *
+ * DESCRIPTION: wait for the next command of the cmd thread. Pending commands
+ *              are taken from cmd queue in batches of up to
+ *              CAMERA_CMD_BATCH_MAX and handed out one per call, so a
+ *              backlog is drained without waking up once per command.
+ *              Only to be called from the cmd thread routine.
+ *
+ * PARAMETERS :
+ *   @cmd     : [out] next command
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraCmdThread::waitCmd(camera_cmd_type_t *cmd)
+{
+    int ret;
+
+    while (m_cmdIdx >= m_numCmds) {
+        do {
+            ret = cam_sem_wait(&cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                      __func__, strerror(errno));
+                return UNKNOWN_ERROR;
+            }
+        } while (ret != 0);
+
+        m_numCmds = getCmds();
+        m_cmdIdx = 0;
+    }
+
+    *cmd = m_cmds[m_cmdIdx++];
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : getCmds
+ *
+ * DESCRIPTION: dequeue all pending commands (up to CAMERA_CMD_BATCH_MAX)
+ *              from cmd queue into m_cmds in one go. Must be called after
+ *              cmd_sem is acquired once; the semaphore counts posted for
+ *              the other dequeued commands are consumed here, so the thread
+ *              does not wake up for them.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of cmds dequeued
+ *==========================================================================*/
+int32_t QCameraCmdThread::getCmds()
+{
+    void *nodes[CAMERA_CMD_BATCH_MAX];
+    int32_t cnt = 0;
+
+    cnt = cmd_queue.dequeueBatch(nodes, CAMERA_CMD_BATCH_MAX);
+    for (int32_t i = 0; i < cnt; i++) {
+        camera_cmd_t *node = (camera_cmd_t *)nodes[i];
+        m_cmds[i] = node->cmd;
+        free(node);
+    }
+
+    // one count was taken by the wake up already. If a sender has not
+    // posted yet, we simply get one more wake up with nothing queued.
+    for (int32_t i = 1; i < cnt; i++) {
+        if (0 != cam_sem_trywait(&cmd_sem)) {
+            break;
+        }
+    }
+
+    if (0 == cnt) {
+        ALOGD("%s: No notify avail", __func__);
+    }
+    return cnt;
+}
+
 /*===========================================================================
  * FUNCTION   : exit
  *
@@ -52,6 +52,9 @@ typedef struct {
     camera_cmd_type_t cmd;
 } camera_cmd_t;
 
+/* max num of cmds taken from cmd queue at once by waitCmd */
+#define CAMERA_CMD_BATCH_MAX 32
+
 class QCameraCmdThread {
 public:
     QCameraCmdThread();
@@ -62,11 +65,19 @@ public:
     int32_t exit();
     int32_t sendCmd(camera_cmd_type_t cmd, uint8_t sync_cmd, uint8_t priority);
     camera_cmd_type_t getCmd();
+    int32_t waitCmd(camera_cmd_type_t *cmd);
 
     QCameraQueue cmd_queue;      /* cmd queue */
     pthread_t cmd_pid;           /* cmd thread ID */
     cam_semaphore_t cmd_sem;               /* semaphore for cmd thread */
     cam_semaphore_t sync_sem;              /* semaphore for synchronized call signal */
+
+private:
+    int32_t getCmds();
+
+    camera_cmd_type_t m_cmds[CAMERA_CMD_BATCH_MAX]; /* batch taken by waitCmd */
+    int32_t m_numCmds;           /* number of cmds in m_cmds */
+    int32_t m_cmdIdx;            /* next cmd of m_cmds to hand out */
 };
 
 }; // namespace qcamera
@@ -0,0 +1,545 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#define LOG_TAG "QCameraFrameDumper"
+
+#include <cutils/properties.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraFrameDumper.h"
+
+using namespace android;
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : getMonotonicMs
+ *
+ * DESCRIPTION: current monotonic time in milliseconds
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : time in ms
+ *==========================================================================*/
+static int64_t getMonotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*===========================================================================
+ * FUNCTION   : getIntProperty
+ *
+ * DESCRIPTION: read an integer system property
+ *
+ * PARAMETERS :
+ *   @name    : property name
+ *   @def     : default value
+ *
+ * RETURN     : property value
+ *==========================================================================*/
+static int32_t getIntProperty(const char *name, int32_t def)
+{
+    char value[PROPERTY_VALUE_MAX];
+    char defValue[PROPERTY_VALUE_MAX];
+    snprintf(defValue, sizeof(defValue), "%d", def);
+    property_get(name, value, defValue);
+    return atoi(value);
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraFrameDumper
+ *
+ * DESCRIPTION: constructor of QCameraFrameDumper. Ring and writer thread
+ *              are only set up once a frame is dumped.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraFrameDumper::QCameraFrameDumper()
+    : mMask(0),
+      mSessionMode(0),
+      mRefreshTime(-QCAMERA_DUMP_PROP_REFRESH_MS),
+      mLaunched(false),
+      mStopping(false),
+      mExit(false),
+      mRing(NULL),
+      mRingSize(0),
+      mFirst(0),
+      mCount(0),
+      mDropped(0),
+      mSessionFd(-1),
+      mSessionMap(NULL),
+      mSessionSize(0),
+      mSessionUsed(0),
+      mSessionCnt(0)
+{
+    memset(&mWriter, 0, sizeof(mWriter));
+    memset(mEntries, 0, sizeof(mEntries));
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mReadyCond, NULL);
+    pthread_cond_init(&mStopCond, NULL);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraFrameDumper
+ *
+ * DESCRIPTION: deconstructor of QCameraFrameDumper
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraFrameDumper::~QCameraFrameDumper()
+{
+    stop();
+    pthread_cond_destroy(&mStopCond);
+    pthread_cond_destroy(&mReadyCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : refreshProperties
+ *
+ * DESCRIPTION: re-read dump properties into the cache
+ *
+ * PARAMETERS :
+ *   @now     : current monotonic time in ms
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraFrameDumper::refreshProperties(int64_t now)
+{
+    __atomic_store_n(&mMask, getIntProperty(QCAMERA_DUMP_PROP_MASK, 0),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&mSessionMode, getIntProperty(QCAMERA_DUMP_PROP_SESSION, 0),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&mRefreshTime, now, __ATOMIC_RELAXED);
+}
+
+/*===========================================================================
+ * FUNCTION   : getDumpMask
+ *
+ * DESCRIPTION: get cached value of the dump mask property, refreshing the
+ *              cache if it is stale
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : dump mask
+ *==========================================================================*/
+int32_t QCameraFrameDumper::getDumpMask()
+{
+    int64_t now = getMonotonicMs();
+    if (now - __atomic_load_n(&mRefreshTime, __ATOMIC_RELAXED) >=
+        QCAMERA_DUMP_PROP_REFRESH_MS) {
+        refreshProperties(now);
+    }
+    return __atomic_load_n(&mMask, __ATOMIC_RELAXED);
+}
+
+/*===========================================================================
+ * FUNCTION   : launch
+ *
+ * DESCRIPTION: allocate the ring and launch the writer thread. Called with
+ *              mLock held.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraFrameDumper::launch()
+{
+    int32_t ringMb = getIntProperty(QCAMERA_DUMP_PROP_RING_MB,
+                                    QCAMERA_DUMP_RING_MB_DEFAULT);
+    if (ringMb <= 0 || ringMb > 1024) {
+        ringMb = QCAMERA_DUMP_RING_MB_DEFAULT;
+    }
+    mRingSize = (uint32_t)ringMb << 20;
+    mRing = (uint8_t *)malloc(mRingSize);
+    if (mRing == NULL) {
+        ALOGE("%s: no mem for %d MB dump ring", __func__, ringMb);
+        mRingSize = 0;
+        return NO_MEMORY;
+    }
+
+    mFirst = 0;
+    mCount = 0;
+    mDropped = 0;
+    mExit = false;
+    if (pthread_create(&mWriter, NULL, writerRoutine, this) != 0) {
+        ALOGE("%s: failed to create dump writer thread", __func__);
+        free(mRing);
+        mRing = NULL;
+        mRingSize = 0;
+        return UNKNOWN_ERROR;
+    }
+    mLaunched = true;
+    ALOGD("%s: dump writer started, ring %d MB", __func__, ringMb);
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : reserve
+ *
+ * DESCRIPTION: find contiguous ring space for a frame copy. Called with
+ *              mLock held. Frame copies are laid out in the ring in the
+ *              order of pending entries, wrapping to the ring start when
+ *              the tail end is too short.
+ *
+ * PARAMETERS :
+ *   @size    : frame size
+ *   @offset  : ring offset of the reserved space
+ *
+ * RETURN     : true if space is found
+ *==========================================================================*/
+bool QCameraFrameDumper::reserve(uint32_t size, uint32_t &offset)
+{
+    if (mCount >= QCAMERA_DUMP_MAX_PENDING || size > mRingSize) {
+        return false;
+    }
+    if (mCount == 0) {
+        offset = 0;
+        return true;
+    }
+
+    const qcamera_dump_entry_t &oldest = mEntries[mFirst];
+    const qcamera_dump_entry_t &newest =
+        mEntries[(mFirst + mCount - 1) % QCAMERA_DUMP_MAX_PENDING];
+    uint32_t head = newest.offset + newest.size;
+    uint32_t tail = oldest.offset;
+
+    if (newest.offset < oldest.offset) {
+        // already wrapped, free space is [head, tail)
+        if (size <= tail - head) {
+            offset = head;
+            return true;
+        }
+    } else if (size <= mRingSize - head) {
+        offset = head;
+        return true;
+    } else if (size <= tail) {
+        offset = 0;
+        return true;
+    }
+    return false;
+}
+
+/*===========================================================================
+ * FUNCTION   : dump
+ *
+ * DESCRIPTION: queue a frame for writing. Frame data is copied, so caller
+ *              may release the frame right after the call. Frames are
+ *              dropped while the dumper is being stopped.
+ *
+ * PARAMETERS :
+ *   @data    : frame data
+ *   @size    : frame size
+ *   @name    : dump file name, or record name in session mode
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraFrameDumper::dump(const void *data, uint32_t size, const char *name)
+{
+    if (data == NULL || size == 0 || name == NULL) {
+        return BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&mLock);
+    if (mStopping) {
+        pthread_mutex_unlock(&mLock);
+        return INVALID_OPERATION;
+    }
+    if (!mLaunched && launch() != NO_ERROR) {
+        pthread_mutex_unlock(&mLock);
+        return NO_MEMORY;
+    }
+
+    uint32_t offset = 0;
+    if (!reserve(size, offset)) {
+        uint32_t dropped = ++mDropped;
+        pthread_mutex_unlock(&mLock);
+        ALOGE("%s: dump ring full, dropped %s (%d dropped)",
+              __func__, name, dropped);
+        return NO_MEMORY;
+    }
+    int idx = (mFirst + mCount) % QCAMERA_DUMP_MAX_PENDING;
+    qcamera_dump_entry_t *entry = &mEntries[idx];
+    entry->offset = offset;
+    entry->size = size;
+    entry->ready = false;
+    entry->session = (__atomic_load_n(&mSessionMode, __ATOMIC_RELAXED) > 0);
+    strlcpy(entry->name, name, sizeof(entry->name));
+    mCount++;
+    pthread_mutex_unlock(&mLock);
+
+    // reserved space is only touched by this thread until entry is ready,
+    // and the writer does not exit while an entry is not ready
+    memcpy(mRing + offset, data, size);
+
+    pthread_mutex_lock(&mLock);
+    entry->ready = true;
+    pthread_cond_signal(&mReadyCond);
+    pthread_mutex_unlock(&mLock);
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : stop
+ *
+ * DESCRIPTION: write out pending frames, stop the writer thread, close the
+ *              session file and release the ring. A later dump starts a
+ *              new session. Only one caller joins the writer, concurrent
+ *              callers wait for it to finish.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraFrameDumper::stop()
+{
+    pthread_mutex_lock(&mLock);
+    if (mStopping) {
+        while (mStopping) {
+            pthread_cond_wait(&mStopCond, &mLock);
+        }
+        pthread_mutex_unlock(&mLock);
+        return;
+    }
+    if (!mLaunched) {
+        pthread_mutex_unlock(&mLock);
+        return;
+    }
+    // no entry is reserved from now on, writer drains the reserved ones
+    mStopping = true;
+    mExit = true;
+    pthread_cond_signal(&mReadyCond);
+    pthread_mutex_unlock(&mLock);
+
+    pthread_join(mWriter, NULL);
+
+    pthread_mutex_lock(&mLock);
+    free(mRing);
+    mRing = NULL;
+    mRingSize = 0;
+    mCount = 0;
+    mLaunched = false;
+    mExit = false;
+    mStopping = false;
+    pthread_cond_broadcast(&mStopCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : writerRoutine
+ *
+ * DESCRIPTION: writer thread, writes out ready entries in queue order.
+ *              On exit, every reserved entry is still waited for and
+ *              written, so the ring is unused once the thread ends.
+ *
+ * PARAMETERS :
+ *   @data    : ptr to QCameraFrameDumper
+ *
+ * RETURN     : NULL
+ *==========================================================================*/
+void *QCameraFrameDumper::writerRoutine(void *data)
+{
+    QCameraFrameDumper *pme = (QCameraFrameDumper *)data;
+
+    pthread_mutex_lock(&pme->mLock);
+    while (1) {
+        while ((pme->mCount == 0 && !pme->mExit) ||
+               (pme->mCount > 0 && !pme->mEntries[pme->mFirst].ready)) {
+            pthread_cond_wait(&pme->mReadyCond, &pme->mLock);
+        }
+        if (pme->mCount == 0) {
+            break;
+        }
+        qcamera_dump_entry_t entry = pme->mEntries[pme->mFirst];
+        pthread_mutex_unlock(&pme->mLock);
+
+        pme->writeEntry(entry);
+
+        // release ring space only after frame is written out
+        pthread_mutex_lock(&pme->mLock);
+        pme->mFirst = (pme->mFirst + 1) % QCAMERA_DUMP_MAX_PENDING;
+        pme->mCount--;
+    }
+    pthread_mutex_unlock(&pme->mLock);
+
+    pme->closeSession();
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : writeEntry
+ *
+ * DESCRIPTION: write one frame copy to its destination
+ *
+ * PARAMETERS :
+ *   @entry   : pending entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraFrameDumper::writeEntry(const qcamera_dump_entry_t &entry)
+{
+    if (entry.session) {
+        writeSession(entry);
+    } else {
+        writeFile(entry);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : writeFile
+ *
+ * DESCRIPTION: write one frame copy to a file of its own
+ *
+ * PARAMETERS :
+ *   @entry   : pending entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraFrameDumper::writeFile(const qcamera_dump_entry_t &entry)
+{
+    ALOGD("dump %s size =%d", entry.name, entry.size);
+    int file_fd = open(entry.name, O_RDWR | O_CREAT, 0777);
+    if (file_fd >= 0) {
+        int written_len = write(file_fd, mRing + entry.offset, entry.size);
+        ALOGD("%s: written number of bytes %d\n", __func__, written_len);
+        close(file_fd);
+    } else {
+        ALOGE("%s: fail t open file for image dumping", __func__);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : writeSession
+ *
+ * DESCRIPTION: append one frame copy to the mmapped session file, which is
+ *              created on the first record of a session
+ *
+ * PARAMETERS :
+ *   @entry   : pending entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraFrameDumper::writeSession(const qcamera_dump_entry_t &entry)
+{
+    if (mSessionFd < 0) {
+        int32_t sessionMb = getIntProperty(QCAMERA_DUMP_PROP_SESSION_MB,
+                                           QCAMERA_DUMP_SESSION_MB_DEFAULT);
+        if (sessionMb <= 0 || sessionMb > 2047) {
+            sessionMb = QCAMERA_DUMP_SESSION_MB_DEFAULT;
+        }
+        char path[QCAMERA_DUMP_NAME_LEN];
+        snprintf(path, sizeof(path), "/data/session_%d_%d.qdmp",
+                 getpid(), mSessionCnt++);
+        mSessionFd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0777);
+        if (mSessionFd < 0) {
+            ALOGE("%s: fail to open session file %s", __func__, path);
+            return;
+        }
+        mSessionSize = (uint32_t)sessionMb << 20;
+        mSessionUsed = 0;
+        void *map = MAP_FAILED;
+        if (ftruncate(mSessionFd, mSessionSize) == 0) {
+            map = mmap(NULL, mSessionSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, mSessionFd, 0);
+        }
+        if (map == MAP_FAILED) {
+            ALOGE("%s: fail to map %d MB session file", __func__, sessionMb);
+            close(mSessionFd);
+            mSessionFd = -1;
+            unlink(path);
+            return;
+        }
+        mSessionMap = (uint8_t *)map;
+        ALOGD("%s: dump session file %s", __func__, path);
+    }
+    if (mSessionMap == NULL) {
+        return;
+    }
+
+    uint32_t recordSize = (sizeof(qcamera_dump_record_t) + entry.size + 7) & ~7;
+    if (recordSize > mSessionSize - mSessionUsed) {
+        ALOGE("%s: session file full, dropped %s", __func__, entry.name);
+        return;
+    }
+    qcamera_dump_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.magic = QCAMERA_DUMP_SESSION_MAGIC;
+    record.size = entry.size;
+    strlcpy(record.name, entry.name, sizeof(record.name));
+    memcpy(mSessionMap + mSessionUsed, &record, sizeof(record));
+    memcpy(mSessionMap + mSessionUsed + sizeof(record),
+           mRing + entry.offset, entry.size);
+    mSessionUsed += recordSize;
+}
+
+/*===========================================================================
+ * FUNCTION   : closeSession
+ *
+ * DESCRIPTION: unmap the session file and trim it to the records written
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraFrameDumper::closeSession()
+{
+    if (mSessionMap != NULL) {
+        munmap(mSessionMap, mSessionSize);
+        mSessionMap = NULL;
+    }
+    if (mSessionFd >= 0) {
+        if (ftruncate(mSessionFd, mSessionUsed) != 0) {
+            ALOGE("%s: fail to trim session file", __func__);
+        }
+        close(mSessionFd);
+        mSessionFd = -1;
+        ALOGD("%s: dump session closed, %d bytes", __func__, mSessionUsed);
+    }
+    mSessionSize = 0;
+    mSessionUsed = 0;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,124 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_FRAME_DUMPER_H__
+#define __QCAMERA_FRAME_DUMPER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+/* bit mask of frame types to dump, see QCAMERA_DUMP_FRM_* */
+#define QCAMERA_DUMP_PROP_MASK      "persist.camera.dumpimg"
+/* 1: append all frames of a session to one mmapped file */
+#define QCAMERA_DUMP_PROP_SESSION   "persist.camera.dumpimg.session"
+/* size in MB of the ring frames are copied into before writing */
+#define QCAMERA_DUMP_PROP_RING_MB   "persist.camera.dumpimg.ringmb"
+/* max size in MB of a session file */
+#define QCAMERA_DUMP_PROP_SESSION_MB "persist.camera.dumpimg.sessionmb"
+
+#define QCAMERA_DUMP_RING_MB_DEFAULT     32
+#define QCAMERA_DUMP_SESSION_MB_DEFAULT  256
+#define QCAMERA_DUMP_PROP_REFRESH_MS     1000
+#define QCAMERA_DUMP_MAX_PENDING         16
+#define QCAMERA_DUMP_NAME_LEN            64
+#define QCAMERA_DUMP_SESSION_MAGIC       0x504D4451 // "QDMP"
+
+// record header in a session file, followed by @size bytes of frame data
+// and padding up to 8 bytes
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    char name[QCAMERA_DUMP_NAME_LEN];
+} qcamera_dump_record_t;
+
+typedef struct {
+    uint32_t offset;             // offset of frame copy in ring
+    uint32_t size;               // frame size
+    bool ready;                  // frame copy is complete
+    bool session;                // goes to session file, not to @name
+    char name[QCAMERA_DUMP_NAME_LEN];
+} qcamera_dump_entry_t;
+
+// Debug frame dumper. Frames are copied into a preallocated ring on the
+// caller thread and written out by a dedicated writer thread, so stream
+// callbacks never block on file I/O. Frames not fitting into the ring are
+// dropped. Dump properties are cached and refreshed at most once per
+// QCAMERA_DUMP_PROP_REFRESH_MS.
+class QCameraFrameDumper {
+public:
+    QCameraFrameDumper();
+    virtual ~QCameraFrameDumper();
+
+    int32_t getDumpMask();
+    int32_t dump(const void *data, uint32_t size, const char *name);
+    void stop();
+
+private:
+    void refreshProperties(int64_t now);
+    int32_t launch();
+    bool reserve(uint32_t size, uint32_t &offset);
+    void writeEntry(const qcamera_dump_entry_t &entry);
+    void writeFile(const qcamera_dump_entry_t &entry);
+    void writeSession(const qcamera_dump_entry_t &entry);
+    void closeSession();
+    static void *writerRoutine(void *data);
+
+    // cached properties, refreshed by any caller once they are stale
+    int32_t mMask;
+    int32_t mSessionMode;
+    int64_t mRefreshTime;
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mReadyCond;   // signals a ready entry or exit to writer
+    pthread_cond_t mStopCond;    // signals end of a stop to other stoppers
+    pthread_t mWriter;
+    bool mLaunched;
+    bool mStopping;              // a stop() is joining the writer
+    bool mExit;
+
+    uint8_t *mRing;
+    uint32_t mRingSize;
+    qcamera_dump_entry_t mEntries[QCAMERA_DUMP_MAX_PENDING];
+    int mFirst;                  // oldest pending entry
+    int mCount;                  // number of pending entries
+    uint32_t mDropped;           // frames dropped for lack of ring space
+
+    // session file, only touched by the writer thread
+    int mSessionFd;
+    uint8_t *mSessionMap;
+    uint32_t mSessionSize;
+    uint32_t mSessionUsed;
+    int mSessionCnt;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_FRAME_DUMPER_H__ */
@@ -0,0 +1,231 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#define LOG_TAG "QCameraLatencyHistogram"
+
+#include <utils/Log.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraLatencyHistogram.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : now
+ *
+ * DESCRIPTION: monotonic timestamp to take latencies with
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : time in ns
+ *==========================================================================*/
+int64_t QCameraLatencyHistogram::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraLatencyHistogram
+ *
+ * DESCRIPTION: constructor of QCameraLatencyHistogram
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraLatencyHistogram::QCameraLatencyHistogram()
+{
+    reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: drop all samples
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraLatencyHistogram::reset()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mSumUs = 0;
+    mMaxUs = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*===========================================================================
+ * FUNCTION   : getBucket
+ *
+ * DESCRIPTION: bucket of a latency. Below 4 us buckets are 1 us wide,
+ *              above that each power of two is split into 4 buckets.
+ *
+ * PARAMETERS :
+ *   @us      : latency in us
+ *
+ * RETURN     : bucket index
+ *==========================================================================*/
+int QCameraLatencyHistogram::getBucket(uint64_t us)
+{
+    if (us < QCAMERA_LATENCY_SUB_BUCKETS) {
+        return (int)us;
+    }
+    int msb = 63 - __builtin_clzll(us);
+    int sub = (int)(us >> (msb - 2)) & (QCAMERA_LATENCY_SUB_BUCKETS - 1);
+    int bucket = QCAMERA_LATENCY_SUB_BUCKETS * (msb - 1) + sub;
+    return (bucket < QCAMERA_LATENCY_BUCKETS) ?
+        bucket : QCAMERA_LATENCY_BUCKETS - 1;
+}
+
+/*===========================================================================
+ * FUNCTION   : getBucketLow
+ *
+ * DESCRIPTION: smallest latency falling into a bucket
+ *
+ * PARAMETERS :
+ *   @bucket  : bucket index
+ *
+ * RETURN     : latency in us
+ *==========================================================================*/
+uint64_t QCameraLatencyHistogram::getBucketLow(int bucket)
+{
+    if (bucket < QCAMERA_LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int msb = bucket / QCAMERA_LATENCY_SUB_BUCKETS + 1;
+    uint64_t sub = bucket % QCAMERA_LATENCY_SUB_BUCKETS;
+    return (QCAMERA_LATENCY_SUB_BUCKETS + sub) << (msb - 2);
+}
+
+/*===========================================================================
+ * FUNCTION   : add
+ *
+ * DESCRIPTION: add one latency sample
+ *
+ * PARAMETERS :
+ *   @latencyNs : latency in ns, negative values count as 0
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraLatencyHistogram::add(int64_t latencyNs)
+{
+    int64_t us = (latencyNs > 0) ? latencyNs / 1000 : 0;
+    __atomic_fetch_add(&mBuckets[getBucket((uint64_t)us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mCount, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mSumUs, us, __ATOMIC_RELAXED);
+
+    int64_t max = __atomic_load_n(&mMaxUs, __ATOMIC_RELAXED);
+    while (us > max &&
+           !__atomic_compare_exchange_n(&mMaxUs, &max, us, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getPercentile
+ *
+ * DESCRIPTION: upper bound of the bucket holding a percentile
+ *
+ * PARAMETERS :
+ *   @count   : total sample count
+ *   @percent : percentile, 1 to 100
+ *
+ * RETURN     : latency in us
+ *==========================================================================*/
+uint64_t QCameraLatencyHistogram::getPercentile(uint32_t count, int percent)
+{
+    uint64_t rank = ((uint64_t)count * percent + 99) / 100;
+    uint64_t seen = 0;
+    uint64_t max = (uint64_t)__atomic_load_n(&mMaxUs, __ATOMIC_RELAXED);
+    for (int i = 0; i < QCAMERA_LATENCY_BUCKETS - 1; i++) {
+        seen += __atomic_load_n(&mBuckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            // the bound of the top bucket is never above the worst sample
+            return getBucketLow(i + 1) < max ? getBucketLow(i + 1) : max;
+        }
+    }
+    return max;
+}
+
+/*===========================================================================
+ * FUNCTION   : dump
+ *
+ * DESCRIPTION: write a summary line and the non empty buckets as text
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *   @name    : histogram name printed in front of it
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraLatencyHistogram::dump(int fd, const char *name)
+{
+    char buf[2048];
+    int len = 0;
+    uint32_t count = __atomic_load_n(&mCount, __ATOMIC_RELAXED);
+
+    if (count == 0) {
+        len = snprintf(buf, sizeof(buf), "  %s: no samples\n", name);
+    } else {
+        len = snprintf(buf, sizeof(buf),
+            "  %s: n %u, avg %.2f ms, p50 <= %.2f ms, p90 <= %.2f ms, "
+            "p99 <= %.2f ms, max %.2f ms\n    ",
+            name, count,
+            __atomic_load_n(&mSumUs, __ATOMIC_RELAXED) / 1000.0 / count,
+            getPercentile(count, 50) / 1000.0,
+            getPercentile(count, 90) / 1000.0,
+            getPercentile(count, 99) / 1000.0,
+            __atomic_load_n(&mMaxUs, __ATOMIC_RELAXED) / 1000.0);
+        for (int i = 0; i < QCAMERA_LATENCY_BUCKETS &&
+             len < (int)sizeof(buf) - 1; i++) {
+            uint32_t n = __atomic_load_n(&mBuckets[i], __ATOMIC_RELAXED);
+            if (n != 0) {
+                len += snprintf(buf + len, sizeof(buf) - len, "[%.2f ms]:%u ",
+                                getBucketLow(i) / 1000.0, n);
+            }
+        }
+        if (len < (int)sizeof(buf) - 1) {
+            len += snprintf(buf + len, sizeof(buf) - len, "\n");
+        }
+    }
+    if (len > (int)sizeof(buf) - 1) {
+        len = sizeof(buf) - 1;
+    }
+    if (write(fd, buf, len) != len) {
+        ALOGE("%s: failed to write histogram %s", __func__, name);
+    }
+}
+
+}; // namespace qcamera
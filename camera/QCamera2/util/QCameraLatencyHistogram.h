@@ -0,0 +1,68 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_LATENCY_HISTOGRAM_H__
+#define __QCAMERA_LATENCY_HISTOGRAM_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+/* log-linear buckets: 4 linear steps per power of two of microseconds,
+ * values of 2^25 us (~33 s) and above land in the last bucket */
+#define QCAMERA_LATENCY_SUB_BUCKETS 4
+#define QCAMERA_LATENCY_BUCKETS     96
+
+// Fixed size latency histogram with ~25% bucket resolution. Samples are
+// added with relaxed atomics, so it can be fed from any thread and
+// dumped without a lock.
+class QCameraLatencyHistogram {
+public:
+    QCameraLatencyHistogram();
+
+    void reset();
+    void add(int64_t latencyNs);
+    void dump(int fd, const char *name);
+
+    static int64_t now();
+
+private:
+    static int getBucket(uint64_t us);
+    static uint64_t getBucketLow(int bucket);
+    uint64_t getPercentile(uint32_t count, int percent);
+
+    uint32_t mBuckets[QCAMERA_LATENCY_BUCKETS];
+    uint32_t mCount;
+    int64_t mSumUs;
+    int64_t mMaxUs;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_LATENCY_HISTOGRAM_H__ */
@@ -0,0 +1,208 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_MAP_INDEX_H__
+#define __QCAMERA_MAP_INDEX_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace qcamera {
+
+#define QCAMERA_MAP_INDEX_MAX_TABLES 64   /* power of 2 */
+
+/* Hash index over the static QCameraMap style tables of HAL1 and HAL3.
+ * The tables reference framework strings that live in other libraries, so
+ * the index cannot be built at compile time; instead it is built the first
+ * time a table is looked up and kept for the life of the process. Tables
+ * are identified by their address, so callers keep passing (arr, len) as
+ * before. Lookups return the index of the first entry matching the key, the
+ * same entry a linear scan would find.
+ *
+ * Traits provide:
+ *   typedef ... Entry; typedef ... Key;
+ *   static uint32_t hash(Key key);
+ *   static uint32_t hashEntry(const Entry &e);
+ *   static bool match(const Entry &e, Key key);
+ *   static bool sameKey(const Entry &a, const Entry &b);
+ */
+template <typename Traits>
+class QCameraMapIndex {
+public:
+    typedef typename Traits::Entry Entry;
+    typedef typename Traits::Key Key;
+
+    /* returns index into arr, or -1 if key is not found */
+    static int find(const Entry *arr, int len, Key key)
+    {
+        const Table *t = getTable(arr, len);
+        if (NULL == t) {
+            return findLinear(arr, len, key);
+        }
+        uint32_t h = Traits::hash(key) & t->mask;
+        while (t->slots[h] >= 0) {
+            if (Traits::match(arr[t->slots[h]], key)) {
+                return t->slots[h];
+            }
+            h = (h + 1) & t->mask;
+        }
+        return -1;
+    }
+
+private:
+    typedef struct {
+        const Entry *arr;      /* published last, NULL if slot unused */
+        int len;
+        uint32_t mask;
+        int16_t *slots;        /* entry index per hash slot, -1 if empty */
+    } Table;
+
+    static int findLinear(const Entry *arr, int len, Key key)
+    {
+        for (int i = 0; i < len; i++) {
+            if (Traits::match(arr[i], key)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static uint32_t tableSlot(const Entry *arr)
+    {
+        uintptr_t p = (uintptr_t)arr;
+        return (uint32_t)((p >> 3) ^ (p >> 11)) & (QCAMERA_MAP_INDEX_MAX_TABLES - 1);
+    }
+
+    static const Table *getTable(const Entry *arr, int len)
+    {
+        uint32_t s = tableSlot(arr);
+        for (int n = 0; n < QCAMERA_MAP_INDEX_MAX_TABLES; n++) {
+            const Entry *cur = __atomic_load_n(&sTables[s].arr, __ATOMIC_ACQUIRE);
+            if (cur == arr) {
+                return (sTables[s].len == len) ? &sTables[s] : NULL;
+            }
+            if (NULL == cur) {
+                return buildTable(arr, len);
+            }
+            s = (s + 1) & (QCAMERA_MAP_INDEX_MAX_TABLES - 1);
+        }
+        return NULL;
+    }
+
+    static const Table *buildTable(const Entry *arr, int len)
+    {
+        const Table *ret = NULL;
+
+        if (len <= 0 || len > 0x3fff) {
+            return NULL;
+        }
+
+        pthread_mutex_lock(&sLock);
+        uint32_t s = tableSlot(arr);
+        for (int n = 0; n < QCAMERA_MAP_INDEX_MAX_TABLES; n++) {
+            Table *t = &sTables[s];
+            if (t->arr == arr) {
+                /* built by another thread meanwhile */
+                ret = (t->len == len) ? t : NULL;
+                break;
+            }
+            if (NULL == t->arr) {
+                uint32_t size = 4;
+                while (size < (uint32_t)len * 2) {
+                    size <<= 1;
+                }
+                int16_t *slots = (int16_t *)malloc(size * sizeof(int16_t));
+                if (NULL == slots) {
+                    break;
+                }
+                memset(slots, 0xff, size * sizeof(int16_t));
+                for (int i = 0; i < len; i++) {
+                    uint32_t h = Traits::hashEntry(arr[i]) & (size - 1);
+                    bool dup = false;
+                    while (slots[h] >= 0) {
+                        if (Traits::sameKey(arr[slots[h]], arr[i])) {
+                            /* keep the first entry, as a linear scan would */
+                            dup = true;
+                            break;
+                        }
+                        h = (h + 1) & (size - 1);
+                    }
+                    if (!dup) {
+                        slots[h] = (int16_t)i;
+                    }
+                }
+                t->len = len;
+                t->mask = size - 1;
+                t->slots = slots;
+                __atomic_store_n(&t->arr, arr, __ATOMIC_RELEASE);
+                ret = t;
+                break;
+            }
+            s = (s + 1) & (QCAMERA_MAP_INDEX_MAX_TABLES - 1);
+        }
+        pthread_mutex_unlock(&sLock);
+        return ret;
+    }
+
+    static Table sTables[QCAMERA_MAP_INDEX_MAX_TABLES];
+    static pthread_mutex_t sLock;
+};
+
+template <typename Traits>
+typename QCameraMapIndex<Traits>::Table
+    QCameraMapIndex<Traits>::sTables[QCAMERA_MAP_INDEX_MAX_TABLES];
+
+template <typename Traits>
+pthread_mutex_t QCameraMapIndex<Traits>::sLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a, for string keyed tables */
+inline uint32_t qcamera_map_hash_str(const char *str)
+{
+    uint32_t h = 2166136261u;
+    while (*str) {
+        h ^= (uint8_t)*str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* integer mix, for value keyed tables */
+inline uint32_t qcamera_map_hash_int(uint32_t v)
+{
+    v ^= v >> 16;
+    v *= 0x7feb352du;
+    v ^= v >> 15;
+    return v;
+}
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_MAP_INDEX_H__ */
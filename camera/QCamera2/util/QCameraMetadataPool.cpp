@@ -0,0 +1,172 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#define LOG_TAG "QCameraMetadataPool"
+
+#include <utils/Log.h>
+#include "QCameraMetadataPool.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraMetadataPool
+ *
+ * DESCRIPTION: constructor of QCameraMetadataPool
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraMetadataPool::QCameraMetadataPool()
+    : mFreeCnt(0),
+      mEntryCnt(0),
+      mDataCnt(0),
+      mSampleCnt(0),
+      mReuseCnt(0),
+      mAllocCnt(0)
+{
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraMetadataPool
+ *
+ * DESCRIPTION: deconstructor of QCameraMetadataPool
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraMetadataPool::~QCameraMetadataPool()
+{
+    clear();
+}
+
+/*===========================================================================
+ * FUNCTION   : get
+ *
+ * DESCRIPTION: get an empty result buffer. Until enough results are seen
+ *              to know the needed capacity no buffer is handed out, and
+ *              pooled buffers smaller than the largest result are freed.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : empty buffer, owned by the caller
+ *              NULL if the capacity is not learned yet or on no memory
+ *==========================================================================*/
+camera_metadata_t *QCameraMetadataPool::get()
+{
+    while (mFreeCnt > 0) {
+        camera_metadata_t *meta = mFree[--mFreeCnt];
+        // pooled before a bigger result came in
+        if (get_camera_metadata_entry_capacity(meta) < mEntryCnt ||
+                get_camera_metadata_data_capacity(meta) < mDataCnt) {
+            free_camera_metadata(meta);
+            continue;
+        }
+        mReuseCnt++;
+        // lay out an empty buffer in place, keeping its capacity
+        return place_camera_metadata(meta, get_camera_metadata_size(meta),
+                get_camera_metadata_entry_capacity(meta),
+                get_camera_metadata_data_capacity(meta));
+    }
+    if (mSampleCnt < QCAMERA_METADATA_LEARN_CNT) {
+        return NULL;
+    }
+
+    // some headroom for entries that show up only now and then
+    camera_metadata_t *meta = allocate_camera_metadata(
+            mEntryCnt + mEntryCnt / 4, mDataCnt + mDataCnt / 4);
+    if (meta == NULL) {
+        ALOGE("%s: failed to allocate result buffer", __func__);
+        return NULL;
+    }
+    mAllocCnt++;
+    return meta;
+}
+
+/*===========================================================================
+ * FUNCTION   : put
+ *
+ * DESCRIPTION: return a result buffer after it was sent. Buffers too small
+ *              for the largest result seen are freed.
+ *
+ * PARAMETERS :
+ *   @meta    : buffer from get() or any buffer that can be freed with
+ *              free_camera_metadata
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMetadataPool::put(camera_metadata_t *meta)
+{
+    if (meta == NULL) {
+        return;
+    }
+
+    size_t entries = get_camera_metadata_entry_count(meta);
+    size_t data = get_camera_metadata_data_count(meta);
+    if (entries > mEntryCnt) {
+        mEntryCnt = entries;
+    }
+    if (data > mDataCnt) {
+        mDataCnt = data;
+    }
+    if (mSampleCnt < QCAMERA_METADATA_LEARN_CNT) {
+        mSampleCnt++;
+    }
+
+    if (mSampleCnt < QCAMERA_METADATA_LEARN_CNT ||
+            mFreeCnt == QCAMERA_METADATA_POOL_SIZE ||
+            get_camera_metadata_entry_capacity(meta) < mEntryCnt ||
+            get_camera_metadata_data_capacity(meta) < mDataCnt) {
+        free_camera_metadata(meta);
+        return;
+    }
+    mFree[mFreeCnt++] = meta;
+}
+
+/*===========================================================================
+ * FUNCTION   : clear
+ *
+ * DESCRIPTION: free all pooled buffers and forget the learned capacity
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMetadataPool::clear()
+{
+    while (mFreeCnt > 0) {
+        free_camera_metadata(mFree[--mFreeCnt]);
+    }
+    mEntryCnt = 0;
+    mDataCnt = 0;
+    mSampleCnt = 0;
+}
+
+}; // namespace qcamera
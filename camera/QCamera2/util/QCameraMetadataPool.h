@@ -0,0 +1,70 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_METADATA_POOL_H__
+#define __QCAMERA_METADATA_POOL_H__
+
+#include <stdint.h>
+#include <system/camera_metadata.h>
+
+namespace qcamera {
+
+/* result buffers kept for reuse, and frames observed before buffers are
+ * allocated with the learned capacity */
+#define QCAMERA_METADATA_POOL_SIZE   4
+#define QCAMERA_METADATA_LEARN_CNT   8
+
+// Pool of camera_metadata_t result buffers. Buffers are sized after the
+// largest result seen, so building a result does not grow its buffer.
+// Not thread safe, the owner serializes access.
+class QCameraMetadataPool {
+public:
+    QCameraMetadataPool();
+    ~QCameraMetadataPool();
+
+    camera_metadata_t *get();
+    void put(camera_metadata_t *meta);
+    void clear();
+
+    uint32_t getReuseCnt() const { return mReuseCnt; }
+    uint32_t getAllocCnt() const { return mAllocCnt; }
+
+private:
+    camera_metadata_t *mFree[QCAMERA_METADATA_POOL_SIZE];
+    uint32_t mFreeCnt;
+    size_t mEntryCnt;     // most entries in a result so far
+    size_t mDataCnt;      // most data bytes in a result so far
+    uint32_t mSampleCnt;
+    uint32_t mReuseCnt;
+    uint32_t mAllocCnt;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_METADATA_POOL_H__ */
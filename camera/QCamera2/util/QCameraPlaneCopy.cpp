@@ -0,0 +1,168 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include "QCameraPlaneCopy.h"
+
+#ifdef QCAMERA_PLANE_COPY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : compactPlaneC
+ *
+ * DESCRIPTION: portable plane copy, one memcpy per row. Rows are coalesced
+ *              into a single copy when neither plane is padded.
+ *
+ * PARAMETERS :
+ *   @dst       : destination plane
+ *   @dstStride : destination row stride in bytes
+ *   @src       : source plane
+ *   @srcStride : source row stride in bytes
+ *   @width     : bytes to copy per row
+ *   @height    : number of rows
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void compactPlaneC(uint8_t *dst, int dstStride,
+                   const uint8_t *src, int srcStride,
+                   int width, int height)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (srcStride == width && dstStride == width) {
+        memcpy(dst, src, (size_t)width * height);
+        return;
+    }
+    for (int i = 0; i < height; i++) {
+        memcpy(dst, src, width);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+#ifdef QCAMERA_PLANE_COPY_NEON
+/*===========================================================================
+ * FUNCTION   : compactPlaneNeon
+ *
+ * DESCRIPTION: NEON plane copy. Each row is moved in 64 byte blocks through
+ *              q registers, then 16 byte blocks, then a scalar tail. Source
+ *              rows are prefetched one row ahead since padded planes defeat
+ *              the hardware stream detection at row boundaries.
+ *
+ * PARAMETERS :
+ *   @dst       : destination plane
+ *   @dstStride : destination row stride in bytes
+ *   @src       : source plane
+ *   @srcStride : source row stride in bytes
+ *   @width     : bytes to copy per row
+ *   @height    : number of rows
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void compactPlaneNeon(uint8_t *dst, int dstStride,
+                      const uint8_t *src, int srcStride,
+                      int width, int height)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (srcStride == width && dstStride == width) {
+        width *= height;
+        height = 1;
+    }
+    for (int i = 0; i < height; i++) {
+        const uint8_t *s = src;
+        uint8_t *d = dst;
+        int n = width;
+
+        if (i + 1 < height) {
+            __builtin_prefetch(src + srcStride);
+        }
+        while (n >= 64) {
+            uint8x16_t v0 = vld1q_u8(s);
+            uint8x16_t v1 = vld1q_u8(s + 16);
+            uint8x16_t v2 = vld1q_u8(s + 32);
+            uint8x16_t v3 = vld1q_u8(s + 48);
+            __builtin_prefetch(s + 256);
+            vst1q_u8(d, v0);
+            vst1q_u8(d + 16, v1);
+            vst1q_u8(d + 32, v2);
+            vst1q_u8(d + 48, v3);
+            s += 64;
+            d += 64;
+            n -= 64;
+        }
+        while (n >= 16) {
+            vst1q_u8(d, vld1q_u8(s));
+            s += 16;
+            d += 16;
+            n -= 16;
+        }
+        while (n > 0) {
+            *d++ = *s++;
+            n--;
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+#endif
+
+/*===========================================================================
+ * FUNCTION   : compactPlane
+ *
+ * DESCRIPTION: copy a padded plane into a tightly packed (or differently
+ *              padded) plane with the best kernel available
+ *
+ * PARAMETERS :
+ *   @dst       : destination plane
+ *   @dstStride : destination row stride in bytes
+ *   @src       : source plane
+ *   @srcStride : source row stride in bytes
+ *   @width     : bytes to copy per row
+ *   @height    : number of rows
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void compactPlane(uint8_t *dst, int dstStride,
+                  const uint8_t *src, int srcStride,
+                  int width, int height)
+{
+#ifdef QCAMERA_PLANE_COPY_NEON
+    compactPlaneNeon(dst, dstStride, src, srcStride, width, height);
+#else
+    compactPlaneC(dst, dstStride, src, srcStride, width, height);
+#endif
+}
+
+}; // namespace qcamera
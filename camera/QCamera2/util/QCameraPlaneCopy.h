@@ -0,0 +1,58 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_PLANE_COPY_H__
+#define __QCAMERA_PLANE_COPY_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+// Copy height rows of width bytes from a plane with srcStride into a plane
+// with dstStride. Used to drop stride/scanline padding of image planes.
+// compactPlane picks the NEON kernel when built for it, the scalar one
+// otherwise. Both produce identical output.
+void compactPlane(uint8_t *dst, int dstStride,
+                  const uint8_t *src, int srcStride,
+                  int width, int height);
+
+void compactPlaneC(uint8_t *dst, int dstStride,
+                   const uint8_t *src, int srcStride,
+                   int width, int height);
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define QCAMERA_PLANE_COPY_NEON
+void compactPlaneNeon(uint8_t *dst, int dstStride,
+                      const uint8_t *src, int srcStride,
+                      int width, int height);
+#endif
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_PLANE_COPY_H__ */
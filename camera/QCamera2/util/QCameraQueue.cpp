@@ -31,6 +31,7 @@
 #include <utils/Log.h>
 #include <malloc.h>
 #include <string.h>
+#include <sched.h>
 #include "QCameraQueue.h"
 
 namespace qcamera {
@@ -49,9 +50,16 @@ QCameraQueue::QCameraQueue()
     pthread_mutex_init(&m_lock, NULL);
     cam_list_init(&m_head.list);
     m_size = 0;
+    cam_list_init(&m_prioHead.list);
+    m_prioSize = 0;
     m_dataFn = NULL;
     m_userData = NULL;
     m_active = true;
+    m_mode = QCAMERA_QUEUE_MODE_LIST;
+    memset(&m_ring, 0, sizeof(m_ring));
+    memset(&m_prioRing, 0, sizeof(m_prioRing));
+    m_ringUsers = 0;
+    m_ringHeld = false;
 }
 
 /*===========================================================================
@@ -70,9 +78,57 @@ QCameraQueue::QCameraQueue(release_data_fn data_rel_fn, void *user_data)
     pthread_mutex_init(&m_lock, NULL);
     cam_list_init(&m_head.list);
     m_size = 0;
+    cam_list_init(&m_prioHead.list);
+    m_prioSize = 0;
     m_dataFn = data_rel_fn;
     m_userData = user_data;
     m_active = true;
+    m_mode = QCAMERA_QUEUE_MODE_LIST;
+    memset(&m_ring, 0, sizeof(m_ring));
+    memset(&m_prioRing, 0, sizeof(m_prioRing));
+    m_ringUsers = 0;
+    m_ringHeld = false;
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraQueue
+ *
+ * DESCRIPTION: constructor of QCameraQueue with selectable queue mode.
+ *              In ring mode all slots are preallocated here, enqueue and
+ *              dequeue are lock-free and never touch the heap while fewer
+ *              than ring_size entries are pending. Beyond that, entries
+ *              spill into the list until the consumer catches up.
+ *
+ * PARAMETERS :
+ *   @data_rel_fn : function ptr to release node data internal resource
+ *   @user_data   : user data ptr
+ *   @mode        : QCAMERA_QUEUE_MODE_LIST or QCAMERA_QUEUE_MODE_RING
+ *   @ring_size   : max number of pending entries in ring mode, rounded up
+ *                  to power of 2. Ignored in list mode.
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraQueue::QCameraQueue(release_data_fn data_rel_fn, void *user_data,
+                           qcamera_queue_mode_t mode, uint32_t ring_size)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    cam_list_init(&m_head.list);
+    m_size = 0;
+    cam_list_init(&m_prioHead.list);
+    m_prioSize = 0;
+    m_dataFn = data_rel_fn;
+    m_userData = user_data;
+    m_active = true;
+    m_mode = mode;
+    memset(&m_ring, 0, sizeof(m_ring));
+    memset(&m_prioRing, 0, sizeof(m_prioRing));
+    m_ringUsers = 0;
+    m_ringHeld = false;
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        initRing(&m_ring, ring_size);
+        // priority entries are rare (exit/flush type cmds), a quarter is plenty
+        initRing(&m_prioRing, (ring_size / 4 > 4) ? ring_size / 4 : 4);
+    }
 }
 
 /*===========================================================================
@@ -87,9 +143,192 @@ QCameraQueue::QCameraQueue(release_data_fn data_rel_fn, void *user_data)
 QCameraQueue::~QCameraQueue()
 {
     flush();
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        deinitRing(&m_prioRing);
+        deinitRing(&m_ring);
+    }
     pthread_mutex_destroy(&m_lock);
 }
 
+/*===========================================================================
+ * FUNCTION   : initRing
+ *
+ * DESCRIPTION: preallocate slots of a ring and reset its positions
+ *
+ * PARAMETERS :
+ *   @ring    : ring to be initialized
+ *   @size    : requested number of slots, rounded up to power of 2
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::initRing(camera_q_ring *ring, uint32_t size)
+{
+    uint32_t cnt = 1;
+    while (cnt < size) {
+        cnt <<= 1;
+    }
+
+    ring->slots = (camera_q_slot *)malloc(sizeof(camera_q_slot) * cnt);
+    ring->kept = (void **)malloc(sizeof(void *) * cnt);
+    if (NULL == ring->slots || NULL == ring->kept) {
+        ALOGE("%s: No memory for %d ring slots", __func__, cnt);
+        free(ring->slots);
+        free(ring->kept);
+        ring->slots = NULL;
+        ring->kept = NULL;
+        ring->mask = 0;
+        return;
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        ring->slots[i].seq = i;
+        ring->slots[i].data = NULL;
+    }
+    ring->mask = cnt - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : deinitRing
+ *
+ * DESCRIPTION: release preallocated slots of a ring
+ *
+ * PARAMETERS :
+ *   @ring    : ring to be released
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::deinitRing(camera_q_ring *ring)
+{
+    if (NULL != ring->slots) {
+        free(ring->slots);
+        ring->slots = NULL;
+    }
+    if (NULL != ring->kept) {
+        free(ring->kept);
+        ring->kept = NULL;
+    }
+    ring->mask = 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : ringPush
+ *
+ * DESCRIPTION: lock-free push of data into the tail of a ring. Safe to be
+ *              called from multiple producers concurrently.
+ *
+ * PARAMETERS :
+ *   @ring    : ring to push into
+ *   @data    : data to be pushed
+ *
+ * RETURN     : true -- success; false -- ring is full
+ *==========================================================================*/
+bool QCameraQueue::ringPush(camera_q_ring *ring, void *data)
+{
+    if (NULL == ring->slots) {
+        return false;
+    }
+
+    uint32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        camera_q_slot *slot = &ring->slots[pos & ring->mask];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // slot is free for this lap, try to claim it
+            if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                slot->data = data;
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            // pos has been reloaded by the failed CAS
+        } else if (diff < 0) {
+            // consumer has not released this slot yet, ring is full
+            return false;
+        } else {
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : ringPop
+ *
+ * DESCRIPTION: lock-free pop of data from the head of a ring
+ *
+ * PARAMETERS :
+ *   @ring    : ring to pop from
+ *
+ * RETURN     : data ptr. NULL if ring is empty.
+ *==========================================================================*/
+void* QCameraQueue::ringPop(camera_q_ring *ring)
+{
+    if (NULL == ring->slots) {
+        return NULL;
+    }
+
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    for (;;) {
+        camera_q_slot *slot = &ring->slots[pos & ring->mask];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                void *data = slot->data;
+                // hand the slot back to producers for the next lap
+                __atomic_store_n(&slot->seq, pos + ring->mask + 1,
+                                 __ATOMIC_RELEASE);
+                return data;
+            }
+        } else if (diff < 0) {
+            // producer has not filled this slot yet, ring is empty
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : ringEmpty
+ *
+ * DESCRIPTION: return if a ring is empty or not
+ *
+ * PARAMETERS :
+ *   @ring    : ring to check
+ *
+ * RETURN     : true -- ring is empty; false -- not empty
+ *==========================================================================*/
+bool QCameraQueue::ringEmpty(camera_q_ring *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) ==
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseData
+ *
+ * DESCRIPTION: release internal resource of node data and free it
+ *
+ * PARAMETERS :
+ *   @data    : data to be released
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::releaseData(void *data)
+{
+    if (NULL != data) {
+        if (m_dataFn) {
+            m_dataFn(data, m_userData);
+        }
+        free(data);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : init
  *
@@ -102,7 +341,7 @@ QCameraQueue::~QCameraQueue()
 void QCameraQueue::init()
 {
     pthread_mutex_lock(&m_lock);
-    m_active = true;
+    __atomic_store_n(&m_active, true, __ATOMIC_RELEASE);
     pthread_mutex_unlock(&m_lock);
 }
 
@@ -118,6 +357,11 @@ void QCameraQueue::init()
 bool QCameraQueue::isEmpty()
 {
     bool flag = true;
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        return ringEmpty(&m_prioRing) && ringEmpty(&m_ring) &&
+               (0 == __atomic_load_n(&m_prioSize, __ATOMIC_ACQUIRE)) &&
+               (0 == __atomic_load_n(&m_size, __ATOMIC_ACQUIRE));
+    }
     pthread_mutex_lock(&m_lock);
     if (m_size > 0) {
         flag = false;
@@ -139,6 +383,10 @@ bool QCameraQueue::isEmpty()
 bool QCameraQueue::enqueue(void *data)
 {
     bool rc;
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        return enqueueRing(&m_ring, &m_head, &m_size, data, false);
+    }
+
     camera_q_node *node =
         (camera_q_node *)malloc(sizeof(camera_q_node));
     if (NULL == node) {
@@ -162,11 +410,185 @@ bool QCameraQueue::enqueue(void *data)
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : tryEnqueue
+ *
+ * DESCRIPTION: enqueue data that may be dropped under backpressure. In ring
+ *              mode this fails instead of spilling into the list once the
+ *              ring is full. Same as enqueue in list mode.
+ *
+ * PARAMETERS :
+ *   @data    : data to be enqueued
+ *
+ * RETURN     : true -- success; false -- failed, caller still owns data
+ *==========================================================================*/
+bool QCameraQueue::tryEnqueue(void *data)
+{
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        return enqueueRing(&m_ring, &m_head, &m_size, data, true);
+    }
+    return enqueue(data);
+}
+
+/*===========================================================================
+ * FUNCTION   : pushRingLockFree
+ *
+ * DESCRIPTION: lock-free push into a ring, the fast path of ring mode
+ *              enqueue. The producer registers in m_ringUsers before it
+ *              checks m_active and m_ringHeld, so flush and flushNodes,
+ *              which change those flags first and then wait for
+ *              m_ringUsers to drop to 0, never miss an in-flight push.
+ *
+ * PARAMETERS :
+ *   @ring    : ring to push into
+ *   @spilled : number of entries spilled from this ring into its list
+ *   @data    : data to be pushed
+ *
+ * RETURN     : true -- success; false -- caller has to take the slow path
+ *==========================================================================*/
+bool QCameraQueue::pushRingLockFree(camera_q_ring *ring, int *spilled,
+                                    void *data)
+{
+    bool rc = false;
+
+    __atomic_add_fetch(&m_ringUsers, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m_active, __ATOMIC_SEQ_CST) &&
+        !__atomic_load_n(&m_ringHeld, __ATOMIC_SEQ_CST) &&
+        0 == __atomic_load_n(spilled, __ATOMIC_ACQUIRE)) {
+        rc = ringPush(ring, data);
+    }
+    __atomic_sub_fetch(&m_ringUsers, 1, __ATOMIC_SEQ_CST);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : enqueueRing
+ *
+ * DESCRIPTION: ring mode enqueue. Entries go to the ring lock-free while it
+ *              has room and nothing has spilled. Otherwise they are
+ *              appended to the ring's overflow list under m_lock, so FIFO
+ *              order holds across the ring and the list.
+ *
+ * PARAMETERS :
+ *   @ring      : ring to enqueue into
+ *   @spill     : overflow list of the ring
+ *   @spilled   : number of entries in the overflow list
+ *   @data      : data to be enqueued
+ *   @droppable : fail instead of spilling into the list
+ *
+ * RETURN     : true -- success; false -- inactive queue, or ring full for
+ *              a droppable entry
+ *==========================================================================*/
+bool QCameraQueue::enqueueRing(camera_q_ring *ring, camera_q_node *spill,
+                               int *spilled, void *data, bool droppable)
+{
+    bool rc = false;
+
+    if (!__atomic_load_n(&m_active, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    if (pushRingLockFree(ring, spilled, data)) {
+        return true;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        rc = false;
+    } else if (0 == *spilled && ringPush(ring, data)) {
+        rc = true;
+    } else if (droppable) {
+        ALOGE("%s: Ring is full (%d entries, %d spilled), dropping entry",
+              __func__, ring->mask + 1, *spilled);
+        rc = false;
+    } else {
+        camera_q_node *node =
+            (camera_q_node *)malloc(sizeof(camera_q_node));
+        if (NULL == node) {
+            ALOGE("%s: No memory for camera_q_node", __func__);
+            rc = false;
+        } else {
+            memset(node, 0, sizeof(camera_q_node));
+            node->data = data;
+            cam_list_add_tail_node(&node->list, &spill->list);
+            __atomic_add_fetch(spilled, 1, __ATOMIC_RELEASE);
+            ALOGV("%s: Ring is full (%d entries), %d spilled",
+                  __func__, ring->mask + 1, *spilled);
+            rc = true;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : dequeueOverflow
+ *
+ * DESCRIPTION: ring mode, dequeue the oldest entry spilled into a list
+ *
+ * PARAMETERS :
+ *   @spill   : overflow list
+ *   @spilled : number of entries in the overflow list
+ *
+ * RETURN     : data ptr. NULL if nothing has spilled.
+ *==========================================================================*/
+void* QCameraQueue::dequeueOverflow(camera_q_node *spill, int *spilled)
+{
+    camera_q_node* node = NULL;
+    void* data = NULL;
+
+    if (0 == __atomic_load_n(spilled, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    struct cam_list *pos = spill->list.next;
+    if (pos != &spill->list) {
+        node = member_of(pos, camera_q_node, list);
+        cam_list_del_node(&node->list);
+        __atomic_sub_fetch(spilled, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (NULL != node) {
+        data = node->data;
+        free(node);
+    }
+    return data;
+}
+
+/*===========================================================================
+ * FUNCTION   : dequeueRing
+ *
+ * DESCRIPTION: ring mode, dequeue the next entry. Priority entries, both
+ *              in their ring and spilled, go out before any normal entry.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : data ptr. NULL if the queue is empty.
+ *==========================================================================*/
+void* QCameraQueue::dequeueRing()
+{
+    void *data = ringPop(&m_prioRing);
+    if (NULL == data) {
+        data = dequeueOverflow(&m_prioHead, &m_prioSize);
+    }
+    if (NULL == data) {
+        data = ringPop(&m_ring);
+    }
+    if (NULL == data) {
+        data = dequeueOverflow(&m_head, &m_size);
+    }
+    return data;
+}
+
 /*===========================================================================
  * FUNCTION   : enqueueWithPriority
  *
  * DESCRIPTION: enqueue data into queue with priority, will insert into the
- *              head of the queue
+ *              head of the queue. In ring mode priority entries go to a
+ *              separate ring, with its own overflow list, that is always
+ *              drained first.
  *
  * PARAMETERS :
  *   @data    : data to be enqueued
@@ -176,6 +598,12 @@ bool QCameraQueue::enqueue(void *data)
 bool QCameraQueue::enqueueWithPriority(void *data)
 {
     bool rc;
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        // too many pending cmds still must not be lost, so spill
+        return enqueueRing(&m_prioRing, &m_prioHead, &m_prioSize,
+                           data, false);
+    }
+
     camera_q_node *node =
         (camera_q_node *)malloc(sizeof(camera_q_node));
     if (NULL == node) {
@@ -212,7 +640,7 @@ bool QCameraQueue::enqueueWithPriority(void *data)
  *
  * PARAMETERS :
  *   @bFromHead : if true, dequeue from the head
- *                if false, dequeue from the tail
+ *                if false, dequeue from the tail. Not supported in ring mode.
  *
  * RETURN     : data ptr. NULL if not any data in the queue.
  *==========================================================================*/
@@ -223,6 +651,17 @@ void* QCameraQueue::dequeue(bool bFromHead)
     struct cam_list *head = NULL;
     struct cam_list *pos = NULL;
 
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        if (!bFromHead) {
+            ALOGE("%s: Dequeue from tail not supported in ring mode", __func__);
+            return NULL;
+        }
+        if (!__atomic_load_n(&m_active, __ATOMIC_ACQUIRE)) {
+            return NULL;
+        }
+        return dequeueRing();
+    }
+
     pthread_mutex_lock(&m_lock);
     if (m_active) {
         head = &m_head.list;
@@ -248,42 +687,101 @@ void* QCameraQueue::dequeue(bool bFromHead)
 }
 
 /*===========================================================================
- * FUNCTION   : flush
+ * FUNCTION   : dequeueBatch
  *
- * DESCRIPTION: flush all nodes from the queue, queue will be empty after this
- *              operation.
+ * DESCRIPTION: dequeue up to max_cnt entries from the head of the queue
+ *              with a single lock acquisition
  *
- * PARAMETERS : None
+ * PARAMETERS :
+ *   @data    : array to be filled with dequeued data ptrs, in queue order
+ *   @max_cnt : size of data array
  *
- * RETURN     : None
+ * RETURN     : number of entries dequeued
  *==========================================================================*/
-void QCameraQueue::flush(){
+int QCameraQueue::dequeueBatch(void **data, int max_cnt)
+{
     camera_q_node* node = NULL;
     struct cam_list *head = NULL;
     struct cam_list *pos = NULL;
+    camera_q_node* nodes = NULL;
+    int cnt = 0;
+
+    if (NULL == data || max_cnt <= 0) {
+        return 0;
+    }
+
+    if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+        if (!__atomic_load_n(&m_active, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+        while (cnt < max_cnt) {
+            void *entry = dequeueRing();
+            if (NULL == entry) {
+                break;
+            }
+            data[cnt++] = entry;
+        }
+        return cnt;
+    }
 
     pthread_mutex_lock(&m_lock);
     if (m_active) {
         head = &m_head.list;
         pos = head->next;
-
-        while(pos != head) {
+        while (pos != head && cnt < max_cnt) {
             node = member_of(pos, camera_q_node, list);
             pos = pos->next;
             cam_list_del_node(&node->list);
             m_size--;
+            data[cnt++] = node->data;
+            // chain detached nodes so they can be freed outside the lock
+            node->list.next = (struct cam_list *)nodes;
+            nodes = node;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
 
-            if (NULL != node->data) {
-                if (m_dataFn) {
-                    m_dataFn(node->data, m_userData);
-                }
-                free(node->data);
+    while (NULL != nodes) {
+        node = nodes;
+        nodes = (camera_q_node *)node->list.next;
+        free(node);
+    }
+
+    return cnt;
+}
+
+/*===========================================================================
+ * FUNCTION   : flush
+ *
+ * DESCRIPTION: flush all nodes from the queue, queue will be empty after this
+ *              operation.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::flush(){
+    pthread_mutex_lock(&m_lock);
+    if (m_active) {
+        if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+            void *data = NULL;
+            // refuse new entries, then wait out the producers that got
+            // past the m_active check before the rings are drained
+            __atomic_store_n(&m_active, false, __ATOMIC_SEQ_CST);
+            holdRings();
+            while ((data = ringPop(&m_prioRing)) != NULL ||
+                   (data = ringPop(&m_ring)) != NULL) {
+                releaseData(data);
             }
-            free(node);
+            flushListNodes(&m_prioHead, &m_prioSize, NULL);
+        }
 
+        // in ring mode this releases the spilled entries
+        flushListNodes(&m_head, &m_size, NULL);
+        __atomic_store_n(&m_active, false, __ATOMIC_RELEASE);
+        if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+            releaseRings();
         }
-        m_size = 0;
-        m_active = false;
     }
     pthread_mutex_unlock(&m_lock);
 }
@@ -292,7 +790,10 @@ void QCameraQueue::flush(){
  * FUNCTION   : flushNodes
  *
  * DESCRIPTION: flush only specific nodes, depending on
- *              the given matching function.
+ *              the given matching function. In ring mode this must be
+ *              called from the consumer context; producers are held off
+ *              while the rings are filtered, so unmatched entries keep
+ *              their order.
  *
  * PARAMETERS :
  *   @match   : matching function
@@ -300,37 +801,158 @@ void QCameraQueue::flush(){
  * RETURN     : None
  *==========================================================================*/
 void QCameraQueue::flushNodes(match_fn match){
-    camera_q_node* node = NULL;
-    struct cam_list *head = NULL;
-    struct cam_list *pos = NULL;
-
     if ( NULL == match ) {
         return;
     }
 
     pthread_mutex_lock(&m_lock);
     if (m_active) {
-        head = &m_head.list;
-        pos = head->next;
+        if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+            holdRings();
+            flushRingNodes(&m_prioRing, &m_prioHead, &m_prioSize, match);
+            flushRingNodes(&m_ring, &m_head, &m_size, match);
+            flushListNodes(&m_prioHead, &m_prioSize, match);
+        }
+        flushListNodes(&m_head, &m_size, match);
+        if (QCAMERA_QUEUE_MODE_RING == m_mode) {
+            releaseRings();
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
 
-        while(pos != head) {
-            node = member_of(pos, camera_q_node, list);
-            pos = pos->next;
-            if ( match(node->data, m_userData) ) {
-                cam_list_del_node(&node->list);
-                m_size--;
-
-                if (NULL != node->data) {
-                    if (m_dataFn) {
-                        m_dataFn(node->data, m_userData);
-                    }
-                    free(node->data);
+/*===========================================================================
+ * FUNCTION   : holdRings
+ *
+ * DESCRIPTION: ring mode, send producers to the slow path, which blocks on
+ *              m_lock, and wait for the ones already pushing lock-free to
+ *              finish. Must be called with m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::holdRings()
+{
+    __atomic_store_n(&m_ringHeld, true, __ATOMIC_SEQ_CST);
+    while (0 != __atomic_load_n(&m_ringUsers, __ATOMIC_SEQ_CST)) {
+        sched_yield();
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseRings
+ *
+ * DESCRIPTION: ring mode, let producers push lock-free again after
+ *              holdRings. Must be called with m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::releaseRings()
+{
+    __atomic_store_n(&m_ringHeld, false, __ATOMIC_SEQ_CST);
+}
+
+/*===========================================================================
+ * FUNCTION   : flushListNodes
+ *
+ * DESCRIPTION: release list nodes that match the given function. Must be
+ *              called with m_lock held.
+ *
+ * PARAMETERS :
+ *   @list    : dummy head of the list
+ *   @size    : number of nodes in the list
+ *   @match   : matching function, NULL to release all nodes
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::flushListNodes(camera_q_node *list, int *size,
+                                  match_fn match)
+{
+    camera_q_node* node = NULL;
+    struct cam_list *head = &list->list;
+    struct cam_list *pos = head->next;
+
+    while(pos != head) {
+        node = member_of(pos, camera_q_node, list);
+        pos = pos->next;
+        if ( NULL == match || match(node->data, m_userData) ) {
+            cam_list_del_node(&node->list);
+            __atomic_sub_fetch(size, 1, __ATOMIC_RELEASE);
+
+            if (NULL != node->data) {
+                if (m_dataFn) {
+                    m_dataFn(node->data, m_userData);
                 }
-                free(node);
+                free(node->data);
             }
+            free(node);
         }
     }
-    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : flushRingNodes
+ *
+ * DESCRIPTION: flush entries of a ring that match the given function.
+ *              Must be called with m_lock held and producers held off.
+ *              All entries are popped, matched ones released and the
+ *              others pushed back in their original order. Entries that
+ *              don't fit back go to the head of the ring's overflow list,
+ *              still ahead of what spilled before.
+ *
+ * PARAMETERS :
+ *   @ring    : ring to be flushed
+ *   @spill   : overflow list of the ring
+ *   @spilled : number of entries in the overflow list
+ *   @match   : matching function
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::flushRingNodes(camera_q_ring *ring, camera_q_node *spill,
+                                  int *spilled, match_fn match)
+{
+    uint32_t cnt = 0;
+    uint32_t i = 0;
+    void *data = NULL;
+
+    if (NULL == ring->kept) {
+        return;
+    }
+
+    while ((data = ringPop(ring)) != NULL) {
+        if (match(data, m_userData)) {
+            releaseData(data);
+        } else {
+            ring->kept[cnt++] = data;
+        }
+    }
+    for (i = 0; i < cnt; i++) {
+        if (!ringPush(ring, ring->kept[i])) {
+            break;
+        }
+    }
+    if (i < cnt) {
+        ALOGE("%s: %d entries don't fit back into the ring, spilling",
+              __func__, cnt - i);
+    }
+    // insert in reverse at the head so the list keeps their order
+    while (cnt > i) {
+        data = ring->kept[--cnt];
+        camera_q_node *node =
+            (camera_q_node *)malloc(sizeof(camera_q_node));
+        if (NULL == node) {
+            ALOGE("%s: No memory for camera_q_node, dropping entry", __func__);
+            releaseData(data);
+            continue;
+        }
+        memset(node, 0, sizeof(camera_q_node));
+        node->data = data;
+        cam_list_insert_before_node(&node->list, spill->list.next);
+        __atomic_add_fetch(spilled, 1, __ATOMIC_RELEASE);
+    }
 }
 
 }; // namespace qcamera
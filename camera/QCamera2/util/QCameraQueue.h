@@ -31,6 +31,7 @@
 #define __QCAMERA_QUEUE_H__
 
 #include <pthread.h>
+#include <stdint.h>
 #include "cam_list.h"
 
 namespace qcamera {
@@ -38,19 +39,32 @@ namespace qcamera {
 typedef void (*release_data_fn)(void* data, void *user_data);
 typedef bool (*match_fn)(void *data, void *user_data);
 
+typedef enum {
+    QCAMERA_QUEUE_MODE_LIST,  /* unbounded, mutex guarded linked list */
+    QCAMERA_QUEUE_MODE_RING,  /* lock-free ring with preallocated slots, backed
+                               * by a list once the ring is full */
+} qcamera_queue_mode_t;
+
+#define QCAMERA_QUEUE_RING_DEFAULT_SIZE 64
+
 class QCameraQueue {
 public:
     QCameraQueue();
     QCameraQueue(release_data_fn data_rel_fn, void *user_data);
+    QCameraQueue(release_data_fn data_rel_fn, void *user_data,
+                 qcamera_queue_mode_t mode,
+                 uint32_t ring_size = QCAMERA_QUEUE_RING_DEFAULT_SIZE);
     virtual ~QCameraQueue();
     void init();
     bool enqueue(void *data);
+    bool tryEnqueue(void *data);
     bool enqueueWithPriority(void *data);
     /* This call will put queue into uninitialized state.
      * Need to call init() in order to use the queue again */
     void flush();
     void flushNodes(match_fn match);
     void* dequeue(bool bFromHead = true);
+    int dequeueBatch(void **data, int max_cnt);
     bool isEmpty();
 private:
     typedef struct {
@@ -58,9 +72,50 @@ private:
         void* data;
     } camera_q_node;
 
-    camera_q_node m_head; // dummy head
+    /* Bounded MPMC ring (Vyukov). Each slot carries a sequence number that
+     * tells producers/consumers whether the slot is free for the current lap,
+     * so neither side needs a lock or a per-node allocation. */
+    typedef struct {
+        uint32_t seq;
+        void* data;
+    } camera_q_slot;
+
+    typedef struct {
+        camera_q_slot *slots;
+        uint32_t mask;
+        uint32_t head;        // consumer position
+        uint8_t pad[60];      // keep producer and consumer on separate lines
+        uint32_t tail;        // producer position
+        void **kept;          // scratch for flushRingNodes, one per slot
+    } camera_q_ring;
+
+    void initRing(camera_q_ring *ring, uint32_t size);
+    void deinitRing(camera_q_ring *ring);
+    static bool ringPush(camera_q_ring *ring, void *data);
+    static void* ringPop(camera_q_ring *ring);
+    static bool ringEmpty(camera_q_ring *ring);
+    bool pushRingLockFree(camera_q_ring *ring, int *spilled, void *data);
+    bool enqueueRing(camera_q_ring *ring, camera_q_node *spill, int *spilled,
+                     void *data, bool droppable);
+    void* dequeueRing();
+    void* dequeueOverflow(camera_q_node *spill, int *spilled);
+    void holdRings();
+    void releaseRings();
+    void flushRingNodes(camera_q_ring *ring, camera_q_node *spill,
+                        int *spilled, match_fn match);
+    void flushListNodes(camera_q_node *list, int *size, match_fn match);
+    void releaseData(void *data);
+
+    camera_q_node m_head; // dummy head, overflow list of m_ring in ring mode
     int m_size;
+    camera_q_node m_prioHead; // dummy head, overflow list of m_prioRing
+    int m_prioSize;
     bool m_active;
+    qcamera_queue_mode_t m_mode;
+    camera_q_ring m_ring;     // normal entries (ring mode)
+    camera_q_ring m_prioRing; // entries enqueued with priority (ring mode)
+    uint32_t m_ringUsers;     // producers pushing to the rings without m_lock
+    bool m_ringHeld;          // flush owns the rings, producers take m_lock
     pthread_mutex_t m_lock;
     release_data_fn m_dataFn;
     void * m_userData;
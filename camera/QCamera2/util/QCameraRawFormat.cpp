@@ -0,0 +1,905 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#define LOG_TAG "QCameraRawFormat"
+
+#include <utils/Log.h>
+#include <string.h>
+#include <unistd.h>
+#include "QCameraRawFormat.h"
+
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSSE3)
+#include <tmmintrin.h>
+#endif
+
+/* rows claimed by a thread at a time */
+#define RAW16_ROW_CHUNK 8
+/* bands smaller than this are converted by the caller alone */
+#define RAW16_MIN_PARALLEL_ROWS 64
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : getRawPacking
+ *
+ * DESCRIPTION: map a bayer stream format to its packed layout
+ *
+ * PARAMETERS :
+ *   @fmt     : stream format
+ *   @packing : packed layout of @fmt, valid if true is returned
+ *
+ * RETURN     : true if @fmt is a packed 10/12bit bayer format
+ *==========================================================================*/
+bool getRawPacking(cam_format_t fmt, qcamera_raw_packing_t &packing)
+{
+    switch (fmt) {
+    case CAM_FORMAT_BAYER_QCOM_RAW_10BPP_GBRG:
+    case CAM_FORMAT_BAYER_QCOM_RAW_10BPP_GRBG:
+    case CAM_FORMAT_BAYER_QCOM_RAW_10BPP_RGGB:
+    case CAM_FORMAT_BAYER_QCOM_RAW_10BPP_BGGR:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_10BPP_GBRG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_10BPP_GRBG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_10BPP_RGGB:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_10BPP_BGGR:
+        packing = RAW_PACKING_QCOM_10;
+        return true;
+    case CAM_FORMAT_BAYER_QCOM_RAW_12BPP_GBRG:
+    case CAM_FORMAT_BAYER_QCOM_RAW_12BPP_GRBG:
+    case CAM_FORMAT_BAYER_QCOM_RAW_12BPP_RGGB:
+    case CAM_FORMAT_BAYER_QCOM_RAW_12BPP_BGGR:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_12BPP_GBRG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_12BPP_GRBG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_12BPP_RGGB:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_12BPP_BGGR:
+        packing = RAW_PACKING_QCOM_12;
+        return true;
+    case CAM_FORMAT_BAYER_MIPI_RAW_10BPP_GBRG:
+    case CAM_FORMAT_BAYER_MIPI_RAW_10BPP_GRBG:
+    case CAM_FORMAT_BAYER_MIPI_RAW_10BPP_RGGB:
+    case CAM_FORMAT_BAYER_MIPI_RAW_10BPP_BGGR:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_10BPP_GBRG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_10BPP_GRBG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_10BPP_RGGB:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_10BPP_BGGR:
+        packing = RAW_PACKING_MIPI_10;
+        return true;
+    case CAM_FORMAT_BAYER_MIPI_RAW_12BPP_GBRG:
+    case CAM_FORMAT_BAYER_MIPI_RAW_12BPP_GRBG:
+    case CAM_FORMAT_BAYER_MIPI_RAW_12BPP_RGGB:
+    case CAM_FORMAT_BAYER_MIPI_RAW_12BPP_BGGR:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_12BPP_GBRG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_12BPP_GRBG:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_12BPP_RGGB:
+    case CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_12BPP_BGGR:
+        packing = RAW_PACKING_MIPI_12;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getRawPackedRowSize
+ *
+ * DESCRIPTION: min number of bytes holding one packed row
+ *
+ * PARAMETERS :
+ *   @packing : packed layout
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : row size in bytes, 0 for unknown layout
+ *==========================================================================*/
+int getRawPackedRowSize(qcamera_raw_packing_t packing, int width)
+{
+    switch (packing) {
+    case RAW_PACKING_QCOM_10:
+        return (width + 5) / 6 * 8;
+    case RAW_PACKING_QCOM_12:
+        return (width + 4) / 5 * 8;
+    case RAW_PACKING_MIPI_10:
+        return (width + 3) / 4 * 5;
+    case RAW_PACKING_MIPI_12:
+        return (width + 1) / 2 * 3;
+    default:
+        return 0;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackQcomWord
+ *
+ * DESCRIPTION: unpack one 64bit opaque raw word into @n 16bit pixels
+ *
+ * PARAMETERS :
+ *   @src     : ptr to the 64bit word
+ *   @dst     : ptr to first output pixel of the word
+ *   @n       : number of pixels to write, at most 64 / @bits
+ *   @bits    : bits per pixel, 10 or 12
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static inline void unpackQcomWord(const uint8_t *src, uint16_t *dst,
+                                  int n, int bits)
+{
+    uint64_t word;
+    uint64_t mask = (1 << bits) - 1;
+    memcpy(&word, src, sizeof(word));
+    for (int j = 0; j < n; j++) {
+        dst[j] = (uint16_t)((word >> (bits * j)) & mask);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackQcom10RowC
+ *
+ * DESCRIPTION: scalar reference opaque raw10 row unpacker. Opaque raw10
+ *              packs 6 pixels into each little endian 64bit word as
+ *              0000 - p5 - p4 - p3 - p2 - p1 - p0.
+ *
+ * PARAMETERS :
+ *   @src     : raw10 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void unpackQcom10RowC(const uint8_t *src, uint16_t *dst, int width)
+{
+    int words = (width + 5) / 6;
+    for (int k = words - 1; k >= 0; k--) {
+        int n = width - 6 * k;
+        unpackQcomWord(src + 8 * k, dst + 6 * k, n < 6 ? n : 6, 10);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackQcom12RowC
+ *
+ * DESCRIPTION: scalar opaque raw12 row unpacker. Opaque raw12 packs 5
+ *              pixels into each little endian 64bit word as
+ *              0000 - p4 - p3 - p2 - p1 - p0.
+ *
+ * PARAMETERS :
+ *   @src     : raw12 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void unpackQcom12RowC(const uint8_t *src, uint16_t *dst, int width)
+{
+    int words = (width + 4) / 5;
+    for (int k = words - 1; k >= 0; k--) {
+        int n = width - 5 * k;
+        unpackQcomWord(src + 8 * k, dst + 5 * k, n < 5 ? n : 5, 12);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackMipi10Group
+ *
+ * DESCRIPTION: unpack one 5 byte MIPI raw10 group into @n 16bit pixels
+ *
+ * PARAMETERS :
+ *   @src     : ptr to the group
+ *   @dst     : ptr to first output pixel of the group
+ *   @n       : number of pixels to write, at most 4
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static inline void unpackMipi10Group(const uint8_t *src, uint16_t *dst, int n)
+{
+    uint8_t b[5];
+    memcpy(b, src, sizeof(b));
+    for (int j = 0; j < n; j++) {
+        dst[j] = (uint16_t)((b[j] << 2) | ((b[4] >> (2 * j)) & 0x3));
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackMipi10RowC
+ *
+ * DESCRIPTION: scalar reference MIPI raw10 row unpacker. MIPI raw10 packs
+ *              4 pixels into 5 bytes: 8 msb of p0..p3, then 2 lsb of
+ *              p0..p3 from bit 0 up.
+ *
+ * PARAMETERS :
+ *   @src     : raw10 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void unpackMipi10RowC(const uint8_t *src, uint16_t *dst, int width)
+{
+    int groups = (width + 3) / 4;
+    for (int k = groups - 1; k >= 0; k--) {
+        int n = width - 4 * k;
+        unpackMipi10Group(src + 5 * k, dst + 4 * k, n < 4 ? n : 4);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackMipi12RowC
+ *
+ * DESCRIPTION: scalar MIPI raw12 row unpacker. MIPI raw12 packs 2 pixels
+ *              into 3 bytes: 8 msb of p0 and p1, then 4 lsb of p0 in the
+ *              low nibble and of p1 in the high nibble.
+ *
+ * PARAMETERS :
+ *   @src     : raw12 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void unpackMipi12RowC(const uint8_t *src, uint16_t *dst, int width)
+{
+    int groups = (width + 1) / 2;
+    for (int k = groups - 1; k >= 0; k--) {
+        const uint8_t *s = src + 3 * k;
+        uint8_t b0 = s[0], b1 = s[1], b2 = s[2];
+        dst[2 * k] = (uint16_t)((b0 << 4) | (b2 & 0xF));
+        if (2 * k + 1 < width) {
+            dst[2 * k + 1] = (uint16_t)((b1 << 4) | (b2 >> 4));
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getMipi10VectorPairs
+ *
+ * DESCRIPTION: number of leading group pairs of a MIPI raw10 row that can
+ *              be unpacked with 16 byte loads. A pair is 10 bytes, so a
+ *              pair is only eligible if its load stays inside the row.
+ *
+ * PARAMETERS :
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : number of pairs
+ *==========================================================================*/
+int getMipi10VectorPairs(int width)
+{
+    int rowSize = (width + 3) / 4 * 5;
+    int pairs = width / 8;
+    while (pairs > 0 && 10 * (pairs - 1) + 16 > rowSize) {
+        pairs--;
+    }
+    return pairs;
+}
+
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+/*===========================================================================
+ * FUNCTION   : unpackQcom10RowSse2
+ *
+ * DESCRIPTION: SSE2 opaque raw10 row unpacker, same scheme as the NEON
+ *              one: two words per iteration, 64bit lane shifts and masks,
+ *              then 32bit shuffles to lay out 12 pixels for a 16+8 byte
+ *              store.
+ *
+ * PARAMETERS :
+ *   @src     : raw10 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+__attribute__((target("sse2")))
+void unpackQcom10RowSse2(const uint8_t *src, uint16_t *dst, int width)
+{
+    int words = (width + 5) / 6;
+    int k = words - 1;
+    const __m128i mask = _mm_set_epi32(0, 0x3FF, 0, 0x3FF);
+
+    if (k >= 0 && width % 6) {
+        unpackQcomWord(src + 8 * k, dst + 6 * k, width - 6 * k, 10);
+        k--;
+    }
+    for (; k >= 1; k -= 2) {
+        uint16_t *d = dst + 6 * (k - 1);
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 8 * (k - 1)));
+        // t: p0 p1 p2 p3 of each word, u: p4 p5 0 0 of each word
+        __m128i t = _mm_and_si128(v, mask);
+        t = _mm_or_si128(t, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 10), mask), 16));
+        t = _mm_or_si128(t, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 20), mask), 32));
+        t = _mm_or_si128(t, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 30), mask), 48));
+        __m128i u = _mm_and_si128(_mm_srli_epi64(v, 40), mask);
+        u = _mm_or_si128(u, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 50), mask), 16));
+
+        // a0a1 a2a3 a4a5 b0b1, then b2b3 b4b5
+        __m128i x = _mm_unpacklo_epi32(u, _mm_shuffle_epi32(t, _MM_SHUFFLE(3, 3, 3, 2)));
+        __m128i lo = _mm_unpacklo_epi64(t, x);
+        __m128i hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(t, _MM_SHUFFLE(3, 3, 3, 3)),
+                                        _mm_shuffle_epi32(u, _MM_SHUFFLE(2, 2, 2, 2)));
+        _mm_storeu_si128((__m128i *)d, lo);
+        _mm_storel_epi64((__m128i *)(d + 8), hi);
+    }
+    if (k == 0) {
+        unpackQcomWord(src, dst, 6, 10);
+    }
+}
+#endif
+
+#if defined(QCAMERA_RAW_FORMAT_SSSE3)
+/*===========================================================================
+ * FUNCTION   : unpackMipi10RowSsse3
+ *
+ * DESCRIPTION: SSSE3 MIPI raw10 row unpacker, same scheme as the NEON one.
+ *              Byte shuffles spread the msb bytes and the lsb byte of two
+ *              groups over 16bit lanes; a multiply moves each pixel's 2 lsb
+ *              to bits 6..7 so one shift brings all of them down.
+ *
+ * PARAMETERS :
+ *   @src     : raw10 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+__attribute__((target("ssse3")))
+void unpackMipi10RowSsse3(const uint8_t *src, uint16_t *dst, int width)
+{
+    const __m128i msbShuf = _mm_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1,
+                                          5, -1, 6, -1, 7, -1, 8, -1);
+    const __m128i lsbShuf = _mm_setr_epi8(4, -1, 4, -1, 4, -1, 4, -1,
+                                          9, -1, 9, -1, 9, -1, 9, -1);
+    const __m128i lsbMul = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i mask = _mm_set1_epi16(0x3);
+    int pairs = getMipi10VectorPairs(width);
+
+    unpackMipi10RowC(src + 10 * pairs, dst + 8 * pairs, width - 8 * pairs);
+    for (int k = pairs - 1; k >= 0; k--) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 10 * k));
+        __m128i msb = _mm_slli_epi16(_mm_shuffle_epi8(v, msbShuf), 2);
+        __m128i lsb = _mm_mullo_epi16(_mm_shuffle_epi8(v, lsbShuf), lsbMul);
+        lsb = _mm_and_si128(_mm_srli_epi16(lsb, 6), mask);
+        _mm_storeu_si128((__m128i *)(dst + 8 * k), _mm_or_si128(msb, lsb));
+    }
+}
+#endif
+
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+/*===========================================================================
+ * FUNCTION   : cpuHasNeon
+ *
+ * DESCRIPTION: check if the running CPU has NEON (ASIMD on 64bit)
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : true if NEON kernels can run
+ *==========================================================================*/
+static bool cpuHasNeon()
+{
+#if defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+#endif
+
+/*===========================================================================
+ * FUNCTION   : pickRawRowUnpacker
+ *
+ * DESCRIPTION: pick the fastest row unpacker of a layout supported by the
+ *              running CPU
+ *
+ * PARAMETERS :
+ *   @packing : packed layout
+ *
+ * RETURN     : row unpacker function, NULL for unknown layout
+ *==========================================================================*/
+static raw_unpack_row_fn pickRawRowUnpacker(qcamera_raw_packing_t packing)
+{
+    switch (packing) {
+    case RAW_PACKING_QCOM_10:
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+        if (cpuHasNeon()) {
+            return unpackQcom10RowNeon;
+        }
+#elif defined(QCAMERA_RAW_FORMAT_SSE2)
+        if (__builtin_cpu_supports("sse2")) {
+            return unpackQcom10RowSse2;
+        }
+#endif
+        return unpackQcom10RowC;
+    case RAW_PACKING_QCOM_12:
+        return unpackQcom12RowC;
+    case RAW_PACKING_MIPI_10:
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+        if (cpuHasNeon()) {
+            return unpackMipi10RowNeon;
+        }
+#elif defined(QCAMERA_RAW_FORMAT_SSSE3)
+        if (__builtin_cpu_supports("ssse3")) {
+            return unpackMipi10RowSsse3;
+        }
+#endif
+        return unpackMipi10RowC;
+    case RAW_PACKING_MIPI_12:
+        return unpackMipi12RowC;
+    default:
+        return NULL;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getRawRowUnpacker
+ *
+ * DESCRIPTION: get the fastest row unpacker of a layout for the running
+ *              CPU, picked once per layout
+ *
+ * PARAMETERS :
+ *   @packing : packed layout
+ *
+ * RETURN     : row unpacker function, NULL for unknown layout
+ *==========================================================================*/
+raw_unpack_row_fn getRawRowUnpacker(qcamera_raw_packing_t packing)
+{
+    static raw_unpack_row_fn unpackers[RAW_PACKING_MAX];
+    if (packing < 0 || packing >= RAW_PACKING_MAX) {
+        return NULL;
+    }
+
+    raw_unpack_row_fn fn = __atomic_load_n(&unpackers[packing], __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+        fn = pickRawRowUnpacker(packing);
+        __atomic_store_n(&unpackers[packing], fn, __ATOMIC_RELEASE);
+    }
+    return fn;
+}
+
+/*===========================================================================
+ * FUNCTION   : packMipi10Row
+ *
+ * DESCRIPTION: pack one row of 16bit pixels into MIPI raw10
+ *
+ * PARAMETERS :
+ *   @src     : RAW16 row, low 10 bits of each pixel are used
+ *   @dst     : raw10 row, getRawPackedRowSize() bytes are written
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void packMipi10Row(const uint16_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x += 4) {
+        uint16_t p[4] = { 0, 0, 0, 0 };
+        int n = width - x < 4 ? width - x : 4;
+        uint8_t lsb = 0;
+        memcpy(p, src + x, n * sizeof(uint16_t));
+        for (int j = 0; j < 4; j++) {
+            dst[j] = (uint8_t)((p[j] >> 2) & 0xFF);
+            lsb |= (uint8_t)((p[j] & 0x3) << (2 * j));
+        }
+        dst[4] = lsb;
+        dst += 5;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : packMipi12Row
+ *
+ * DESCRIPTION: pack one row of 16bit pixels into MIPI raw12
+ *
+ * PARAMETERS :
+ *   @src     : RAW16 row, low 12 bits of each pixel are used
+ *   @dst     : raw12 row, getRawPackedRowSize() bytes are written
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void packMipi12Row(const uint16_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x += 2) {
+        uint16_t p0 = src[x];
+        uint16_t p1 = (x + 1 < width) ? src[x + 1] : 0;
+        dst[0] = (uint8_t)((p0 >> 4) & 0xFF);
+        dst[1] = (uint8_t)((p1 >> 4) & 0xFF);
+        dst[2] = (uint8_t)((p0 & 0xF) | ((p1 & 0xF) << 4));
+        dst += 3;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : subtractBlackLevelRowC
+ *
+ * DESCRIPTION: scalar reference black level subtraction of one row of
+ *              16bit pixels, clamping at 0
+ *
+ * PARAMETERS :
+ *   @row     : RAW16 row
+ *   @width   : number of pixels in the row
+ *   @black0  : black level of even columns
+ *   @black1  : black level of odd columns
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void subtractBlackLevelRowC(uint16_t *row, int width,
+                            uint16_t black0, uint16_t black1)
+{
+    for (int x = 0; x < width; x++) {
+        uint16_t b = (x & 1) ? black1 : black0;
+        row[x] = (row[x] > b) ? (uint16_t)(row[x] - b) : 0;
+    }
+}
+
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+/*===========================================================================
+ * FUNCTION   : subtractBlackLevelRowSse2
+ *
+ * DESCRIPTION: SSE2 black level subtraction of one row of 16bit pixels,
+ *              8 pixels at a time with saturating subtracts
+ *
+ * PARAMETERS :
+ *   @row     : RAW16 row
+ *   @width   : number of pixels in the row
+ *   @black0  : black level of even columns
+ *   @black1  : black level of odd columns
+ *
+ * RETURN     : none
+ *==========================================================================*/
+__attribute__((target("sse2")))
+void subtractBlackLevelRowSse2(uint16_t *row, int width,
+                               uint16_t black0, uint16_t black1)
+{
+    int x = 0;
+    const __m128i black = _mm_setr_epi16(black0, black1, black0, black1,
+                                         black0, black1, black0, black1);
+    for (; x + 8 <= width; x += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+        _mm_storeu_si128((__m128i *)(row + x), _mm_subs_epu16(v, black));
+    }
+    subtractBlackLevelRowC(row + x, width - x, black0, black1);
+}
+#endif
+
+/*===========================================================================
+ * FUNCTION   : pickBlackLevelRow
+ *
+ * DESCRIPTION: pick the fastest black level row function supported by the
+ *              running CPU
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : black level row function
+ *==========================================================================*/
+static raw_black_level_row_fn pickBlackLevelRow()
+{
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+    if (cpuHasNeon()) {
+        return subtractBlackLevelRowNeon;
+    }
+#elif defined(QCAMERA_RAW_FORMAT_SSE2)
+    if (__builtin_cpu_supports("sse2")) {
+        return subtractBlackLevelRowSse2;
+    }
+#endif
+    return subtractBlackLevelRowC;
+}
+
+/*===========================================================================
+ * FUNCTION   : subtractBlackLevelRow
+ *
+ * DESCRIPTION: subtract black level from one row of 16bit pixels, clamping
+ *              at 0, with the fastest variant for the running CPU
+ *
+ * PARAMETERS :
+ *   @row     : RAW16 row
+ *   @width   : number of pixels in the row
+ *   @black0  : black level of even columns
+ *   @black1  : black level of odd columns
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void subtractBlackLevelRow(uint16_t *row, int width,
+                           uint16_t black0, uint16_t black1)
+{
+    static raw_black_level_row_fn blackLevelRow;
+
+    raw_black_level_row_fn fn = __atomic_load_n(&blackLevelRow, __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+        fn = pickBlackLevelRow();
+        __atomic_store_n(&blackLevelRow, fn, __ATOMIC_RELEASE);
+    }
+    fn(row, width, black0, black1);
+}
+
+/*===========================================================================
+ * FUNCTION   : subtractBlackLevel
+ *
+ * DESCRIPTION: subtract per channel black level from a 16bit bayer frame
+ *
+ * PARAMETERS :
+ *   @buf     : RAW16 frame
+ *   @width   : frame width in pixels
+ *   @height  : frame height in pixels
+ *   @stride  : row stride in pixels
+ *   @black   : black levels in 2x2 CFA order
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void subtractBlackLevel(uint16_t *buf, int width, int height, int stride,
+                        const uint16_t black[4])
+{
+    for (int y = 0; y < height; y++) {
+        const uint16_t *b = black + 2 * (y & 1);
+        subtractBlackLevelRow(buf + (int64_t)y * stride, width, b[0], b[1]);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraRaw16Converter
+ *
+ * DESCRIPTION: constructor of QCameraRaw16Converter. Helper threads are
+ *              launched on first conversion.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraRaw16Converter::QCameraRaw16Converter()
+    : mNumWorkers(-1),
+      mGeneration(0),
+      mActive(0),
+      mExit(false),
+      mUnpackRow(NULL),
+      mBuf(NULL),
+      mWidth(0),
+      mSrcStride(0),
+      mRaw16Stride(0),
+      mBandBegin(0),
+      mBandEnd(0),
+      mNextRow(0)
+{
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mJobCond, NULL);
+    pthread_cond_init(&mDoneCond, NULL);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraRaw16Converter
+ *
+ * DESCRIPTION: deconstructor of QCameraRaw16Converter, stops helper threads
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraRaw16Converter::~QCameraRaw16Converter()
+{
+    pthread_mutex_lock(&mLock);
+    mExit = true;
+    pthread_cond_broadcast(&mJobCond);
+    pthread_mutex_unlock(&mLock);
+    for (int i = 0; i < mNumWorkers; i++) {
+        pthread_join(mWorkers[i], NULL);
+    }
+    pthread_cond_destroy(&mDoneCond);
+    pthread_cond_destroy(&mJobCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : launchWorkers
+ *
+ * DESCRIPTION: launch one helper thread per extra online core, up to
+ *              RAW16_CONVERTER_MAX_THREADS
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRaw16Converter::launchWorkers()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int num = (cores > 1) ? (int)(cores - 1) : 0;
+    if (num > RAW16_CONVERTER_MAX_THREADS) {
+        num = RAW16_CONVERTER_MAX_THREADS;
+    }
+
+    mNumWorkers = 0;
+    for (int i = 0; i < num; i++) {
+        if (pthread_create(&mWorkers[i], NULL, workerRoutine, this) != 0) {
+            ALOGE("%s: failed to create helper thread %d", __func__, i);
+            break;
+        }
+        mNumWorkers++;
+    }
+    ALOGD("%s: %d helper threads", __func__, mNumWorkers);
+}
+
+/*===========================================================================
+ * FUNCTION   : workerRoutine
+ *
+ * DESCRIPTION: helper thread, converts rows of each posted band
+ *
+ * PARAMETERS :
+ *   @data    : ptr to QCameraRaw16Converter
+ *
+ * RETURN     : NULL
+ *==========================================================================*/
+void *QCameraRaw16Converter::workerRoutine(void *data)
+{
+    QCameraRaw16Converter *pme = (QCameraRaw16Converter *)data;
+    uint32_t seen = 0;
+
+    pthread_mutex_lock(&pme->mLock);
+    while (1) {
+        while (!pme->mExit && pme->mGeneration == seen) {
+            pthread_cond_wait(&pme->mJobCond, &pme->mLock);
+        }
+        if (pme->mExit) {
+            break;
+        }
+        seen = pme->mGeneration;
+        pthread_mutex_unlock(&pme->mLock);
+
+        pme->runRows();
+
+        pthread_mutex_lock(&pme->mLock);
+        if (--pme->mActive == 0) {
+            pthread_cond_signal(&pme->mDoneCond);
+        }
+    }
+    pthread_mutex_unlock(&pme->mLock);
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : runRows
+ *
+ * DESCRIPTION: claim and convert rows of current band until none is left
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRaw16Converter::runRows()
+{
+    while (1) {
+        int y = mBandBegin +
+            __atomic_fetch_add(&mNextRow, RAW16_ROW_CHUNK, __ATOMIC_RELAXED);
+        if (y >= mBandEnd) {
+            break;
+        }
+        int last = y + RAW16_ROW_CHUNK;
+        if (last > mBandEnd) {
+            last = mBandEnd;
+        }
+        for (; y < last; y++) {
+            mUnpackRow(mBuf + y * mSrcStride,
+                       (uint16_t *)mBuf + y * mRaw16Stride,
+                       mWidth);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : convertBand
+ *
+ * DESCRIPTION: convert rows [begin, end) of current frame, which are
+ *              independent of each other, and wait for completion
+ *
+ * PARAMETERS :
+ *   @begin   : first row of the band
+ *   @end     : one past last row of the band
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRaw16Converter::convertBand(int begin, int end)
+{
+    mBandBegin = begin;
+    mBandEnd = end;
+    mNextRow = 0;
+
+    if (mNumWorkers <= 0 || end - begin < RAW16_MIN_PARALLEL_ROWS) {
+        runRows();
+        return;
+    }
+
+    pthread_mutex_lock(&mLock);
+    mActive = mNumWorkers;
+    mGeneration++;
+    pthread_cond_broadcast(&mJobCond);
+    pthread_mutex_unlock(&mLock);
+
+    runRows();
+
+    pthread_mutex_lock(&mLock);
+    while (mActive > 0) {
+        pthread_cond_wait(&mDoneCond, &mLock);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : convert
+ *
+ * DESCRIPTION: convert a frame from packed raw to RAW16 in place
+ *
+ * PARAMETERS :
+ *   @buf         : frame buffer
+ *   @width       : frame width in pixels
+ *   @height      : frame height in pixels
+ *   @srcStride   : packed row stride in bytes
+ *   @raw16Stride : RAW16 row stride in pixels
+ *   @packing     : packed layout of the frame
+ *
+ * RETURN     : true if the frame was converted
+ *              false if the frame is invalid and left packed
+ *==========================================================================*/
+bool QCameraRaw16Converter::convert(void *buf, int width, int height,
+                                    int srcStride, int raw16Stride,
+                                    qcamera_raw_packing_t packing)
+{
+    int64_t raw16RowBytes = (int64_t)raw16Stride * 2;
+    raw_unpack_row_fn unpackRow = getRawRowUnpacker(packing);
+    if (buf == NULL || width <= 0 || height <= 0 || unpackRow == NULL ||
+        raw16RowBytes < srcStride ||
+        srcStride < getRawPackedRowSize(packing, width)) {
+        ALOGE("%s: invalid frame %dx%d, packing %d, strides %d/%d", __func__,
+              width, height, packing, srcStride, raw16Stride);
+        return false;
+    }
+    if (mNumWorkers < 0) {
+        launchWorkers();
+    }
+
+    mUnpackRow = unpackRow;
+    mBuf = (uint8_t *)buf;
+    mWidth = width;
+    mSrcStride = srcStride;
+    mRaw16Stride = raw16Stride;
+
+    // Rows [begin, end) write at or after begin * raw16RowBytes, which is
+    // past the packed data of all rows below end. When no such band of more
+    // than one row exists, rows are done one by one, each row only
+    // overwriting packed data of itself and of rows already converted.
+    int end = height;
+    while (end > 0) {
+        int begin = (int)(((int64_t)end * srcStride + raw16RowBytes - 1) /
+                          raw16RowBytes);
+        if (begin >= end) {
+            begin = end - 1;
+        }
+        convertBand(begin, end);
+        end = begin;
+    }
+    return true;
+}
+
+}; // namespace qcamera
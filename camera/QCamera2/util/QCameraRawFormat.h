@@ -0,0 +1,163 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_RAW_FORMAT_H__
+#define __QCAMERA_RAW_FORMAT_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include "cam_types.h"
+
+namespace qcamera {
+
+// Packed bayer layouts handled by the converters below
+typedef enum {
+    RAW_PACKING_QCOM_10,  // 6 pixels per little endian 64bit word, 4 msb unused
+    RAW_PACKING_QCOM_12,  // 5 pixels per little endian 64bit word, 4 msb unused
+    RAW_PACKING_MIPI_10,  // 4 pixels in 5 bytes: 4 msb bytes then 2 lsb of each
+    RAW_PACKING_MIPI_12,  // 2 pixels in 3 bytes: 2 msb bytes then 4 lsb of each
+    RAW_PACKING_MAX
+} qcamera_raw_packing_t;
+
+// Get packing of a bayer stream format.
+// Returns false if format is not a packed 10/12bit bayer format.
+bool getRawPacking(cam_format_t fmt, qcamera_raw_packing_t &packing);
+
+// Min row size in bytes of @width pixels in @packing
+int getRawPackedRowSize(qcamera_raw_packing_t packing, int width);
+
+// Unpack one packed row into 16bit pixels. Pixel groups are converted
+// from last to first and each group is read before it is written, so dst
+// may alias src as long as dst >= src.
+typedef void (*raw_unpack_row_fn)(const uint8_t *src, uint16_t *dst, int width);
+
+void unpackQcom10RowC(const uint8_t *src, uint16_t *dst, int width);
+void unpackQcom12RowC(const uint8_t *src, uint16_t *dst, int width);
+void unpackMipi10RowC(const uint8_t *src, uint16_t *dst, int width);
+void unpackMipi12RowC(const uint8_t *src, uint16_t *dst, int width);
+
+// SIMD variants are built for every ARM or x86 target and only picked at
+// runtime when the CPU has the instructions. The NEON ones live in
+// QCameraRawFormatNeon.cpp, built with NEON enabled on 32bit ARM.
+#if defined(__arm__) || defined(__aarch64__)
+#define QCAMERA_RAW_FORMAT_NEON
+void unpackQcom10RowNeon(const uint8_t *src, uint16_t *dst, int width);
+void unpackMipi10RowNeon(const uint8_t *src, uint16_t *dst, int width);
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+#define QCAMERA_RAW_FORMAT_SSE2
+#define QCAMERA_RAW_FORMAT_SSSE3
+void unpackQcom10RowSse2(const uint8_t *src, uint16_t *dst, int width);
+void unpackMipi10RowSsse3(const uint8_t *src, uint16_t *dst, int width);
+#endif
+
+// Leading MIPI raw10 group pairs of a row that 16 byte loads can cover
+int getMipi10VectorPairs(int width);
+
+// Best row unpacker of @packing for the running CPU, picked once
+raw_unpack_row_fn getRawRowUnpacker(qcamera_raw_packing_t packing);
+
+// Pack one row of 16bit pixels, only the low 10/12 bits of each pixel
+// are kept. Pixels of a partial last group past @width are zeroed.
+void packMipi10Row(const uint16_t *src, uint8_t *dst, int width);
+void packMipi12Row(const uint16_t *src, uint8_t *dst, int width);
+
+// Subtract black level from one row of 16bit pixels, clamping at 0.
+// @black0 applies to even columns, @black1 to odd columns.
+void subtractBlackLevelRow(uint16_t *row, int width,
+                           uint16_t black0, uint16_t black1);
+
+typedef void (*raw_black_level_row_fn)(uint16_t *row, int width,
+                                       uint16_t black0, uint16_t black1);
+
+void subtractBlackLevelRowC(uint16_t *row, int width,
+                            uint16_t black0, uint16_t black1);
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+void subtractBlackLevelRowNeon(uint16_t *row, int width,
+                               uint16_t black0, uint16_t black1);
+#endif
+#if defined(QCAMERA_RAW_FORMAT_SSE2)
+void subtractBlackLevelRowSse2(uint16_t *row, int width,
+                               uint16_t black0, uint16_t black1);
+#endif
+
+// Subtract per channel black level from a 16bit bayer frame. @black is
+// in 2x2 CFA order: row 0 col 0, row 0 col 1, row 1 col 0, row 1 col 1.
+// @stride is in pixels.
+void subtractBlackLevel(uint16_t *buf, int width, int height, int stride,
+                        const uint16_t black[4]);
+
+/* max num of helper threads used by QCameraRaw16Converter */
+#define RAW16_CONVERTER_MAX_THREADS 3
+
+// In place packed raw to 16bit frame converter. Rows are spread over a
+// small pool of helper threads plus the calling thread. Since 16bit rows
+// are longer than packed rows, frame is converted in bands from bottom to
+// top, where every row of a band writes past the packed data of all rows
+// not converted yet, so rows inside a band are independent.
+class QCameraRaw16Converter {
+public:
+    QCameraRaw16Converter();
+    ~QCameraRaw16Converter();
+
+    // @srcStride in bytes, @raw16Stride in pixels.
+    // Returns false if the frame is left packed.
+    bool convert(void *buf, int width, int height,
+                 int srcStride, int raw16Stride,
+                 qcamera_raw_packing_t packing = RAW_PACKING_QCOM_10);
+
+private:
+    static void *workerRoutine(void *data);
+    void launchWorkers();
+    void convertBand(int begin, int end);
+    void runRows();
+
+    int mNumWorkers;
+    pthread_t mWorkers[RAW16_CONVERTER_MAX_THREADS];
+    pthread_mutex_t mLock;
+    pthread_cond_t mJobCond;     // signals new band or exit to workers
+    pthread_cond_t mDoneCond;    // signals band completion to caller
+    uint32_t mGeneration;        // bumped for each band posted to workers
+    int mActive;                 // workers still busy on current band
+    bool mExit;
+
+    // current band, read by workers after mGeneration changes
+    raw_unpack_row_fn mUnpackRow;
+    uint8_t *mBuf;
+    int mWidth;
+    int mSrcStride;
+    int mRaw16Stride;
+    int mBandBegin;
+    int mBandEnd;
+    int mNextRow;                // next row to claim, atomic
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_RAW_FORMAT_H__ */
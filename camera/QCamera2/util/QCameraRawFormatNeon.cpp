@@ -0,0 +1,155 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include "QCameraRawFormat.h"
+
+#if defined(QCAMERA_RAW_FORMAT_NEON)
+
+#include <arm_neon.h>
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : unpackQcom10RowNeon
+ *
+ * DESCRIPTION: NEON opaque raw10 row unpacker. Two words (12 pixels) are
+ *              loaded into a q register, each pixel field is shifted down
+ *              and masked in both 64bit lanes at once, then fields are
+ *              merged into 16bit lanes and stored as 24 bytes.
+ *
+ * PARAMETERS :
+ *   @src     : raw10 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void unpackQcom10RowNeon(const uint8_t *src, uint16_t *dst, int width)
+{
+    int words = (width + 5) / 6;
+    int k = words - 1;
+    const uint64x2_t mask = vdupq_n_u64(0x3FF);
+
+    if (k >= 0 && width % 6) {
+        unpackQcom10RowC(src + 8 * k, dst + 6 * k, width - 6 * k);
+        k--;
+    }
+    for (; k >= 1; k -= 2) {
+        uint16_t *d = dst + 6 * (k - 1);
+        uint64x2_t v = vreinterpretq_u64_u8(vld1q_u8(src + 8 * (k - 1)));
+        // t: p0 p1 p2 p3 of each word, u: p4 p5 0 0 of each word
+        uint64x2_t t = vandq_u64(v, mask);
+        t = vorrq_u64(t, vshlq_n_u64(vandq_u64(vshrq_n_u64(v, 10), mask), 16));
+        t = vorrq_u64(t, vshlq_n_u64(vandq_u64(vshrq_n_u64(v, 20), mask), 32));
+        t = vorrq_u64(t, vshlq_n_u64(vandq_u64(vshrq_n_u64(v, 30), mask), 48));
+        uint64x2_t u = vandq_u64(vshrq_n_u64(v, 40), mask);
+        u = vorrq_u64(u, vshlq_n_u64(vandq_u64(vshrq_n_u64(v, 50), mask), 16));
+
+        uint32x4_t t32 = vreinterpretq_u32_u64(t);
+        uint32x4_t u32 = vreinterpretq_u32_u64(u);
+        // a4a5 b0b1, then b2b3 b4b5
+        uint32x2_t mid = vzip_u32(vget_low_u32(u32), vget_high_u32(t32)).val[0];
+        uint32x2_t hi = vext_u32(vget_high_u32(t32), vget_high_u32(u32), 1);
+        vst1_u16(d, vget_low_u16(vreinterpretq_u16_u64(t)));
+        vst1_u16(d + 4, vreinterpret_u16_u32(mid));
+        vst1_u16(d + 8, vreinterpret_u16_u32(hi));
+    }
+    if (k == 0) {
+        unpackQcom10RowC(src, dst, 6);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackMipi10RowNeon
+ *
+ * DESCRIPTION: NEON MIPI raw10 row unpacker, two groups (8 pixels) per
+ *              iteration. Table lookups spread the msb bytes and the lsb
+ *              byte of each group over 16bit lanes, then per lane shifts
+ *              move each pixel's 2 lsb down.
+ *
+ * PARAMETERS :
+ *   @src     : raw10 row
+ *   @dst     : RAW16 row, may alias @src if dst >= src
+ *   @width   : number of pixels in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void unpackMipi10RowNeon(const uint8_t *src, uint16_t *dst, int width)
+{
+    static const uint8_t msbIdx[8] = { 0, 1, 2, 3, 5, 6, 7, 8 };
+    static const uint8_t lsbIdx[8] = { 4, 4, 4, 4, 9, 9, 9, 9 };
+    static const int16_t lsbShift[8] = { 0, -2, -4, -6, 0, -2, -4, -6 };
+    const uint8x8_t msbTbl = vld1_u8(msbIdx);
+    const uint8x8_t lsbTbl = vld1_u8(lsbIdx);
+    const int16x8_t shift = vld1q_s16(lsbShift);
+    const uint16x8_t mask = vdupq_n_u16(0x3);
+    int pairs = getMipi10VectorPairs(width);
+
+    unpackMipi10RowC(src + 10 * pairs, dst + 8 * pairs, width - 8 * pairs);
+    for (int k = pairs - 1; k >= 0; k--) {
+        uint8x16_t v = vld1q_u8(src + 10 * k);
+        uint8x8x2_t t;
+        t.val[0] = vget_low_u8(v);
+        t.val[1] = vget_high_u8(v);
+        uint16x8_t msb = vshlq_n_u16(vmovl_u8(vtbl2_u8(t, msbTbl)), 2);
+        uint16x8_t lsb = vshlq_u16(vmovl_u8(vtbl2_u8(t, lsbTbl)), shift);
+        vst1q_u16(dst + 8 * k, vorrq_u16(msb, vandq_u16(lsb, mask)));
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : subtractBlackLevelRowNeon
+ *
+ * DESCRIPTION: NEON black level subtraction of one row of 16bit pixels,
+ *              8 pixels at a time with saturating subtracts
+ *
+ * PARAMETERS :
+ *   @row     : RAW16 row
+ *   @width   : number of pixels in the row
+ *   @black0  : black level of even columns
+ *   @black1  : black level of odd columns
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void subtractBlackLevelRowNeon(uint16_t *row, int width,
+                               uint16_t black0, uint16_t black1)
+{
+    int x = 0;
+    const uint16_t pattern[8] = { black0, black1, black0, black1,
+                                  black0, black1, black0, black1 };
+    const uint16x8_t black = vld1q_u16(pattern);
+    for (; x + 8 <= width; x += 8) {
+        vst1q_u16(row + x, vqsubq_u16(vld1q_u16(row + x), black));
+    }
+    subtractBlackLevelRowC(row + x, width - x, black0, black1);
+}
+
+}; // namespace qcamera
+
+#endif
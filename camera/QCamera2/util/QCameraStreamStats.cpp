@@ -0,0 +1,311 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#define LOG_TAG "QCameraStreamStats"
+
+#include <utils/Log.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraStreamStats.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : updateMax
+ *
+ * DESCRIPTION: raise a max counter to @val
+ *
+ * PARAMETERS :
+ *   @max     : ptr to the max counter
+ *   @val     : new sample
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static inline void updateMax(int64_t *max, int64_t val)
+{
+    int64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (val > cur &&
+           !__atomic_compare_exchange_n(max, &cur, val, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : now
+ *
+ * DESCRIPTION: monotonic timestamp used for all stats
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : time in ns
+ *==========================================================================*/
+int64_t QCameraStreamStats::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraStreamStats
+ *
+ * DESCRIPTION: constructor of QCameraStreamStats
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraStreamStats::QCameraStreamStats()
+{
+    reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: clear all stats, called when stream starts
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStreamStats::reset()
+{
+    mFramesReceived = 0;
+    mFramesDropped = 0;
+    mFramesSkipped = 0;
+    mLastFrameIdx = 0;
+    mLastArrival = 0;
+    mAvgInterval = 0;
+    memset(mJitterHist, 0, sizeof(mJitterHist));
+    memset(mBufArrival, 0, sizeof(mBufArrival));
+    mReturnCnt = 0;
+    mReturnSum = 0;
+    mReturnMax = 0;
+    mCbCnt = 0;
+    mCbSum = 0;
+    mCbMax = 0;
+    mFpsLastCount = 0;
+    mFpsLastTime = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*===========================================================================
+ * FUNCTION   : frameReceived
+ *
+ * DESCRIPTION: account a frame arriving from mm-camera-interface. Only
+ *              called from the data notify thread of the stream.
+ *
+ * PARAMETERS :
+ *   @frameIdx: frame index from the buffer
+ *   @bufIdx  : buffer index, its return latency is measured from now
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStreamStats::frameReceived(uint32_t frameIdx, int bufIdx)
+{
+    int64_t t = now();
+    uint32_t cnt = __atomic_add_fetch(&mFramesReceived, 1, __ATOMIC_RELAXED);
+
+    if (cnt > 1) {
+        if (frameIdx > mLastFrameIdx + 1) {
+            __atomic_fetch_add(&mFramesSkipped, frameIdx - mLastFrameIdx - 1,
+                               __ATOMIC_RELAXED);
+        }
+
+        int64_t interval = t - mLastArrival;
+        int64_t avg = (cnt == 2) ? interval :
+            mAvgInterval + (interval - mAvgInterval) / 8;
+        int64_t dev = interval - avg;
+        if (dev < 0) {
+            dev = -dev;
+        }
+        int bucket = 0;
+        for (int64_t ms = dev / 1000000; ms > 0 &&
+             bucket < QCAMERA_STATS_JITTER_BUCKETS - 1; ms >>= 1) {
+            bucket++;
+        }
+        __atomic_fetch_add(&mJitterHist[bucket], 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&mAvgInterval, avg, __ATOMIC_RELAXED);
+    }
+    mLastFrameIdx = frameIdx;
+    mLastArrival = t;
+
+    if (bufIdx >= 0 && bufIdx < CAM_MAX_NUM_BUFS_PER_STREAM) {
+        __atomic_store_n(&mBufArrival[bufIdx], t, __ATOMIC_RELAXED);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : frameDropped
+ *
+ * DESCRIPTION: account a received frame dropped by HAL before the stream
+ *              callback
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStreamStats::frameDropped()
+{
+    __atomic_fetch_add(&mFramesDropped, 1, __ATOMIC_RELAXED);
+}
+
+/*===========================================================================
+ * FUNCTION   : bufReturned
+ *
+ * DESCRIPTION: account a buffer returned to kernel, sampling the time it
+ *              was held since its frame arrived
+ *
+ * PARAMETERS :
+ *   @bufIdx  : buffer index
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStreamStats::bufReturned(int bufIdx)
+{
+    if (bufIdx < 0 || bufIdx >= CAM_MAX_NUM_BUFS_PER_STREAM) {
+        return;
+    }
+    // 0 if buffer was never delivered, e.g. initial queueing
+    int64_t arrival = __atomic_exchange_n(&mBufArrival[bufIdx], 0,
+                                          __ATOMIC_RELAXED);
+    if (arrival == 0) {
+        return;
+    }
+    int64_t latency = now() - arrival;
+    __atomic_fetch_add(&mReturnCnt, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mReturnSum, latency, __ATOMIC_RELAXED);
+    updateMax(&mReturnMax, latency);
+}
+
+/*===========================================================================
+ * FUNCTION   : callbackDone
+ *
+ * DESCRIPTION: account time spent in the stream callback
+ *
+ * PARAMETERS :
+ *   @startNs : now() when the callback was entered
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStreamStats::callbackDone(int64_t startNs)
+{
+    int64_t spent = now() - startNs;
+    __atomic_fetch_add(&mCbCnt, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mCbSum, spent, __ATOMIC_RELAXED);
+    updateMax(&mCbMax, spent);
+}
+
+/*===========================================================================
+ * FUNCTION   : sampleFps
+ *
+ * DESCRIPTION: frame rate since last sample, once the sampling window of
+ *              QCAMERA_STATS_FPS_WINDOW_NS has passed. Meant to be called
+ *              from a single thread, e.g. the stream callback.
+ *
+ * PARAMETERS :
+ *   @fps     : frames per second, valid if true is returned
+ *
+ * RETURN     : true if a new sample is available
+ *==========================================================================*/
+bool QCameraStreamStats::sampleFps(float &fps)
+{
+    int64_t t = now();
+    uint32_t cnt = __atomic_load_n(&mFramesReceived, __ATOMIC_RELAXED);
+    if (mFpsLastTime == 0) {
+        // first call only opens the window
+        mFpsLastCount = cnt;
+        mFpsLastTime = t;
+        return false;
+    }
+    int64_t diff = t - mFpsLastTime;
+    if (diff <= QCAMERA_STATS_FPS_WINDOW_NS) {
+        return false;
+    }
+    fps = (float)(cnt - mFpsLastCount) * 1000000000.0f / (float)diff;
+    mFpsLastCount = cnt;
+    mFpsLastTime = t;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : dump
+ *
+ * DESCRIPTION: write stats as text
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *   @name    : stream name printed in front of the stats
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStreamStats::dump(int fd, const char *name)
+{
+    char buf[512];
+    int len = 0;
+    uint32_t returnCnt = __atomic_load_n(&mReturnCnt, __ATOMIC_RELAXED);
+    uint32_t cbCnt = __atomic_load_n(&mCbCnt, __ATOMIC_RELAXED);
+    int64_t returnSum = __atomic_load_n(&mReturnSum, __ATOMIC_RELAXED);
+    int64_t cbSum = __atomic_load_n(&mCbSum, __ATOMIC_RELAXED);
+
+    len += snprintf(buf + len, sizeof(buf) - len,
+        "  %s: received %u, dropped %u, skipped %u, avg interval %.2f ms\n",
+        name,
+        __atomic_load_n(&mFramesReceived, __ATOMIC_RELAXED),
+        __atomic_load_n(&mFramesDropped, __ATOMIC_RELAXED),
+        __atomic_load_n(&mFramesSkipped, __ATOMIC_RELAXED),
+        __atomic_load_n(&mAvgInterval, __ATOMIC_RELAXED) / 1000000.0);
+    len += snprintf(buf + len, sizeof(buf) - len,
+        "    jitter ms <1:%u <2:%u <4:%u <8:%u <16:%u <32:%u <64:%u >=64:%u\n",
+        __atomic_load_n(&mJitterHist[0], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[1], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[2], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[3], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[4], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[5], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[6], __ATOMIC_RELAXED),
+        __atomic_load_n(&mJitterHist[7], __ATOMIC_RELAXED));
+    len += snprintf(buf + len, sizeof(buf) - len,
+        "    buf return ms avg %.2f max %.2f, callback ms avg %.2f max %.2f\n",
+        returnCnt ? returnSum / 1000000.0 / returnCnt : 0.0,
+        __atomic_load_n(&mReturnMax, __ATOMIC_RELAXED) / 1000000.0,
+        cbCnt ? cbSum / 1000000.0 / cbCnt : 0.0,
+        __atomic_load_n(&mCbMax, __ATOMIC_RELAXED) / 1000000.0);
+    if (len > (int)sizeof(buf) - 1) {
+        len = sizeof(buf) - 1;
+    }
+    if (write(fd, buf, len) != len) {
+        ALOGE("%s: failed to write stats of %s", __func__, name);
+    }
+}
+
+}; // namespace qcamera
@@ -0,0 +1,86 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_STREAM_STATS_H__
+#define __QCAMERA_STREAM_STATS_H__
+
+#include <stdint.h>
+#include "cam_types.h"
+
+namespace qcamera {
+
+/* inter-frame jitter buckets: [0,1) [1,2) [2,4) ... [64,inf) ms */
+#define QCAMERA_STATS_JITTER_BUCKETS 8
+/* min window over which sampleFps computes a rate */
+#define QCAMERA_STATS_FPS_WINDOW_NS  250000000LL
+
+// Per stream frame statistics. Counters are updated with relaxed atomics
+// from the data notify, stream and buffer return threads, so reading them
+// is cheap and always on; a dump may mix values of adjacent frames.
+class QCameraStreamStats {
+public:
+    QCameraStreamStats();
+
+    void reset();
+    void frameReceived(uint32_t frameIdx, int bufIdx);
+    void frameDropped();
+    void bufReturned(int bufIdx);
+    void callbackDone(int64_t startNs);
+    bool sampleFps(float &fps);
+    void dump(int fd, const char *name);
+
+    static int64_t now();
+
+private:
+    uint32_t mFramesReceived;
+    uint32_t mFramesDropped;       // dropped in HAL
+    uint32_t mFramesSkipped;       // frame_idx gaps, not delivered to HAL
+    uint32_t mLastFrameIdx;
+
+    int64_t mLastArrival;          // ns
+    int64_t mAvgInterval;          // ns, moving average of 8 frames
+    uint32_t mJitterHist[QCAMERA_STATS_JITTER_BUCKETS];
+
+    int64_t mBufArrival[CAM_MAX_NUM_BUFS_PER_STREAM];
+    uint32_t mReturnCnt;
+    int64_t mReturnSum;            // ns
+    int64_t mReturnMax;            // ns
+
+    uint32_t mCbCnt;
+    int64_t mCbSum;                // ns
+    int64_t mCbMax;                // ns
+
+    // fps sampling window
+    uint32_t mFpsLastCount;
+    int64_t mFpsLastTime;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_STREAM_STATS_H__ */
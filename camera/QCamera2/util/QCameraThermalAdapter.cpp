@@ -32,8 +32,8 @@
 #include <dlfcn.h>
 #include <stdlib.h>
 #include <utils/Errors.h>
+#include <utils/Log.h>
 
-#include "QCamera2HWI.h"
 #include "QCameraThermalAdapter.h"
 
 using namespace android;